@@ -71,13 +71,11 @@ int  main(
     STRING     input_filename, output_filename, label_filename;
     STRING     argument;
     int        clobber_mode, a, in_minc_id, out_minc_id, value;
-    int        i, n_excluded, label_lookup_var;
+    int        n_excluded, label_lookup_var;
     BOOLEAN    label_specified;
     STRING     label_string;
-    int        n_labels;
-    int        *values;
-    STRING     *labels;
     FILE       *file;
+    label_table_struct  table;
 
     /* --- initialize the information that will be in the arguments */
 
@@ -142,7 +140,7 @@ int  main(
 
     /* --- read the label lookup from the minc file */
 
-    if( !read_label_lookup( in_minc_id, &n_labels, &values, &labels ) )
+    if( !read_label_table( in_minc_id, &table ) )
     {
         print_error( "Error reading current label lookup.\n" );
         return( 1 );
@@ -175,13 +173,11 @@ int  main(
 
             if( string_length( argv[a+1] ) > 0 )
             {
-                add_label_to_list( &n_labels, &values, &labels,
-                                   value, argv[a+1] );
+                add_label_to_table( &table, value, argv[a+1] );
             }
             else
             {
-                delete_label_from_list( &n_labels, &values, &labels,
-                                        value );
+                (void) delete_label_from_table( &table, value );
             }
         }
     }
@@ -209,13 +205,11 @@ int  main(
 
             if( string_length( label_string ) > 0 )
             {
-                add_label_to_list( &n_labels, &values, &labels,
-                                   value, label_string );
+                add_label_to_table( &table, value, label_string );
             }
             else
             {
-                delete_label_from_list( &n_labels, &values, &labels,
-                                        value );
+                (void) delete_label_from_table( &table, value );
             }
         }
 
@@ -240,7 +234,7 @@ int  main(
 
     /* --- output the label lookup to the output file */
 
-    if( !write_label_lookup( out_minc_id, n_labels, values, labels ) )
+    if( !write_label_table( out_minc_id, &table ) )
         print_error( "Error writing label lookup.\n" );
 
     (void) ncendef( out_minc_id );
@@ -257,14 +251,7 @@ int  main(
 
     /* --- free up the memory */
 
-    if( n_labels > 0 )
-    {
-        for_less( i, 0, n_labels )
-            FREE( labels[i] );
-
-        FREE( values );
-        FREE( labels );
-    }
+    delete_label_table( &table );
 
     return( 0 );
 }
@@ -1,4 +1,7 @@
+#include  <volume_io/internal_volume_io.h>
 #include  <bicpl.h>
+#include  <volume_derivatives.h>
+#include  <volume_pyramid.h>
 
 int  main(
     int   argc,
@@ -8,9 +11,10 @@ int  main(
     STRING     input_filename, output_filename;
     char       history[EXTREMELY_LARGE_STRING_SIZE];
     int        x_size, y_size, z_size, sizes[MAX_DIMENSIONS];
-    int        n_voxels, x, y, z, i, j, k;
-    int        end_x, end_y, end_z;
-    Real       value, voxel_value, avg;
+    int        x, y, z, dim, block_sizes[N_DIMENSIONS];
+    int        n_blocks[N_DIMENSIONS];
+    Real       ratios[N_DIMENSIONS];
+    float      *values, *block_values;
 
     initialize_argument_processing( argc, argv );
 
@@ -18,7 +22,8 @@ int  main(
         !get_string_argument( "", &output_filename ) ||
         !get_int_argument( 0, &x_size ) ||
         !get_int_argument( 0, &y_size ) ||
-        !get_int_argument( 0, &z_size ) )
+        !get_int_argument( 0, &z_size ) ||
+        x_size <= 0 || y_size <= 0 || z_size <= 0 )
     {
         print( "Usage: %s input.mnc output.mnc  nx_voxels_per_block ny_voxels_per_block nz_voxels_per_block\n", argv[0] );
         return( 1 );
@@ -33,48 +38,43 @@ int  main(
 
     get_volume_sizes( volume, sizes );
 
-    /*--- compute the number of voxels in each average */
+    /*--- average each block, the blocks at the high edges holding only
+          the voxels inside the volume */
 
-    n_voxels = x_size * y_size * z_size;
+    block_sizes[X] = x_size;
+    block_sizes[Y] = y_size;
+    block_sizes[Z] = z_size;
 
-    /*--- step through volume in steps of averaging size */
+    for_less( dim, 0, N_DIMENSIONS )
+    {
+        ratios[dim] = (Real) block_sizes[dim];
+        n_blocks[dim] = (sizes[dim] + block_sizes[dim] - 1) / block_sizes[dim];
+    }
+
+    ALLOC( values, sizes[X] * sizes[Y] * sizes[Z] );
+    ALLOC( block_values, n_blocks[X] * n_blocks[Y] * n_blocks[Z] );
+
+    get_volume_float_values( volume, values );
 
-    for( x = 0;  x < sizes[X];  x += x_size )
+    downsample_float_values( sizes, values, ratios, n_blocks, BOX_FILTER,
+                             block_values );
+
+    /*--- store the average in the block of voxels */
+
+    for_less( x, 0, sizes[X] )
+    for_less( y, 0, sizes[Y] )
+    for_less( z, 0, sizes[Z] )
     {
-        end_x = MIN( sizes[X], x + x_size );
-        for( y = 0;  y < sizes[Y];  y += y_size )
-        {
-            end_y = MIN( sizes[Y], y + y_size );
-            for( z = 0;  z < sizes[Z];  z += z_size )
-            {
-                end_z = MIN( sizes[Z], z + z_size );
-
-                /*--- get the average of the block of voxels */
-
-                avg = 0.0;
-                for_less( i, x, end_x )
-                for_less( j, y, end_y )
-                for_less( k, z, end_z )
-                {
-                    value = get_volume_real_value( volume, i, j, k, 0, 0 );
-                    avg += value;
-                }
-
-                avg /= (Real) n_voxels;
-                voxel_value = convert_value_to_voxel( volume, avg );
-
-                /*--- store the average in the block of voxels */
-
-                for_less( i, x, end_x )
-                for_less( j, y, end_y )
-                for_less( k, z, end_z )
-                {
-                    set_volume_real_value( volume, i, j, k, 0, 0, voxel_value );
-                }
-            }
-        }
+        values[IJK(x,y,z,sizes[Y],sizes[Z])] =
+               block_values[IJK(x/x_size,y/y_size,z/z_size,
+                                n_blocks[Y],n_blocks[Z])];
     }
 
+    set_volume_float_values( volume, values );
+
+    FREE( values );
+    FREE( block_values );
+
     (void) sprintf( history, "%s %s %s %d %d %d\n",
                     argv[0], input_filename, output_filename,
                     x_size, y_size, z_size );
@@ -1,5 +1,6 @@
 #include  <volume_io/internal_volume_io.h>
 #include  <special_geometry.h>
+#include  <tag_index.h>
 
 private  void  usage(
     STRING  executable )
@@ -18,14 +19,16 @@ int  main(
 {
     STRING               input_tags_filename, output_tags_filename;
     STRING               axis_name;
-    int                  tag, axis;
+    int                  axis, dim, n_alloced, *found;
     Real                 min_pos, max_pos;
+    Real                 box_min[N_DIMENSIONS], box_max[N_DIMENSIONS];
     int                  n_volumes, n_tag_points, *structure_ids, *patient_ids;
     Real                 **tags1, **tags2, *weights;
     STRING               *labels;
     int                  n_new_tags, *new_structure_ids, *new_patient_ids;
     Real                 **new_tags1, **new_tags2, *new_weights;
     STRING               *new_labels;
+    tag_index            index;
 
     initialize_argument_processing( argc, argv );
 
@@ -41,12 +44,13 @@ int  main(
                         &patient_ids, &labels ) != OK )
         return( 1 );
 
-    new_structure_ids = NULL;
-    new_patient_ids = NULL;
-    new_tags1 = NULL;
-    new_tags2 = NULL;
-    new_weights = NULL;
-    new_labels = NULL;
+    /*--- successive limits intersect, so they reduce to a single box */
+
+    for_less( dim, 0, N_DIMENSIONS )
+    {
+        box_min[dim] = -1.0e30;
+        box_max[dim] = 1.0e30;
+    }
 
     while( get_string_argument( NULL, &axis_name ) &&
            get_real_argument( 0.0, &min_pos ) &&
@@ -61,59 +65,36 @@ int  main(
 
         axis = (int) (axis_name[0] - 'x');
 
-        n_new_tags = 0;
-
-        for_less( tag, 0, n_tag_points )
-        {
-            if( tags1[tag][axis] >= min_pos && tags1[tag][axis] <= max_pos )
-            {
-                SET_ARRAY_SIZE( new_tags1, n_new_tags, n_new_tags+1, 10 );
-                ALLOC( new_tags1[n_new_tags], 3 );
-
-                SET_ARRAY_SIZE( new_weights, n_new_tags, n_new_tags+1, 10 );
-                SET_ARRAY_SIZE( new_structure_ids, n_new_tags, n_new_tags+1,10);
-                SET_ARRAY_SIZE( new_patient_ids, n_new_tags, n_new_tags+1, 10 );
-
-                SET_ARRAY_SIZE( new_labels, n_new_tags, n_new_tags+1, 10 );
-
-                /*--- copy from the input tags to the new tags */
-
-                new_tags1[n_new_tags][0] = tags1[tag][0];
-                new_tags1[n_new_tags][1] = tags1[tag][1];
-                new_tags1[n_new_tags][2] = tags1[tag][2];
+        box_min[axis] = MAX( box_min[axis], min_pos );
+        box_max[axis] = MIN( box_max[axis], max_pos );
+    }
 
-                if( n_volumes == 2 )
-                {
-                    SET_ARRAY_SIZE( new_tags2, n_new_tags, n_new_tags+1, 10 );
-                    ALLOC( new_tags2[n_new_tags], 3 );
+    index = create_tag_index( n_tag_points, tags1 );
 
-                    new_tags2[n_new_tags][0] = tags2[tag][0];
-                    new_tags2[n_new_tags][1] = tags2[tag][1];
-                    new_tags2[n_new_tags][2] = tags2[tag][2];
-                }
+    n_alloced = 0;
+    n_new_tags = tag_index_find_in_box( index, box_min, box_max,
+                                        &n_alloced, &found );
 
-                new_weights[n_new_tags] = weights[tag];
-                new_structure_ids[n_new_tags] = structure_ids[tag];
-                new_patient_ids[n_new_tags] = patient_ids[tag];
-                new_labels[n_new_tags] = create_string( labels[tag] );
+    delete_tag_index( index );
 
-                /*--- increment the number of new tags */
+    extract_tag_subset( n_volumes, n_new_tags, found,
+                        tags1, tags2, weights, structure_ids, patient_ids,
+                        labels, &new_tags1, &new_tags2, &new_weights,
+                        &new_structure_ids, &new_patient_ids, &new_labels );
 
-                ++n_new_tags;
-            }
-        }
+    if( n_alloced > 0 )
+        FREE( found );
 
-        free_tag_points( n_volumes, n_tag_points, tags1, tags2,
-                         weights, structure_ids, patient_ids, labels );
+    free_tag_points( n_volumes, n_tag_points, tags1, tags2,
+                     weights, structure_ids, patient_ids, labels );
 
-        n_tag_points = n_new_tags;
-        tags1 = new_tags1;
-        tags2 = new_tags2;
-        weights = new_weights;
-        structure_ids = new_structure_ids;
-        patient_ids = new_patient_ids;
-        labels = new_labels;
-    }
+    n_tag_points = n_new_tags;
+    tags1 = new_tags1;
+    tags2 = new_tags2;
+    weights = new_weights;
+    structure_ids = new_structure_ids;
+    patient_ids = new_patient_ids;
+    labels = new_labels;
 
     if( output_tag_file( output_tags_filename, "Chopped off some tags",
                          n_volumes, n_tag_points, tags1, tags2,
@@ -1,5 +1,6 @@
 #include  <volume_io/internal_volume_io.h>
 #include  <special_geometry.h>
+#include  <tag_index.h>
 
 #define  X_FACTOR  5.0
 #define  Y_FACTOR  5.0
@@ -49,7 +50,7 @@ int  main(
     STRING               three_tags_filename, input_tags_filename;
     STRING               output_tags_filename, plane_filename;
     STRING               volume_filename;
-    Real                 min_dist, max_dist, dist, voxel_volume;
+    Real                 min_dist, max_dist, voxel_volume;
     Real                 angle_increment, angle_offset;
     int                  i, n_objects, plane_status;
     Point                points[3], origin, point, centroid;
@@ -65,6 +66,9 @@ int  main(
     int                  n_new_tags, *new_structure_ids, *new_patient_ids;
     Real                 **new_tags1, **new_tags2, *new_weights;
     STRING               *new_labels;
+    int                  n_alloced, *found;
+    Real                 normal_coords[N_DIMENSIONS];
+    tag_index            index;
 #ifdef PROGRESS
     progress_struct      progress;
 #endif
@@ -165,59 +169,31 @@ int  main(
                             "Clipping" );
 #endif
 
-    new_tags1 = NULL;
-    new_tags2 = NULL;
-    new_weights = NULL;
-    new_structure_ids = NULL;
-    new_patient_ids = NULL;
-    new_labels = NULL;
+    /*--- select the tags between the planes */
 
-    for_less( i, 0, n_tag_points )
-    {
-        fill_Point( point, tags1[i][X], tags1[i][Y], tags1[i][Z] );
-
-        dist = distance_from_plane( &point, &normal,
-                                    -DOT_POINT_VECTOR(origin,normal) );
-
-        if( dist >= min_dist && dist <= max_dist )
-        {
-            /*--- increase the memory allocation of the tag points */
-
-            SET_ARRAY_SIZE( new_tags1, n_new_tags, n_new_tags+1, 10 );
-            ALLOC( new_tags1[n_new_tags], 3 );
+    normal_coords[X] = (Real) Vector_x(normal);
+    normal_coords[Y] = (Real) Vector_y(normal);
+    normal_coords[Z] = (Real) Vector_z(normal);
 
-            SET_ARRAY_SIZE( new_weights, n_new_tags, n_new_tags+1, 10 );
-            SET_ARRAY_SIZE( new_structure_ids, n_new_tags, n_new_tags+1, 10 );
-            SET_ARRAY_SIZE( new_patient_ids, n_new_tags, n_new_tags+1, 10 );
+    index = create_tag_index( n_tag_points, tags1 );
 
-            SET_ARRAY_SIZE( new_labels, n_new_tags, n_new_tags+1, 10 );
+    n_alloced = 0;
+    n_new_tags = tag_index_find_between_planes( index, normal_coords,
+                                      -DOT_POINT_VECTOR(origin,normal),
+                                      min_dist, max_dist, &n_alloced, &found );
 
-            /*--- copy from the input tags to the new tags */
+    delete_tag_index( index );
 
-            new_tags1[n_new_tags][0] = tags1[i][0];
-            new_tags1[n_new_tags][1] = tags1[i][1];
-            new_tags1[n_new_tags][2] = tags1[i][2];
+    extract_tag_subset( n_volumes, n_new_tags, found,
+                        tags1, tags2, weights, structure_ids, patient_ids,
+                        labels, &new_tags1, &new_tags2, &new_weights,
+                        &new_structure_ids, &new_patient_ids, &new_labels );
 
-            if( n_volumes == 2 )
-            {
-                SET_ARRAY_SIZE( new_tags2, n_new_tags, n_new_tags+1, 10 );
-                ALLOC( new_tags2[n_new_tags], 3 );
-
-                new_tags2[n_new_tags][0] = tags2[i][0];
-                new_tags2[n_new_tags][1] = tags2[i][1];
-                new_tags2[n_new_tags][2] = tags2[i][2];
-            }
-
-            new_weights[n_new_tags] = weights[i];
-            new_structure_ids[n_new_tags] = structure_ids[i];
-            new_patient_ids[n_new_tags] = patient_ids[i];
-            new_labels[n_new_tags] = create_string( labels[i] );
-
-            /*--- increment the number of new tags */
-
-            ++n_new_tags;
-        }
+    if( n_alloced > 0 )
+        FREE( found );
 
+    for_less( i, 0, n_tag_points )
+    {
         if( volume_desired )
         {
             plane_status = get_voxel_plane_status( vol,
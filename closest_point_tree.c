@@ -0,0 +1,546 @@
+#include  <volume_io/internal_volume_io.h>
+#include  <closest_point_tree.h>
+#include  <triangle_tree.h>
+
+/*--- closest points and signed distances to a triangulated surface, from a
+      bounding volume hierarchy built with the surface area heuristic.  The
+      sign comes from the angle weighted pseudo-normal of the closest
+      feature, vertex, edge or face, so no rays need to be cast. */
+
+#define  MAX_TRIANGLES_IN_LEAF   4
+
+/*--- features of a triangle which may hold the closest point */
+
+#define  EDGE_FEATURE            3
+#define  FACE_FEATURE            6
+
+struct  closest_point_tree_struct
+{
+    triangle_tree_struct  triangles;
+    Real                  *normals;
+    Real                  (*vertex_normals)[N_DIMENSIONS];
+    int                   *stack_nodes;
+    Real                  *stack_dists;
+};
+
+/*--- corners of triangle t in tree order, and its face normal followed by
+      the pseudo-normals of its edges */
+
+#define  CORNER( tree, t, k )   TRIANGLE_CORNER( &(tree)->triangles, t, k )
+#define  NORMAL( tree, t, k )   (&(tree)->normals[((t)*4+(k))*N_DIMENSIONS])
+
+typedef  struct
+{
+    int   v0, v1;
+    int   triangle;
+    int   edge;
+} edge_record;
+
+private  int  compare_edges(
+    const void   *e1,
+    const void   *e2 )
+{
+    const edge_record   *a, *b;
+
+    a = (const edge_record *) e1;
+    b = (const edge_record *) e2;
+
+    if( a->v0 != b->v0 )
+        return( a->v0 < b->v0 ? -1 : 1 );
+    else if( a->v1 != b->v1 )
+        return( a->v1 < b->v1 ? -1 : 1 );
+    else
+        return( 0 );
+}
+
+/* ----------------------------- MNI Header -----------------------------------
+@NAME       : create_closest_point_tree
+@INPUT      : polygons
+@OUTPUT     :
+@RETURNS    : tree
+@DESCRIPTION: Builds the hierarchy used to find closest points on the
+              polygons, which are split into triangles around their first
+              vertex, and computes the pseudo-normals of their vertices and
+              edges.  Signed distances are positive on the side the polygon
+              normals point to, so the surface should be closed and
+              consistently oriented.
+@METHOD     :
+@GLOBALS    :
+@CALLS      :
+@CREATED    :
+@MODIFIED   :
+---------------------------------------------------------------------------- */
+
+public  closest_point_tree  create_closest_point_tree(
+    polygons_struct  *polygons )
+{
+    closest_point_tree   tree;
+    int                  t, i, dim, n_triangles, run_start, run_end;
+    int                  *vertices;
+    Real                 *normals, e1[3], e2[3], len, dot;
+    Real                 angle, sum[N_DIMENSIONS], *c0, *c1, *c2;
+    edge_record          *edges;
+
+    ALLOC( tree, 1 );
+
+    create_triangle_tree( polygons, MAX_TRIANGLES_IN_LEAF,
+                          &tree->triangles );
+
+    n_triangles = tree->triangles.n_triangles;
+
+    if( n_triangles == 0 )
+        return( tree );
+
+    vertices = tree->triangles.vertices;
+
+    ALLOC( tree->normals, 12 * n_triangles );
+    ALLOC( tree->vertex_normals, polygons->n_points );
+
+    normals = tree->normals;
+
+    for_less( i, 0, polygons->n_points )
+    {
+        for_less( dim, 0, N_DIMENSIONS )
+            tree->vertex_normals[i][dim] = 0.0;
+    }
+
+    for_less( t, 0, n_triangles )
+    {
+        c0 = CORNER( tree, t, 0 );
+        c1 = CORNER( tree, t, 1 );
+        c2 = CORNER( tree, t, 2 );
+
+        for_less( dim, 0, N_DIMENSIONS )
+        {
+            e1[dim] = c1[dim] - c0[dim];
+            e2[dim] = c2[dim] - c0[dim];
+        }
+
+        normals[t*12+X] = e1[Y] * e2[Z] - e1[Z] * e2[Y];
+        normals[t*12+Y] = e1[Z] * e2[X] - e1[X] * e2[Z];
+        normals[t*12+Z] = e1[X] * e2[Y] - e1[Y] * e2[X];
+
+        len = sqrt( normals[t*12+X] * normals[t*12+X] +
+                    normals[t*12+Y] * normals[t*12+Y] +
+                    normals[t*12+Z] * normals[t*12+Z] );
+
+        for_less( dim, 0, N_DIMENSIONS )
+        {
+            if( len > 0.0 )
+                normals[t*12+dim] /= len;
+            else
+                normals[t*12+dim] = 0.0;
+        }
+    }
+
+    /*--- vertex pseudo-normals weight the face normals by the angles of
+          the faces at the vertex */
+
+    for_less( t, 0, n_triangles )
+    {
+        for_less( i, 0, 3 )
+        {
+            c0 = CORNER( tree, t, i );
+            c1 = CORNER( tree, t, (i+1)%3 );
+            c2 = CORNER( tree, t, (i+2)%3 );
+
+            for_less( dim, 0, N_DIMENSIONS )
+            {
+                e1[dim] = c1[dim] - c0[dim];
+                e2[dim] = c2[dim] - c0[dim];
+            }
+
+            len = sqrt( (e1[X] * e1[X] + e1[Y] * e1[Y] + e1[Z] * e1[Z]) *
+                        (e2[X] * e2[X] + e2[Y] * e2[Y] + e2[Z] * e2[Z]) );
+
+            if( len <= 0.0 )
+                continue;
+
+            dot = (e1[X] * e2[X] + e1[Y] * e2[Y] + e1[Z] * e2[Z]) / len;
+            if( dot > 1.0 )
+                dot = 1.0;
+            else if( dot < -1.0 )
+                dot = -1.0;
+            angle = acos( dot );
+
+            for_less( dim, 0, N_DIMENSIONS )
+                tree->vertex_normals[vertices[t*3+i]][dim] +=
+                                                 angle * normals[t*12+dim];
+        }
+    }
+
+    /*--- edge pseudo-normals sum the normals of the faces sharing the edge,
+          found by sorting the edges by their end points */
+
+    ALLOC( edges, 3 * n_triangles );
+
+    for_less( t, 0, n_triangles )
+    {
+        for_less( i, 0, 3 )
+        {
+            edges[t*3+i].v0 = MIN( vertices[t*3+i], vertices[t*3+(i+1)%3] );
+            edges[t*3+i].v1 = MAX( vertices[t*3+i], vertices[t*3+(i+1)%3] );
+            edges[t*3+i].triangle = t;
+            edges[t*3+i].edge = i;
+        }
+    }
+
+    qsort( (void *) edges, (size_t) (3 * n_triangles), sizeof(edges[0]),
+           compare_edges );
+
+    run_start = 0;
+    while( run_start < 3 * n_triangles )
+    {
+        run_end = run_start + 1;
+        while( run_end < 3 * n_triangles &&
+               compare_edges( &edges[run_start], &edges[run_end] ) == 0 )
+            ++run_end;
+
+        for_less( dim, 0, N_DIMENSIONS )
+            sum[dim] = 0.0;
+
+        for_less( i, run_start, run_end )
+        {
+            for_less( dim, 0, N_DIMENSIONS )
+                sum[dim] += normals[edges[i].triangle*12+dim];
+        }
+
+        for_less( i, run_start, run_end )
+        {
+            for_less( dim, 0, N_DIMENSIONS )
+                normals[edges[i].triangle*12 + (1+edges[i].edge)*3 + dim] =
+                                                                    sum[dim];
+        }
+
+        run_start = run_end;
+    }
+
+    FREE( edges );
+
+    ALLOC( tree->stack_nodes, tree->triangles.max_depth + 2 );
+    ALLOC( tree->stack_dists, tree->triangles.max_depth + 2 );
+
+    return( tree );
+}
+
+public  void  delete_closest_point_tree(
+    closest_point_tree   tree )
+{
+    if( tree->triangles.n_triangles > 0 )
+    {
+        FREE( tree->normals );
+        FREE( tree->vertex_normals );
+        FREE( tree->stack_nodes );
+        FREE( tree->stack_dists );
+    }
+
+    delete_triangle_tree( &tree->triangles );
+
+    FREE( tree );
+}
+
+/*--- closest point to p on the triangle a b c, and which feature it lies
+      on: corners 0 to 2, edges EDGE_FEATURE + 0 to 2 starting at the
+      corner of the same number, or the face (Ericson, Real-Time Collision
+      Detection, 5.1.5) */
+
+private  Real  closest_point_on_triangle(
+    Real   p[],
+    Real   a[],
+    Real   b[],
+    Real   c[],
+    Real   closest[],
+    int    *feature )
+{
+    int    dim;
+    Real   ab[N_DIMENSIONS], ac[N_DIMENSIONS], ap[N_DIMENSIONS];
+    Real   bp[N_DIMENSIONS], cp[N_DIMENSIONS], d, dist_sq;
+    Real   d1, d2, d3, d4, d5, d6, va, vb, vc, v, w, denom;
+
+    for_less( dim, 0, N_DIMENSIONS )
+    {
+        ab[dim] = b[dim] - a[dim];
+        ac[dim] = c[dim] - a[dim];
+        ap[dim] = p[dim] - a[dim];
+        bp[dim] = p[dim] - b[dim];
+        cp[dim] = p[dim] - c[dim];
+    }
+
+    d1 = ab[X] * ap[X] + ab[Y] * ap[Y] + ab[Z] * ap[Z];
+    d2 = ac[X] * ap[X] + ac[Y] * ap[Y] + ac[Z] * ap[Z];
+    d3 = ab[X] * bp[X] + ab[Y] * bp[Y] + ab[Z] * bp[Z];
+    d4 = ac[X] * bp[X] + ac[Y] * bp[Y] + ac[Z] * bp[Z];
+    d5 = ab[X] * cp[X] + ab[Y] * cp[Y] + ab[Z] * cp[Z];
+    d6 = ac[X] * cp[X] + ac[Y] * cp[Y] + ac[Z] * cp[Z];
+
+    vc = d1 * d4 - d3 * d2;
+    vb = d5 * d2 - d1 * d6;
+    va = d3 * d6 - d5 * d4;
+
+    if( d1 <= 0.0 && d2 <= 0.0 )
+    {
+        *feature = 0;
+        for_less( dim, 0, N_DIMENSIONS )
+            closest[dim] = a[dim];
+    }
+    else if( d3 >= 0.0 && d4 <= d3 )
+    {
+        *feature = 1;
+        for_less( dim, 0, N_DIMENSIONS )
+            closest[dim] = b[dim];
+    }
+    else if( vc <= 0.0 && d1 >= 0.0 && d3 <= 0.0 )
+    {
+        *feature = EDGE_FEATURE + 0;
+        v = d1 / (d1 - d3);
+        for_less( dim, 0, N_DIMENSIONS )
+            closest[dim] = a[dim] + v * ab[dim];
+    }
+    else if( d6 >= 0.0 && d5 <= d6 )
+    {
+        *feature = 2;
+        for_less( dim, 0, N_DIMENSIONS )
+            closest[dim] = c[dim];
+    }
+    else if( vb <= 0.0 && d2 >= 0.0 && d6 <= 0.0 )
+    {
+        *feature = EDGE_FEATURE + 2;
+        w = d2 / (d2 - d6);
+        for_less( dim, 0, N_DIMENSIONS )
+            closest[dim] = a[dim] + w * ac[dim];
+    }
+    else if( va <= 0.0 && d4 - d3 >= 0.0 && d5 - d6 >= 0.0 )
+    {
+        *feature = EDGE_FEATURE + 1;
+        w = (d4 - d3) / ((d4 - d3) + (d5 - d6));
+        for_less( dim, 0, N_DIMENSIONS )
+            closest[dim] = b[dim] + w * (c[dim] - b[dim]);
+    }
+    else if( va + vb + vc != 0.0 )
+    {
+        *feature = FACE_FEATURE;
+        denom = 1.0 / (va + vb + vc);
+        v = vb * denom;
+        w = vc * denom;
+        for_less( dim, 0, N_DIMENSIONS )
+            closest[dim] = a[dim] + v * ab[dim] + w * ac[dim];
+    }
+    else
+    {
+        *feature = 0;
+        for_less( dim, 0, N_DIMENSIONS )
+            closest[dim] = a[dim];
+    }
+
+    dist_sq = 0.0;
+    for_less( dim, 0, N_DIMENSIONS )
+    {
+        d = p[dim] - closest[dim];
+        dist_sq += d * d;
+    }
+
+    return( dist_sq );
+}
+
+private  Real  box_distance_sq(
+    Real   limits[2][N_DIMENSIONS],
+    Real   p[] )
+{
+    int    dim;
+    Real   d, dist_sq;
+
+    dist_sq = 0.0;
+    for_less( dim, 0, N_DIMENSIONS )
+    {
+        if( p[dim] < limits[0][dim] )
+            d = limits[0][dim] - p[dim];
+        else if( p[dim] > limits[1][dim] )
+            d = p[dim] - limits[1][dim];
+        else
+            continue;
+        dist_sq += d * d;
+    }
+
+    return( dist_sq );
+}
+
+/* ----------------------------- MNI Header -----------------------------------
+@NAME       : find_signed_surface_distance
+@INPUT      : tree
+              point
+              triangle_hint  - triangle closest to a nearby point, or -1
+@OUTPUT     : triangle_hint  - triangle containing the closest point
+              closest        - closest point, may be NULL
+@RETURNS    : signed distance
+@DESCRIPTION: Finds the closest point on the surface, and the distance to it,
+              negative if the point is inside the surface.  The hint gives
+              an initial bound on the distance, so querying the vertices of
+              a mesh in order, passing the same hint, prunes most of the
+              hierarchy at once.
+@METHOD     : The sign is that of the projection onto the pseudo-normal of
+              the feature containing the closest point.
+@GLOBALS    :
+@CALLS      :
+@CREATED    :
+@MODIFIED   :
+---------------------------------------------------------------------------- */
+
+public  Real  find_signed_surface_distance(
+    closest_point_tree   tree,
+    Point                *point,
+    int                  *triangle_hint,
+    Point                *closest )
+{
+    int                   t, dim, n_stack, node_index, best_t, best_feature;
+    int                   feature, near, far;
+    Real                  p[N_DIMENSIONS], best_point[N_DIMENSIONS];
+    Real                  q[N_DIMENSIONS], dist_sq, best_dist_sq, dist;
+    Real                  child_dist[2], *normal, dot;
+    triangle_node_struct  *node;
+
+    for_less( dim, 0, N_DIMENSIONS )
+        p[dim] = (Real) Point_coord( *point, dim );
+
+    if( tree->triangles.n_triangles == 0 )
+    {
+        if( closest != NULL )
+            *closest = *point;
+        return( 0.0 );
+    }
+
+    best_t = -1;
+    best_feature = FACE_FEATURE;
+    best_dist_sq = 0.0;
+
+    if( triangle_hint != NULL && *triangle_hint >= 0 &&
+        *triangle_hint < tree->triangles.n_triangles )
+    {
+        best_t = *triangle_hint;
+        best_dist_sq = closest_point_on_triangle( p,
+                                CORNER( tree, best_t, 0 ),
+                                CORNER( tree, best_t, 1 ),
+                                CORNER( tree, best_t, 2 ),
+                                best_point, &best_feature );
+    }
+
+    tree->stack_nodes[0] = 0;
+    tree->stack_dists[0] = box_distance_sq( tree->triangles.nodes[0].limits,
+                                            p );
+    n_stack = 1;
+
+    while( n_stack > 0 )
+    {
+        --n_stack;
+        node_index = tree->stack_nodes[n_stack];
+
+        if( best_t >= 0 && tree->stack_dists[n_stack] >= best_dist_sq )
+            continue;
+
+        node = &tree->triangles.nodes[node_index];
+
+        if( node->children[0] < 0 )
+        {
+            for_less( t, node->start, node->end )
+            {
+                dist_sq = closest_point_on_triangle( p,
+                                CORNER( tree, t, 0 ), CORNER( tree, t, 1 ),
+                                CORNER( tree, t, 2 ), q, &feature );
+
+                if( best_t < 0 || dist_sq < best_dist_sq )
+                {
+                    best_t = t;
+                    best_dist_sq = dist_sq;
+                    best_feature = feature;
+                    for_less( dim, 0, N_DIMENSIONS )
+                        best_point[dim] = q[dim];
+                }
+            }
+            continue;
+        }
+
+        /*--- visit the nearer child first */
+
+        child_dist[0] = box_distance_sq(
+                     tree->triangles.nodes[node->children[0]].limits, p );
+        child_dist[1] = box_distance_sq(
+                     tree->triangles.nodes[node->children[1]].limits, p );
+
+        near = (child_dist[1] < child_dist[0]) ? 1 : 0;
+        far = 1 - near;
+
+        if( best_t < 0 || child_dist[far] < best_dist_sq )
+        {
+            tree->stack_nodes[n_stack] = node->children[far];
+            tree->stack_dists[n_stack] = child_dist[far];
+            ++n_stack;
+        }
+
+        if( best_t < 0 || child_dist[near] < best_dist_sq )
+        {
+            tree->stack_nodes[n_stack] = node->children[near];
+            tree->stack_dists[n_stack] = child_dist[near];
+            ++n_stack;
+        }
+    }
+
+    if( best_feature < EDGE_FEATURE )
+        normal = tree->vertex_normals[
+                      tree->triangles.vertices[best_t*3+best_feature]];
+    else if( best_feature < FACE_FEATURE )
+        normal = NORMAL( tree, best_t, 1 + best_feature - EDGE_FEATURE );
+    else
+        normal = NORMAL( tree, best_t, 0 );
+
+    dot = 0.0;
+    for_less( dim, 0, N_DIMENSIONS )
+        dot += (p[dim] - best_point[dim]) * normal[dim];
+
+    dist = sqrt( best_dist_sq );
+    if( dot < 0.0 )
+        dist = -dist;
+
+    if( triangle_hint != NULL )
+        *triangle_hint = best_t;
+
+    if( closest != NULL )
+    {
+        fill_Point( *closest, best_point[X], best_point[Y], best_point[Z] );
+    }
+
+    return( dist );
+}
+
+/* ----------------------------- MNI Header -----------------------------------
+@NAME       : evaluate_signed_surface_distances
+@INPUT      : tree
+              n_points
+              points
+@OUTPUT     : distances
+@RETURNS    :
+@DESCRIPTION: Computes the signed distances from a list of points to the
+              surface, each query starting from the closest triangle of the
+              previous point.  Mesh vertices in their stored order are
+              mostly near their predecessors.
+@METHOD     :
+@GLOBALS    :
+@CALLS      :
+@CREATED    :
+@MODIFIED   :
+---------------------------------------------------------------------------- */
+
+public  void  evaluate_signed_surface_distances(
+    closest_point_tree   tree,
+    int                  n_points,
+    Point                points[],
+    Real                 distances[] )
+{
+    int   p, hint;
+
+    hint = -1;
+
+    for_less( p, 0, n_points )
+    {
+        distances[p] = find_signed_surface_distance( tree, &points[p],
+                                                     &hint, NULL );
+    }
+}
@@ -0,0 +1,24 @@
+#ifndef  DEF_CLOSEST_POINT_TREE_H
+#define  DEF_CLOSEST_POINT_TREE_H
+
+#include  <bicpl.h>
+
+struct  closest_point_tree_struct;
+
+typedef  struct  closest_point_tree_struct  *closest_point_tree;
+
+
+#ifndef  public
+#define       public   extern
+#define       public_was_defined_here
+#endif
+
+#include  <closest_point_tree_prototypes.h>
+
+#ifdef  public_was_defined_here
+#undef       public
+#undef       public_was_defined_here
+#endif
+
+
+#endif
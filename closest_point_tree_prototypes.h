@@ -0,0 +1,21 @@
+#ifndef  DEF_CLOSEST_POINT_TREE_PROTOTYPES
+#define  DEF_CLOSEST_POINT_TREE_PROTOTYPES
+
+public  closest_point_tree  create_closest_point_tree(
+    polygons_struct  *polygons );
+
+public  void  delete_closest_point_tree(
+    closest_point_tree   tree );
+
+public  Real  find_signed_surface_distance(
+    closest_point_tree   tree,
+    Point                *point,
+    int                  *triangle_hint,
+    Point                *closest );
+
+public  void  evaluate_signed_surface_distances(
+    closest_point_tree   tree,
+    int                  n_points,
+    Point                points[],
+    Real                 distances[] );
+#endif
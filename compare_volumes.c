@@ -1,11 +1,14 @@
+#include  <volume_io/internal_volume_io.h>
 #include  <bicpl.h>
+#include  <voxel_scan.h>
 
 int  main(
     int   argc,
     char  *argv[] )
 {
-    int                  x, y, z;
-    Real                 value1, value2;
+    int                  i, v[MAX_DIMENSIONS], start, n_voxels;
+    Real                 *values1, *values2;
+    voxel_scan_struct    scan1, scan2;
     int                  sizes1[MAX_DIMENSIONS], sizes2[MAX_DIMENSIONS];
     char                 *input_volume1, *input_volume2;
     Volume               volume1, volume2;
@@ -39,20 +42,27 @@ int  main(
         return( 1 );
     }
 
-    for_less( x, 0, sizes1[X] )
+    initialize_voxel_scan( &scan1, volume1, 0 );
+    initialize_voxel_scan( &scan2, volume2, 0 );
+
+    while( get_next_voxel_span_values( &scan1, TRUE, &start, &n_voxels,
+                                       &values1 ) &&
+           get_next_voxel_span_values( &scan2, TRUE, &start, &n_voxels,
+                                       &values2 ) )
     {
-        for_less( y, 0, sizes1[Y] )
+        for_less( i, 0, n_voxels )
         {
-            for_less( z, 0, sizes1[Z] )
+            if( values1[i] != values2[i] )
             {
-                GET_VALUE_3D( value1, volume1, x, y, z );
-                GET_VALUE_3D( value2, volume2, x, y, z );
-                if( value1 != value2 )
-                    print( "Volumes differ: %d %d %d:  %g %g.\n", x, y, z,
-                           value1, value2 );
+                get_voxel_scan_position( &scan1, start + i, v );
+                print( "Volumes differ: %d %d %d:  %g %g.\n",
+                       v[X], v[Y], v[Z], values1[i], values2[i] );
             }
         }
     }
 
+    delete_voxel_scan( &scan1 );
+    delete_voxel_scan( &scan2 );
+
     return( 0 );
 }
@@ -1,118 +1,179 @@
 #include  <volume_io/internal_volume_io.h>
 #include  <bicpl.h>
+#include  <image_codec.h>
+#include  <image_composite.h>
 
-int  main(
-    int   argc,
-    char  *argv[] )
-{
-    STRING            input_filename, output_filename;
-    int               x, y, n_files, r, g, b, a;
-    int               x_offset, y_offset, x_min, x_max, y_min, y_max;
-    int               y_offset_flipped;
-    pixels_struct     pixels, top_pixels;
-    Colour            bottom, top, col;
-    BOOLEAN           add_flag;
-
-    initialize_argument_processing( argc, argv );
+/*--- composites one set of arguments: output.rgb [-add] input1 -xy ...,
+      or -layout layout_file output.rgb */
 
-    if( argc <= 1 )
+private  Status  composite_image_list(
+    int      n_args,
+    STRING   args[] )
+{
+    STRING               input_filename, output_filename;
+    int                  i, x_offset, y_offset, x_size, y_size, nc;
+    pixels_struct        pixels;
+    BOOLEAN              add_flag;
+    image_layout_struct  layout;
+    Status               status;
+
+    if( n_args == 3 && equal_strings( args[0], "-layout" ) )
     {
-        print( "Usage: %s output.rgb [-add] input1.rgb  -xy [input2.rgb] ...\n", argv[0] );
-        return( 1 );
-    }
+        if( input_image_layout( args[1], &layout ) != OK )
+            return( ERROR );
 
-    output_filename = NULL;
+        output_filename = args[2];
+    }
+    else
+    {
+        output_filename = NULL;
 
-    n_files = 0;
-    add_flag = FALSE;
-    x_offset = 0;
-    y_offset = 0;
+        initialize_image_layout( &layout, 0, 0,
+                                 make_rgba_Colour( 0, 0, 0, 0 ) );
+        add_flag = FALSE;
+        x_offset = 0;
+        y_offset = 0;
 
-    while( get_string_argument( NULL, &input_filename ) )
-    {
-        if( equal_strings( input_filename, "-add" ) )
-        {
-            add_flag = TRUE;
-            continue;
-        }
-        if( equal_strings( input_filename, "-composite" ) )
+        i = 0;
+        while( i < n_args )
         {
-            add_flag = FALSE;
-            continue;
-        }
-        if( equal_strings( input_filename, "-xy" ) )
-        {
-            if( !get_int_argument( 0, &x_offset ) ||
-                !get_int_argument( 0, &y_offset ) )
+            input_filename = args[i];
+            ++i;
+
+            if( equal_strings( input_filename, "-add" ) )
             {
-                print_error( "Error in -xy arguments\n" );
-                return( 1 );
+                add_flag = TRUE;
+                continue;
+            }
+            if( equal_strings( input_filename, "-composite" ) )
+            {
+                add_flag = FALSE;
+                continue;
+            }
+            if( equal_strings( input_filename, "-xy" ) )
+            {
+                if( i + 2 > n_args ||
+                    sscanf( args[i], "%d", &x_offset ) != 1 ||
+                    sscanf( args[i+1], "%d", &y_offset ) != 1 )
+                {
+                    print_error( "Error in -xy arguments\n" );
+                    delete_image_layout( &layout );
+                    return( ERROR );
+                }
+                i += 2;
+                continue;
+            }
+            if( output_filename == NULL )
+            {
+                output_filename = input_filename;
+                continue;
+            }
+
+            /*--- the first image is the base, and sets the output size */
+
+            if( layout.n_layers == 0 )
+            {
+                if( input_image_header( input_filename, &x_size, &y_size,
+                                        &nc ) != OK )
+                {
+                    print_error( "Error reading %s.\n", input_filename );
+                    delete_image_layout( &layout );
+                    return( ERROR );
+                }
+
+                layout.x_size = x_size;
+                layout.y_size = y_size;
+                add_image_layer( &layout, input_filename, 0, 0,
+                                 REPLACE_BLEND );
+            }
+            else
+            {
+                add_image_layer( &layout, input_filename, x_offset, y_offset,
+                                 add_flag ? ADD_BLEND : OVER_BLEND );
             }
-            continue;
-        }
-        if( output_filename == NULL )
-        {
-            output_filename = input_filename;
-            continue;
         }
+    }
 
-        if( input_rgb_file( input_filename, &top_pixels ) != OK )
-            return( 1 );
+    if( output_filename == NULL || layout.n_layers == 0 )
+    {
+        print_error( "No input images for %s\n",
+                     (output_filename == NULL) ? "" : output_filename );
+        delete_image_layout( &layout );
+        return( ERROR );
+    }
+
+    status = render_image_layout( &layout, &pixels );
+
+    delete_image_layout( &layout );
+
+    if( status == OK )
+    {
+        status = output_image_file( output_filename, &pixels );
+        delete_pixels( &pixels );
+    }
+
+    return( status );
+}
 
-        if( top_pixels.pixel_type != RGB_PIXEL )
+/*--- in batch mode each line of the list file holds the arguments of one
+      composite, so many images are made without restarting */
+
+private  Status  composite_batch(
+    STRING   list_filename )
+{
+    FILE     *file;
+    STRING   line, *args, token;
+    int      n_args;
+    Status   status;
+
+    if( open_file( list_filename, READ_FILE, ASCII_FORMAT, &file ) != OK )
+        return( ERROR );
+
+    status = OK;
+
+    while( status == OK && input_line( file, &line ) == OK )
+    {
+        n_args = 0;
+        args = NULL;
+
+        for( token = strtok( line, " \t" );  token != NULL;
+             token = strtok( NULL, " \t" ) )
         {
-            print( "Pixels must be RGB type.\n" );
-            return( 1 );
+            ADD_ELEMENT_TO_ARRAY( args, n_args, token, DEFAULT_CHUNK_SIZE );
         }
 
-        if( n_files == 0 )
-            pixels = top_pixels;
-        else
+        if( n_args > 0 )
         {
-            y_offset_flipped = pixels.y_size - 1 -
-                               (y_offset + top_pixels.y_size - 1);
-            x_min = MAX( 0, x_offset );
-            x_max = MIN( pixels.x_size-1, x_offset + top_pixels.x_size - 1 );
-            y_min = MAX( 0, y_offset_flipped );
-            y_max = MIN( pixels.y_size-1, y_offset_flipped +
-                         top_pixels.y_size - 1 );
-
-            for_inclusive( x, x_min, x_max )
-            {
-                for_inclusive( y, y_min, y_max )
-                {
-                    bottom = PIXEL_RGB_COLOUR(pixels,x,y);
-                    top = PIXEL_RGB_COLOUR(top_pixels,x-x_offset,y-y_offset_flipped);
-
-                    if( add_flag )
-                    {
-                        r = get_Colour_r(bottom) + get_Colour_r(top);
-                        g = get_Colour_g(bottom) + get_Colour_g(top);
-                        b = get_Colour_b(bottom) + get_Colour_b(top);
-                        a = get_Colour_a(bottom) + get_Colour_a(top);
-
-                        if( r > 255 )  r = 255;
-                        if( g > 255 )  g = 255;
-                        if( b > 255 )  b = 255;
-                        if( a > 255 )  a = 255;
-
-                        col = make_rgba_Colour( r, g, b, a );
-                    }
-                    else
-                    {
-                        COMPOSITE_COLOURS( col, top, bottom );
-                    }
-
-                    PIXEL_RGB_COLOUR(pixels,x,y) = col;
-                }
-            }
-            delete_pixels( &top_pixels );
+            status = composite_image_list( n_args, args );
+            FREE( args );
         }
 
-        ++n_files;
+        delete_string( line );
     }
 
-    if( output_rgb_file( output_filename, &pixels ) != OK )
+    (void) close_file( file );
+
+    return( status );
+}
+
+int  main(
+    int   argc,
+    char  *argv[] )
+{
+    if( argc <= 1 )
+    {
+        print( "Usage: %s output.rgb [-add] input1.rgb  -xy [input2.rgb] ...\n", argv[0] );
+        print( "       %s -layout layout_file output.rgb\n", argv[0] );
+        print( "       %s -batch list_file\n", argv[0] );
+        return( 1 );
+    }
+
+    if( argc == 3 && equal_strings( argv[1], "-batch" ) )
+    {
+        if( composite_batch( argv[2] ) != OK )
+            return( 1 );
+    }
+    else if( composite_image_list( argc - 1, &argv[1] ) != OK )
         return( 1 );
 
     return( 0 );
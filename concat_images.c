@@ -1,5 +1,6 @@
 #include  <volume_io/internal_volume_io.h>
 #include  <bicpl.h>
+#include  <image_codec.h>
 
 int  main(
     int   argc,
@@ -20,10 +21,10 @@ int  main(
         return( 1 );
     }
 
-    if( input_rgb_file( input_filename1, &in_pixels1 ) != OK )
+    if( input_image_file( input_filename1, &in_pixels1 ) != OK )
         return( 1 );
 
-    if( input_rgb_file( input_filename2, &in_pixels2 ) != OK )
+    if( input_image_file( input_filename2, &in_pixels2 ) != OK )
         return( 1 );
 
     if( in_pixels1.pixel_type != RGB_PIXEL ||
@@ -56,7 +57,7 @@ int  main(
         }
     }
 
-    if( output_rgb_file( output_filename, &out_pixels ) != OK )
+    if( output_image_file( output_filename, &out_pixels ) != OK )
         return( 1 );
 
     return( 0 );
@@ -23,10 +23,26 @@ struct  conjugate_min_struct
     int              max_iterations;
     int              n_restarts;
     int              max_restarts;
+    int              n_evaluations;
+    int              n_deriv_evaluations;
 
     conjugate_grad   conjugate_dir_info;
 };
 
+/*--- the line minimization calls the objective through this, so that
+      evaluations can be counted without changing its interface */
+
+private  Real  count_function_evaluation(
+    Real   parameters[],
+    void   *data )
+{
+    conjugate_min   conj;
+
+    conj = (conjugate_min) data;
+    ++conj->n_evaluations;
+
+    return( (*conj->function) ( parameters, conj->function_data ) );
+}
 
 public   conjugate_min  conjugate_min_initialize(
     int                    n_parameters,
@@ -72,9 +88,11 @@ public   conjugate_min  conjugate_min_initialize(
         conj->max_restarts = DEFAULT_N_RESTARTS;
     else
         conj->max_restarts = max_restarts;
+    conj->n_evaluations = 0;
+    conj->n_deriv_evaluations = 0;
 
-    conj->current_value = (*conj->function) ( conj->parameters,
-                                              conj->function_data );
+    conj->current_value = count_function_evaluation( conj->parameters,
+                                                     (void *) conj );
 
     if( current_value != NULL )
         *current_value = conj->current_value;
@@ -94,6 +112,7 @@ public  BOOLEAN  conjugate_min_do_one_iteration(
 
     ++conj->n_iterations;
 
+    ++conj->n_deriv_evaluations;
     (*conj->deriv_function) ( conj->parameters, conj->function_data,
                               conj->derivative );
 
@@ -107,8 +126,8 @@ public  BOOLEAN  conjugate_min_do_one_iteration(
                                        conj->parameters,
                                        conj->derivative,
                                        conj->test_parameters,
-                                       conj->function,
-                                       conj->function_data,
+                                       count_function_evaluation,
+                                       (void *) conj,
                                        conj->line_min_range_tolerance,
                                        conj->line_min_domain_tolerance,
                                        conj->current_value,
@@ -153,11 +172,25 @@ public  int  conjugate_min_get_n_iterations(
     return( conj->n_iterations );
 }
 
+public  int  conjugate_min_get_n_evaluations(  
+    conjugate_min     conj )
+{
+    return( conj->n_evaluations );
+}
+
+public  int  conjugate_min_get_n_deriv_evaluations(  
+    conjugate_min     conj )
+{
+    return( conj->n_deriv_evaluations );
+}
+
 public  void  conjugate_min_print_iteration_info(  
     conjugate_min     conj )
 {
-    print( "Iter  %5d:   Value: %30.16g    N restarts: %2d\n",
-           conj->n_iterations, conj->current_value, conj->n_restarts );
+    print( "Iter  %5d:   Value: %30.16g    Evals: %5d %5d  N restarts: %2d\n",
+           conj->n_iterations, conj->current_value,
+           conj->n_evaluations, conj->n_deriv_evaluations,
+           conj->n_restarts );
 }
 
 public  void  conjugate_min_terminate(  
@@ -171,6 +204,8 @@ public  void  conjugate_min_terminate(
     }
 
     delete_conjugate_gradient( conj->conjugate_dir_info );
+
+    FREE( conj );
 }
 
 public  Real  conjugate_minimize_function(
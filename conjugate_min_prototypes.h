@@ -26,6 +26,12 @@ public  void  conjugate_min_get_current_position(
 public  int  conjugate_min_get_n_iterations(  
     conjugate_min     conj );
 
+public  int  conjugate_min_get_n_evaluations(  
+    conjugate_min     conj );
+
+public  int  conjugate_min_get_n_deriv_evaluations(  
+    conjugate_min     conj );
+
 public  void  conjugate_min_print_iteration_info(  
     conjugate_min     conj );
 
@@ -1,15 +1,10 @@
-
-static int dbg = 0;
-static int dbg2 = 0;
-
 #include  <volume_io/internal_volume_io.h>
 #include  <bicpl.h>
 
-#define  TOLERANCE_2D   1.0e-3
-#define  TOLERANCE_DISTANCE   1.0e-6
+/*--- points closer than this fraction of the size of the point set to a
+      face of the hull are considered to be on it */
 
-#define  POINT_USED_IN_CONVEX_HULL  1
-#define  POINT_DISCARDED            2
+#define  HULL_TOLERANCE_FACTOR  1.0e-8
 
 private  int  get_points_of_region(
     char *  input_filename,
@@ -22,22 +17,12 @@ private  void  get_convex_hull(
     Point            points[],
     polygons_struct  *polygons );
 
-private  int  get_convex_hull_2d(
-    int              n_points,
-    Real             x[],
-    Real             y[],
-    int              hull_indices[],
-    int              start,
-    int              end );
-
 private int read_surface_obj( STRING, int *, Point *[],
                               Vector *[], int *[], int **[] );
 
 private int get_surface_neighbours( polygons_struct *, int *[],
                                     int ** [] );
 
-static int KeyFactor = 100000;
-
 private  void  usage(
     STRING   executable )
 {
@@ -75,7 +60,6 @@ int  main(
  
     n_points = get_points_of_region( input_filename,
                                      min_value, max_value, &points );
-    KeyFactor = n_points;
 
     object = create_object( POLYGONS );
 
@@ -141,8 +125,11 @@ private  int  get_points_of_region(
 
         // Find the convex points for a volume .mnc file.
 
-        int        x, y, z, sizes[N_DIMENSIONS], n_inside;
-        int        dx, dy, dz, tx, ty, tz;
+        // Only the corners of the first and last voxels of the region
+        // along each row can be on the hull, since the corners of the
+        // voxels between them lie on the segments joining those corners.
+
+        int        x, y, z, z_min, z_max, sizes[N_DIMENSIONS], dx, dy;
         Real       value, xw, yw, zw, voxel[N_DIMENSIONS];
         Point      point;
 
@@ -150,32 +137,35 @@ private  int  get_points_of_region(
 
         n_points = 0;
 
-        for_less( x, 0, sizes[X] + 1 ) {
-          for_less( y, 0, sizes[Y] + 1 ) {
-            for_less( z, 0, sizes[Z] + 1 ) {
-              n_inside = 0;
-              for_less( dx, 0, 2 ) {
-                for_less( dy, 0, 2 ) {
-                  for_less( dz, 0, 2 ) {
-                    tx = x - dx;
-                    ty = y - dy;
-                    tz = z - dz;
-
-                    if( tx >= 0 && tx < sizes[X] &&
-                        ty >= 0 && ty < sizes[Y] &&
-                        tz >= 0 && tz < sizes[Z] ) {
-                      value = get_volume_real_value( volume, tx, ty, tz, 0, 0 );
-
-                      if( min_value <= value && value <= max_value ) ++n_inside;
-                    }
-                  }
-                }
+        for_less( x, 0, sizes[X] ) {
+          for_less( y, 0, sizes[Y] ) {
+            z_min = -1;
+            for_less( z, 0, sizes[Z] ) {
+              value = get_volume_real_value( volume, x, y, z, 0, 0 );
+              if( min_value <= value && value <= max_value ) {
+                z_min = z;
+                break;
               }
+            }
 
-              if( n_inside == 1 ) {
-                voxel[X] = (Real) x - 0.5;
-                voxel[Y] = (Real) y - 0.5;
-                voxel[Z] = (Real) z - 0.5;
+            if( z_min < 0 ) continue;
+
+            for( z_max = sizes[Z] - 1; z_max > z_min; --z_max ) {
+              value = get_volume_real_value( volume, x, y, z_max, 0, 0 );
+              if( min_value <= value && value <= max_value ) break;
+            }
+
+            for_less( dx, 0, 2 ) {
+              for_less( dy, 0, 2 ) {
+                voxel[X] = (Real) (x + dx) - 0.5;
+                voxel[Y] = (Real) (y + dy) - 0.5;
+
+                voxel[Z] = (Real) z_min - 0.5;
+                convert_voxel_to_world( volume, voxel, &xw, &yw, &zw );
+                fill_Point( point, xw, yw, zw );
+                ADD_ELEMENT_TO_ARRAY( *points, n_points, point, DEFAULT_CHUNK_SIZE);
+
+                voxel[Z] = (Real) z_max + 0.5;
                 convert_voxel_to_world( volume, voxel, &xw, &yw, &zw );
                 fill_Point( point, xw, yw, zw );
                 ADD_ELEMENT_TO_ARRAY( *points, n_points, point, DEFAULT_CHUNK_SIZE);
@@ -183,6 +173,8 @@ private  int  get_points_of_region(
             }
           }
         }
+
+        delete_volume( volume );
       } else {
         print_error( "Cannot read input file %s\n", input_filename );
         n_points = 0;
@@ -193,112 +185,6 @@ private  int  get_points_of_region(
 
 }
 
-private  Real  compute_clockwise_degrees( Real x, Real y )
-{
-    Real   degrees;
-
-    if( x >= -TOLERANCE_DISTANCE && x <= TOLERANCE_DISTANCE )
-    {
-        if( y < -TOLERANCE_DISTANCE )
-            return( 90.0 );
-        else if( y > TOLERANCE_DISTANCE )
-            return( 270.0 );
-        else
-            return( 0.0 );
-    }
-    else if( y >= -TOLERANCE_DISTANCE && y <= TOLERANCE_DISTANCE)
-    {
-        if( x > 0.0 )
-            return( 0.0 );
-        else
-            return( 180.0 );
-    }
-    else
-    {
-        degrees = - RAD_TO_DEG * (Real) atan2( (double) y, (double) x );
-
-        if( degrees < 0.0 )
-            degrees += 360.0;
-
-        return( degrees );
-    }
-}
-
-private  int  find_limit_plane(
-    int              n_points,
-    Point            points[],
-    Smallest_int     point_flags[],
-    Point            *centre,
-    Vector           *hinge,
-    Vector           *normal )
-{
-    int      i, best_ind;
-    Vector   horizontal, vertical, offset;
-    Real     angle, best_angle, x, y;
-    BOOLEAN  first;
-
-    best_angle = 0.0;
-    best_ind = -1;
-
-    NORMALIZE_VECTOR( horizontal, *normal );
-    CROSS_VECTORS( vertical, *normal, *hinge );
-    NORMALIZE_VECTOR( vertical, vertical );
-
-    first = TRUE;
-    double plane_constant = -distance_from_plane( centre, &vertical, 0.0 );
-
-    /* these are the total number of inputs points */
-    for_less( i, 0, n_points ) {
-        if( point_flags[i] & POINT_DISCARDED )
-            continue;
-
-        SUB_VECTORS( offset, points[i], *centre );
-        x = -DOT_VECTORS( horizontal, offset );
-        y = DOT_VECTORS( vertical, offset );
-
-        if( x >= -TOLERANCE_2D && x <= TOLERANCE_2D &&
-            y >= -TOLERANCE_2D && y <= TOLERANCE_2D )
-            continue;
-
-        angle = compute_clockwise_degrees( x, y ) - 180.0;
-        if( angle < 0.0 )
-            angle += 360.0;
-
-        if( first || angle < best_angle )
-        {
-            if( angle < 90.0 - 0.1 || angle > 270.0 + 0.1 )
-            {
-                handle_internal_error( "find_limit_plane angle" );
-                exit(1);
-            }
-            else
-            {
-if(dbg)printf( "  found i = %d angle = %g side = %g\n", i, angle,
-                -distance_from_plane( &points[i], &vertical, plane_constant ) );
-        
-                best_angle = angle;
-                best_ind = i;
-                first = FALSE;
-            }
-        }
-        else if( angle == best_angle )
-        {
-            if( distance_between_points( centre, &points[i] ) <
-                distance_between_points( centre, &points[best_ind] ) )
-            {
-                best_ind = i;
-            }
-        }
-    }
-
-    if( best_ind < 0 ) {
-        handle_internal_error( "find_limit_plane" );
-        exit(1);
-    }
-if(dbg)printf( "  keep i = %d\n", best_ind );
-    return( best_ind );
-}
-
 private  int  get_polygon_point_index(
     polygons_struct  *polygons,
     Point            points[],
@@ -329,433 +215,526 @@ private  int  add_polygon(
 
     SET_ARRAY_SIZE( polygons->indices, n_indices, n_indices + n_vertices,
                     DEFAULT_CHUNK_SIZE );
-if(dbg2) printf( "NEW POLY %d :", polygons->n_items-1 );
-    for_less( i, 0, n_vertices ) {
+    for_less( i, 0, n_vertices )
         polygons->indices[n_indices+i] = vertices[i];
-if(dbg2) printf( " %d", vertices[i] );
-    }
-if(dbg2) printf( "\n" );
 
     return( polygons->n_items - 1 );
 }
 
+/*--- Quickhull: each face of the current hull keeps a list of the points
+      outside it.  The point furthest from a face is added by deleting the
+      faces it can see and joining it to the edges of the horizon around
+      them, and the outside points of the deleted faces are passed on to
+      the new faces.  Points inside the hull are discarded as soon as no
+      face can see them. */
+
 typedef  struct
 {
-    int  poly;
-    int  edge;
-} queue_entry;
+    int      vertices[3];
+    int      neighbours[3];
+    Real     normal[N_DIMENSIONS];
+    Real     constant;
+    int      first_outside;
+    BOOLEAN  deleted;
+} hull_face_struct;
 
-typedef struct
+typedef  struct
 {
-    Smallest_int  ref_count;
-} edge_struct;
+    Real               (*coords)[N_DIMENSIONS];
+    int                *next_outside;
+    Real               tolerance;
+    int                n_faces;
+    hull_face_struct   *faces;
+    int                n_visible;
+    int                *visible;
+    int                n_horizon;
+    int                *horizon_edges;
+} hull_struct;
+
+private  Real  hull_face_distance(
+    hull_struct   *hull,
+    int           face,
+    int           p )
+{
+    hull_face_struct   *f;
 
-typedef  QUEUE_STRUCT( queue_entry )  queue_struct;
+    f = &hull->faces[face];
 
-#define  ENLARGE_THRESHOLD         0.25
-#define  NEW_DENSITY               0.125
-#define  KEY_FACTOR                1000000
+    return( f->normal[X] * hull->coords[p][X] +
+            f->normal[Y] * hull->coords[p][Y] +
+            f->normal[Z] * hull->coords[p][Z] - f->constant );
+}
 
-private  int get_edge_key(
-    polygons_struct              *polygons,
-    int                          poly,
-    int                          edge ) {
+private  int  create_hull_face(
+    hull_struct   *hull,
+    int           p0,
+    int           p1,
+    int           p2 )
+{
+    int                face, dim;
+    Real               e1[N_DIMENSIONS], e2[N_DIMENSIONS], len;
+    hull_face_struct   *f;
 
-    int          p0, p1, size;
+    face = hull->n_faces;
+    SET_ARRAY_SIZE( hull->faces, hull->n_faces, hull->n_faces+1,
+                    DEFAULT_CHUNK_SIZE );
+    ++hull->n_faces;
+
+    f = &hull->faces[face];
+    f->vertices[0] = p0;
+    f->vertices[1] = p1;
+    f->vertices[2] = p2;
+    f->neighbours[0] = -1;
+    f->neighbours[1] = -1;
+    f->neighbours[2] = -1;
+    f->first_outside = -1;
+    f->deleted = FALSE;
+
+    for_less( dim, 0, N_DIMENSIONS )
+    {
+        e1[dim] = hull->coords[p1][dim] - hull->coords[p0][dim];
+        e2[dim] = hull->coords[p2][dim] - hull->coords[p0][dim];
+    }
 
-    size = GET_OBJECT_SIZE( *polygons, poly );
+    f->normal[X] = e1[Y] * e2[Z] - e1[Z] * e2[Y];
+    f->normal[Y] = e1[Z] * e2[X] - e1[X] * e2[Z];
+    f->normal[Z] = e1[X] * e2[Y] - e1[Y] * e2[X];
 
-    p0 = polygons->indices[POINT_INDEX(polygons->end_indices,poly,edge)];
-    p1 = polygons->indices[POINT_INDEX(polygons->end_indices,poly,
-                           (edge+1)%size)];
+    len = sqrt( f->normal[X] * f->normal[X] + f->normal[Y] * f->normal[Y] +
+                f->normal[Z] * f->normal[Z] );
 
-    return( IJ(MIN( p0, p1 ),MAX( p0, p1 ),KeyFactor) );
+    for_less( dim, 0, N_DIMENSIONS )
+    {
+        if( len > 0.0 )
+            f->normal[dim] /= len;
+        else
+            f->normal[dim] = 0.0;
+    }
+
+    f->constant = f->normal[X] * hull->coords[p0][X] +
+                  f->normal[Y] * hull->coords[p0][Y] +
+                  f->normal[Z] * hull->coords[p0][Z];
+
+    return( face );
 }
 
+/*--- passes each point of a list to the first of the faces which can see
+      it, dropping those which none of them can */
 
-private  void  add_edge_to_list(
-    queue_struct                 *queue,
-    hash_table_struct            *edge_table,
-    polygons_struct              *polygons,
-    int                          poly,
-    int                          edge )
+private  void  assign_outside_points(
+    hull_struct   *hull,
+    int           first_point,
+    int           first_face,
+    int           end_face )
 {
-    int          key;
-    edge_struct  edge_ptr;
-    queue_entry  entry;
-
-    key = get_edge_key( polygons, poly, edge );
-
-    if( lookup_in_hash_table( edge_table, key, NULL ) ) {
-      /* This is quite convoluted, but it works. CL */
-      remove_from_hash_table( edge_table, key, (void *) &edge_ptr );
-if( edge_ptr.ref_count == 2 ) {
-  printf( " bad count for edge %d %d\n", key/KeyFactor, key%KeyFactor );
-  // exit(1);
-}
-      edge_ptr.ref_count++;
-      insert_in_hash_table( edge_table, key, (void *) &edge_ptr );
-    } else {
-      edge_ptr.ref_count = 1;
-      insert_in_hash_table( edge_table, key, (void*)&edge_ptr );
+    int   p, next, face;
 
-      entry.poly = poly;
-      entry.edge = edge;
-      INSERT_IN_QUEUE( *queue, entry );
-    }
+    for( p = first_point;  p >= 0;  p = next )
+    {
+        next = hull->next_outside[p];
 
+        for_less( face, first_face, end_face )
+        {
+            if( !hull->faces[face].deleted &&
+                hull_face_distance( hull, face, p ) > hull->tolerance )
+            {
+                hull->next_outside[p] = hull->faces[face].first_outside;
+                hull->faces[face].first_outside = p;
+                break;
+            }
+        }
+    }
 }
 
-private  int   get_plane_polygon_vertices(
-    int              n_points,
-    Point            points[],
-    Smallest_int     point_flags[],
-    int              p0,
-    int              p1,
-    int              p2,
-    int              e0,
-    int              e1,
-    int              vertices[] )
+/*--- deletes the faces the eye point can see, starting from one of them,
+      and lists the edges of the horizon in order around the eye.  Each
+      face is searched from the edge after the one it was entered by, so
+      consecutive horizon edges share a vertex. */
+
+private  void  find_hull_horizon(
+    hull_struct   *hull,
+    int           eye,
+    int           face,
+    int           entry_edge )
 {
-    int      i, n_in_hull, n_in_plane, *plane_points, *hull_points;
-    Real     plane_constant, horiz_constant, *x, *y, dist;
-    Vector   v01, v02, normal, offset, horizontal, vertical;
-
-    SUB_POINTS( v01, points[p1], points[p0] );
-    SUB_POINTS( v02, points[p2], points[p0] );
-    CROSS_VECTORS( normal, v01, v02 );
-    NORMALIZE_VECTOR( normal, normal );
-
-    if( e0 < 0 && e1 < 0 ) {
-      NORMALIZE_VECTOR( horizontal, v01 );
-      CROSS_VECTORS( vertical, normal, horizontal );
-      NORMALIZE_VECTOR( vertical, vertical );
-    } else {
-      SUB_POINTS( v01, points[e1], points[e0] );
-      NORMALIZE_VECTOR( vertical, v01 );
-      CROSS_VECTORS( horizontal, vertical, normal );
-      NORMALIZE_VECTOR( horizontal, horizontal );
-    }
+    int   i, k, edge, neighbour;
 
-if(dbg) printf( "  p0=%d p1=%d p2=%d\n", p0, p1, p2 );
-if(dbg) printf( "  n=%g %g %g  h=%g %g %g\n", normal.coords[0], normal.coords[1],
-                normal.coords[2], horizontal.coords[0], horizontal.coords[1],
-                horizontal.coords[2] );
+    hull->faces[face].deleted = TRUE;
+    ADD_ELEMENT_TO_ARRAY( hull->visible, hull->n_visible, face,
+                          DEFAULT_CHUNK_SIZE );
 
-    plane_constant = -distance_from_plane( &points[p0], &normal, 0.0 );
-    horiz_constant = -distance_from_plane( &points[p0], &horizontal, 0.0 );
+    for_less( i, 0, 3 )
+    {
+        if( entry_edge < 0 )
+            k = i;
+        else if( i < 2 )
+            k = (entry_edge + 1 + i) % 3;
+        else
+            break;
 
-    n_in_plane = 0;
-    plane_points = NULL;
+        neighbour = hull->faces[face].neighbours[k];
 
-if(dbg) printf( "  loop candidates:\n" );
-    for_less( i, 0, n_points ) {
-        if( point_flags[i] & POINT_DISCARDED )
+        if( hull->faces[neighbour].deleted )
             continue;
-        if( i == p0 || i == p1 || i == p2 ) {
-          ADD_ELEMENT_TO_ARRAY( plane_points, n_in_plane, i, 10 );
-        } else {
-          dist = distance_from_plane( &points[i], &normal, plane_constant );
-          if( dist >= -TOLERANCE_DISTANCE ) {
-            dist = distance_from_plane( &points[i], &horizontal, horiz_constant );
-            if( dist >= -TOLERANCE_DISTANCE ) {
-if(dbg) printf( "  %d  %g %g %g d = %g\n", i, points[i].coords[0], points[i].coords[1],
-                points[i].coords[2], dist );
-              ADD_ELEMENT_TO_ARRAY( plane_points, n_in_plane, i, 10 );
-            }
-          }
-        }
-    }
 
-    if( n_in_plane < 3 )
-        handle_internal_error( "get_plane_polygon_vertices" );
-
-    ALLOC( x, n_in_plane );
-    ALLOC( y, n_in_plane );
-    ALLOC( hull_points, n_in_plane );
-
-    int i0 = -1, i1 = -1;
-    for_less( i, 0, n_in_plane ) {
-        SUB_POINTS( offset, points[plane_points[i]], points[p0] );
-        x[i] = DOT_VECTORS( offset, horizontal );
-        y[i] = DOT_VECTORS( offset, vertical );
-        if( ! (point_flags[plane_points[i]] & POINT_USED_IN_CONVEX_HULL) )
-            point_flags[plane_points[i]] |= POINT_DISCARDED;
-        if( plane_points[i] == e0 ) i0 = i;
-        if( plane_points[i] == e1 ) i1 = i;
-    }
+        if( hull_face_distance( hull, neighbour, eye ) > hull->tolerance )
+        {
+            for_less( edge, 0, 3 )
+            {
+                if( hull->faces[neighbour].neighbours[edge] == face )
+                    break;
+            }
 
-    n_in_hull = get_convex_hull_2d( n_in_plane, x, y, hull_points, i0, i1 );
-
-    for_less( i, 0, n_in_hull ) {
-        // Correction is not so effective in single precision.
-        int ii = plane_points[hull_points[i]];
-        dist = distance_from_plane( &points[ii], &normal, plane_constant );
-        points[ii].coords[0] -= dist * normal.coords[0];
-        points[ii].coords[1] -= dist * normal.coords[1];
-        points[ii].coords[2] -= dist * normal.coords[2];
-        point_flags[ii] = POINT_USED_IN_CONVEX_HULL;
-        vertices[i] = ii;
+            find_hull_horizon( hull, eye, neighbour, edge );
+        }
+        else
+        {
+            SET_ARRAY_SIZE( hull->horizon_edges, 3 * hull->n_horizon,
+                            3 * (hull->n_horizon+1), DEFAULT_CHUNK_SIZE );
+            hull->horizon_edges[3*hull->n_horizon+0] =
+                                         hull->faces[face].vertices[k];
+            hull->horizon_edges[3*hull->n_horizon+1] =
+                                         hull->faces[face].vertices[(k+1)%3];
+            hull->horizon_edges[3*hull->n_horizon+2] = neighbour;
+            ++hull->n_horizon;
+        }
     }
-
-    FREE( hull_points );
-    FREE( x );
-    FREE( y );
-    FREE( plane_points );
-
-    return( n_in_hull );
 }
 
-private  void  get_convex_hull(
-    int              n_points,
-    Point            points[],
-    polygons_struct  *polygons )
+private  void  add_point_to_hull(
+    hull_struct   *hull,
+    int           face,
+    int           eye )
 {
+    int   i, k, first_new, new_face, neighbour, p0, p1, v, p, next;
 
-    int                          i, min_ind, ind, second_ind, size;
-    int                          n_bad_ref_count, n_edges;
-    Vector                       hinge, new_hinge, normal, new_normal;
-    int                          *new_indices, other_index, key;
-    int                          poly, edge, new_poly;
-    int                          n_vertices, *vertices;
-    int                          *poly_vertices;
-    Point                        *poly_points;
-    Smallest_int                 *point_flags;
-    queue_entry                  entry;
-    queue_struct                 queue;
-    edge_struct                  edge_ptr;
-    hash_table_struct            edge_table;
-    hash_table_pointer           hash_ptr;
+    hull->n_visible = 0;
+    hull->n_horizon = 0;
 
-    initialize_polygons( polygons, WHITE, NULL );
+    find_hull_horizon( hull, eye, face, -1 );
 
-    if( n_points == 0 )
-        return;
+    first_new = hull->n_faces;
 
-    min_ind = 0;
-    for_less( i, 0, n_points ) {
-        if( i == 0 || Point_x(points[i]) < Point_x(points[min_ind]) )
-            min_ind = i;
-        else if( Point_x(points[i]) == Point_x(points[min_ind]) &&
-                 Point_y(points[i]) <  Point_y(points[min_ind]) )
-            min_ind = i;
-        else if( Point_x(points[i]) == Point_x(points[min_ind]) &&
-                 Point_y(points[i]) == Point_y(points[min_ind]) &&
-                 Point_z(points[i]) <  Point_z(points[min_ind]) )
-            min_ind = i;
-    }
+    for_less( i, 0, hull->n_horizon )
+    {
+        p0 = hull->horizon_edges[3*i+0];
+        p1 = hull->horizon_edges[3*i+1];
+        neighbour = hull->horizon_edges[3*i+2];
 
-    fill_Vector( hinge, 0.0, 0.0, 1.0 );
-    fill_Vector( normal, -1.0, 0.0, 0.0 );
+        if( hull->horizon_edges[3*((i+1)%hull->n_horizon)+0] != p1 )
+            handle_internal_error( "add_point_to_hull: horizon" );
 
-    ALLOC( point_flags, n_points );
+        new_face = create_hull_face( hull, p0, p1, eye );
 
-    for_less( i, 0, n_points )
-        point_flags[i] = FALSE;
+        hull->faces[new_face].neighbours[0] = neighbour;
+        hull->faces[new_face].neighbours[1] =
+                                  first_new + (i + 1) % hull->n_horizon;
+        hull->faces[new_face].neighbours[2] =
+                  first_new + (i + hull->n_horizon - 1) % hull->n_horizon;
 
-    ind = find_limit_plane( n_points, points, point_flags,
-                            &points[min_ind], &hinge, &normal );
+        for_less( k, 0, 3 )
+        {
+            v = hull->faces[neighbour].vertices[k];
+            if( v == p1 &&
+                hull->faces[neighbour].vertices[(k+1)%3] == p0 )
+                hull->faces[neighbour].neighbours[k] = new_face;
+        }
+    }
 
-    SUB_POINTS( new_hinge, points[ind], points[min_ind] );
-    CROSS_VECTORS( new_normal, hinge, new_hinge );
+    for_less( i, 0, hull->n_visible )
+    {
+        for( p = hull->faces[hull->visible[i]].first_outside;  p >= 0;
+             p = next )
+        {
+            next = hull->next_outside[p];
+            if( p != eye )
+            {
+                hull->next_outside[p] = -1;
+                assign_outside_points( hull, p, first_new, hull->n_faces );
+            }
+        }
 
-    second_ind = find_limit_plane( n_points, points, point_flags,
-                                   &points[ind], &new_hinge, &new_normal );
+        hull->faces[hull->visible[i]].first_outside = -1;
+    }
 
-    if( min_ind == ind || min_ind == second_ind || ind == second_ind )
-        handle_internal_error( "get_convex_hull" );
+    if( hull->n_visible > 0 )
+        FREE( hull->visible );
+    if( hull->n_horizon > 0 )
+        FREE( hull->horizon_edges );
+}
 
-    ALLOC( vertices, n_points );
-    ALLOC( poly_vertices, n_points );
-    ALLOC( poly_points, n_points );
+/*--- finds four points spanning a tetrahedron, or returns FALSE if the
+      points are all coplanar */
 
-    n_vertices = get_plane_polygon_vertices( n_points, points, point_flags, 
-                                             min_ind, ind, second_ind,
-                                             -1, -1, vertices );
-   
-    poly = add_polygon( polygons, n_vertices, vertices );
+private  BOOLEAN  get_initial_simplex(
+    hull_struct   *hull,
+    int           n_points,
+    int           simplex[] )
+{
+    int    i, dim, extremes[2][N_DIMENSIONS];
+    Real   d, best, len_sq, t, dir[N_DIMENSIONS], diff[N_DIMENSIONS];
+    Real   normal[N_DIMENSIONS], e1[N_DIMENSIONS], e2[N_DIMENSIONS];
 
-    INITIALIZE_QUEUE( queue );
+    for_less( dim, 0, N_DIMENSIONS )
+    {
+        extremes[0][dim] = 0;
+        extremes[1][dim] = 0;
+    }
 
-    initialize_hash_table( &edge_table, 1000, sizeof(edge_struct),
-                           ENLARGE_THRESHOLD, NEW_DENSITY );
+    for_less( i, 1, n_points )
+    {
+        for_less( dim, 0, N_DIMENSIONS )
+        {
+            if( hull->coords[i][dim] < hull->coords[extremes[0][dim]][dim] )
+                extremes[0][dim] = i;
+            if( hull->coords[i][dim] > hull->coords[extremes[1][dim]][dim] )
+                extremes[1][dim] = i;
+        }
+    }
 
-    for_less( i, 0, n_vertices ) {
-        add_edge_to_list( &queue, &edge_table, polygons, poly, i );
+    best = -1.0;
+    for_less( dim, 0, N_DIMENSIONS )
+    {
+        d = hull->coords[extremes[1][dim]][dim] -
+            hull->coords[extremes[0][dim]][dim];
+        if( d > best )
+        {
+            best = d;
+            simplex[0] = extremes[0][dim];
+            simplex[1] = extremes[1][dim];
+        }
     }
 
-    while( !IS_QUEUE_EMPTY( queue ) ) {
-        REMOVE_FROM_QUEUE( queue, entry );
+    if( best <= hull->tolerance )
+        return( FALSE );
 
-        poly = entry.poly;
-        edge = entry.edge;
+    /*--- furthest from the line through the first two */
 
-        key = get_edge_key( polygons, poly, edge );
+    len_sq = 0.0;
+    for_less( dim, 0, N_DIMENSIONS )
+    {
+        dir[dim] = hull->coords[simplex[1]][dim] - hull->coords[simplex[0]][dim];
+        len_sq += dir[dim] * dir[dim];
+    }
 
-        if( !lookup_in_hash_table( &edge_table, key, (void *) &edge_ptr ) ) {
-            handle_internal_error( "Convex hull" );
+    best = -1.0;
+    for_less( i, 0, n_points )
+    {
+        t = 0.0;
+        for_less( dim, 0, N_DIMENSIONS )
+        {
+            diff[dim] = hull->coords[i][dim] - hull->coords[simplex[0]][dim];
+            t += diff[dim] * dir[dim];
         }
+        t /= len_sq;
 
-        if( edge_ptr.ref_count >= 2 )
-            continue;
-
-        size = GET_OBJECT_SIZE( *polygons, poly );
+        d = 0.0;
+        for_less( dim, 0, N_DIMENSIONS )
+            d += (diff[dim] - t * dir[dim]) * (diff[dim] - t * dir[dim]);
 
-        for_less( i, 0, size ) {
-            poly_vertices[i] = polygons->indices[
-                            POINT_INDEX(polygons->end_indices,poly,i)];
-            poly_points[i].coords[0] = points[poly_vertices[i]].coords[0];
-            poly_points[i].coords[1] = points[poly_vertices[i]].coords[1];
-            poly_points[i].coords[2] = points[poly_vertices[i]].coords[2];
+        if( d > best )
+        {
+            best = d;
+            simplex[2] = i;
         }
+    }
 
-        SUB_POINTS( hinge, points[poly_vertices[edge]],
-                           points[poly_vertices[(edge+1)%size]] );
-
-        find_polygon_normal( size, poly_points, &normal );
-
-if(dbg) printf( "EDGE ENTRY %d:%d for poly %d\n", poly_vertices[edge], 
-                poly_vertices[(edge+1)%size], poly );
+    if( sqrt( best ) <= hull->tolerance )
+        return( FALSE );
 
-        ind = find_limit_plane( n_points, points, point_flags,
-                                &points[poly_vertices[edge]],
-                                &hinge, &normal );
+    /*--- furthest from the plane through the first three */
 
-        other_index = ind;
+    for_less( dim, 0, N_DIMENSIONS )
+    {
+        e1[dim] = hull->coords[simplex[1]][dim] - hull->coords[simplex[0]][dim];
+        e2[dim] = hull->coords[simplex[2]][dim] - hull->coords[simplex[0]][dim];
+    }
 
-        n_vertices = get_plane_polygon_vertices( n_points, points, point_flags,
-                 poly_vertices[edge], other_index, poly_vertices[(edge+1)%size], 
-                 poly_vertices[edge], poly_vertices[(edge+1)%size],
-                 vertices );
+    normal[X] = e1[Y] * e2[Z] - e1[Z] * e2[Y];
+    normal[Y] = e1[Z] * e2[X] - e1[X] * e2[Z];
+    normal[Z] = e1[X] * e2[Y] - e1[Y] * e2[X];
+    d = sqrt( normal[X] * normal[X] + normal[Y] * normal[Y] +
+              normal[Z] * normal[Z] );
+    for_less( dim, 0, N_DIMENSIONS )
+        normal[dim] /= d;
 
-        new_poly = add_polygon( polygons, n_vertices, vertices );
+    best = -1.0;
+    for_less( i, 0, n_points )
+    {
+        d = 0.0;
+        for_less( dim, 0, N_DIMENSIONS )
+            d += (hull->coords[i][dim] - hull->coords[simplex[0]][dim]) *
+                 normal[dim];
 
-        for( i = 0; i < n_vertices; i++ ) {
-            add_edge_to_list( &queue, &edge_table, polygons, new_poly, i );
+        if( FABS( d ) > best )
+        {
+            best = FABS( d );
+            simplex[3] = i;
         }
     }
 
-    DELETE_QUEUE( queue );
-    if( vertices ) FREE( vertices );
-    if( poly_vertices ) FREE( poly_vertices );
-    if( poly_points ) FREE( poly_points );
-    if( point_flags ) FREE( point_flags );
+    if( best <= hull->tolerance )
+        return( FALSE );
 
-    initialize_hash_pointer( &hash_ptr );
+    return( TRUE );
+}
 
-    n_bad_ref_count = 0;
-    n_edges = 0;
-    while( get_next_hash_entry( &edge_table, &hash_ptr, (void *) &edge_ptr ) ) {
-        if( edge_ptr.ref_count != 2 ) {
-            printf( "bad ref_count is %d for edge %d\n", edge_ptr.ref_count, n_edges );
-            ++n_bad_ref_count;
-        }
-        ++n_edges;
-    }
+private  void  get_convex_hull(
+    int              n_points,
+    Point            points[],
+    polygons_struct  *polygons )
+{
+    int           i, j, k, dim, face, p, furthest, simplex[4];
+    int           *new_indices, vertices[3];
+    Real          dist, max_dist, scale, centre[N_DIMENSIONS];
+    hull_struct   hull;
 
-    delete_hash_table( &edge_table );
+    initialize_polygons( polygons, WHITE, NULL );
 
-    if( n_bad_ref_count > 0 )
-        print( "N ref counts != 2: %d/%d\n", n_bad_ref_count, n_edges );
+    if( n_points < 4 )
+        return;
 
-    // Renumber the vertices of the convex hull locally.
+    ALLOC( hull.coords, n_points );
+    ALLOC( hull.next_outside, n_points );
 
-    ALLOC( new_indices, n_points );
-    for_less( i, 0, n_points ) {
-        new_indices[i] = -1;
+    scale = 0.0;
+    for_less( i, 0, n_points )
+    {
+        for_less( dim, 0, N_DIMENSIONS )
+        {
+            hull.coords[i][dim] = (Real) Point_coord( points[i], dim );
+            scale = MAX( scale, FABS( hull.coords[i][dim] ) );
+        }
     }
-    for( i = 0; i < polygons->end_indices[polygons->n_items-1]; i++ ) {
-      polygons->indices[i] = get_polygon_point_index( polygons, points, new_indices, 
-                                                      polygons->indices[i] );
+
+    hull.tolerance = HULL_TOLERANCE_FACTOR * MAX( scale, 1.0 );
+    hull.n_faces = 0;
+    hull.faces = NULL;
+    hull.n_visible = 0;
+    hull.visible = NULL;
+    hull.n_horizon = 0;
+    hull.horizon_edges = NULL;
+
+    if( !get_initial_simplex( &hull, n_points, simplex ) )
+    {
+        print_error( "The points are coplanar, no convex hull created.\n" );
+        FREE( hull.coords );
+        FREE( hull.next_outside );
+        return;
     }
 
-if(dbg) {
-    for_less( i, 0, n_points ) {
-      if( new_indices[i] != -1 ) {
-        printf( "v=%d new=%d at %g %g %g\n", i, new_indices[i],
-                points[i].coords[0], points[i].coords[1], points[i].coords[2] );
-      }
+    /*--- the faces of the tetrahedron, turned to face away from its centre,
+          and joined across their edges */
+
+    for_less( dim, 0, N_DIMENSIONS )
+    {
+        centre[dim] = (hull.coords[simplex[0]][dim] +
+                       hull.coords[simplex[1]][dim] +
+                       hull.coords[simplex[2]][dim] +
+                       hull.coords[simplex[3]][dim]) / 4.0;
     }
-}
 
-    if( new_indices ) FREE( new_indices );
+    for_less( i, 0, 4 )
+    {
+        face = create_hull_face( &hull, simplex[i], simplex[(i+1)%4],
+                                 simplex[(i+2)%4] );
 
-    if( polygons->n_points > 0 ) {
-        ALLOC( polygons->normals, polygons->n_points );
-        compute_polygon_normals( polygons );
+        dist = 0.0;
+        for_less( dim, 0, N_DIMENSIONS )
+            dist += hull.faces[face].normal[dim] * centre[dim];
+
+        if( dist > hull.faces[face].constant )
+        {
+            hull.n_faces = face;
+            (void) create_hull_face( &hull, simplex[i], simplex[(i+2)%4],
+                                     simplex[(i+1)%4] );
+        }
     }
-}
 
-private  int  get_convex_hull_2d(
-    int              n_points,
-    Real             x[],
-    Real             y[],
-    int              hull_indices[],
-    int              e0,
-    int              e1 ) {
-
-    int      i, j, min_ind, n_in_hull, current_ind, best_ind;
-    Real     dx, dy, best_len, cross;
-
-    n_in_hull = 0;
-    if( e0 < 0 && e1 < 0 ) {
-      min_ind = 0;
-      for_less( i, 1, n_points ) {
-          if( x[i] < x[min_ind] )
-              min_ind = i;
-          else if( x[i] == x[min_ind] && y[i] < y[min_ind] )
-              min_ind = i;
-      }
-      current_ind = min_ind;
-    } else {
-      min_ind = e1;
-      hull_indices[n_in_hull] = e1;
-      n_in_hull++;
-      current_ind = e0;
+    for_less( i, 0, 4 )
+    for_less( k, 0, 3 )
+    for_less( j, 0, 4 )
+    {
+        if( j != i &&
+            ((hull.faces[j].vertices[0] ==
+                                  hull.faces[i].vertices[(k+1)%3] &&
+              hull.faces[j].vertices[1] == hull.faces[i].vertices[k]) ||
+             (hull.faces[j].vertices[1] ==
+                                  hull.faces[i].vertices[(k+1)%3] &&
+              hull.faces[j].vertices[2] == hull.faces[i].vertices[k]) ||
+             (hull.faces[j].vertices[2] ==
+                                  hull.faces[i].vertices[(k+1)%3] &&
+              hull.faces[j].vertices[0] == hull.faces[i].vertices[k])) )
+            hull.faces[i].neighbours[k] = j;
     }
 
-    do {
-      if( n_in_hull >= n_points ) {
-            handle_internal_error( "get_convex_hull_2d" );
-            printf( "\n" );
-            for( i = 0; i < n_in_hull; i++ ) {
-              printf( " %g %g\n", x[hull_indices[i]], y[hull_indices[i]] );
-            }
-            exit(1);
+    /*--- all the other points start on the tetrahedron */
+
+    p = -1;
+    for( i = n_points-1;  i >= 0;  --i )
+    {
+        if( i != simplex[0] && i != simplex[1] &&
+            i != simplex[2] && i != simplex[3] )
+        {
+            hull.next_outside[i] = p;
+            p = i;
         }
-        hull_indices[n_in_hull] = current_ind;
-        ++n_in_hull;
-        best_len = 0.0;
-        best_ind = -1;
+    }
 
-        for_less( i, 0, n_points ) {
+    assign_outside_points( &hull, p, 0, 4 );
 
-          if( i == current_ind ) continue;
+    /*--- new faces are appended, so one pass reaches them all */
 
-          dx = x[i] - x[current_ind];
-          dy = y[i] - y[current_ind];
+    for( face = 0;  face < hull.n_faces;  ++face )
+    {
+        if( hull.faces[face].deleted || hull.faces[face].first_outside < 0 )
+            continue;
 
-          for( j = 0; j < n_points; j++ ) {
-            if( j == current_ind || j == i ) continue;
-            cross = dx * ( y[j] - y[current_ind] ) - dy * ( x[j] - x[current_ind] );
-            if( cross < -TOLERANCE_DISTANCE ) break;
-          }
-          if( j == n_points ) {
-            if( dx * dx + dy * dy > best_len ) {
-              best_len = dx * dx + dy * dy;
-              best_ind = i;
+        furthest = -1;
+        max_dist = 0.0;
+        for( p = hull.faces[face].first_outside;  p >= 0;
+             p = hull.next_outside[p] )
+        {
+            dist = hull_face_distance( &hull, face, p );
+            if( furthest < 0 || dist > max_dist )
+            {
+                furthest = p;
+                max_dist = dist;
             }
-          }
         }
-        if( best_ind >= 0 ) {
-          current_ind = best_ind;
-        } else {
-          printf( "could not find best index\n" );
-          exit(1);
+
+        add_point_to_hull( &hull, face, furthest );
+    }
+
+    // Renumber the vertices of the convex hull locally.
+
+    ALLOC( new_indices, n_points );
+    for_less( i, 0, n_points )
+        new_indices[i] = -1;
+
+    for_less( face, 0, hull.n_faces )
+    {
+        if( hull.faces[face].deleted )
+            continue;
+
+        for_less( k, 0, 3 )
+        {
+            vertices[k] = get_polygon_point_index( polygons, points,
+                              new_indices, hull.faces[face].vertices[k] );
         }
-    } while( current_ind != min_ind );
 
-    return( n_in_hull );
+        (void) add_polygon( polygons, 3, vertices );
+    }
+
+    FREE( new_indices );
+    FREE( hull.coords );
+    FREE( hull.next_outside );
+    FREE( hull.faces );
+
+    if( polygons->n_points > 0 ) {
+        ALLOC( polygons->normals, polygons->n_points );
+        compute_polygon_normals( polygons );
+    }
 }
 
 // -------------------------------------------------------------------
@@ -92,6 +92,17 @@ typedef struct
     voxel_lin_coef_struct  *tail;
 } voxel_coef_struct;
 
+#define  DEFAULT_VOXEL_BLOCK_SIZE  8
+
+typedef struct
+{
+    int                    degrees_continuity;
+    int                    block_size;
+    int                    n_blocks[N_DIMENSIONS];
+    float                  *min_values;
+    float                  *max_values;
+} voxel_block_range_struct;
+
 #define  N_DEFORM_HISTOGRAM   7
 
 typedef struct
@@ -53,6 +53,23 @@ public  BOOLEAN  find_boundary_in_direction(
     boundary_definition_struct  *boundary_def,
     Real                        *boundary_distance );
 
+public  int  find_boundaries_in_directions(
+    Volume                      volume,
+    Volume                      label_volume,
+    voxel_coef_struct           *lookup,
+    bitlist_3d_struct           *done_bits,
+    bitlist_3d_struct           *surface_bits,
+    voxel_block_range_struct    *block_ranges,
+    int                         n_rays,
+    Point                       ray_origins[],
+    Vector                      ray_directions[],
+    Real                        max_outwards_search_distance,
+    Real                        max_inwards_search_distance,
+    int                         degrees_continuity,
+    boundary_definition_struct  *boundary_def,
+    BOOLEAN                     found[],
+    Real                        boundary_distances[] );
+
 public  int  find_voxel_line_polynomial(
     Real        coefs[],
     int         degrees_continuity,
@@ -264,4 +281,19 @@ public  void  lookup_volume_coeficients(
 
 public  void  delete_lookup_volume_coeficients(
     voxel_coef_struct  *lookup );
+
+public  void  initialize_voxel_block_ranges(
+    voxel_block_range_struct  *blocks,
+    Volume                    volume,
+    int                       degrees_continuity,
+    int                       block_size );
+
+public  BOOLEAN  voxel_block_might_contain_range(
+    voxel_block_range_struct  *blocks,
+    int                       voxel[],
+    Real                      min_value,
+    Real                      max_value );
+
+public  void  delete_voxel_block_ranges(
+    voxel_block_range_struct  *blocks );
 #endif
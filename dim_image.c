@@ -1,5 +1,6 @@
 #include  <volume_io/internal_volume_io.h>
 #include  <bicpl.h>
+#include  <image_codec.h>
 
 int  main(
     int   argc,
@@ -31,7 +32,7 @@ int  main(
         a_scale = 1.0;
     }
 
-    if( input_rgb_file( input_filename, &pixels ) != OK )
+    if( input_image_file( input_filename, &pixels ) != OK )
         return( 1 );
 
     if( pixels.pixel_type != RGB_PIXEL )
@@ -59,7 +60,7 @@ int  main(
         }
     }
 
-    if( output_rgb_file( output_filename, &pixels ) != OK )
+    if( output_image_file( output_filename, &pixels ) != OK )
         return( 1 );
 
     return( 0 );
@@ -0,0 +1,629 @@
+#include  <volume_io/internal_volume_io.h>
+#include  <fast_thin_plate_spline.h>
+
+#define   INVERSE_FUNCTION_TOLERANCE     0.01
+#define   INVERSE_DELTA_TOLERANCE        0.01
+#define   MAX_INVERSE_ITERATIONS         20
+
+#define   LEAF_SIZE                      16
+#define   CHUNK_SIZE                     64
+
+/*--- each node stores, per value, the weighted moments of its landmarks
+      about the node centre: sum w, sum w q (3), sum w q q^T (6) */
+
+#define   N_MOMENTS                      10
+
+/*--- the third order remainder of the expansion of |d - q| is at most
+      0.2 |q|^3 / (|d| - |q|)^2 */
+
+#define   FAR_FIELD_ERROR_FACTOR         0.2
+
+typedef  struct
+{
+    Real   centre[N_DIMENSIONS];
+    Real   radius;
+    Real   abs_weight;
+    int    first_landmark;
+    int    n_landmarks;
+    int    children[2];
+    Real   *moments;
+} tps_node_struct;
+
+struct  fast_thin_plate_spline_struct
+{
+    int               n_dims;
+    int               n_values;
+    int               n_points;
+    Real              *landmarks[N_DIMENSIONS];
+    Real              **weights;
+    Real              *constant;
+    Real              **linear;
+    Real              tolerance_per_weight;
+    int               n_nodes;
+    tps_node_struct   *nodes;
+};
+
+private  int  build_tps_node(
+    fast_thin_plate_spline   tps,
+    Real                     **points,
+    int                      order[],
+    int                      first,
+    int                      n );
+
+private  void  compute_tps_node_moments(
+    fast_thin_plate_spline   tps,
+    tps_node_struct          *node );
+
+/* ----------------------------- MNI Header -----------------------------------
+@NAME       : initialize_fast_thin_plate_spline
+@INPUT      : n_dims           - dimensionality of the function
+              n_values         - number of values of the function
+              n_points         - number of defining landmarks
+              points[n_points][n_dims]  - landmarks
+              weights[n_points+1+n_dims][n_values] - weights for the points
+              far_field_tolerance - maximum error allowed in each value by
+                                 the far field approximation, or 0 to
+                                 evaluate the spline exactly
+@OUTPUT     :
+@RETURNS    : the spline, ready for evaluation
+@DESCRIPTION: Copies the spline definition used by evaluate_thin_plate_spline()
+              into a form suited to evaluating many points: the affine part
+              is held separately, the landmarks and radial weights are stored
+              as contiguous arrays per coordinate and per value, and, for
+              3D splines with a positive tolerance, the landmarks are
+              organized in a tree whose nodes carry the moments needed to
+              approximate the contribution of distant groups of landmarks.
+@METHOD     :
+@GLOBALS    :
+@CALLS      :
+@CREATED    :
+@MODIFIED   :
+---------------------------------------------------------------------------- */
+
+public  fast_thin_plate_spline  initialize_fast_thin_plate_spline(
+    int      n_dims,
+    int      n_values,
+    int      n_points,
+    Real     **points,
+    Real     **weights,
+    Real     far_field_tolerance )
+{
+    int                     p, d, v, node, *order;
+    Real                    max_weight, total_abs_weight;
+    fast_thin_plate_spline  tps;
+
+    ALLOC( tps, 1 );
+
+    tps->n_dims = n_dims;
+    tps->n_values = n_values;
+    tps->n_points = n_points;
+
+    ALLOC( tps->constant, n_values );
+    ALLOC2D( tps->linear, n_dims, n_values );
+
+    for_less( v, 0, n_values )
+        tps->constant[v] = weights[n_points][v];
+
+    for_less( d, 0, n_dims )
+    for_less( v, 0, n_values )
+        tps->linear[d][v] = weights[n_points+1+d][v];
+
+    ALLOC( order, MAX( 1, n_points ) );
+    for_less( p, 0, n_points )
+        order[p] = p;
+
+    tps->n_nodes = 0;
+    tps->nodes = NULL;
+
+    total_abs_weight = 0.0;
+    for_less( p, 0, n_points )
+    {
+        max_weight = 0.0;
+        for_less( v, 0, n_values )
+            max_weight = MAX( max_weight, FABS( weights[p][v] ) );
+        total_abs_weight += max_weight;
+    }
+
+    if( n_dims == 3 && far_field_tolerance > 0.0 && n_points > LEAF_SIZE &&
+        total_abs_weight > 0.0 )
+    {
+        tps->tolerance_per_weight = far_field_tolerance / total_abs_weight;
+        ALLOC( tps->nodes, 2 * n_points );
+        (void) build_tps_node( tps, points, order, 0, n_points );
+    }
+    else
+        tps->tolerance_per_weight = 0.0;
+
+    /*--- store the landmarks and weights in tree order */
+
+    for_less( d, 0, n_dims )
+    {
+        ALLOC( tps->landmarks[d], MAX( 1, n_points ) );
+        for_less( p, 0, n_points )
+            tps->landmarks[d][p] = points[order[p]][d];
+    }
+
+    ALLOC2D( tps->weights, n_values, MAX( 1, n_points ) );
+    for_less( v, 0, n_values )
+    for_less( p, 0, n_points )
+        tps->weights[v][p] = weights[order[p]][v];
+
+    FREE( order );
+
+    for_less( node, 0, tps->n_nodes )
+        compute_tps_node_moments( tps, &tps->nodes[node] );
+
+    return( tps );
+}
+
+public  void  delete_fast_thin_plate_spline(
+    fast_thin_plate_spline   tps )
+{
+    int   d, node;
+
+    for_less( node, 0, tps->n_nodes )
+        FREE( tps->nodes[node].moments );
+
+    if( tps->nodes != NULL )
+        FREE( tps->nodes );
+
+    for_less( d, 0, tps->n_dims )
+        FREE( tps->landmarks[d] );
+
+    FREE2D( tps->weights );
+    FREE2D( tps->linear );
+    FREE( tps->constant );
+    FREE( tps );
+}
+
+private  int  build_tps_node(
+    fast_thin_plate_spline   tps,
+    Real                     **points,
+    int                      order[],
+    int                      first,
+    int                      n )
+{
+    int              node, i, d, axis, n_left, tmp, left, right;
+    Real             min_pos[N_DIMENSIONS], max_pos[N_DIMENSIONS];
+    Real             split, dist, delta, radius;
+    tps_node_struct  *node_ptr;
+
+    node = tps->n_nodes;
+    ++tps->n_nodes;
+
+    for_less( d, 0, N_DIMENSIONS )
+    {
+        min_pos[d] = points[order[first]][d];
+        max_pos[d] = min_pos[d];
+    }
+
+    for_less( i, first + 1, first + n )
+    for_less( d, 0, N_DIMENSIONS )
+    {
+        min_pos[d] = MIN( min_pos[d], points[order[i]][d] );
+        max_pos[d] = MAX( max_pos[d], points[order[i]][d] );
+    }
+
+    node_ptr = &tps->nodes[node];
+    for_less( d, 0, N_DIMENSIONS )
+        node_ptr->centre[d] = (min_pos[d] + max_pos[d]) / 2.0;
+
+    radius = 0.0;
+    for_less( i, first, first + n )
+    {
+        dist = 0.0;
+        for_less( d, 0, N_DIMENSIONS )
+        {
+            delta = points[order[i]][d] - node_ptr->centre[d];
+            dist += delta * delta;
+        }
+        radius = MAX( radius, dist );
+    }
+
+    node_ptr->radius = sqrt( radius );
+    node_ptr->first_landmark = first;
+    node_ptr->n_landmarks = n;
+    node_ptr->children[0] = -1;
+    node_ptr->children[1] = -1;
+    node_ptr->moments = NULL;
+
+    axis = X;
+    for_less( d, Y, N_DIMENSIONS )
+    {
+        if( max_pos[d] - min_pos[d] > max_pos[axis] - min_pos[axis] )
+            axis = d;
+    }
+
+    if( n <= LEAF_SIZE || max_pos[axis] == min_pos[axis] )
+        return( node );
+
+    /*--- partition about the centre of the widest axis */
+
+    split = node_ptr->centre[axis];
+    n_left = 0;
+    for_less( i, first, first + n )
+    {
+        if( points[order[i]][axis] < split )
+        {
+            tmp = order[first+n_left];
+            order[first+n_left] = order[i];
+            order[i] = tmp;
+            ++n_left;
+        }
+    }
+
+    if( n_left == 0 || n_left == n )
+        n_left = n / 2;
+
+    left = build_tps_node( tps, points, order, first, n_left );
+    right = build_tps_node( tps, points, order, first + n_left, n - n_left );
+
+    tps->nodes[node].children[0] = left;
+    tps->nodes[node].children[1] = right;
+
+    return( node );
+}
+
+private  void  compute_tps_node_moments(
+    fast_thin_plate_spline   tps,
+    tps_node_struct          *node )
+{
+    int    p, v;
+    Real   w, qx, qy, qz, max_weight, *m;
+
+    ALLOC( node->moments, tps->n_values * N_MOMENTS );
+
+    for_less( v, 0, tps->n_values * N_MOMENTS )
+        node->moments[v] = 0.0;
+
+    node->abs_weight = 0.0;
+
+    for_less( p, node->first_landmark,
+                 node->first_landmark + node->n_landmarks )
+    {
+        qx = tps->landmarks[X][p] - node->centre[X];
+        qy = tps->landmarks[Y][p] - node->centre[Y];
+        qz = tps->landmarks[Z][p] - node->centre[Z];
+
+        max_weight = 0.0;
+        for_less( v, 0, tps->n_values )
+        {
+            w = tps->weights[v][p];
+            max_weight = MAX( max_weight, FABS( w ) );
+
+            m = &node->moments[v * N_MOMENTS];
+            m[0] += w;
+            m[1] += w * qx;
+            m[2] += w * qy;
+            m[3] += w * qz;
+            m[4] += w * qx * qx;
+            m[5] += w * qx * qy;
+            m[6] += w * qx * qz;
+            m[7] += w * qy * qy;
+            m[8] += w * qy * qz;
+            m[9] += w * qz * qz;
+        }
+
+        node->abs_weight += max_weight;
+    }
+}
+
+/*--- adds the exact contribution of landmarks first to first+n-1, computing
+      the radial function (and its gradient) for a chunk of landmarks at a
+      time, then applying the chunk to each value with a contiguous dot
+      product */
+
+private  void  sum_landmark_kernels(
+    fast_thin_plate_spline   tps,
+    Real                     pos[],
+    int                      first,
+    int                      n,
+    Real                     values[],
+    Real                     **derivs )
+{
+    int    start, end, n_chunk, k, v, d, n_dims;
+    Real   u[CHUNK_SIZE], g[N_DIMENSIONS][CHUNK_SIZE];
+    Real   dx, dy, dz, r, r2, sum, *w;
+
+    n_dims = tps->n_dims;
+    end = first + n;
+
+    for( start = first;  start < end;  start += CHUNK_SIZE )
+    {
+        n_chunk = MIN( CHUNK_SIZE, end - start );
+
+        switch( n_dims )
+        {
+        case 1:
+            for_less( k, 0, n_chunk )
+            {
+                dx = pos[X] - tps->landmarks[X][start+k];
+                r = FABS( dx );
+                u[k] = r * r * r;
+                g[X][k] = 3.0 * dx * r;
+            }
+            break;
+
+        case 2:
+            for_less( k, 0, n_chunk )
+            {
+                dx = pos[X] - tps->landmarks[X][start+k];
+                dy = pos[Y] - tps->landmarks[Y][start+k];
+                r2 = dx * dx + dy * dy;
+                if( r2 == 0.0 )
+                {
+                    u[k] = 0.0;
+                    g[X][k] = 0.0;
+                    g[Y][k] = 0.0;
+                }
+                else
+                {
+                    u[k] = r2 * log( r2 );
+                    g[X][k] = (1.0 + log( r2 )) * 2.0 * dx;
+                    g[Y][k] = (1.0 + log( r2 )) * 2.0 * dy;
+                }
+            }
+            break;
+
+        case 3:
+            for_less( k, 0, n_chunk )
+            {
+                dx = pos[X] - tps->landmarks[X][start+k];
+                dy = pos[Y] - tps->landmarks[Y][start+k];
+                dz = pos[Z] - tps->landmarks[Z][start+k];
+                r = sqrt( dx * dx + dy * dy + dz * dz );
+                u[k] = r;
+                if( r == 0.0 )
+                    r = 1.0;
+                g[X][k] = dx / r;
+                g[Y][k] = dy / r;
+                g[Z][k] = dz / r;
+            }
+            break;
+
+        default:
+            handle_internal_error( "sum_landmark_kernels: n_dims" );
+            return;
+        }
+
+        for_less( v, 0, tps->n_values )
+        {
+            w = &tps->weights[v][start];
+
+            sum = 0.0;
+            for_less( k, 0, n_chunk )
+                sum += w[k] * u[k];
+            values[v] += sum;
+
+            if( derivs != NULL )
+            {
+                for_less( d, 0, n_dims )
+                {
+                    sum = 0.0;
+                    for_less( k, 0, n_chunk )
+                        sum += w[k] * g[d][k];
+                    derivs[v][d] += sum;
+                }
+            }
+        }
+    }
+}
+
+/*--- adds the second order expansion of sum w |x - p| about the node centre:
+      M0 |d| - M1.d / |d| + (trace(M2) - d'M2d / |d|^2) / (2 |d|) */
+
+private  void  add_far_field(
+    fast_thin_plate_spline   tps,
+    tps_node_struct          *node,
+    Real                     d[],
+    Real                     s,
+    Real                     values[],
+    Real                     **derivs )
+{
+    int    v, dim;
+    Real   *m, m1d, trace, m2d[N_DIMENSIONS], dm2d, s3, s5;
+
+    s3 = s * s * s;
+    s5 = s3 * s * s;
+
+    for_less( v, 0, tps->n_values )
+    {
+        m = &node->moments[v * N_MOMENTS];
+
+        m1d = m[1] * d[X] + m[2] * d[Y] + m[3] * d[Z];
+        trace = m[4] + m[7] + m[9];
+        m2d[X] = m[4] * d[X] + m[5] * d[Y] + m[6] * d[Z];
+        m2d[Y] = m[5] * d[X] + m[7] * d[Y] + m[8] * d[Z];
+        m2d[Z] = m[6] * d[X] + m[8] * d[Y] + m[9] * d[Z];
+        dm2d = d[X] * m2d[X] + d[Y] * m2d[Y] + d[Z] * m2d[Z];
+
+        values[v] += m[0] * s - m1d / s + (trace / s - dm2d / s3) / 2.0;
+
+        if( derivs != NULL )
+        {
+            for_less( dim, 0, N_DIMENSIONS )
+            {
+                derivs[v][dim] += m[0] * d[dim] / s
+                                  - m[1+dim] / s + m1d * d[dim] / s3
+                                  - (trace * d[dim] + 2.0 * m2d[dim]) /
+                                    (2.0 * s3)
+                                  + 3.0 * dm2d * d[dim] / (2.0 * s5);
+            }
+        }
+    }
+}
+
+private  void  evaluate_tps_node(
+    fast_thin_plate_spline   tps,
+    int                      node_index,
+    Real                     pos[],
+    Real                     values[],
+    Real                     **derivs )
+{
+    int              dim;
+    Real             d[N_DIMENSIONS], s, rad, error;
+    tps_node_struct  *node;
+
+    node = &tps->nodes[node_index];
+
+    for_less( dim, 0, N_DIMENSIONS )
+        d[dim] = pos[dim] - node->centre[dim];
+    s = sqrt( d[X] * d[X] + d[Y] * d[Y] + d[Z] * d[Z] );
+    rad = node->radius;
+
+    /*--- accept the expansion if its error bound is within this node's
+          share of the tolerance, in proportion to its absolute weight */
+
+    if( s > rad && node->n_landmarks > 1 )
+    {
+        error = FAR_FIELD_ERROR_FACTOR * rad * rad * rad /
+                ((s - rad) * (s - rad));
+
+        if( error <= tps->tolerance_per_weight )
+        {
+            add_far_field( tps, node, d, s, values, derivs );
+            return;
+        }
+    }
+
+    if( node->children[0] < 0 )
+    {
+        sum_landmark_kernels( tps, pos, node->first_landmark,
+                              node->n_landmarks, values, derivs );
+    }
+    else
+    {
+        evaluate_tps_node( tps, node->children[0], pos, values, derivs );
+        evaluate_tps_node( tps, node->children[1], pos, values, derivs );
+    }
+}
+
+/* ----------------------------- MNI Header -----------------------------------
+@NAME       : evaluate_fast_thin_plate_spline
+@INPUT      : tps
+              pos[n_dims]      - position at which to evaluate
+@OUTPUT     : values[n_values] - function values at this position
+              deriv[n_values][n_dims] - function derivatives at this point
+@RETURNS    :
+@DESCRIPTION: Evaluates the spline, and, if the argument is non-null, the
+              derivatives also, as evaluate_thin_plate_spline(), to within
+              the far field tolerance given at initialization.
+@METHOD     :
+@GLOBALS    :
+@CALLS      :
+@CREATED    :
+@MODIFIED   :
+---------------------------------------------------------------------------- */
+
+public  void  evaluate_fast_thin_plate_spline(
+    fast_thin_plate_spline   tps,
+    Real                     pos[],
+    Real                     values[],
+    Real                     **derivs )
+{
+    int    v, d;
+
+    /* --- the affine part */
+
+    for_less( v, 0, tps->n_values )
+    {
+        values[v] = tps->constant[v];
+        for_less( d, 0, tps->n_dims )
+            values[v] += tps->linear[d][v] * pos[d];
+
+        if( derivs != NULL )
+        {
+            for_less( d, 0, tps->n_dims )
+                derivs[v][d] = tps->linear[d][v];
+        }
+    }
+
+    /* --- the radial part */
+
+    if( tps->n_nodes > 0 )
+        evaluate_tps_node( tps, 0, pos, values, derivs );
+    else if( tps->n_points > 0 )
+        sum_landmark_kernels( tps, pos, 0, tps->n_points, values, derivs );
+}
+
+/*--- positions[n_positions*n_dims], values[n_positions*n_values] */
+
+public  void  evaluate_fast_thin_plate_spline_points(
+    fast_thin_plate_spline   tps,
+    int                      n_positions,
+    Real                     positions[],
+    Real                     values[] )
+{
+    int    i;
+
+    for_less( i, 0, n_positions )
+    {
+        evaluate_fast_thin_plate_spline( tps, &positions[i*tps->n_dims],
+                                         &values[i*tps->n_values], NULL );
+    }
+}
+
+private  void   newton_function(
+    void     *function_data,
+    Real     parameters[],
+    Real     values[],
+    Real     **first_derivs )
+{
+    evaluate_fast_thin_plate_spline( (fast_thin_plate_spline) function_data,
+                                     parameters, values, first_derivs );
+}
+
+/* ----------------------------- MNI Header -----------------------------------
+@NAME       : fast_thin_plate_spline_transform_points
+@INPUT      : tps          - spline with n_values == n_dims
+              inverse_flag - TRUE to apply the inverse transform
+              n_positions
+              positions[n_positions*n_dims]
+@OUTPUT     : transformed[n_positions*n_dims] - may be the same as positions
+@RETURNS    :
+@DESCRIPTION: Transforms an array of points, as thin_plate_spline_transform()
+              and thin_plate_spline_inverse_transform() do for one point.
+              Points whose inverse cannot be found are left unchanged.
+@METHOD     :
+@GLOBALS    :
+@CALLS      :
+@CREATED    :
+@MODIFIED   :
+---------------------------------------------------------------------------- */
+
+public  void  fast_thin_plate_spline_transform_points(
+    fast_thin_plate_spline   tps,
+    BOOLEAN                  inverse_flag,
+    int                      n_positions,
+    Real                     positions[],
+    Real                     transformed[] )
+{
+    int    i, d, n_dims;
+    Real   x_in[N_DIMENSIONS], solution[N_DIMENSIONS];
+
+    n_dims = tps->n_dims;
+
+    if( tps->n_values != n_dims )
+        handle_internal_error( "fast_thin_plate_spline_transform_points" );
+
+    for_less( i, 0, n_positions )
+    {
+        for_less( d, 0, n_dims )
+            x_in[d] = positions[IJ(i,d,n_dims)];
+
+        if( !inverse_flag )
+            evaluate_fast_thin_plate_spline( tps, x_in, solution, NULL );
+        else if( !newton_root_find( n_dims, newton_function, (void *) tps,
+                                    x_in, x_in, solution,
+                                    INVERSE_FUNCTION_TOLERANCE,
+                                    INVERSE_DELTA_TOLERANCE,
+                                    MAX_INVERSE_ITERATIONS ) )
+        {
+            for_less( d, 0, n_dims )
+                solution[d] = x_in[d];
+        }
+
+        for_less( d, 0, n_dims )
+            transformed[IJ(i,d,n_dims)] = solution[d];
+    }
+}
@@ -0,0 +1,22 @@
+#ifndef  DEF_FAST_THIN_PLATE_SPLINE_H
+#define  DEF_FAST_THIN_PLATE_SPLINE_H
+
+struct  fast_thin_plate_spline_struct;
+
+typedef  struct  fast_thin_plate_spline_struct  *fast_thin_plate_spline;
+
+
+#ifndef  public
+#define       public   extern
+#define       public_was_defined_here
+#endif
+
+#include  <fast_thin_plate_spline_prototypes.h>
+
+#ifdef  public_was_defined_here
+#undef       public
+#undef       public_was_defined_here
+#endif
+
+
+#endif
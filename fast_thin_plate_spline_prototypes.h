@@ -0,0 +1,33 @@
+#ifndef  DEF_FAST_THIN_PLATE_SPLINE_PROTOTYPES
+#define  DEF_FAST_THIN_PLATE_SPLINE_PROTOTYPES
+
+public  fast_thin_plate_spline  initialize_fast_thin_plate_spline(
+    int      n_dims,
+    int      n_values,
+    int      n_points,
+    Real     **points,
+    Real     **weights,
+    Real     far_field_tolerance );
+
+public  void  delete_fast_thin_plate_spline(
+    fast_thin_plate_spline   tps );
+
+public  void  evaluate_fast_thin_plate_spline(
+    fast_thin_plate_spline   tps,
+    Real                     pos[],
+    Real                     values[],
+    Real                     **derivs );
+
+public  void  evaluate_fast_thin_plate_spline_points(
+    fast_thin_plate_spline   tps,
+    int                      n_positions,
+    Real                     positions[],
+    Real                     values[] );
+
+public  void  fast_thin_plate_spline_transform_points(
+    fast_thin_plate_spline   tps,
+    BOOLEAN                  inverse_flag,
+    int                      n_positions,
+    Real                     positions[],
+    Real                     transformed[] );
+#endif
@@ -1,5 +1,6 @@
 #include  <volume_io/internal_volume_io.h>
 #include  <bicpl.h>
+#include  <closest_point_tree.h>
 
 #define  BINTREE_FACTOR  0.5
 
@@ -9,7 +10,7 @@ private  void  find_boundary_blocks(
     int                x_size,
     int                y_size,
     int                z_size,
-    bitlist_3d_struct  *on_boundary,
+    bitlist_struct     *on_boundary,
     object_struct      *surface,
     Real               radius_of_curvature );
 private  BOOLEAN  block_within_distance(
@@ -18,7 +19,7 @@ private  BOOLEAN  block_within_distance(
     int                x_size,
     int                y_size,
     int                z_size,
-    bitlist_3d_struct  *on_boundary,
+    bitlist_struct     *on_boundary,
     Point              *point,
     Real               radius );
 
@@ -41,7 +42,7 @@ int  main(
     Real                 surface_area, buried_surface_area, total_surface_area;
     Real                 block_size;
     Point                min_point, max_point;
-    bitlist_3d_struct    bitlist;
+    bitlist_struct       bitlist;
 
     initialize_argument_processing( argc, argv );
 
@@ -153,7 +154,7 @@ int  main(
            buried_surface_area / total_surface_area );
 
     FREE( points );
-    delete_bitlist_3d( &bitlist );
+    delete_bitlist( &bitlist );
 
     (void) output_graphics_file( dest_polygons_filename,
                                  format, n_objects, objects );
@@ -193,12 +194,35 @@ private  void  convert_block_to_world(
                 RPoint_z(*min_point) + z_block * block_size );
 }
 
-typedef  struct
-{
-    unsigned short x;
-    unsigned short y;
-    unsigned short z;
-} voxel_struct;
+/*--- blocks are indexed in one flat bitlist, z varying fastest */
+
+#define  BLOCK_INDEX( x, y, z, y_size, z_size )  IJK( x, y, z, y_size, z_size )
+
+/* ----------------------------- MNI Header -----------------------------------
+@NAME       : find_boundary_blocks
+@INPUT      : min_point
+              block_size
+              x_size
+              y_size
+              z_size
+              surface
+              radius_of_curvature
+@OUTPUT     : on_boundary
+@RETURNS    :
+@DESCRIPTION: Finds the blocks within the radius of the surface which can be
+              reached from outside without passing through other such
+              blocks.
+@METHOD     : The distance to the surface at each block centre comes from a
+              closest point tree, scanning each row along z.  Since the
+              distance changes by at most the block size from one block to
+              the next, a block far from the surface skips the following
+              blocks which cannot come within the radius.  The outside is
+              then filled with a stack of block indices.
+@GLOBALS    :
+@CALLS      :
+@CREATED    :
+@MODIFIED   :
+---------------------------------------------------------------------------- */
 
 private  void  find_boundary_blocks(
     Point              *min_point,
@@ -206,125 +230,92 @@ private  void  find_boundary_blocks(
     int                x_size,
     int                y_size,
     int                z_size,
-    bitlist_3d_struct  *on_boundary,
+    bitlist_struct     *on_boundary,
     object_struct      *surface,
     Real               radius_of_curvature )
 {
-    int                           n_to_do, poly, size;
-    polygons_struct               *polygons;
-    bitlist_3d_struct             visited_flags, intersects;
-    QUEUE_STRUCT( voxel_struct )  queue;
-    voxel_struct                  voxel;
-    int                           x, y, z, *dx, *dy, *dz, dir, n_dirs;
-    Real                          x_min_real, x_max_real, y_min_real;
-    Real                          y_max_real, z_min_real, z_max_real;
-    int                           x_min, x_max, y_min, y_max, z_min, z_max;
-    int                           nx, ny, nz;
-    Point                         block_centre, *points, lower, upper;
-    Point                         max_range, min_range, nearest_point;
-    Vector                        offset;
-    Real                          distance, dist;
-    int                           max_x, max_y, max_z;
-    progress_struct               progress;
+    int                   n_stack, n_stack_alloced, index, hint;
+    bitlist_struct        visited_flags, intersects;
+    int                   *stack;
+    int                   x, y, z, *dx, *dy, *dz, dir, n_dirs;
+    int                   nx, ny, nz, n_blocks, n_done;
+    Point                 block_centre;
+    Real                  distance, dist;
+    closest_point_tree    tree;
+    progress_struct       progress;
 
     distance = radius_of_curvature;
+    n_blocks = x_size * y_size * z_size;
 
-    create_bitlist_3d( x_size, y_size, z_size, &intersects );
-    polygons = get_polygons_ptr( surface );
+    create_bitlist( n_blocks, &intersects );
 
-    initialize_progress_report( &progress, FALSE, polygons->n_items,
-                                "Scanning Polygons" );
+    tree = create_closest_point_tree( get_polygons_ptr( surface ) );
 
-    ALLOC( points, polygons->n_points );
+    initialize_progress_report( &progress, FALSE, x_size,
+                                "Scanning Blocks" );
 
-    for_less( poly, 0, polygons->n_items )
-    {
-        size = get_polygon_points( polygons, poly, points );
+    hint = -1;
 
-        get_range_points( size, points, &min_range, &max_range );
-
-        fill_Vector( offset, distance, distance, distance );
-        SUB_POINT_VECTOR( lower, min_range, offset );
-        ADD_POINT_VECTOR( upper, max_range, offset );
-        convert_world_to_block( min_point, block_size, &lower,
-                                &x_min_real, &y_min_real, &z_min_real );
-        convert_world_to_block( min_point, block_size, &upper,
-                                &x_max_real, &y_max_real, &z_max_real );
-
-        x_min = MAX( 0, FLOOR( x_min_real ) );
-        x_max = MIN( x_size-1, CEILING( x_max_real ) );
-        y_min = MAX( 0, FLOOR( y_min_real ) );
-        y_max = MIN( y_size-1, CEILING( y_max_real ) );
-        z_min = MAX( 0, FLOOR( z_min_real ) );
-        z_max = MIN( z_size-1, CEILING( z_max_real ) );
-
-        for_inclusive( x, x_min, x_max )
-        for_inclusive( y, y_min, y_max )
-        for_inclusive( z, z_min, z_max )
+    for_less( x, 0, x_size )
+    {
+        for_less( y, 0, y_size )
         {
-            if( get_bitlist_bit_3d( &intersects, x, y, z ) )
-                continue;
-
-            convert_block_to_world( min_point, block_size,
-                                    (Real) x + 0.5,
-                                    (Real) y + 0.5,
-                                    (Real) z + 0.5, &block_centre );
+            z = 0;
+            while( z < z_size )
+            {
+                convert_block_to_world( min_point, block_size,
+                                        (Real) x + 0.5,
+                                        (Real) y + 0.5,
+                                        (Real) z + 0.5, &block_centre );
 
-            dist = get_point_object_distance_sq( &block_centre,
-                                                 surface, poly,
-                                                 &nearest_point );
+                dist = FABS( find_signed_surface_distance( tree,
+                                               &block_centre, &hint, NULL ) );
 
-            if( dist < distance * distance )
-                set_bitlist_bit_3d( &intersects, x, y, z, TRUE );
+                if( dist < distance )
+                {
+                    set_bitlist_bit( &intersects,
+                          BLOCK_INDEX( x, y, z, y_size, z_size ), TRUE );
+                    ++z;
+                }
+                else
+                    z += 1 + (int) ((dist - distance) / block_size);
+            }
         }
 
-        update_progress_report( &progress, poly+1 );
+        update_progress_report( &progress, x+1 );
     }
 
     terminate_progress_report( &progress );
 
-    FREE( points );
+    delete_closest_point_tree( tree );
 
     n_dirs = get_3D_neighbour_directions( EIGHT_NEIGHBOURS, &dx, &dy, &dz );
 
-    create_bitlist_3d( x_size, y_size, z_size, on_boundary );
-    create_bitlist_3d( x_size, y_size, z_size, &visited_flags );
+    create_bitlist( n_blocks, on_boundary );
+    create_bitlist( n_blocks, &visited_flags );
 
-    INITIALIZE_QUEUE( queue );
-    voxel.x = 0;
-    voxel.y = 0;
-    voxel.z = 0;
-    INSERT_IN_QUEUE( queue, voxel );
+    n_stack = 0;
+    n_stack_alloced = 0;
+    stack = NULL;
+    ADD_ELEMENT_TO_ARRAY_WITH_SIZE( stack, n_stack_alloced, n_stack, 0,
+                                    DEFAULT_CHUNK_SIZE );
 
-    set_bitlist_bit_3d( &visited_flags, 0, 0, 0, TRUE );
-    set_bitlist_bit_3d( on_boundary, 0, 0, 0, FALSE );
+    set_bitlist_bit( &visited_flags, 0, TRUE );
+    set_bitlist_bit( on_boundary, 0, FALSE );
 
-    max_x = 0;
-    max_y = 0;
-    max_z = 0;
-
-    initialize_progress_report( &progress, FALSE,
-                                MAX3(x_size,y_size,z_size),
+    initialize_progress_report( &progress, FALSE, n_blocks,
                                 "Filling from Outside" );
 
-    while( !IS_QUEUE_EMPTY(queue) )
+    n_done = 0;
+
+    while( n_stack > 0 )
     {
-        REMOVE_FROM_QUEUE( queue, voxel );
+        --n_stack;
+        index = stack[n_stack];
 
-        x = (int) voxel.x;
-        y = (int) voxel.y;
-        z = (int) voxel.z;
-
-        if( x > max_x || y > max_y || z > max_z )
-        {
-            max_x = MAX( x, max_x );
-            max_y = MAX( y, max_y );
-            max_z = MAX( z, max_z );
-            n_to_do = MAX3( x_size - max_x, y_size - max_y, z_size - max_z );
-            update_progress_report( &progress,
-                                    MAX3(x_size,y_size,z_size) -
-                                    n_to_do + 1 );
-        }
+        z = index % z_size;
+        y = (index / z_size) % y_size;
+        x = index / z_size / y_size;
 
         for_less( dir, 0, n_dirs )
         {
@@ -334,30 +325,37 @@ private  void  find_boundary_blocks(
 
             if( nx < 0 || nx >= x_size ||
                 ny < 0 || ny >= y_size ||
-                nz < 0 || nz >= z_size ||
-                get_bitlist_bit_3d( &visited_flags, nx, ny, nz ) )
+                nz < 0 || nz >= z_size )
+                continue;
+
+            index = BLOCK_INDEX( nx, ny, nz, y_size, z_size );
+
+            if( get_bitlist_bit( &visited_flags, index ) )
                 continue;
 
-            set_bitlist_bit_3d( &visited_flags, nx, ny, nz, TRUE );
+            set_bitlist_bit( &visited_flags, index, TRUE );
 
-            if( get_bitlist_bit_3d( &intersects, nx, ny, nz ) )
-                set_bitlist_bit_3d( on_boundary, nx, ny, nz, TRUE );
+            if( get_bitlist_bit( &intersects, index ) )
+                set_bitlist_bit( on_boundary, index, TRUE );
             else
             {
-                voxel.x = nx;
-                voxel.y = ny;
-                voxel.z = nz;
-                INSERT_IN_QUEUE( queue, voxel );
+                ADD_ELEMENT_TO_ARRAY_WITH_SIZE( stack, n_stack_alloced,
+                                                n_stack, index,
+                                                DEFAULT_CHUNK_SIZE );
             }
         }
+
+        ++n_done;
+        update_progress_report( &progress, n_done );
     }
 
     terminate_progress_report( &progress );
 
-    DELETE_QUEUE( queue );
+    if( n_stack_alloced > 0 )
+        FREE( stack );
 
-    delete_bitlist_3d( &intersects );
-    delete_bitlist_3d( &visited_flags );
+    delete_bitlist( &intersects );
+    delete_bitlist( &visited_flags );
 }
 
 private  BOOLEAN  block_within_distance(
@@ -366,7 +364,7 @@ private  BOOLEAN  block_within_distance(
     int                x_size,
     int                y_size,
     int                z_size,
-    bitlist_3d_struct  *on_boundary,
+    bitlist_struct     *on_boundary,
     Point              *point,
     Real               radius )
 {
@@ -397,7 +395,8 @@ private  BOOLEAN  block_within_distance(
     for_inclusive( y, y_min, y_max )
     for_inclusive( z, z_min, z_max )
     {
-        if( get_bitlist_bit_3d( on_boundary, x, y, z ) )
+        if( get_bitlist_bit( on_boundary,
+                             BLOCK_INDEX( x, y, z, y_size, z_size ) ) )
         {
             convert_block_to_world( min_point, block_size,
                                     (Real) x,
@@ -3,6 +3,7 @@
 
 private  BOOLEAN  voxel_might_contain_boundary(
     Volume                      volume,
+    voxel_block_range_struct    *block_ranges,
     bitlist_3d_struct           *done_bits,
     bitlist_3d_struct           *surface_bits,
     int                         degrees_continuity,
@@ -259,10 +260,11 @@ private  void  set_up_to_search_ray(
 static  int  count = 0;
 #endif
 
-public  BOOLEAN  find_boundary_in_direction(
+private  BOOLEAN  search_ray_for_boundary(
     Volume                      volume,
     Volume                      label_volume,
     voxel_coef_struct           *lookup,
+    voxel_block_range_struct    *block_ranges,
     bitlist_3d_struct           *done_bits,
     bitlist_3d_struct           *surface_bits,
     Real                        model_dist,
@@ -425,7 +427,8 @@ public  BOOLEAN  find_boundary_in_direction(
             if( stop_distance0 < max_dist )
                 max_dist = stop_distance0;
 
-            if( voxel_might_contain_boundary( volume, done_bits, surface_bits,
+            if( voxel_might_contain_boundary( volume, block_ranges,
+                                              done_bits, surface_bits,
                                               degrees_continuity, voxel_index0,
                                               boundary_def ) &&
                 (isovalue &&
@@ -507,7 +510,8 @@ public  BOOLEAN  find_boundary_in_direction(
             if( stop_distance1 < max_dist )
                 max_dist = stop_distance1;
 
-            if( voxel_might_contain_boundary( volume, done_bits, surface_bits,
+            if( voxel_might_contain_boundary( volume, block_ranges,
+                                              done_bits, surface_bits,
                                               degrees_continuity, voxel_index1,
                                               boundary_def ) &&
                 (isovalue &&
@@ -595,6 +599,165 @@ public  BOOLEAN  find_boundary_in_direction(
     return( found );
 }
 
+public  BOOLEAN  find_boundary_in_direction(
+    Volume                      volume,
+    Volume                      label_volume,
+    voxel_coef_struct           *lookup,
+    bitlist_3d_struct           *done_bits,
+    bitlist_3d_struct           *surface_bits,
+    Real                        model_dist,
+    Point                       *ray_origin,
+    Vector                      *unit_pos_dir,
+    Vector                      *unit_neg_dir,
+    Real                        max_outwards_search_distance,
+    Real                        max_inwards_search_distance,
+    int                         degrees_continuity,
+    boundary_definition_struct  *boundary_def,
+    Real                        *boundary_distance )
+{
+    return( search_ray_for_boundary( volume, label_volume, lookup, NULL,
+                                     done_bits, surface_bits, model_dist,
+                                     ray_origin, unit_pos_dir, unit_neg_dir,
+                                     max_outwards_search_distance,
+                                     max_inwards_search_distance,
+                                     degrees_continuity, boundary_def,
+                                     boundary_distance ) );
+}
+
+typedef  struct
+{
+    unsigned  int  key;
+    int            ray;
+} ray_order_struct;
+
+private  int  compare_ray_order(
+    const void  *p1,
+    const void  *p2 )
+{
+    const ray_order_struct  *r1 = (const ray_order_struct *) p1;
+    const ray_order_struct  *r2 = (const ray_order_struct *) p2;
+
+    if( r1->key < r2->key )
+        return( -1 );
+    else if( r1->key > r2->key )
+        return( 1 );
+    else
+        return( r1->ray - r2->ray );
+}
+
+/*--- interleave the bits of the block coordinates (Morton order), so rays
+      sorted on the key visit neighbouring voxels consecutively */
+
+private  unsigned  int  get_ray_locality_key(
+    Volume   volume,
+    int      sizes[],
+    int      block_size,
+    Point    *origin )
+{
+    int            dim, bit, b[N_DIMENSIONS];
+    unsigned  int  key;
+    Real           voxel[N_DIMENSIONS];
+
+    convert_world_to_voxel( volume, RPoint_x(*origin), RPoint_y(*origin),
+                            RPoint_z(*origin), voxel );
+
+    for_less( dim, 0, N_DIMENSIONS )
+    {
+        b[dim] = FLOOR( voxel[dim] + 0.5 );
+        if( b[dim] < 0 )
+            b[dim] = 0;
+        else if( b[dim] >= sizes[dim] )
+            b[dim] = sizes[dim] - 1;
+        b[dim] /= block_size;
+    }
+
+    key = 0;
+    for_less( bit, 0, 10 )
+    {
+        for_less( dim, 0, N_DIMENSIONS )
+            key |= (unsigned int) ((b[dim] >> bit) & 1) << (3 * bit + dim);
+    }
+
+    return( key );
+}
+
+/*--- searches each ray in both directions from its origin, as
+      find_boundary_in_direction() with model_dist 0 and the same direction
+      for both legs, but in order of spatial locality so that the coefficient
+      lookup and the done/surface bits are reused across neighbouring rays.
+      If block_ranges is not NULL, voxels in blocks which cannot contain
+      the isovalue range are skipped.  Returns the number of rays for which
+      a boundary was found. */
+
+public  int  find_boundaries_in_directions(
+    Volume                      volume,
+    Volume                      label_volume,
+    voxel_coef_struct           *lookup,
+    bitlist_3d_struct           *done_bits,
+    bitlist_3d_struct           *surface_bits,
+    voxel_block_range_struct    *block_ranges,
+    int                         n_rays,
+    Point                       ray_origins[],
+    Vector                      ray_directions[],
+    Real                        max_outwards_search_distance,
+    Real                        max_inwards_search_distance,
+    int                         degrees_continuity,
+    boundary_definition_struct  *boundary_def,
+    BOOLEAN                     found[],
+    Real                        boundary_distances[] )
+{
+    int                i, ray, n_found, block_size, sizes[N_DIMENSIONS];
+    ray_order_struct   *order;
+
+    if( n_rays <= 0 )
+        return( 0 );
+
+    if( block_ranges != NULL )
+        block_size = block_ranges->block_size;
+    else
+        block_size = DEFAULT_VOXEL_BLOCK_SIZE;
+
+    get_volume_sizes( volume, sizes );
+
+    ALLOC( order, n_rays );
+
+    for_less( i, 0, n_rays )
+    {
+        order[i].ray = i;
+        order[i].key = get_ray_locality_key( volume, sizes, block_size,
+                                             &ray_origins[i] );
+    }
+
+    if( n_rays > 1 )
+        qsort( (void *) order, (size_t) n_rays, sizeof(order[0]),
+               compare_ray_order );
+
+    n_found = 0;
+
+    for_less( i, 0, n_rays )
+    {
+        ray = order[i].ray;
+
+        found[ray] = search_ray_for_boundary( volume, label_volume, lookup,
+                                              block_ranges,
+                                              done_bits, surface_bits, 0.0,
+                                              &ray_origins[ray],
+                                              &ray_directions[ray],
+                                              &ray_directions[ray],
+                                              max_outwards_search_distance,
+                                              max_inwards_search_distance,
+                                              degrees_continuity,
+                                              boundary_def,
+                                              &boundary_distances[ray] );
+        if( found[ray] )
+            ++n_found;
+    }
+
+    FREE( order );
+
+    return( n_found );
+}
+
 private  void   get_trilinear_gradient(
     Real   coefs[],
     Real   u,
@@ -840,6 +1003,7 @@ private  BOOLEAN  does_voxel_contain_value_range(
 
 private  BOOLEAN  voxel_might_contain_boundary(
     Volume                      volume,
+    voxel_block_range_struct    *block_ranges,
     bitlist_3d_struct           *done_bits,
     bitlist_3d_struct           *surface_bits,
     int                         degrees_continuity,
@@ -848,6 +1012,12 @@ private  BOOLEAN  voxel_might_contain_boundary(
 {
     BOOLEAN         contains;
 
+    if( block_ranges != NULL &&
+        !voxel_block_might_contain_range( block_ranges, voxel_indices,
+                                          boundary_def->min_isovalue,
+                                          boundary_def->max_isovalue ) )
+        return( FALSE );
+
     if( done_bits != NULL )
     {
         if( !get_bitlist_bit_3d( done_bits,
@@ -1,5 +1,6 @@
 #include  <volume_io/internal_volume_io.h>
 #include  <bicpl.h>
+#include  <volume_sampler.h>
 
 int  main(
     int   argc,
@@ -9,9 +10,10 @@ int  main(
     Volume               volume;
     int                  i, n_inside;
     int                  n_volumes, n_tag_points;
-    Real                 **tags_volume1, **tags_volume2, value;
-    Real                 voxel[N_DIMENSIONS], avg_threshold, tag_threshold;
-    int                  int_voxel[N_DIMENSIONS];
+    Real                 **tags_volume1, **tags_volume2, *values;
+    Real                 avg_threshold, tag_threshold;
+    BOOLEAN              *inside;
+    volume_sampler_struct  sampler;
 
     initialize_argument_processing( argc, argv );
 
@@ -36,27 +38,39 @@ int  main(
                             NULL, NULL, NULL, NULL ) != OK )
             return( 1 );
 
-        n_inside = 0;
+        initialize_volume_sampler( &sampler, n_tag_points );
 
         for_less( i, 0, n_tag_points )
         {
-            convert_world_to_voxel( volume, tags_volume1[i][X],
-                                    tags_volume1[i][Y],
-                                    tags_volume1[i][Z],
-                                    voxel );
+            set_volume_sampler_point( &sampler, i, tags_volume1[i][X],
+                                      tags_volume1[i][Y], tags_volume1[i][Z] );
+        }
+
+        if( n_tag_points > 0 )
+        {
+            ALLOC( values, n_tag_points );
+            ALLOC( inside, n_tag_points );
+        }
+
+        sample_volumes_at_points( &sampler, 1, &volume, -1, 0.0,
+                                  &values, &inside );
 
-            convert_real_to_int_voxel( N_DIMENSIONS, voxel, int_voxel );
+        n_inside = 0;
 
-            if( int_voxel_is_within_volume( volume, int_voxel ) )
-            {
-                value = get_volume_real_value( volume, int_voxel[X],
-                                         int_voxel[Y], int_voxel[Z], 0, 0 );
+        for_less( i, 0, n_tag_points )
+        {
+            if( inside[i] && values[i] >= avg_threshold )
+                ++n_inside;
+        }
 
-                if( value >= avg_threshold )
-                    ++n_inside;
-            }
+        if( n_tag_points > 0 )
+        {
+            FREE( values );
+            FREE( inside );
         }
 
+        delete_volume_sampler( &sampler );
+
         if( (Real) n_inside / (Real) n_tag_points < tag_threshold )
             print( "POSSIBLE TAG OUTLIER: %s\n", input_tags );
 
@@ -1,5 +1,6 @@
 #include  <volume_io/internal_volume_io.h>
 #include  <bicpl.h>
+#include  <voxel_scan.h>
 
 private  void  usage(
     STRING  executable )
@@ -18,9 +19,10 @@ int  main(
 {
     STRING     input_filename;
     Volume     volume;
-    int        v[MAX_DIMENSIONS], n_dims, dim;
-    Real       value, weight, threshold, xw, yw, zw;
-    Real       voxel_centroid[MAX_DIMENSIONS];
+    int                v[MAX_DIMENSIONS], n_dims, dim, i, start, n_voxels;
+    Real               value, weight, threshold, xw, yw, zw, *values;
+    Real               voxel_centroid[MAX_DIMENSIONS];
+    voxel_scan_struct  scan;
 
     initialize_argument_processing( argc, argv );
 
@@ -43,18 +45,38 @@ int  main(
         voxel_centroid[dim] = 0.0;
     weight = 0.0;
 
-    BEGIN_ALL_VOXELS( volume, v[0], v[1], v[2], v[3], v[4] )
+    initialize_voxel_scan( &scan, volume, 0 );
 
-        value = get_volume_real_value( volume, v[0], v[1], v[2], v[3], v[4] );
+    while( get_next_voxel_span_values( &scan, TRUE, &start, &n_voxels,
+                                       &values ) )
+    {
+        get_voxel_scan_position( &scan, start, v );
 
-        if( value >= threshold )
+        for_less( i, 0, n_voxels )
         {
-            weight += value;
-            for_less( dim, 0, n_dims )
-                voxel_centroid[dim] += (Real) v[dim] * value;
+            value = values[i];
+
+            if( value >= threshold )
+            {
+                weight += value;
+                for_less( dim, 0, n_dims )
+                    voxel_centroid[dim] += (Real) v[dim] * value;
+            }
+
+            /*--- step to the next voxel, last dimension fastest */
+
+            dim = MAX_DIMENSIONS - 1;
+            while( dim > 0 && ++v[dim] == scan.sizes[dim] )
+            {
+                v[dim] = 0;
+                --dim;
+            }
+            if( dim == 0 )
+                ++v[0];
         }
+    }
 
-    END_ALL_VOXELS
+    delete_voxel_scan( &scan );
 
     for_less( dim, 0, n_dims )
         voxel_centroid[dim] /= weight;
@@ -458,6 +458,7 @@ private  void  create_image_coefficients(
     voxel_coef_struct           *voxel_lookup,
     bitlist_3d_struct           *done_bits,
     bitlist_3d_struct           *surface_bits,
+    voxel_block_range_struct    *block_ranges,
     boundary_definition_struct  *boundary,
     Real                        tangent_weight,
     Real                        max_outward,
@@ -489,14 +490,27 @@ private  void  create_image_coefficients(
     Vector     perp, vectors[3];
     Real       angle, vector_weights[3], *node_weights;
     Transform  transform;
+    BOOLEAN    found_flag;
+    int        ray, n_rays, *ray_nodes;
+    Point      *ray_origins;
+    Vector     *ray_normals;
+    BOOLEAN    *ray_found;
+    Real       *ray_dists;
     progress_struct  progress;
 
     ALLOC( indices, n_parameters );
     ALLOC( node_weights, n_parameters );
 
-    initialize_progress_report( &progress, FALSE, n_nodes,
-                                "Creating Image Coefficients" );
+    /*--- gather the search rays of all nodes, so they can be searched
+          in one batch, ordered for locality in the volume */
 
+    ALLOC( ray_nodes, n_nodes );
+    ALLOC( ray_origins, n_nodes );
+    ALLOC( ray_normals, n_nodes );
+    ALLOC( ray_found, n_nodes );
+    ALLOC( ray_dists, n_nodes );
+
+    n_rays = 0;
     for_less( node, 0, n_nodes )
     {
         parm_index = to_parameter[node];
@@ -518,18 +532,36 @@ private  void  create_image_coefficients(
                 neigh_points[n] = surface_points[neigh];
         }
 
-        find_polygon_normal( n_neighbours[node], neigh_points, &normal );
+        find_polygon_normal( n_neighbours[node], neigh_points,
+                             &ray_normals[n_rays] );
 
-        fill_Point( origin,
+        fill_Point( ray_origins[n_rays],
                     parameters[IJ(parm_index,X,3)],
                     parameters[IJ(parm_index,Y,3)],
                     parameters[IJ(parm_index,Z,3)] );
+        ray_nodes[n_rays] = node;
+        ++n_rays;
+    }
+
+    (void) find_boundaries_in_directions( volume, NULL, voxel_lookup,
+                                          done_bits, surface_bits,
+                                          block_ranges, n_rays,
+                                          ray_origins, ray_normals,
+                                          max_outward, max_inward, 0,
+                                          boundary, ray_found, ray_dists );
+
+    initialize_progress_report( &progress, FALSE, n_rays,
+                                "Creating Image Coefficients" );
 
-        if( !find_boundary_in_direction( volume, NULL, voxel_lookup,
-                                         done_bits, surface_bits,
-                                         0.0, &origin, &normal, &normal,
-                                         max_outward, max_inward, 0,
-                                         boundary, &dist ) )
+    for_less( ray, 0, n_rays )
+    {
+        node = ray_nodes[ray];
+        parm_index = to_parameter[node];
+        origin = ray_origins[ray];
+        normal = ray_normals[ray];
+        dist = ray_dists[ray];
+
+        if( !ray_found[ray] )
         {
             if( floating_flag )
             {
@@ -615,11 +647,17 @@ private  void  create_image_coefficients(
             }
         }
 
-        update_progress_report( &progress, node+1 );
+        update_progress_report( &progress, ray+1 );
     }
 
     terminate_progress_report( &progress );
 
+    FREE( ray_nodes );
+    FREE( ray_origins );
+    FREE( ray_normals );
+    FREE( ray_found );
+    FREE( ray_dists );
+
     if( oversample <= 0 )
     {
         FREE( indices );
@@ -745,12 +783,15 @@ private  void  create_image_coefficients(
                                           (1.0 - alpha) * RPoint_z(p1) +
                                                  alpha  * RPoint_z(p2) );
 
-                if( !find_boundary_in_direction( volume, NULL, voxel_lookup,
-                                                 done_bits, surface_bits,
-                                                 0.0, &search_point,
-                                                 &search_normal, &search_normal,
-                                                 max_outward, max_inward, 0,
-                                                 boundary, &dist ) )
+                if( find_boundaries_in_directions( volume, NULL,
+                                                   voxel_lookup,
+                                                   done_bits, surface_bits,
+                                                   block_ranges, 1,
+                                                   &search_point,
+                                                   &search_normal,
+                                                   max_outward, max_inward, 0,
+                                                   boundary, &found_flag,
+                                                   &dist ) == 0 )
                 {
                     if( floating_flag )
                     {
@@ -938,6 +979,7 @@ private  void   fit_polygons(
     voxel_coef_struct           voxel_lookup;
     bitlist_3d_struct           done_bits, surface_bits;
     bitlist_3d_struct           *done_bits_ptr, *surface_bits_ptr;
+    voxel_block_range_struct    block_ranges;
     Real                        constant;
     int                         *n_cross_terms, **cross_parms;
     ftype                       *linear_terms, *square_terms, **cross_terms;
@@ -1056,6 +1098,9 @@ private  void   fit_polygons(
         create_bitlist_3d( sizes[X], sizes[Y], sizes[Z], &surface_bits );
     }
 
+    initialize_voxel_block_ranges( &block_ranges, volume, 0,
+                                   DEFAULT_VOXEL_BLOCK_SIZE );
+
     ALLOC( weights, n_parameters );
 
     INITIALIZE_LSQ( n_parameters, &constant, &linear_terms,
@@ -1082,7 +1127,7 @@ private  void   fit_polygons(
         weight = sqrt( 1.0 / (Real) (n_image_equations+n_oversample_equations));
 
         create_image_coefficients( weight, volume, &voxel_lookup,
-                       done_bits_ptr, surface_bits_ptr,
+                       done_bits_ptr, surface_bits_ptr, &block_ranges,
                        &boundary, tangent_weight,
                        max_outward, max_inward,
                        floating_flag, oversample,
@@ -1111,6 +1156,8 @@ private  void   fit_polygons(
 
     FREE( weights );
 
+    delete_voxel_block_ranges( &block_ranges );
+
     DELETE_LSQ( n_parameters, linear_terms,
                 square_terms, n_cross_terms, cross_parms, cross_terms );
 
@@ -1,12 +1,14 @@
 #include  <volume_io/internal_volume_io.h>
 #include  <bicpl.h>
 #include  <conjugate_min.h>
+#include  <lbfgs_min.h>
 
 private  void  fit_curve(
     int     n_points,
     Point   points[],
     Real    stretch_weight,
     Real    smoothness_weight,
+    int     n_corrections,
     int     n_cvs,
     Point   cvs[] );
 
@@ -21,10 +23,13 @@ private  void  usage(
     STRING  usage_str = "\n\
 Usage: %s  input_lines.tag  output_lines.obj n_mm_per_segment\n\
                   [stretch_weight] [smoothness_weight] [disjoint_distance]\n\
+                  [-lbfgs n_corrections]\n\
 \n\
      Creates a piecewise linear curve that approximates the set of points in\n\
      the tag file.  The n_mm_per_segment sets\n\
-     the number of mm length of the line segments\n\n";
+     the number of mm length of the line segments.  With -lbfgs, the curve\n\
+     is fitted by L-BFGS keeping n_corrections corrections, instead of by\n\
+     conjugate gradients.\n\n";
 
     print_error( usage_str, executable );
 }
@@ -33,14 +38,14 @@ int  main(
     int   argc,
     char  *argv[] )
 {
-    STRING               input_filename, output_filename;
+    STRING               input_filename, output_filename, option;
     Real                 **tags, stretch_weight, smoothness_weight;
     Real                 disjoint_distance, sq_disjoint_distance;
     Real                 n_mm_per_segment, length, pos, delta_length;
     Real                 current_length;
     int                  *tree_indices, n_span, n_segments;
     int                  p, n_tag_points, n_volumes;
-    int                  i, n_cvs;
+    int                  i, n_cvs, n_corrections;
     int                  n_class_points, p2, p1, n_classes;
     int                  current_ind;
     object_struct        **object_list;
@@ -63,6 +68,18 @@ int  main(
     (void) get_real_argument( 10.0, &smoothness_weight );
     break_up_flag = get_real_argument( 0.0, &disjoint_distance );
 
+    n_corrections = 0;
+
+    if( get_string_argument( NULL, &option ) )
+    {
+        if( !equal_strings( option, "-lbfgs" ) ||
+            !get_int_argument( 0, &n_corrections ) || n_corrections <= 0 )
+        {
+            usage( argv[0] );
+            return( 1 );
+        }
+    }
+
     if( input_tag_file( input_filename, &n_volumes, &n_tag_points,
                         &tags, NULL, NULL, NULL, NULL, NULL ) != OK )
         return( 1 );
@@ -227,8 +244,8 @@ int  main(
             }
         }
 
-        fit_curve( n_class_points, class_points,
-                   stretch_weight, smoothness_weight, n_cvs, lines->points );
+        fit_curve( n_class_points, class_points, stretch_weight,
+                   smoothness_weight, n_corrections, n_cvs, lines->points );
 
         FREE( tree_indices );
     }
@@ -776,6 +793,7 @@ private  void  fit_curve(
     Point   points[],
     Real    stretch_weight,
     Real    smoothness_weight,
+    int     n_corrections,
     int     n_cvs,
     Point   cvs[] )
 {
@@ -811,14 +829,25 @@ private  void  fit_curve(
     data.stretch_weight = stretch_weight;
     data.smoothness_weight = smoothness_weight;
 
-    fit = conjugate_minimize_function( 3 * n_cvs, parameters,
+    if( n_corrections > 0 )
+    {
+        fit = lbfgs_minimize_function( 3 * n_cvs, parameters,
                                        function, function_deriv,
                                        (void *) &data, range_tolerance,
-                                       domain_tolerance,
-                                       line_min_range_tolerance,
-                                       line_min_domain_tolerance,
-                                       n_iterations, 2,
-                                       parameters );
+                                       domain_tolerance, n_corrections,
+                                       n_iterations, parameters );
+    }
+    else
+    {
+        fit = conjugate_minimize_function( 3 * n_cvs, parameters,
+                                           function, function_deriv,
+                                           (void *) &data, range_tolerance,
+                                           domain_tolerance,
+                                           line_min_range_tolerance,
+                                           line_min_domain_tolerance,
+                                           n_iterations, 2,
+                                           parameters );
+    }
 
     for_less( p, 0, n_cvs )
     {
@@ -0,0 +1,300 @@
+#include  <volume_io/internal_volume_io.h>
+#include  <bicpl.h>
+#include  <flatten_energy.h>
+
+/*--- terms are evaluated a block at a time: the coordinates are gathered
+      into contiguous arrays, the residuals are computed in a tight loop,
+      and only then are the gradients scattered back to the vertices */
+
+#define  BLOCK_SIZE   256
+
+public  void  initialize_flatten_energy(
+    flatten_energy_struct  *energy,
+    int                    n_points )
+{
+    energy->n_points = n_points;
+
+    energy->n_edges = 0;
+    energy->edge_p1 = NULL;
+    energy->edge_p2 = NULL;
+    energy->edge_target = NULL;
+    energy->edge_weight = NULL;
+
+    energy->n_fans = 0;
+    energy->fan_centre = NULL;
+    energy->fan_prev = NULL;
+    energy->fan_cur = NULL;
+    energy->fan_next = NULL;
+    energy->fan_target = NULL;
+    energy->fan_weight = NULL;
+}
+
+public  void  add_flatten_edge_term(
+    flatten_energy_struct  *energy,
+    int                    p1,
+    int                    p2,
+    Real                   target,
+    Real                   weight )
+{
+    int   n;
+
+    n = energy->n_edges;
+
+    SET_ARRAY_SIZE( energy->edge_p1, n, n+1, DEFAULT_CHUNK_SIZE );
+    SET_ARRAY_SIZE( energy->edge_p2, n, n+1, DEFAULT_CHUNK_SIZE );
+    SET_ARRAY_SIZE( energy->edge_target, n, n+1, DEFAULT_CHUNK_SIZE );
+    SET_ARRAY_SIZE( energy->edge_weight, n, n+1, DEFAULT_CHUNK_SIZE );
+
+    energy->edge_p1[n] = p1;
+    energy->edge_p2[n] = p2;
+    energy->edge_target[n] = (float) target;
+    energy->edge_weight[n] = (float) weight;
+
+    energy->n_edges = n + 1;
+}
+
+public  void  add_flatten_fan_term(
+    flatten_energy_struct  *energy,
+    int                    centre,
+    int                    prev,
+    int                    cur,
+    int                    next,
+    Real                   target,
+    Real                   weight )
+{
+    int   n;
+
+    n = energy->n_fans;
+
+    SET_ARRAY_SIZE( energy->fan_centre, n, n+1, DEFAULT_CHUNK_SIZE );
+    SET_ARRAY_SIZE( energy->fan_prev, n, n+1, DEFAULT_CHUNK_SIZE );
+    SET_ARRAY_SIZE( energy->fan_cur, n, n+1, DEFAULT_CHUNK_SIZE );
+    SET_ARRAY_SIZE( energy->fan_next, n, n+1, DEFAULT_CHUNK_SIZE );
+    SET_ARRAY_SIZE( energy->fan_target, n, n+1, DEFAULT_CHUNK_SIZE );
+    SET_ARRAY_SIZE( energy->fan_weight, n, n+1, DEFAULT_CHUNK_SIZE );
+
+    energy->fan_centre[n] = centre;
+    energy->fan_prev[n] = prev;
+    energy->fan_cur[n] = cur;
+    energy->fan_next[n] = next;
+    energy->fan_target[n] = (float) target;
+    energy->fan_weight[n] = (float) weight;
+
+    energy->n_fans = n + 1;
+}
+
+public  void  delete_flatten_energy(
+    flatten_energy_struct  *energy )
+{
+    if( energy->n_edges > 0 )
+    {
+        FREE( energy->edge_p1 );
+        FREE( energy->edge_p2 );
+        FREE( energy->edge_target );
+        FREE( energy->edge_weight );
+    }
+
+    if( energy->n_fans > 0 )
+    {
+        FREE( energy->fan_centre );
+        FREE( energy->fan_prev );
+        FREE( energy->fan_cur );
+        FREE( energy->fan_next );
+        FREE( energy->fan_target );
+        FREE( energy->fan_weight );
+    }
+}
+
+private  Real  evaluate_edge_terms(
+    flatten_energy_struct  *energy,
+    float                  x[],
+    float                  y[],
+    float                  z[],
+    float                  gx[],
+    float                  gy[],
+    float                  gz[] )
+{
+    int     start, n, k, i, j;
+    float   dx[BLOCK_SIZE], dy[BLOCK_SIZE], dz[BLOCK_SIZE];
+    float   coef[BLOCK_SIZE], diff, w;
+    Real    fit;
+
+    fit = 0.0;
+
+    for( start = 0;  start < energy->n_edges;  start += BLOCK_SIZE )
+    {
+        n = MIN( BLOCK_SIZE, energy->n_edges - start );
+
+        for_less( k, 0, n )
+        {
+            i = energy->edge_p1[start+k];
+            j = energy->edge_p2[start+k];
+            dx[k] = x[i] - x[j];
+            dy[k] = y[i] - y[j];
+            dz[k] = z[i] - z[j];
+        }
+
+        for_less( k, 0, n )
+        {
+            diff = dx[k] * dx[k] + dy[k] * dy[k] + dz[k] * dz[k] -
+                   energy->edge_target[start+k];
+            w = energy->edge_weight[start+k];
+            fit += (Real) (w * diff * diff);
+            coef[k] = 4.0f * w * diff;
+        }
+
+        if( gx == NULL )
+            continue;
+
+        for_less( k, 0, n )
+        {
+            i = energy->edge_p1[start+k];
+            j = energy->edge_p2[start+k];
+            gx[i] += coef[k] * dx[k];
+            gy[i] += coef[k] * dy[k];
+            gz[i] += coef[k] * dz[k];
+            gx[j] -= coef[k] * dx[k];
+            gy[j] -= coef[k] * dy[k];
+            gz[j] -= coef[k] * dz[k];
+        }
+    }
+
+    return( fit );
+}
+
+private  Real  evaluate_fan_terms(
+    flatten_energy_struct  *energy,
+    float                  x[],
+    float                  y[],
+    float                  z[],
+    float                  gx[],
+    float                  gy[],
+    float                  gz[] )
+{
+    int     start, n, k, c, i2, i3, i4;
+    float   dx2[BLOCK_SIZE], dy2[BLOCK_SIZE], dz2[BLOCK_SIZE];
+    float   dx3[BLOCK_SIZE], dy3[BLOCK_SIZE], dz3[BLOCK_SIZE];
+    float   dx4[BLOCK_SIZE], dy4[BLOCK_SIZE], dz4[BLOCK_SIZE];
+    float   coef[BLOCK_SIZE];
+    float   cx, cy, cz, vol, diff, w;
+    float   g2x, g2y, g2z, g3x, g3y, g3z, g4x, g4y, g4z;
+    Real    fit;
+
+    fit = 0.0;
+
+    for( start = 0;  start < energy->n_fans;  start += BLOCK_SIZE )
+    {
+        n = MIN( BLOCK_SIZE, energy->n_fans - start );
+
+        for_less( k, 0, n )
+        {
+            c = energy->fan_centre[start+k];
+            i2 = energy->fan_prev[start+k];
+            i3 = energy->fan_cur[start+k];
+            i4 = energy->fan_next[start+k];
+
+            dx2[k] = x[i2] - x[c];
+            dy2[k] = y[i2] - y[c];
+            dz2[k] = z[i2] - z[c];
+            dx3[k] = x[i3] - x[c];
+            dy3[k] = y[i3] - y[c];
+            dz3[k] = z[i3] - z[c];
+            dx4[k] = x[i4] - x[c];
+            dy4[k] = y[i4] - y[c];
+            dz4[k] = z[i4] - z[c];
+        }
+
+        for_less( k, 0, n )
+        {
+            cx = dy3[k] * dz2[k] - dz3[k] * dy2[k];
+            cy = dz3[k] * dx2[k] - dx3[k] * dz2[k];
+            cz = dx3[k] * dy2[k] - dy3[k] * dx2[k];
+
+            vol = cx * dx4[k] + cy * dy4[k] + cz * dz4[k];
+            diff = vol - energy->fan_target[start+k];
+            w = energy->fan_weight[start+k];
+            fit += (Real) (w * diff * diff);
+            coef[k] = 2.0f * w * diff;
+        }
+
+        if( gx == NULL )
+            continue;
+
+        /*--- vol = (d3 x d2) . d4 = d3 . (d2 x d4) = d2 . (d4 x d3) */
+
+        for_less( k, 0, n )
+        {
+            c = energy->fan_centre[start+k];
+            i2 = energy->fan_prev[start+k];
+            i3 = energy->fan_cur[start+k];
+            i4 = energy->fan_next[start+k];
+
+            g4x = coef[k] * (dy3[k] * dz2[k] - dz3[k] * dy2[k]);
+            g4y = coef[k] * (dz3[k] * dx2[k] - dx3[k] * dz2[k]);
+            g4z = coef[k] * (dx3[k] * dy2[k] - dy3[k] * dx2[k]);
+
+            g3x = coef[k] * (dy2[k] * dz4[k] - dz2[k] * dy4[k]);
+            g3y = coef[k] * (dz2[k] * dx4[k] - dx2[k] * dz4[k]);
+            g3z = coef[k] * (dx2[k] * dy4[k] - dy2[k] * dx4[k]);
+
+            g2x = coef[k] * (dy4[k] * dz3[k] - dz4[k] * dy3[k]);
+            g2y = coef[k] * (dz4[k] * dx3[k] - dx4[k] * dz3[k]);
+            g2z = coef[k] * (dx4[k] * dy3[k] - dy4[k] * dx3[k]);
+
+            gx[i2] += g2x;
+            gy[i2] += g2y;
+            gz[i2] += g2z;
+            gx[i3] += g3x;
+            gy[i3] += g3y;
+            gz[i3] += g3z;
+            gx[i4] += g4x;
+            gy[i4] += g4y;
+            gz[i4] += g4z;
+            gx[c] -= g2x + g3x + g4x;
+            gy[c] -= g2y + g3y + g4y;
+            gz[c] -= g2z + g3z + g4z;
+        }
+    }
+
+    return( fit );
+}
+
+/*--- returns the energy of the positions, and if deriv is not NULL, fills
+      it with the gradient in the same layout, computed in the same pass */
+
+public  Real  evaluate_flatten_energy(
+    flatten_energy_struct  *energy,
+    float                  positions[],
+    float                  deriv[] )
+{
+    int     p, n_points;
+    float   *x, *y, *z, *gx, *gy, *gz;
+    Real    fit;
+
+    n_points = energy->n_points;
+
+    x = &positions[FLATTEN_INDEX(n_points,0,X)];
+    y = &positions[FLATTEN_INDEX(n_points,0,Y)];
+    z = &positions[FLATTEN_INDEX(n_points,0,Z)];
+
+    if( deriv != NULL )
+    {
+        for_less( p, 0, 3 * n_points )
+            deriv[p] = 0.0f;
+
+        gx = &deriv[FLATTEN_INDEX(n_points,0,X)];
+        gy = &deriv[FLATTEN_INDEX(n_points,0,Y)];
+        gz = &deriv[FLATTEN_INDEX(n_points,0,Z)];
+    }
+    else
+    {
+        gx = NULL;
+        gy = NULL;
+        gz = NULL;
+    }
+
+    fit = evaluate_edge_terms( energy, x, y, z, gx, gy, gz );
+    fit += evaluate_fan_terms( energy, x, y, z, gx, gy, gz );
+
+    return( fit );
+}
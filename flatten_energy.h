@@ -0,0 +1,45 @@
+#ifndef  DEF_FLATTEN_ENERGY_H
+#define  DEF_FLATTEN_ENERGY_H
+
+/*--- positions are stored coordinate by coordinate: x[0..n_points-1],
+      then y, then z */
+
+#define  FLATTEN_INDEX( n_points, point, coord )  ((coord) * (n_points) + (point))
+
+typedef struct
+{
+    int      n_points;
+
+    /*--- edge terms:  weight * (|p1 - p2|^2 - target)^2 */
+
+    int      n_edges;
+    int      *edge_p1;
+    int      *edge_p2;
+    float    *edge_target;
+    float    *edge_weight;
+
+    /*--- one-ring terms, for each centre vertex and consecutive neighbours
+          prev, cur, next:  weight * ((cur-c) x (prev-c) . (next-c) - target)^2 */
+
+    int      n_fans;
+    int      *fan_centre;
+    int      *fan_prev;
+    int      *fan_cur;
+    int      *fan_next;
+    float    *fan_target;
+    float    *fan_weight;
+} flatten_energy_struct;
+
+#ifndef  public
+#define       public   extern
+#define       public_was_defined_here
+#endif
+
+#include  <flatten_energy_prototypes.h>
+
+#ifdef  public_was_defined_here
+#undef       public
+#undef       public_was_defined_here
+#endif
+
+#endif
@@ -0,0 +1,31 @@
+#ifndef  DEF_FLATTEN_ENERGY_PROTOTYPES
+#define  DEF_FLATTEN_ENERGY_PROTOTYPES
+
+public  void  initialize_flatten_energy(
+    flatten_energy_struct  *energy,
+    int                    n_points );
+
+public  void  add_flatten_edge_term(
+    flatten_energy_struct  *energy,
+    int                    p1,
+    int                    p2,
+    Real                   target,
+    Real                   weight );
+
+public  void  add_flatten_fan_term(
+    flatten_energy_struct  *energy,
+    int                    centre,
+    int                    prev,
+    int                    cur,
+    int                    next,
+    Real                   target,
+    Real                   weight );
+
+public  void  delete_flatten_energy(
+    flatten_energy_struct  *energy );
+
+public  Real  evaluate_flatten_energy(
+    flatten_energy_struct  *energy,
+    float                  positions[],
+    float                  deriv[] );
+#endif
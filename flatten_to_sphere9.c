@@ -1,5 +1,8 @@
 #include  <volume_io/internal_volume_io.h>
 #include  <bicpl.h>
+#include  <special_geometry.h>
+#include  <flatten_energy.h>
+#include  <lbfgs_min.h>
 
 #define  TOLERANCE         1.0e-7
 
@@ -17,7 +20,23 @@ private  void  flatten_polygons(
     int              start_vertex,
     int              n_vertices_to_do,
     Real             weight,
-    int              n_iters );
+    int              n_iters,
+    int              n_corrections );
+
+private  Point  *flatten_coarse_levels(
+    polygons_struct  *polygons,
+    Point            init_points[],
+    Real             radius,
+    Real             ratio,
+    Real             distance_weight,
+    int              start_vertex,
+    int              n_vertices_to_do,
+    Real             weight,
+    int              n_levels,
+    int              n_coarse_iters,
+    int              n_refine_iters,
+    int              n_corrections,
+    BOOLEAN          *solved );
 
 int  main(
     int    argc,
@@ -27,13 +46,14 @@ int  main(
     int                  n_objects, n_i_objects, n_iters, poly;
     int                  *n_neighbours, **neighbours, n_points;
     int                  start_vertex, n_vertices_to_do;
+    int                  n_levels, n_refine_iters, n_corrections;
     Real                 radius, ratio, distance_weight;
     Real                 weight;
     File_formats         format;
     object_struct        **object_list, **i_object_list;
     polygons_struct      *polygons, *init_polygons, p;
     Point                *init_points, *points;
-    BOOLEAN              init_specified;
+    BOOLEAN              init_specified, coarse_solved;
 
     initialize_argument_processing( argc, argv );
 
@@ -42,7 +62,8 @@ int  main(
     {
         print_error( "Usage: %s  input.obj output.obj [n_iters] [init] [ratio] [min max]\n",
                      argv[0] );
-        print_error( "            vertex  n_vertices  weight\n" );
+        print_error( "            vertex  n_vertices  weight  [n_levels] [n_refine_iters]\n" );
+        print_error( "            [n_lbfgs_corrections]\n" );
         return( 1 );
     }
 
@@ -55,6 +76,9 @@ int  main(
     (void) get_int_argument( -1, &start_vertex );
     (void) get_int_argument( -1, &n_vertices_to_do );
     (void) get_real_argument( 1.0, &weight );
+    (void) get_int_argument( 1, &n_levels );
+    (void) get_int_argument( 10, &n_refine_iters );
+    (void) get_int_argument( 0, &n_corrections );
 
     if( input_graphics_file( src_filename, &format, &n_objects,
                              &object_list ) != OK || n_objects != 1 ||
@@ -94,6 +118,21 @@ int  main(
 
     radius = sqrt( get_polygons_surface_area( polygons ) / 4.0 / PI );
 
+    /*--- solve on the coarser subdivision levels first, and start the
+          full resolution solve from the prolonged result */
+
+    if( n_levels > 1 )
+    {
+        init_points = flatten_coarse_levels( polygons, init_points, radius,
+                                             ratio, distance_weight,
+                                             start_vertex, n_vertices_to_do,
+                                             weight, n_levels, n_iters,
+                                             n_refine_iters, n_corrections,
+                                             &coarse_solved );
+        if( coarse_solved )
+            n_iters = n_refine_iters;
+    }
+
     create_polygon_point_neighbours( polygons, FALSE, &n_neighbours,
                                      &neighbours, NULL, NULL );
 
@@ -104,7 +143,8 @@ int  main(
 
     flatten_polygons( n_points, points, n_neighbours, neighbours,
                       init_points, radius, ratio, distance_weight,
-                      start_vertex, n_vertices_to_do, weight, n_iters );
+                      start_vertex, n_vertices_to_do, weight, n_iters,
+                      n_corrections );
 
     p.n_points = n_points;
     delete_polygon_point_neighbours( &p, n_neighbours, neighbours, NULL, NULL );
@@ -124,254 +164,175 @@ int  main(
     return( 0 );
 }
 
-private  Real  evaluate_fit(
-    int     n_parameters,
-    dtype   parameters[],
-    Real    distance_weight,
-    dtype   distances[],
-    dtype   volumes[],
-    dtype   weights[],
-    int     n_neighbours[],
-    int     *neighbours[] )
+/* ----------------------------- MNI Header -----------------------------------
+@NAME       : flatten_coarse_levels
+@INPUT      : polygons
+              init_points      - starting positions, or NULL
+              radius
+              ratio
+              distance_weight
+              start_vertex
+              n_vertices_to_do
+              weight
+              n_levels         - number of levels, including the finest
+              n_coarse_iters
+              n_refine_iters
+              n_corrections    - L-BFGS corrections, or 0 for conjugate
+                                 gradients
+@OUTPUT     : solved           - TRUE if any coarse level was solved
+@RETURNS    : starting positions for the finest level
+@DESCRIPTION: Coarse-to-fine solve over the subdivision hierarchy of a
+              sphere mesh which passes is_this_tetrahedral_topology(), a
+              regular subdivision of a tetrahedron, octahedron or
+              icosahedron, as tri_mesh_convert_from_polygons() rebuilds
+              the hierarchy down to a 4, 8 or 20 triangle base.  Any other
+              mesh is solved at a single level.  The coarsest level is
+              flattened with n_coarse_iters, each vertex introduced at the
+              next level is placed at the midpoint of the edge it bisects,
+              and each finer level is refined with n_refine_iters.  The
+              returned array replaces init_points, which is freed.  If
+              the mesh is not subdivided or there are no coarser levels,
+              solved is FALSE and the finest level must be solved with the
+              full number of iterations.
+@METHOD     : 
+@GLOBALS    : 
+@CALLS      : 
+@CREATED    : 
+@MODIFIED   : 
+---------------------------------------------------------------------------- */
+
+private  Point  *flatten_coarse_levels(
+    polygons_struct  *polygons,
+    Point            init_points[],
+    Real             radius,
+    Real             ratio,
+    Real             distance_weight,
+    int              start_vertex,
+    int              n_vertices_to_do,
+    Real             weight,
+    int              n_levels,
+    int              n_coarse_iters,
+    int              n_refine_iters,
+    int              n_corrections,
+    BOOLEAN          *solved )
 {
-    int     p, n_points, n, p_index, ind, n_neighs;
-    int     n_index, next_index, neigh;
-    Real    fit, diff, weight, dist, act_dist;
-    dtype   x1, y1, z1, vol;
-    dtype   cx, cy, cz;
-    dtype   dx2, dy2, dz2, dx3, dy3, dz3, dx4, dy4, dz4;
-    Real    dx, dy, dz;
-
-    fit = 0.0;
+    int              point, i, level, first_level, max_level, n_level_points;
+    int              *point_levels, (*parents)[2], *mesh_indices;
+    int              *n_neighbours, **neighbours;
+    int              level_start, level_n_to_do, level_iters;
+    Point            *positions, *level_init;
+    tri_mesh_struct  mesh;
+    polygons_struct  level_polygons;
 
-    n_points = n_parameters / 3;
+    *solved = FALSE;
 
-    ind = 0;
-    for_less( p, 0, n_points )
+    if( !is_this_tetrahedral_topology( polygons ) )
     {
-        for_less( n, 0, n_neighbours[p] )
-        {
-            neigh = neighbours[p][n];
-            if( neigh < p )
-                continue;
-
-            dist = (Real) distances[ind];
-            ++ind;
-
-            dx = (Real)parameters[IJ(p,0,3)] - (Real)parameters[IJ(neigh,0,3)];
-            dy = (Real)parameters[IJ(p,1,3)] - (Real)parameters[IJ(neigh,1,3)];
-            dz = (Real)parameters[IJ(p,2,3)] - (Real)parameters[IJ(neigh,2,3)];
-            act_dist = dx * dx + dy * dy + dz * dz;
-            diff = dist - act_dist;
-            fit += diff * diff;
-        }
+        print_error( "Multiresolution needs a subdivided tetrahedral, " );
+        print_error( "octahedral or icosahedral mesh, " );
+        print_error( "using a single level.\n" );
+        return( init_points );
     }
-    fit *= distance_weight;
-
-    ind = 0;
-    for_less( p, 0, n_points )
-    {
-        p_index = IJ(p,0,3);
-        x1 = parameters[p_index+0];
-        y1 = parameters[p_index+1];
-        z1 = parameters[p_index+2];
 
-        n_neighs = n_neighbours[p];
+    tri_mesh_convert_from_polygons( polygons, &mesh );
 
-        n_index = IJ(neighbours[p][n_neighs-1],0,3);
-        dx3 = parameters[n_index+0] - x1;
-        dy3 = parameters[n_index+1] - y1;
-        dz3 = parameters[n_index+2] - z1;
+    ALLOC( point_levels, mesh.n_points );
+    ALLOC( parents, mesh.n_points );
+    ALLOC( mesh_indices, mesh.n_points );
 
-        next_index = IJ(neighbours[p][0],0,3);
-        dx4 = parameters[next_index+0] - x1;
-        dy4 = parameters[next_index+1] - y1;
-        dz4 = parameters[next_index+2] - z1;
+    max_level = tri_mesh_get_point_levels( &mesh, point_levels, parents );
+    first_level = MAX( 0, max_level - n_levels + 1 );
 
-        for_less( n, 0, n_neighs )
-        {
-            dx2 = dx3;
-            dy2 = dy3;
-            dz2 = dz3;
-
-            dx3 = dx4;
-            dy3 = dy4;
-            dz3 = dz4;
-
-            next_index = IJ(neighbours[p][(n+1)%n_neighs],0,3);
-            dx4 = parameters[next_index+0] - x1;
-            dy4 = parameters[next_index+1] - y1;
-            dz4 = parameters[next_index+2] - z1;
-
-            cx = dy3 * dz2 - dz3 * dy2;
-            cy = dz3 * dx2 - dx3 * dz2;
-            cz = dx3 * dy2 - dy3 * dx2;
-
-            vol = cx * dx4 + cy * dy4 + cz * dz4;
-            diff = (Real) (vol - volumes[ind]);
-            weight = (Real) weights[ind];
-            ++ind;
+    ALLOC( positions, polygons->n_points );
 
-            fit += weight * diff * diff;
-        }
+    if( init_points != NULL )
+    {
+        for_less( point, 0, polygons->n_points )
+            positions[point] = init_points[point];
+        FREE( init_points );
+    }
+    else
+    {
+        for_less( point, 0, polygons->n_points )
+            positions[point] = polygons->points[point];
     }
 
-    return( fit );
-}
-
-private  void  evaluate_fit_derivative(
-    int      n_parameters,
-    dtype    parameters[],
-    Real     distance_weight,
-    dtype    distances[],
-    dtype    volumes[],
-    dtype    weights[],
-    int      n_neighbours[],
-    int      *neighbours[],
-    dtype    deriv[] )
-{
-    int     p, n_points, n, p_index, prev_index, ind;
-    int     n_index, next_index, neigh;
-    dtype   x1, y1, z1, x2, y2, z2, vol, d2, diff;
-    dtype   x3, y3, z3, cx, cy, cz, x4, y4, z4;
-    dtype   dx2, dy2, dz2, dx3, dy3, dz3, dx4, dy4, dz4;
-    Real    rx1, ry1, rz1, rx2, ry2, rz2;
-    Real    dx, dy, dz, act_dist, dist;
-    Real    x_deriv, y_deriv, z_deriv, factor;
-
-    for_less( p, 0, n_parameters )
-        deriv[p] = (dtype) 0.0;
-
-    n_points = n_parameters / 3;
-
-    ind = 0;
-    for_less( p, 0, n_points )
+    for_less( level, first_level, max_level )
     {
-        p_index = IJ(p,0,3);
-        rx1 = (Real) parameters[p_index+0];
-        ry1 = (Real) parameters[p_index+1];
-        rz1 = (Real) parameters[p_index+2];
+        n_level_points = tri_mesh_extract_level( &mesh, level, &level_polygons,
+                                                 mesh_indices );
 
-        x_deriv = 0.0;
-        y_deriv = 0.0;
-        z_deriv = 0.0;
+        create_polygon_point_neighbours( &level_polygons, FALSE, &n_neighbours,
+                                         &neighbours, NULL, NULL );
 
-        for_less( n, 0, n_neighbours[p] )
+        ALLOC( level_init, n_level_points );
+        level_start = -1;
+        for_less( i, 0, n_level_points )
         {
-            neigh = neighbours[p][n];
-            if( neigh < p )
-                continue;
+            level_init[i] = positions[mesh_indices[i]];
+            if( mesh_indices[i] == start_vertex )
+                level_start = i;
+        }
 
-            dist = (Real) distances[ind];
-            ++ind;
+        /*--- the weighted region covers the same fraction of the surface */
 
-            n_index = IJ(neigh,0,3);
-            rx2 = (Real) parameters[n_index+0];
-            ry2 = (Real) parameters[n_index+1];
-            rz2 = (Real) parameters[n_index+2];
-
-            dx = rx1 - rx2;
-            dy = ry1 - ry2;
-            dz = rz1 - rz2;
-            act_dist = dx * dx + dy * dy + dz * dz;
-            factor = 4.0 * distance_weight * (act_dist - dist);
-            dx *= factor;
-            dy *= factor;
-            dz *= factor;
-            x_deriv += dx;
-            y_deriv += dy;
-            z_deriv += dz;
-            deriv[n_index+0] += (dtype) -dx;
-            deriv[n_index+1] += (dtype) -dy;
-            deriv[n_index+2] += (dtype) -dz;
-        }
+        if( level_start >= 0 && n_vertices_to_do > 0 )
+            level_n_to_do = MAX( 1, (int) ((Real) n_vertices_to_do *
+                                 (Real) n_level_points /
+                                 (Real) polygons->n_points) );
+        else
+            level_n_to_do = -1;
 
-        deriv[p_index+0] += (dtype) x_deriv;
-        deriv[p_index+1] += (dtype) y_deriv;
-        deriv[p_index+2] += (dtype) z_deriv;
-    }
+        if( level == first_level )
+            level_iters = n_coarse_iters;
+        else
+            level_iters = n_refine_iters;
 
-    ind = 0;
-    for_less( p, 0, n_points )
-    {
-        p_index = IJ(p,0,3);
-        x1 = parameters[p_index+0];
-        y1 = parameters[p_index+1];
-        z1 = parameters[p_index+2];
+        print( "Level %d:  %d points\n", level, n_level_points );
 
-        for_less( n, 0, n_neighbours[p] )
-        {
-            prev_index = IJ(neighbours[p][(n-1+n_neighbours[p])%
-                                        n_neighbours[p]],0,3);
-            x2 = parameters[prev_index+0];
-            y2 = parameters[prev_index+1];
-            z2 = parameters[prev_index+2];
-
-            n_index = IJ(neighbours[p][n],0,3);
-            x3 = parameters[n_index+0];
-            y3 = parameters[n_index+1];
-            z3 = parameters[n_index+2];
-
-            next_index = IJ(neighbours[p][(n+1)%n_neighbours[p]],0,3);
-            x4 = parameters[next_index+0];
-            y4 = parameters[next_index+1];
-            z4 = parameters[next_index+2];
-
-            dx2 = x2 - x1;
-            dy2 = y2 - y1;
-            dz2 = z2 - z1;
-
-            dx3 = x3 - x1;
-            dy3 = y3 - y1;
-            dz3 = z3 - z1;
-
-            dx4 = x4 - x1;
-            dy4 = y4 - y1;
-            dz4 = z4 - z1;
-
-            cx = dy3 * dz2 - dz3 * dy2;
-            cy = dz3 * dx2 - dx3 * dz2;
-            cz = dx3 * dy2 - dy3 * dx2;
-
-            vol = cx * dx4 + cy * dy4 + cz * dz4;
-            diff = vol - volumes[ind];
-            d2 = 2.0f * weights[ind] * diff;
-            ++ind;
+        flatten_polygons( n_level_points, level_polygons.points,
+                          n_neighbours, neighbours, level_init,
+                          radius, ratio, distance_weight,
+                          level_start, level_n_to_do, weight, level_iters,
+                          n_corrections );
+
+        for_less( i, 0, n_level_points )
+            positions[mesh_indices[i]] = level_polygons.points[i];
 
-            deriv[p_index+0] += d2 * ((y1-y2)*(z3-z1) + (z2-z1)*(y3-y1) +
-                                      (z3-z2)*(y4-y1) + (y2-y3)*(z4-z1));
-            deriv[p_index+1] += d2 * ((z1-z2)*(x3-x1) + (x2-x1)*(z3-z1) +
-                                      (x3-x2)*(z4-z1) + (z2-z3)*(x4-x1));
-            deriv[p_index+2] += d2 * ((x1-x2)*(y3-y1) + (y2-y1)*(x3-x1) +
-                                      (y3-y2)*(x4-x1) + (x2-x3)*(y4-y1));
+        *solved = TRUE;
 
-            deriv[prev_index+0] += d2 * ((z1-z3)*(y4-y1) + (y3-y1)*(z4-z1));
-            deriv[prev_index+1] += d2 * ((x1-x3)*(z4-z1) + (z3-z1)*(x4-x1));
-            deriv[prev_index+2] += d2 * ((y1-y3)*(x4-x1) + (x3-x1)*(y4-y1));
+        delete_polygon_point_neighbours( &level_polygons, n_neighbours,
+                                         neighbours, NULL, NULL );
+        delete_polygons( &level_polygons );
 
-            deriv[n_index+0] += d2 * ((z2-z1)*(y4-y1) + (y1-y2)*(z4-z1));
-            deriv[n_index+1] += d2 * ((x2-x1)*(z4-z1) + (z1-z2)*(x4-x1));
-            deriv[n_index+2] += d2 * ((y2-y1)*(x4-x1) + (x1-x2)*(y4-y1));
+        /*--- prolong to the next level */
 
-            deriv[next_index+0] += d2 * ((y2-y1)*(z3-z1) - (z2-z1)*(y3-y1));
-            deriv[next_index+1] += d2 * ((z2-z1)*(x3-x1) - (x2-x1)*(z3-z1));
-            deriv[next_index+2] += d2 * ((x2-x1)*(y3-y1) - (y2-y1)*(x3-x1));
+        for_less( point, 0, mesh.n_points )
+        {
+            if( point_levels[point] == level + 1 )
+            {
+                INTERPOLATE_POINTS( positions[point],
+                                    positions[parents[point][0]],
+                                    positions[parents[point][1]], 0.5 );
+            }
         }
     }
+
+    FREE( point_levels );
+    FREE( parents );
+    FREE( mesh_indices );
+    tri_mesh_delete( &mesh );
+
+    return( positions );
 }
 
 private  Real  evaluate_fit_along_line(
-    int     n_parameters,
-    dtype   parameters[],
-    dtype   line_dir[],
-    dtype   buffer[],
-    Real    dist,
-    Real    distance_weight,
-    dtype   distances[],
-    dtype   volumes[],
-    dtype   weights[],
-    int     n_neighbours[],
-    int     *neighbours[] )
+    flatten_energy_struct  *energy,
+    int                    n_parameters,
+    dtype                  parameters[],
+    dtype                  line_dir[],
+    dtype                  buffer[],
+    Real                   dist )
 {
     int     p;
     Real    fit;
@@ -379,8 +340,7 @@ private  Real  evaluate_fit_along_line(
     for_less( p, 0, n_parameters )
         buffer[p] = (float) ( (Real) parameters[p] + dist * (Real) line_dir[p]);
 
-    fit = evaluate_fit( n_parameters, buffer, distance_weight, distances,
-                        volumes, weights, n_neighbours, neighbours );
+    fit = evaluate_flatten_energy( energy, buffer, NULL );
 
     return( fit );
 }
@@ -388,17 +348,12 @@ private  Real  evaluate_fit_along_line(
 #define  GOLDEN_RATIO   0.618034
 
 private  Real  minimize_along_line(
-    Real    current_fit,
-    int     n_parameters,
-    dtype   parameters[],
-    dtype   line_dir[],
-    Real    distance_weight,
-    dtype   distances[],
-    dtype   volumes[],
-    dtype   weights[],
-    int     n_neighbours[],
-    int     *neighbours[],
-    BOOLEAN *changed )
+    flatten_energy_struct  *energy,
+    Real                   current_fit,
+    int                    n_parameters,
+    dtype                  parameters[],
+    dtype                  line_dir[],
+    BOOLEAN                *changed )
 {
     int      p, n_iters;
     Real     t0, t1, t2, f0, f1, f2, t_next, f_next;
@@ -419,11 +374,8 @@ private  Real  minimize_along_line(
         if( t0 < -1e30 )
             return( current_fit );
 
-        f0 = evaluate_fit_along_line( n_parameters, parameters, line_dir,
-                                      test_parameters, t0,
-                                      distance_weight, distances,
-                                      volumes, weights,
-                                      n_neighbours, neighbours );
+        f0 = evaluate_fit_along_line( energy, n_parameters, parameters,
+                                      line_dir, test_parameters, t0 );
     }
     while( f0 <= f1 );
 
@@ -435,11 +387,8 @@ private  Real  minimize_along_line(
         if( t2 > 1e30 )
             return( current_fit );
 
-        f2 = evaluate_fit_along_line( n_parameters, parameters, line_dir,
-                                      test_parameters, t2,
-                                      distance_weight, distances,
-                                      volumes, weights,
-                                      n_neighbours, neighbours );
+        f2 = evaluate_fit_along_line( energy, n_parameters, parameters,
+                                      line_dir, test_parameters, t2 );
     }
     while( f2 <= f1 );
 
@@ -448,11 +397,8 @@ private  Real  minimize_along_line(
     {
         t_next = t0 + (t1 - t0) * GOLDEN_RATIO;
 
-        f_next = evaluate_fit_along_line( n_parameters, parameters, line_dir,
-                                          test_parameters, t_next,
-                                          distance_weight, distances,
-                                          volumes, weights,
-                                          n_neighbours, neighbours );
+        f_next = evaluate_fit_along_line( energy, n_parameters, parameters,
+                                          line_dir, test_parameters, t_next );
 
 /*
         print( "%g  %g  %g  %g\n", t0, t_next, t1, t2 );
@@ -596,6 +542,118 @@ private  void  compute_sphere_points(
     SUB_POINTS( *v4, s4, s1 );
 }
 
+/*--- the energy and its derivative at Real parameters, for L-BFGS */
+
+typedef  struct
+{
+    flatten_energy_struct  *energy;
+    int                    n_parameters;
+    dtype                  *positions;
+    dtype                  *deriv;
+} lbfgs_data_struct;
+
+private  Real  lbfgs_energy(
+    Real   parameters[],
+    void   *void_ptr )
+{
+    int                p;
+    lbfgs_data_struct  *data;
+
+    data = (lbfgs_data_struct *) void_ptr;
+
+    for_less( p, 0, data->n_parameters )
+        data->positions[p] = (dtype) parameters[p];
+
+    return( evaluate_flatten_energy( data->energy, data->positions, NULL ) );
+}
+
+private  void  lbfgs_energy_deriv(
+    Real   parameters[],
+    void   *void_ptr,
+    Real   deriv[] )
+{
+    int                p;
+    lbfgs_data_struct  *data;
+
+    data = (lbfgs_data_struct *) void_ptr;
+
+    for_less( p, 0, data->n_parameters )
+        data->positions[p] = (dtype) parameters[p];
+
+    (void) evaluate_flatten_energy( data->energy, data->positions,
+                                    data->deriv );
+
+    for_less( p, 0, data->n_parameters )
+        deriv[p] = (Real) data->deriv[p];
+}
+
+/*--- minimizes the energy by L-BFGS, printing progress at the same rate as
+      the conjugate gradient loop, and the number of evaluations used */
+
+private  Real  minimize_energy_lbfgs(
+    flatten_energy_struct  *energy,
+    int                    n_parameters,
+    dtype                  parameters[],
+    int                    n_iters,
+    int                    n_corrections )
+{
+    int                p, iter, update_rate;
+    Real               fit, *real_parameters, current_time, last_update_time;
+    lbfgs_min          lbfgs;
+    lbfgs_data_struct  data;
+
+    data.energy = energy;
+    data.n_parameters = n_parameters;
+    ALLOC( data.positions, n_parameters );
+    ALLOC( data.deriv, n_parameters );
+    ALLOC( real_parameters, n_parameters );
+
+    for_less( p, 0, n_parameters )
+        real_parameters[p] = (Real) parameters[p];
+
+    lbfgs = lbfgs_min_initialize( n_parameters, real_parameters,
+                                  lbfgs_energy, lbfgs_energy_deriv,
+                                  (void *) &data, TOLERANCE, TOLERANCE,
+                                  n_corrections, n_iters, &fit );
+
+    update_rate = 1;
+    last_update_time = current_cpu_seconds();
+
+    while( lbfgs_min_do_one_iteration( lbfgs, &fit ) )
+    {
+        iter = lbfgs_min_get_n_iterations( lbfgs );
+
+        if( (iter % update_rate) == 0 || iter == n_iters )
+        {
+            print( "%d: %g\n", iter, fit );
+
+            (void) flush_file( stdout );
+            current_time = current_cpu_seconds();
+            if( current_time - last_update_time < 1.0 )
+                update_rate *= 10;
+
+            last_update_time = current_time;
+        }
+    }
+
+    print( "L-BFGS: %d iterations, %d evaluations, %d derivatives\n",
+           lbfgs_min_get_n_iterations( lbfgs ),
+           lbfgs_min_get_n_evaluations( lbfgs ),
+           lbfgs_min_get_n_deriv_evaluations( lbfgs ) );
+
+    lbfgs_min_get_current_position( lbfgs, real_parameters );
+    lbfgs_min_terminate( lbfgs );
+
+    for_less( p, 0, n_parameters )
+        parameters[p] = (dtype) real_parameters[p];
+
+    FREE( real_parameters );
+    FREE( data.positions );
+    FREE( data.deriv );
+
+    return( fit );
+}
+
 private  void  flatten_polygons(
     int              n_points,
     Point            points[],
@@ -608,7 +666,8 @@ private  void  flatten_polygons(
     int              start_vertex,
     int              n_vertices_to_do,
     Real             weight,
-    int              n_iters )
+    int              n_iters,
+    int              n_corrections )
 {
     int              p, point, n_parameters, ind;
     Real             gg, dgg, gam, current_time, last_update_time, fit;
@@ -618,7 +677,8 @@ private  void  flatten_polygons(
     int              iter, update_rate, n, total_neighbours;
     int              *queue, current, n_done, nn;
     dtype            *g, *h, *xi, *parameters, *unit_dir, *volumes;
-    dtype            *weights, **start_weights, *distances;
+    dtype            *weights, **start_weights;
+    flatten_energy_struct  energy;
     BOOLEAN          init_supplied, changed, debug, testing;
 
     debug = getenv( "DEBUG" ) != NULL;
@@ -708,19 +768,44 @@ private  void  flatten_polygons(
         FREE( start_weights );
     }
 
-    ALLOC( distances, total_neighbours );
-    ind = 0;
+    /*--- each edge once, with its original squared length as target,
+          and each one-ring volume with its weight */
+
+    initialize_flatten_energy( &energy, n_points );
+
     for_less( point, 0, n_points )
     {
         for_less( n, 0, n_neighbours[point] )
         {
-            distances[ind] = (dtype) sq_distance_between_points(
-                                       &points[point],
-                                       &points[neighbours[point][n]] );
+            if( neighbours[point][n] > point )
+            {
+                add_flatten_edge_term( &energy, point, neighbours[point][n],
+                                       sq_distance_between_points(
+                                            &points[point],
+                                            &points[neighbours[point][n]] ),
+                                       distance_weight );
+            }
+        }
+    }
+
+    ind = 0;
+    for_less( point, 0, n_points )
+    {
+        nn = n_neighbours[point];
+        for_less( n, 0, nn )
+        {
+            add_flatten_fan_term( &energy, point,
+                                  neighbours[point][(n-1+nn)%nn],
+                                  neighbours[point][n],
+                                  neighbours[point][(n+1)%nn],
+                                  (Real) volumes[ind], (Real) weights[ind] );
             ++ind;
         }
     }
 
+    FREE( volumes );
+    FREE( weights );
+
     n_parameters = 3 * n_points;
 
     ALLOC( parameters, n_parameters );
@@ -731,25 +816,22 @@ private  void  flatten_polygons(
 
     for_less( point, 0, n_points )
     {
-        parameters[IJ(point,0,3)] = (dtype) Point_x(init_points[point] );
-        parameters[IJ(point,1,3)] = (dtype) Point_y(init_points[point] );
-        parameters[IJ(point,2,3)] = (dtype) Point_z(init_points[point] );
+        parameters[FLATTEN_INDEX(n_points,point,X)] =
+                                   (dtype) Point_x(init_points[point] );
+        parameters[FLATTEN_INDEX(n_points,point,Y)] =
+                                   (dtype) Point_y(init_points[point] );
+        parameters[FLATTEN_INDEX(n_points,point,Z)] =
+                                   (dtype) Point_z(init_points[point] );
     }
 
     if( init_supplied )
         FREE( init_points );
 
-    fit = evaluate_fit( n_parameters, parameters, distance_weight, distances,
-                        volumes, weights, n_neighbours, neighbours );
+    fit = evaluate_flatten_energy( &energy, parameters, xi );
 
     print( "Initial  %g\n", fit );
     (void) flush_file( stdout );
 
-    evaluate_fit_derivative( n_parameters, parameters,
-                             distance_weight, distances,
-                             volumes, weights,
-                             n_neighbours, neighbours, xi );
-
     if( getenv( "STEP" ) != NULL && sscanf( getenv("STEP"), "%lf", &step ) == 1)
         testing = TRUE;
     else
@@ -764,13 +846,9 @@ private  void  flatten_polygons(
         {
             save = parameters[p];
             parameters[p] = (dtype) ((Real) save - step);
-            f1 = evaluate_fit( n_parameters, parameters, distance_weight,
-                               distances, volumes, weights,
-                               n_neighbours, neighbours );
+            f1 = evaluate_flatten_energy( &energy, parameters, NULL );
             parameters[p] = (dtype) ((Real) save + step);
-            f2 = evaluate_fit( n_parameters, parameters, distance_weight,
-                               distances, volumes, weights,
-                               n_neighbours, neighbours );
+            f2 = evaluate_flatten_energy( &energy, parameters, NULL );
             parameters[p] = save;
 
             test_deriv = (f2 - f1) / 2.0 / step;
@@ -786,127 +864,125 @@ private  void  flatten_polygons(
     }
 
 
-    for_less( p, 0, n_parameters )
+    if( n_corrections > 0 )
     {
-        g[p] = -xi[p];
-        h[p] = g[p];
-        xi[p] = g[p];
+        fit = minimize_energy_lbfgs( &energy, n_parameters, parameters,
+                                     n_iters, n_corrections );
     }
-
-    update_rate = 1;
-    last_update_time = current_cpu_seconds();
-
-    for_less( iter, 0, n_iters )
+    else
     {
-        len = 0.0;
         for_less( p, 0, n_parameters )
-            len += (Real) xi[p] * (Real) xi[p];
+        {
+            g[p] = -xi[p];
+            h[p] = g[p];
+            xi[p] = g[p];
+        }
 
-        len = sqrt( len );
-        for_less( p, 0, n_parameters )
-            unit_dir[p] = (dtype) ((Real) xi[p] / len);
+        update_rate = 1;
+        last_update_time = current_cpu_seconds();
 
-        if( debug )
+        for_less( iter, 0, n_iters )
         {
+            len = 0.0;
             for_less( p, 0, n_parameters )
-                unit_dir[p] = 0.0f;
-            unit_dir[iter % n_parameters] = 1.0f;
-        }
+                len += (Real) xi[p] * (Real) xi[p];
 
-        fit = minimize_along_line( fit, n_parameters, parameters, unit_dir,
-                                   distance_weight, distances,
-                                   volumes, weights, n_neighbours, neighbours,
-                                   &changed );
+            len = sqrt( len );
+            for_less( p, 0, n_parameters )
+                unit_dir[p] = (dtype) ((Real) xi[p] / len);
 
-        if( !debug )
-        {
-            if( !changed )
-                break;
-        }
+            if( debug )
+            {
+                for_less( p, 0, n_parameters )
+                    unit_dir[p] = 0.0f;
+                unit_dir[iter % n_parameters] = 1.0f;
+            }
 
-        if( ((iter+1) % update_rate) == 0 || iter == n_iters - 1 )
-        {
-            print( "%d: %g", iter+1, fit );
-            print( "\t Radius: %g", radius );
-            print( "\n" );
+            fit = minimize_along_line( &energy, fit, n_parameters, parameters,
+                                       unit_dir, &changed );
 
-            (void) flush_file( stdout );
-            current_time = current_cpu_seconds();
-            if( current_time - last_update_time < 1.0 )
-                update_rate *= 10;
+            if( !debug )
+            {
+                if( !changed )
+                    break;
+            }
 
-            last_update_time = current_time;
-        }
+            if( ((iter+1) % update_rate) == 0 || iter == n_iters - 1 )
+            {
+                print( "%d: %g", iter+1, fit );
+                print( "\t Radius: %g", radius );
+                print( "\n" );
 
-        evaluate_fit_derivative( n_parameters, parameters,
-                                 distance_weight, distances,  volumes, weights,
-                                 n_neighbours, neighbours, xi );
+                (void) flush_file( stdout );
+                current_time = current_cpu_seconds();
+                if( current_time - last_update_time < 1.0 )
+                    update_rate *= 10;
 
-        if( testing )
-        {
-            dtype  save;
-            Real   f1, f2, test_deriv;
+                last_update_time = current_time;
+            }
 
-            for_less( p, 0, n_parameters )
-            {
-                save = parameters[p];
-                parameters[p] = (dtype) ((Real) save - step);
-                f1 = evaluate_fit( n_parameters, parameters, distance_weight,
-                                   distances, volumes, weights,
-                                   n_neighbours, neighbours );
-                parameters[p] = (dtype) ((Real) save + step);
-                f2 = evaluate_fit( n_parameters, parameters, distance_weight,
-                                   distances, volumes, weights,
-                                   n_neighbours, neighbours );
-                parameters[p] = save;
-
-                test_deriv = (f2 - f1) / 2.0 / step;
+            (void) evaluate_flatten_energy( &energy, parameters, xi );
 
-/*
-                if( !numerically_close( test_deriv, (Real) xi[p] , 1.0e-5 ) )
-                    print( "Derivs mismatch %d d%c:  %g  %g\n",
-                           p / 3, "XYZ"[p%3], test_deriv, xi[p] );
-*/
+            if( testing )
+            {
+                dtype  save;
+                Real   f1, f2, test_deriv;
 
-                xi[p] = (dtype) test_deriv;
+                for_less( p, 0, n_parameters )
+                {
+                    save = parameters[p];
+                    parameters[p] = (dtype) ((Real) save - step);
+                    f1 = evaluate_flatten_energy( &energy, parameters, NULL );
+                    parameters[p] = (dtype) ((Real) save + step);
+                    f2 = evaluate_flatten_energy( &energy, parameters, NULL );
+                    parameters[p] = save;
+
+                    test_deriv = (f2 - f1) / 2.0 / step;
+
+    /*
+                    if( !numerically_close( test_deriv, (Real) xi[p] , 1.0e-5 ) )
+                        print( "Derivs mismatch %d d%c:  %g  %g\n",
+                               p / 3, "XYZ"[p%3], test_deriv, xi[p] );
+    */
+
+                    xi[p] = (dtype) test_deriv;
+                }
             }
-        }
 
-        gg = 0.0;
-        dgg = 0.0;
-        for_less( p, 0, n_parameters )
-        {
-            gg += (Real) g[p] * (Real) g[p];
-            dgg += ((Real) xi[p] + (Real) g[p]) * (Real) xi[p];
-/*
-            dgg += ((Real) xi[p] * (Real) xi[p];
-*/
-        }
+            gg = 0.0;
+            dgg = 0.0;
+            for_less( p, 0, n_parameters )
+            {
+                gg += (Real) g[p] * (Real) g[p];
+                dgg += ((Real) xi[p] + (Real) g[p]) * (Real) xi[p];
+    /*
+                dgg += ((Real) xi[p] * (Real) xi[p];
+    */
+            }
 
-        if( gg == 0.0 )
-            break;
+            if( gg == 0.0 )
+                break;
 
-        gam = dgg / gg;
+            gam = dgg / gg;
 
-        for_less( p, 0, n_parameters )
-        {
-            g[p] = -xi[p];
-            h[p] = (dtype) ((Real) g[p] + gam * (Real) h[p]);
-            xi[p] = h[p];
+            for_less( p, 0, n_parameters )
+            {
+                g[p] = -xi[p];
+                h[p] = (dtype) ((Real) g[p] + gam * (Real) h[p]);
+                xi[p] = h[p];
+            }
         }
     }
 
     for_less( point, 0, n_points )
     {
         fill_Point( points[point],
-                    parameters[IJ(point,0,3)],
-                    parameters[IJ(point,1,3)],
-                    parameters[IJ(point,2,3)] );
+                    parameters[FLATTEN_INDEX(n_points,point,X)],
+                    parameters[FLATTEN_INDEX(n_points,point,Y)],
+                    parameters[FLATTEN_INDEX(n_points,point,Z)] );
     }
 
-    FREE( distances );
-    FREE( volumes );
-    FREE( weights );
+    delete_flatten_energy( &energy );
     FREE( parameters );
     FREE( xi );
     FREE( g );
@@ -1,5 +1,6 @@
 #include  <volume_io/internal_volume_io.h>
 #include  <bicpl.h>
+#include  <volume_derivatives.h>
 
 private  void  chamfer_volume(
     Volume   volume );
@@ -30,7 +31,9 @@ int  main(
     Real          voxel[N_DIMENSIONS], mag, value, hist;
     Real          upper_limit;
     int           *count, n_x_steps, n_y_steps, n_z_steps;
-    int           ignore_threshold;
+    int           ignore_threshold, ind;
+    BOOLEAN       on_grid;
+    float         *values, *grad;
 
     initialize_argument_processing( argc, argv );
 
@@ -68,6 +71,23 @@ int  main(
     n_y_steps = sizes[Y] / y_step;
     n_z_steps = sizes[Z] / z_step;
 
+    /*--- when the samples fall on voxel centres, the derivatives of the
+          whole volume are computed at once from the voxel values */
+
+    on_grid = (x_step == (Real) ROUND( x_step ) &&
+               y_step == (Real) ROUND( y_step ) &&
+               z_step == (Real) ROUND( z_step ));
+
+    if( on_grid )
+    {
+        ALLOC( values, sizes[X] * sizes[Y] * sizes[Z] );
+        ALLOC( grad, sizes[X] * sizes[Y] * sizes[Z] );
+
+        get_volume_float_values( volume, values );
+        compute_volume_derivatives( sizes, values, 0, GRADIENT_MAGNITUDE,
+                                    &grad );
+    }
+
     for_less( x, 0, n_x_steps )
     for_less( y, 0, n_y_steps )
     for_less( z, 0, n_z_steps )
@@ -76,13 +96,23 @@ int  main(
         voxel[Y] = (Real) y * y_step;
         voxel[Z] = (Real) z * z_step;
 
-        deriv[0] = deriv_info;
-        (void) evaluate_volume( volume, voxel, NULL, 0, FALSE, 0.0,
-                                &value, deriv, NULL );
+        if( on_grid )
+        {
+            ind = (ROUND( voxel[X] ) * sizes[Y] + ROUND( voxel[Y] )) *
+                  sizes[Z] + ROUND( voxel[Z] );
+            value = (Real) values[ind];
+            mag = (Real) grad[ind] * (Real) grad[ind];
+        }
+        else
+        {
+            deriv[0] = deriv_info;
+            (void) evaluate_volume( volume, voxel, NULL, 0, FALSE, 0.0,
+                                    &value, deriv, NULL );
 
-        mag = deriv_info[0] * deriv_info[0] +
-              deriv_info[1] * deriv_info[1] +
-              deriv_info[2] * deriv_info[2];
+            mag = deriv_info[0] * deriv_info[0] +
+                  deriv_info[1] * deriv_info[1] +
+                  deriv_info[2] * deriv_info[2];
+        }
 
 /*
         if( mag > 0.0 )
@@ -98,6 +128,12 @@ int  main(
         sum[v_step] += mag;
     }
 
+    if( on_grid )
+    {
+        FREE( values );
+        FREE( grad );
+    }
+
     for_less( step, 0, n_steps )
     {
         pos = min_value + ((Real) step + 0.5) * (max_value - min_value) /
@@ -1,5 +1,6 @@
 #include  <volume_io/internal_volume_io.h>
 #include  <bicpl.h>
+#include  <voxel_histogram.h>
 
 #define  FILTER_WIDTH 0.02
 
@@ -16,19 +17,21 @@ int  main(
     int                  x, y, z, sizes[N_DIMENSIONS];
     int                  start[N_DIMENSIONS], end[N_DIMENSIONS];
     int                  slice, axis, xyz_axis;
-    Real                 value, min_voxel, max_voxel, filter_width;
+    Real                 min_voxel, max_voxel, filter_width;
     Real                 min_value, max_value, filter_ratio;
     Real                 min_nonzero, max_nonzero, y_scale;
     Real                 min_range, max_range;
     STRING               input_volume_filename, output_filename;
     STRING               axis_name;
     lines_struct         *lines;
-    histogram_struct     histogram;
+    voxel_histogram_struct  histogram;
     Real                 xyz[N_DIMENSIONS], voxel[N_DIMENSIONS];
     Real                 *counts, delta;
     Real                 scale, trans, interval_width;
     Real                 x1, y1, x2, y2;
-    int                  n, i;
+    int                  n, i, n_bins;
+    BOOLEAN              whole_volume;
+    Real                 *values;
     int                  n_objects, n_voxels;
     int                  n_boxes, deriv;
     object_struct        **objects;
@@ -91,7 +94,10 @@ int  main(
     if( n_boxes < 1 && (max_value - min_value) / delta > (Real) MAX_BOXES )
         delta = (max_value - min_value) / (Real) MAX_BOXES;
 
-    initialize_histogram( &histogram, delta, min_value - scale/2.0 );
+    n_bins = ROUND( (max_value - min_value) / delta ) + 1;
+
+    initialize_voxel_histogram( &histogram, min_value - delta / 2.0,
+                                max_value + delta / 2.0, n_bins );
 
     start[X] = 0;
     end[X] = sizes[X];
@@ -100,6 +106,8 @@ int  main(
     start[Z] = 0;
     end[Z] = sizes[Z];
 
+    whole_volume = TRUE;
+
     if( axis >= 0 && axis < N_DIMENSIONS )
     {
         xyz_axis = axis;
@@ -118,43 +126,62 @@ int  main(
         {
             start[axis] = slice;
             end[axis] = slice+1;
+            whole_volume = FALSE;
             print( "Slice %d in %c\n", slice, "XYZ"[xyz_axis] );
         }
     }
 
-    n_voxels = 0;
-    for_less( x, start[X], end[X] )
+    if( whole_volume )
+    {
+        if( add_volume_to_voxel_histogram( &histogram, volume,
+                                           (Volume) NULL ) != OK )
+            return( 1 );
+    }
+    else
     {
-        for_less( y, start[Y], end[Y] )
+        ALLOC( values, end[Z] - start[Z] );
+
+        for_less( x, start[X], end[X] )
         {
-            for_less( z, start[Z], end[Z] )
+            for_less( y, start[Y], end[Y] )
             {
-                value = get_volume_real_value( volume, x, y, z, 0, 0 );
-                if( min_value <= value && value <= max_value )
+                for_less( z, start[Z], end[Z] )
                 {
-                    add_to_histogram( &histogram, value );
-                    ++n_voxels;
+                    values[z-start[Z]] = get_volume_real_value( volume,
+                                                           x, y, z, 0, 0 );
                 }
+
+                add_values_to_voxel_histogram( &histogram, end[Z] - start[Z],
+                                               values );
             }
         }
+
+        FREE( values );
     }
 
+    n_voxels = histogram.n_samples;
+
     /*--- find mins and maxes */
 
     filter_width = 0.0;
 
-    n = get_histogram_counts( &histogram, &counts, filter_width,
-                              &scale, &trans );
+    n = get_voxel_histogram_counts( &histogram, filter_width, &counts,
+                                    &scale, &trans );
 
     min_nonzero = scale * (-0.5) + trans;
     max_nonzero = scale * ((Real) n + 0.5) + trans;
 
-    FREE( counts );
+    if( n > 0 )
+    {
+        FREE( counts );
+    }
 
     filter_width = filter_ratio * (max_nonzero - min_nonzero);
 
-    n = get_histogram_counts( &histogram, &counts, filter_width,
-                              &scale, &trans );
+    n = get_voxel_histogram_counts( &histogram, filter_width, &counts,
+                                    &scale, &trans );
+
+    delete_voxel_histogram( &histogram );
 
     interval_width = 1.0 / (Real) n;
 
@@ -0,0 +1,1377 @@
+#if HAVE_CONFIG_H
+#include "config.h"
+#endif /* HAVE_CONFIG_H */
+
+#include  <volume_io/internal_volume_io.h>
+#include  <image_codec.h>
+
+#if HAVE_ZLIB_H && HAVE_LIBZ
+#define  PNG_SUPPORTED
+#include  <zlib.h>
+#endif
+
+#define  SGI_MAGIC            474
+#define  SGI_HEADER_SIZE      512
+
+#define  PNG_SIGNATURE_SIZE   8
+#define  PNG_BUFFER_SIZE      65536
+
+static  unsigned char  png_signature[PNG_SIGNATURE_SIZE] =
+                          { 137, 80, 78, 71, 13, 10, 26, 10 };
+
+/*--- byte order helpers, all three formats store multibyte values
+      big endian */
+
+private  int  get_short_bytes(
+    unsigned char  bytes[] )
+{
+    return( ((int) bytes[0] << 8) | (int) bytes[1] );
+}
+
+private  unsigned long  get_long_bytes(
+    unsigned char  bytes[] )
+{
+    return( ((unsigned long) bytes[0] << 24) |
+            ((unsigned long) bytes[1] << 16) |
+            ((unsigned long) bytes[2] << 8) |
+            (unsigned long) bytes[3] );
+}
+
+private  void  set_short_bytes(
+    unsigned char  bytes[],
+    int            value )
+{
+    bytes[0] = (unsigned char) ((value >> 8) & 255);
+    bytes[1] = (unsigned char) (value & 255);
+}
+
+private  void  set_long_bytes(
+    unsigned char  bytes[],
+    unsigned long  value )
+{
+    bytes[0] = (unsigned char) ((value >> 24) & 255);
+    bytes[1] = (unsigned char) ((value >> 16) & 255);
+    bytes[2] = (unsigned char) ((value >> 8) & 255);
+    bytes[3] = (unsigned char) (value & 255);
+}
+
+/*--- converts one row of interleaved 8 bit components (grey, grey-alpha,
+      rgb or rgba) to a row of pixels, and back */
+
+private  void  unpack_pixel_row(
+    pixels_struct  *pixels,
+    int            y,
+    int            n_components,
+    unsigned char  row[] )
+{
+    int            x, x_size;
+    Colour         *pixel;
+    unsigned char  *c;
+
+    x_size = pixels->x_size;
+    pixel = &PIXEL_RGB_COLOUR( *pixels, 0, y );
+    c = row;
+
+    switch( n_components )
+    {
+    case 1:
+        for_less( x, 0, x_size )
+        {
+            pixel[x] = make_Colour( c[0], c[0], c[0] );
+            c += 1;
+        }
+        break;
+
+    case 2:
+        for_less( x, 0, x_size )
+        {
+            pixel[x] = make_rgba_Colour( c[0], c[0], c[0], c[1] );
+            c += 2;
+        }
+        break;
+
+    case 3:
+        for_less( x, 0, x_size )
+        {
+            pixel[x] = make_Colour( c[0], c[1], c[2] );
+            c += 3;
+        }
+        break;
+
+    default:
+        for_less( x, 0, x_size )
+        {
+            pixel[x] = make_rgba_Colour( c[0], c[1], c[2], c[3] );
+            c += 4;
+        }
+        break;
+    }
+}
+
+private  void  pack_pixel_row(
+    pixels_struct  *pixels,
+    int            y,
+    int            n_components,
+    unsigned char  row[] )
+{
+    int            x, x_size, r, g, b;
+    Colour         *pixel;
+    unsigned char  *c;
+
+    x_size = pixels->x_size;
+    pixel = &PIXEL_RGB_COLOUR( *pixels, 0, y );
+    c = row;
+
+    switch( n_components )
+    {
+    case 1:
+        for_less( x, 0, x_size )
+        {
+            r = get_Colour_r( pixel[x] );
+            g = get_Colour_g( pixel[x] );
+            b = get_Colour_b( pixel[x] );
+            c[0] = (unsigned char) ((77 * r + 150 * g + 29 * b + 128) >> 8);
+            c += 1;
+        }
+        break;
+
+    case 3:
+        for_less( x, 0, x_size )
+        {
+            c[0] = (unsigned char) get_Colour_r( pixel[x] );
+            c[1] = (unsigned char) get_Colour_g( pixel[x] );
+            c[2] = (unsigned char) get_Colour_b( pixel[x] );
+            c += 3;
+        }
+        break;
+
+    default:
+        for_less( x, 0, x_size )
+        {
+            c[0] = (unsigned char) get_Colour_r( pixel[x] );
+            c[1] = (unsigned char) get_Colour_g( pixel[x] );
+            c[2] = (unsigned char) get_Colour_b( pixel[x] );
+            c[3] = (unsigned char) get_Colour_a( pixel[x] );
+            c += 4;
+        }
+        break;
+    }
+}
+
+/*--------------------------- format detection ----------------------------- */
+
+public  Image_file_formats  get_image_file_format(
+    STRING   filename )
+{
+    FILE                *file;
+    unsigned char       magic[PNG_SIGNATURE_SIZE];
+    int                 n_read, i;
+    Image_file_formats  format;
+
+    if( open_file( filename, READ_FILE, BINARY_FORMAT, &file ) != OK )
+        return( UNKNOWN_IMAGE_FORMAT );
+
+    n_read = (int) fread( magic, 1, PNG_SIGNATURE_SIZE, file );
+
+    (void) close_file( file );
+
+    format = UNKNOWN_IMAGE_FORMAT;
+
+    if( n_read >= 2 && magic[0] == 'P' &&
+        (magic[1] == '2' || magic[1] == '3' ||
+         magic[1] == '5' || magic[1] == '6') )
+        format = PNM_IMAGE_FORMAT;
+    else if( n_read >= 2 && get_short_bytes( magic ) == SGI_MAGIC )
+        format = SGI_IMAGE_FORMAT;
+    else if( n_read == PNG_SIGNATURE_SIZE )
+    {
+        for_less( i, 0, PNG_SIGNATURE_SIZE )
+        {
+            if( magic[i] != png_signature[i] )
+                break;
+        }
+
+#ifdef  PNG_SUPPORTED
+        if( i == PNG_SIGNATURE_SIZE )
+            format = PNG_IMAGE_FORMAT;
+#endif
+    }
+
+    return( format );
+}
+
+/*--- output format is chosen by extension; anything not recognized is
+      written as SGI rgb, as output_rgb_file() does.  Without PNG support,
+      .png files are of unknown format. */
+
+public  Image_file_formats  get_image_output_format(
+    STRING   filename )
+{
+    if( string_ends_in( filename, ".ppm" ) ||
+        string_ends_in( filename, ".pgm" ) ||
+        string_ends_in( filename, ".pnm" ) )
+        return( PNM_IMAGE_FORMAT );
+
+    if( string_ends_in( filename, ".png" ) )
+    {
+#ifdef  PNG_SUPPORTED
+        return( PNG_IMAGE_FORMAT );
+#else
+        return( UNKNOWN_IMAGE_FORMAT );
+#endif
+    }
+
+    return( SGI_IMAGE_FORMAT );
+}
+
+/*------------------------------ PNM format -------------------------------- */
+
+/*--- reads a decimal header value, skipping white space and comments; the
+      single white space character following the value is consumed */
+
+private  Status  input_pnm_value(
+    FILE   *file,
+    int    *value )
+{
+    int   ch;
+
+    do
+    {
+        ch = getc( file );
+        if( ch == '#' )
+        {
+            while( ch != '\n' && ch != EOF )
+                ch = getc( file );
+        }
+    }
+    while( ch == ' ' || ch == '\t' || ch == '\r' || ch == '\n' );
+
+    if( ch < '0' || ch > '9' )
+        return( ERROR );
+
+    *value = 0;
+    while( ch >= '0' && ch <= '9' )
+    {
+        *value = 10 * *value + (ch - '0');
+        ch = getc( file );
+    }
+
+    return( OK );
+}
+
+private  Status  input_pnm_header(
+    FILE     *file,
+    int      *x_size,
+    int      *y_size,
+    int      *n_components,
+    int      *max_value,
+    BOOLEAN  *ascii_flag )
+{
+    int   magic[2];
+
+    magic[0] = getc( file );
+    magic[1] = getc( file );
+
+    if( magic[0] != 'P' )
+        return( ERROR );
+
+    switch( magic[1] )
+    {
+    case '2':  *n_components = 1;   *ascii_flag = TRUE;    break;
+    case '3':  *n_components = 3;   *ascii_flag = TRUE;    break;
+    case '5':  *n_components = 1;   *ascii_flag = FALSE;   break;
+    case '6':  *n_components = 3;   *ascii_flag = FALSE;   break;
+    default:   return( ERROR );
+    }
+
+    if( input_pnm_value( file, x_size ) != OK ||
+        input_pnm_value( file, y_size ) != OK ||
+        input_pnm_value( file, max_value ) != OK ||
+        *max_value <= 0 || *max_value > 65535 )
+        return( ERROR );
+
+    return( OK );
+}
+
+private  Status  input_pnm_file(
+    FILE           *file,
+    STRING         filename,
+    pixels_struct  *pixels )
+{
+    int            x_size, y_size, nc, max_value, row, y, i, n_values;
+    int            n_bytes, value;
+    BOOLEAN        ascii_flag;
+    unsigned char  *in_row, *row_values;
+    Status         status;
+
+    if( input_pnm_header( file, &x_size, &y_size, &nc, &max_value,
+                          &ascii_flag ) != OK )
+    {
+        print_error( "Error reading PNM header of %s.\n", filename );
+        return( ERROR );
+    }
+
+    initialize_pixels( pixels, 0, 0, x_size, y_size, 1.0, 1.0, RGB_PIXEL );
+
+    n_values = x_size * nc;
+    n_bytes = (max_value > 255) ? 2 : 1;
+
+    ALLOC( in_row, n_values * n_bytes );
+    ALLOC( row_values, n_values );
+
+    status = OK;
+
+    for_less( row, 0, y_size )
+    {
+        if( ascii_flag )
+        {
+            for_less( i, 0, n_values )
+            {
+                if( input_pnm_value( file, &value ) != OK )
+                {
+                    status = ERROR;
+                    break;
+                }
+                row_values[i] = (unsigned char) (value * 255 / max_value);
+            }
+        }
+        else
+        {
+            if( fread( in_row, (size_t) n_bytes, (size_t) n_values, file ) !=
+                (size_t) n_values )
+                status = ERROR;
+            else if( n_bytes == 2 )
+            {
+                for_less( i, 0, n_values )
+                {
+                    value = get_short_bytes( &in_row[2*i] );
+                    row_values[i] = (unsigned char) (value * 255 / max_value);
+                }
+            }
+            else if( max_value != 255 )
+            {
+                for_less( i, 0, n_values )
+                {
+                    row_values[i] = (unsigned char) ((int) in_row[i] * 255 /
+                                                     max_value);
+                }
+            }
+            else
+                (void) memcpy( row_values, in_row, (size_t) n_values );
+        }
+
+        if( status != OK )
+        {
+            print_error( "Error reading row %d of %s.\n", row, filename );
+            break;
+        }
+
+        /*--- PNM rows are stored top to bottom */
+
+        y = y_size - 1 - row;
+        unpack_pixel_row( pixels, y, nc, row_values );
+    }
+
+    FREE( in_row );
+    FREE( row_values );
+
+    if( status != OK )
+        delete_pixels( pixels );
+
+    return( status );
+}
+
+private  Status  output_pnm_file(
+    FILE           *file,
+    STRING         filename,
+    pixels_struct  *pixels )
+{
+    int            nc, row;
+    unsigned char  *row_values;
+    Status         status;
+
+    nc = string_ends_in( filename, ".pgm" ) ? 1 : 3;
+
+    (void) fprintf( file, "P%c\n%d %d\n255\n", (nc == 1) ? '5' : '6',
+                    pixels->x_size, pixels->y_size );
+
+    ALLOC( row_values, MAX( 1, pixels->x_size * nc ) );
+
+    status = OK;
+
+    for_less( row, 0, pixels->y_size )
+    {
+        pack_pixel_row( pixels, pixels->y_size - 1 - row, nc, row_values );
+
+        if( fwrite( row_values, 1, (size_t) (pixels->x_size * nc), file ) !=
+            (size_t) (pixels->x_size * nc) )
+        {
+            print_error( "Error writing %s.\n", filename );
+            status = ERROR;
+            break;
+        }
+    }
+
+    FREE( row_values );
+
+    return( status );
+}
+
+/*------------------------------ SGI format -------------------------------- */
+
+private  Status  input_sgi_header(
+    FILE           *file,
+    unsigned char  header[],
+    int            *x_size,
+    int            *y_size,
+    int            *n_components,
+    BOOLEAN        *rle_flag )
+{
+    int   dimension;
+
+    if( fread( header, 1, SGI_HEADER_SIZE, file ) != SGI_HEADER_SIZE ||
+        get_short_bytes( &header[0] ) != SGI_MAGIC ||
+        header[2] > 1 || header[3] != 1 )
+        return( ERROR );
+
+    *rle_flag = (header[2] == 1);
+    dimension = get_short_bytes( &header[4] );
+    *x_size = get_short_bytes( &header[6] );
+    *y_size = (dimension >= 2) ? get_short_bytes( &header[8] ) : 1;
+    *n_components = (dimension >= 3) ? get_short_bytes( &header[10] ) : 1;
+
+    if( *n_components < 1 || *n_components > 4 )
+        return( ERROR );
+
+    return( OK );
+}
+
+/*--- decodes one run length encoded channel row, returns FALSE if the
+      encoding would overrun the row or the data */
+
+private  BOOLEAN  decode_sgi_row(
+    unsigned char  data[],
+    unsigned long  n_data,
+    unsigned long  start,
+    int            x_size,
+    unsigned char  row[] )
+{
+    unsigned long  pos;
+    int            x, count, value;
+
+    pos = start;
+    x = 0;
+
+    while( pos < n_data )
+    {
+        value = data[pos++];
+        count = value & 0x7f;
+        if( count == 0 )
+            break;
+
+        if( x + count > x_size )
+            return( FALSE );
+
+        if( value & 0x80 )
+        {
+            if( pos + (unsigned long) count > n_data )
+                return( FALSE );
+            (void) memcpy( &row[x], &data[pos], (size_t) count );
+            pos += (unsigned long) count;
+        }
+        else
+        {
+            if( pos >= n_data )
+                return( FALSE );
+            (void) memset( &row[x], data[pos++], (size_t) count );
+        }
+
+        x += count;
+    }
+
+    return( x == x_size );
+}
+
+private  Status  input_sgi_file(
+    FILE           *file,
+    STRING         filename,
+    pixels_struct  *pixels )
+{
+    int            x_size, y_size, nc, x, y, z, n_rows, i;
+    BOOLEAN        rle_flag;
+    unsigned char  header[SGI_HEADER_SIZE], table_bytes[4];
+    unsigned char  *data, *channel_row, *row_values;
+    unsigned long  *starts, n_data, end;
+    Status         status;
+
+    if( input_sgi_header( file, header, &x_size, &y_size, &nc,
+                          &rle_flag ) != OK )
+    {
+        print_error( "Error reading SGI header of %s.\n", filename );
+        return( ERROR );
+    }
+
+    n_rows = y_size * nc;
+    starts = NULL;
+    status = OK;
+
+    /*--- the whole pixel data is read in one block, then interleaved a row
+          at a time */
+
+    if( rle_flag )
+    {
+        ALLOC( starts, MAX( 1, n_rows ) );
+
+        for_less( i, 0, n_rows )
+        {
+            if( fread( table_bytes, 1, 4, file ) != 4 )
+                status = ERROR;
+            starts[i] = get_long_bytes( table_bytes );
+        }
+
+        n_data = 0;
+        for_less( i, 0, n_rows )
+        {
+            if( fread( table_bytes, 1, 4, file ) != 4 )
+                status = ERROR;
+            end = starts[i] + get_long_bytes( table_bytes );
+            if( end > n_data )
+                n_data = end;
+        }
+
+        if( status != OK || n_data < (unsigned long) (SGI_HEADER_SIZE +
+                                                      8 * n_rows) )
+        {
+            print_error( "Error reading SGI tables of %s.\n", filename );
+            FREE( starts );
+            return( ERROR );
+        }
+
+        /*--- offsets in the tables are from the start of the file */
+
+        n_data -= (unsigned long) (SGI_HEADER_SIZE + 8 * n_rows);
+        for_less( i, 0, n_rows )
+            starts[i] -= (unsigned long) (SGI_HEADER_SIZE + 8 * n_rows);
+    }
+    else
+        n_data = (unsigned long) x_size * (unsigned long) n_rows;
+
+    ALLOC( data, MAX( 1, n_data ) );
+
+    if( fread( data, 1, (size_t) n_data, file ) != (size_t) n_data )
+    {
+        print_error( "Error reading SGI data of %s.\n", filename );
+        FREE( data );
+        if( rle_flag )
+            FREE( starts );
+        return( ERROR );
+    }
+
+    initialize_pixels( pixels, 0, 0, x_size, y_size, 1.0, 1.0, RGB_PIXEL );
+
+    ALLOC( channel_row, MAX( 1, x_size ) );
+    ALLOC( row_values, MAX( 1, x_size * nc ) );
+
+    for_less( y, 0, y_size )
+    {
+        for_less( z, 0, nc )
+        {
+            if( rle_flag )
+            {
+                if( !decode_sgi_row( data, n_data, starts[z*y_size+y],
+                                     x_size, channel_row ) )
+                {
+                    print_error( "Error decoding row %d of %s.\n", y,
+                                 filename );
+                    status = ERROR;
+                    break;
+                }
+
+                for_less( x, 0, x_size )
+                    row_values[x*nc+z] = channel_row[x];
+            }
+            else
+            {
+                unsigned char  *plane_row;
+
+                plane_row = &data[(unsigned long) (z * y_size + y) *
+                                  (unsigned long) x_size];
+                for_less( x, 0, x_size )
+                    row_values[x*nc+z] = plane_row[x];
+            }
+        }
+
+        if( status != OK )
+            break;
+
+        unpack_pixel_row( pixels, y, nc, row_values );
+    }
+
+    FREE( channel_row );
+    FREE( row_values );
+    FREE( data );
+    if( rle_flag )
+        FREE( starts );
+
+    if( status != OK )
+        delete_pixels( pixels );
+
+    return( status );
+}
+
+private  Status  output_sgi_file(
+    FILE           *file,
+    STRING         filename,
+    pixels_struct  *pixels )
+{
+    int            x, y, z, x_size, y_size;
+    unsigned char  header[SGI_HEADER_SIZE];
+    unsigned char  *row_values, *plane_row;
+    Status         status;
+
+    x_size = pixels->x_size;
+    y_size = pixels->y_size;
+
+    (void) memset( header, 0, SGI_HEADER_SIZE );
+    set_short_bytes( &header[0], SGI_MAGIC );
+    header[2] = 0;
+    header[3] = 1;
+    set_short_bytes( &header[4], 3 );
+    set_short_bytes( &header[6], x_size );
+    set_short_bytes( &header[8], y_size );
+    set_short_bytes( &header[10], 4 );
+    set_long_bytes( &header[12], 0 );
+    set_long_bytes( &header[16], 255 );
+
+    status = OK;
+
+    if( fwrite( header, 1, SGI_HEADER_SIZE, file ) != SGI_HEADER_SIZE )
+        status = ERROR;
+
+    ALLOC( row_values, MAX( 1, 4 * x_size ) );
+    ALLOC( plane_row, MAX( 1, x_size ) );
+
+    /*--- verbatim storage: each channel in turn, rows bottom to top */
+
+    for_less( z, 0, 4 )
+    {
+        for_less( y, 0, y_size )
+        {
+            if( status != OK )
+                break;
+
+            pack_pixel_row( pixels, y, 4, row_values );
+
+            for_less( x, 0, x_size )
+                plane_row[x] = row_values[4*x+z];
+
+            if( fwrite( plane_row, 1, (size_t) x_size, file ) !=
+                (size_t) x_size )
+                status = ERROR;
+        }
+    }
+
+    if( status != OK )
+        print_error( "Error writing %s.\n", filename );
+
+    FREE( row_values );
+    FREE( plane_row );
+
+    return( status );
+}
+
+/*------------------------------ PNG format -------------------------------- */
+
+#ifdef  PNG_SUPPORTED
+
+private  int  paeth_predictor(
+    int   a,
+    int   b,
+    int   c )
+{
+    int   p, pa, pb, pc;
+
+    p = a + b - c;
+    pa = ABS( p - a );
+    pb = ABS( p - b );
+    pc = ABS( p - c );
+
+    if( pa <= pb && pa <= pc )
+        return( a );
+    else if( pb <= pc )
+        return( b );
+    else
+        return( c );
+}
+
+/*--- undoes the filter of a row in place, prev is the previous unfiltered
+      row, or all zero for the first row */
+
+private  BOOLEAN  unfilter_png_row(
+    int            filter,
+    int            n_bytes,
+    int            bpp,
+    unsigned char  row[],
+    unsigned char  prev[] )
+{
+    int   i, left, up_left;
+
+    switch( filter )
+    {
+    case 0:
+        break;
+
+    case 1:
+        for_less( i, bpp, n_bytes )
+            row[i] = (unsigned char) (row[i] + row[i-bpp]);
+        break;
+
+    case 2:
+        for_less( i, 0, n_bytes )
+            row[i] = (unsigned char) (row[i] + prev[i]);
+        break;
+
+    case 3:
+        for_less( i, 0, n_bytes )
+        {
+            left = (i >= bpp) ? row[i-bpp] : 0;
+            row[i] = (unsigned char) (row[i] + ((left + prev[i]) >> 1));
+        }
+        break;
+
+    case 4:
+        for_less( i, 0, n_bytes )
+        {
+            left = (i >= bpp) ? row[i-bpp] : 0;
+            up_left = (i >= bpp) ? prev[i-bpp] : 0;
+            row[i] = (unsigned char) (row[i] +
+                                      paeth_predictor( left, prev[i],
+                                                       up_left ));
+        }
+        break;
+
+    default:
+        return( FALSE );
+    }
+
+    return( TRUE );
+}
+
+typedef  struct
+{
+    int            x_size;
+    int            y_size;
+    int            bit_depth;
+    int            colour_type;
+    int            n_channels;
+    int            n_palette;
+    unsigned char  palette[256][4];
+} png_info_struct;
+
+/*--- expands an unfiltered row to 8 bit components, returning the number
+      of components per pixel */
+
+private  int  expand_png_row(
+    png_info_struct  *info,
+    unsigned char    row[],
+    unsigned char    row_values[] )
+{
+    int   x, i, n_samples, shift, mask, sample, scale;
+
+    n_samples = info->x_size * info->n_channels;
+
+    if( info->bit_depth == 8 && info->colour_type != 3 )
+    {
+        (void) memcpy( row_values, row, (size_t) n_samples );
+        return( info->n_channels );
+    }
+
+    if( info->bit_depth == 16 )
+    {
+        for_less( i, 0, n_samples )
+            row_values[i] = row[2*i];
+        return( info->n_channels );
+    }
+
+    /*--- grey or palette, 1, 2, 4 or 8 bits per pixel */
+
+    mask = (1 << info->bit_depth) - 1;
+    scale = 255 / mask;
+
+    for_less( x, 0, info->x_size )
+    {
+        shift = 8 - info->bit_depth - (x * info->bit_depth) % 8;
+        sample = (row[x * info->bit_depth / 8] >> shift) & mask;
+
+        if( info->colour_type == 3 )
+        {
+            if( sample >= info->n_palette )
+                sample = 0;
+            for_less( i, 0, 4 )
+                row_values[4*x+i] = info->palette[sample][i];
+        }
+        else
+            row_values[x] = (unsigned char) (sample * scale);
+    }
+
+    return( (info->colour_type == 3) ? 4 : 1 );
+}
+
+private  Status  input_png_header(
+    FILE             *file,
+    png_info_struct  *info )
+{
+    unsigned char  bytes[PNG_SIGNATURE_SIZE+25];
+    int            i;
+
+    if( fread( bytes, 1, PNG_SIGNATURE_SIZE + 25, file ) !=
+        PNG_SIGNATURE_SIZE + 25 )
+        return( ERROR );
+
+    for_less( i, 0, PNG_SIGNATURE_SIZE )
+    {
+        if( bytes[i] != png_signature[i] )
+            return( ERROR );
+    }
+
+    if( get_long_bytes( &bytes[8] ) != 13 ||
+        strncmp( (char *) &bytes[12], "IHDR", 4 ) != 0 )
+        return( ERROR );
+
+    info->x_size = (int) get_long_bytes( &bytes[16] );
+    info->y_size = (int) get_long_bytes( &bytes[20] );
+    info->bit_depth = bytes[24];
+    info->colour_type = bytes[25];
+
+    switch( info->colour_type )
+    {
+    case 0:  info->n_channels = 1;   break;
+    case 2:  info->n_channels = 3;   break;
+    case 3:  info->n_channels = 1;   break;
+    case 4:  info->n_channels = 2;   break;
+    case 6:  info->n_channels = 4;   break;
+    default: return( ERROR );
+    }
+
+    if( bytes[26] != 0 || bytes[27] != 0 )
+        return( ERROR );
+
+    if( bytes[28] != 0 )
+    {
+        print_error( "Interlaced PNG files are not supported.\n" );
+        return( ERROR );
+    }
+
+    if( (info->bit_depth != 8 && info->bit_depth != 16 &&
+         info->colour_type != 0 && info->colour_type != 3) ||
+        (info->bit_depth == 16 && info->colour_type == 3) ||
+        (info->bit_depth != 1 && info->bit_depth != 2 &&
+         info->bit_depth != 4 && info->bit_depth != 8 &&
+         info->bit_depth != 16) )
+        return( ERROR );
+
+    info->n_palette = 0;
+
+    return( OK );
+}
+
+private  Status  input_png_file(
+    FILE           *file,
+    STRING         filename,
+    pixels_struct  *pixels )
+{
+    png_info_struct  info;
+    unsigned char    chunk_header[8], crc[4];
+    unsigned char    *chunk, *row, *prev, *tmp, *row_values;
+    unsigned long    length, chunk_alloced;
+    int              row_bytes, bpp, n_rows_done, nc, i, ret;
+    BOOLEAN          done;
+    z_stream         stream;
+    Status           status;
+
+    if( input_png_header( file, &info ) != OK )
+    {
+        print_error( "Error reading PNG header of %s.\n", filename );
+        return( ERROR );
+    }
+
+    row_bytes = (info.x_size * info.n_channels * info.bit_depth + 7) / 8;
+    bpp = MAX( 1, info.n_channels * info.bit_depth / 8 );
+
+    for_less( i, 0, 256 )
+    {
+        info.palette[i][0] = 0;
+        info.palette[i][1] = 0;
+        info.palette[i][2] = 0;
+        info.palette[i][3] = 255;
+    }
+
+    initialize_pixels( pixels, 0, 0, info.x_size, info.y_size, 1.0, 1.0,
+                       RGB_PIXEL );
+
+    /*--- rows hold the filter type byte followed by the filtered data */
+
+    ALLOC( row, row_bytes + 1 );
+    ALLOC( prev, row_bytes + 1 );
+    ALLOC( row_values, MAX( 1, 4 * info.x_size ) );
+    for_less( i, 0, row_bytes + 1 )
+        prev[i] = 0;
+
+    chunk_alloced = PNG_BUFFER_SIZE;
+    ALLOC( chunk, chunk_alloced );
+
+    stream.zalloc = Z_NULL;
+    stream.zfree = Z_NULL;
+    stream.opaque = Z_NULL;
+    stream.next_in = Z_NULL;
+    stream.avail_in = 0;
+    (void) inflateInit( &stream );
+
+    stream.next_out = row;
+    stream.avail_out = (uInt) (row_bytes + 1);
+
+    n_rows_done = 0;
+    done = FALSE;
+    status = OK;
+
+    while( !done && status == OK )
+    {
+        if( fread( chunk_header, 1, 8, file ) != 8 )
+        {
+            status = ERROR;
+            break;
+        }
+
+        length = get_long_bytes( chunk_header );
+
+        if( length > chunk_alloced )
+        {
+            FREE( chunk );
+            chunk_alloced = length;
+            ALLOC( chunk, chunk_alloced );
+        }
+
+        if( fread( chunk, 1, (size_t) length, file ) != (size_t) length ||
+            fread( crc, 1, 4, file ) != 4 )
+        {
+            status = ERROR;
+            break;
+        }
+
+        if( strncmp( (char *) &chunk_header[4], "IEND", 4 ) == 0 )
+            done = TRUE;
+        else if( strncmp( (char *) &chunk_header[4], "PLTE", 4 ) == 0 )
+        {
+            info.n_palette = MIN( 256, (int) length / 3 );
+            for_less( i, 0, info.n_palette )
+            {
+                info.palette[i][0] = chunk[3*i];
+                info.palette[i][1] = chunk[3*i+1];
+                info.palette[i][2] = chunk[3*i+2];
+            }
+        }
+        else if( strncmp( (char *) &chunk_header[4], "tRNS", 4 ) == 0 &&
+                 info.colour_type == 3 )
+        {
+            for_less( i, 0, MIN( 256, (int) length ) )
+                info.palette[i][3] = chunk[i];
+        }
+        else if( strncmp( (char *) &chunk_header[4], "IDAT", 4 ) == 0 )
+        {
+            stream.next_in = chunk;
+            stream.avail_in = (uInt) length;
+
+            while( stream.avail_in > 0 && n_rows_done < info.y_size )
+            {
+                ret = inflate( &stream, Z_NO_FLUSH );
+
+                if( ret != Z_OK && ret != Z_STREAM_END )
+                {
+                    status = ERROR;
+                    break;
+                }
+
+                if( stream.avail_out == 0 )
+                {
+                    if( !unfilter_png_row( (int) row[0], row_bytes, bpp,
+                                           &row[1], &prev[1] ) )
+                    {
+                        status = ERROR;
+                        break;
+                    }
+
+                    nc = expand_png_row( &info, &row[1], row_values );
+
+                    /*--- PNG rows are stored top to bottom */
+
+                    unpack_pixel_row( pixels, info.y_size - 1 - n_rows_done,
+                                      nc, row_values );
+                    ++n_rows_done;
+
+                    tmp = prev;
+                    prev = row;
+                    row = tmp;
+
+                    stream.next_out = row;
+                    stream.avail_out = (uInt) (row_bytes + 1);
+                }
+
+                if( ret == Z_STREAM_END )
+                    break;
+            }
+        }
+    }
+
+    (void) inflateEnd( &stream );
+
+    FREE( chunk );
+    FREE( row );
+    FREE( prev );
+    FREE( row_values );
+
+    if( status != OK || n_rows_done < info.y_size )
+    {
+        print_error( "Error reading PNG data of %s.\n", filename );
+        delete_pixels( pixels );
+        status = ERROR;
+    }
+
+    return( status );
+}
+
+private  Status  output_png_chunk(
+    FILE           *file,
+    char           type[],
+    unsigned char  data[],
+    unsigned long  length )
+{
+    unsigned char  bytes[4];
+    uLong          crc;
+
+    set_long_bytes( bytes, length );
+    if( fwrite( bytes, 1, 4, file ) != 4 ||
+        fwrite( type, 1, 4, file ) != 4 ||
+        (length > 0 &&
+         fwrite( data, 1, (size_t) length, file ) != (size_t) length) )
+        return( ERROR );
+
+    crc = crc32( 0L, Z_NULL, 0 );
+    crc = crc32( crc, (Bytef *) type, 4 );
+    if( length > 0 )
+        crc = crc32( crc, data, (uInt) length );
+
+    set_long_bytes( bytes, (unsigned long) crc );
+    if( fwrite( bytes, 1, 4, file ) != 4 )
+        return( ERROR );
+
+    return( OK );
+}
+
+/*--- writes 8 bit RGBA with the up filter on every row, compressed for
+      speed rather than size */
+
+private  Status  output_png_file(
+    FILE           *file,
+    STRING         filename,
+    pixels_struct  *pixels )
+{
+    unsigned char  header[13], *row, *prev, *filtered, *tmp, *buffer;
+    int            row_bytes, n_rows, i, flush, ret;
+    z_stream       stream;
+    Status         status;
+
+    status = OK;
+
+    if( fwrite( png_signature, 1, PNG_SIGNATURE_SIZE, file ) !=
+        PNG_SIGNATURE_SIZE )
+        status = ERROR;
+
+    set_long_bytes( &header[0], (unsigned long) pixels->x_size );
+    set_long_bytes( &header[4], (unsigned long) pixels->y_size );
+    header[8] = 8;
+    header[9] = 6;
+    header[10] = 0;
+    header[11] = 0;
+    header[12] = 0;
+
+    if( status == OK )
+        status = output_png_chunk( file, "IHDR", header, 13 );
+
+    row_bytes = 4 * pixels->x_size;
+
+    ALLOC( row, MAX( 1, row_bytes ) );
+    ALLOC( prev, MAX( 1, row_bytes ) );
+    ALLOC( filtered, row_bytes + 1 );
+    ALLOC( buffer, PNG_BUFFER_SIZE );
+
+    for_less( i, 0, row_bytes )
+        prev[i] = 0;
+
+    stream.zalloc = Z_NULL;
+    stream.zfree = Z_NULL;
+    stream.opaque = Z_NULL;
+    stream.next_in = Z_NULL;
+    stream.avail_in = 0;
+    (void) deflateInit( &stream, Z_BEST_SPEED );
+
+    stream.next_out = buffer;
+    stream.avail_out = PNG_BUFFER_SIZE;
+
+    n_rows = 0;
+    flush = Z_NO_FLUSH;
+
+    while( status == OK )
+    {
+        if( stream.avail_in == 0 && flush == Z_NO_FLUSH )
+        {
+            if( n_rows < pixels->y_size )
+            {
+                pack_pixel_row( pixels, pixels->y_size - 1 - n_rows, 4, row );
+
+                filtered[0] = 2;
+                for_less( i, 0, row_bytes )
+                    filtered[i+1] = (unsigned char) (row[i] - prev[i]);
+
+                tmp = prev;
+                prev = row;
+                row = tmp;
+
+                stream.next_in = filtered;
+                stream.avail_in = (uInt) (row_bytes + 1);
+                ++n_rows;
+            }
+            else
+                flush = Z_FINISH;
+        }
+
+        ret = deflate( &stream, flush );
+
+        if( ret != Z_OK && ret != Z_STREAM_END && ret != Z_BUF_ERROR )
+        {
+            status = ERROR;
+            break;
+        }
+
+        if( stream.avail_out == 0 || ret == Z_STREAM_END )
+        {
+            status = output_png_chunk( file, "IDAT", buffer,
+                                       PNG_BUFFER_SIZE - stream.avail_out );
+            stream.next_out = buffer;
+            stream.avail_out = PNG_BUFFER_SIZE;
+        }
+
+        if( ret == Z_STREAM_END )
+            break;
+    }
+
+    (void) deflateEnd( &stream );
+
+    if( status == OK )
+        status = output_png_chunk( file, "IEND", NULL, 0 );
+
+    if( status != OK )
+        print_error( "Error writing %s.\n", filename );
+
+    FREE( row );
+    FREE( prev );
+    FREE( filtered );
+    FREE( buffer );
+
+    return( status );
+}
+
+#endif  /* PNG_SUPPORTED */
+
+/* ----------------------------- MNI Header -----------------------------------
+@NAME       : input_image_header
+@INPUT      : filename
+@OUTPUT     : x_size
+              y_size
+              n_components   - 1 grey, 2 grey-alpha, 3 rgb, 4 rgba
+@RETURNS    : OK or ERROR
+@DESCRIPTION: Reads the size of a PNM, SGI rgb or PNG image from its header.
+@METHOD     :
+@GLOBALS    :
+@CALLS      :
+@CREATED    :
+@MODIFIED   :
+---------------------------------------------------------------------------- */
+
+public  Status  input_image_header(
+    STRING   filename,
+    int      *x_size,
+    int      *y_size,
+    int      *n_components )
+{
+    FILE                *file;
+    Image_file_formats  format;
+    unsigned char       header[SGI_HEADER_SIZE];
+    int                 max_value;
+    BOOLEAN             flag;
+    Status              status;
+#ifdef  PNG_SUPPORTED
+    png_info_struct     info;
+#endif
+
+    format = get_image_file_format( filename );
+
+    if( format == UNKNOWN_IMAGE_FORMAT )
+        return( ERROR );
+
+    if( open_file( filename, READ_FILE, BINARY_FORMAT, &file ) != OK )
+        return( ERROR );
+
+    switch( format )
+    {
+    case PNM_IMAGE_FORMAT:
+        status = input_pnm_header( file, x_size, y_size, n_components,
+                                   &max_value, &flag );
+        break;
+
+    case SGI_IMAGE_FORMAT:
+        status = input_sgi_header( file, header, x_size, y_size,
+                                   n_components, &flag );
+        break;
+
+#ifdef  PNG_SUPPORTED
+    case PNG_IMAGE_FORMAT:
+        status = input_png_header( file, &info );
+        *x_size = info.x_size;
+        *y_size = info.y_size;
+        *n_components = (info.colour_type == 3) ? 4 : info.n_channels;
+        break;
+#endif
+
+    default:
+        status = ERROR;
+        break;
+    }
+
+    (void) close_file( file );
+
+    return( status );
+}
+
+/* ----------------------------- MNI Header -----------------------------------
+@NAME       : input_image_file
+@INPUT      : filename
+@OUTPUT     : pixels
+@RETURNS    : OK or ERROR
+@DESCRIPTION: Reads a PNM (P2, P3, P5, P6), SGI rgb (verbatim or run length
+              encoded) or PNG image into RGB pixels, recognizing the format
+              from the start of the file.  Each row is read or decoded
+              into a byte buffer and converted to pixels in one pass.
+@METHOD     :
+@GLOBALS    :
+@CALLS      :
+@CREATED    :
+@MODIFIED   :
+---------------------------------------------------------------------------- */
+
+public  Status  input_image_file(
+    STRING         filename,
+    pixels_struct  *pixels )
+{
+    FILE                *file;
+    Image_file_formats  format;
+    Status              status;
+
+    format = get_image_file_format( filename );
+
+    if( format == UNKNOWN_IMAGE_FORMAT )
+    {
+        print_error( "Unrecognized image format: %s\n", filename );
+        return( ERROR );
+    }
+
+    if( open_file( filename, READ_FILE, BINARY_FORMAT, &file ) != OK )
+        return( ERROR );
+
+    switch( format )
+    {
+    case PNM_IMAGE_FORMAT:
+        status = input_pnm_file( file, filename, pixels );
+        break;
+
+    case SGI_IMAGE_FORMAT:
+        status = input_sgi_file( file, filename, pixels );
+        break;
+
+#ifdef  PNG_SUPPORTED
+    case PNG_IMAGE_FORMAT:
+        status = input_png_file( file, filename, pixels );
+        break;
+#endif
+
+    default:
+        status = ERROR;
+        break;
+    }
+
+    (void) close_file( file );
+
+    return( status );
+}
+
+/* ----------------------------- MNI Header -----------------------------------
+@NAME       : output_image_file
+@INPUT      : filename
+              pixels
+@OUTPUT     :
+@RETURNS    : OK or ERROR
+@DESCRIPTION: Writes RGB pixels as PPM or PGM (.ppm, .pnm, .pgm), PNG (.png)
+              or otherwise SGI rgb with an alpha channel.
+@METHOD     :
+@GLOBALS    :
+@CALLS      :
+@CREATED    :
+@MODIFIED   :
+---------------------------------------------------------------------------- */
+
+public  Status  output_image_file(
+    STRING         filename,
+    pixels_struct  *pixels )
+{
+    FILE                *file;
+    Image_file_formats  format;
+    Status              status;
+
+    if( pixels->pixel_type != RGB_PIXEL )
+    {
+        print_error( "output_image_file: pixels must be RGB type.\n" );
+        return( ERROR );
+    }
+
+    format = get_image_output_format( filename );
+
+    if( format == UNKNOWN_IMAGE_FORMAT )
+    {
+        print_error( "Not compiled with support for writing %s\n",
+                     filename );
+        return( ERROR );
+    }
+
+    if( open_file( filename, WRITE_FILE, BINARY_FORMAT, &file ) != OK )
+        return( ERROR );
+
+    switch( format )
+    {
+    case PNM_IMAGE_FORMAT:
+        status = output_pnm_file( file, filename, pixels );
+        break;
+
+#ifdef  PNG_SUPPORTED
+    case PNG_IMAGE_FORMAT:
+        status = output_png_file( file, filename, pixels );
+        break;
+#endif
+
+    default:
+        status = output_sgi_file( file, filename, pixels );
+        break;
+    }
+
+    (void) close_file( file );
+
+    return( status );
+}
@@ -0,0 +1,26 @@
+#ifndef  DEF_IMAGE_CODEC_H
+#define  DEF_IMAGE_CODEC_H
+
+#include  <bicpl.h>
+
+/*--- image files read and written in process; pixel rows are stored
+      bottom to top, as for input_rgb_file() */
+
+typedef  enum  { UNKNOWN_IMAGE_FORMAT,
+                 PNM_IMAGE_FORMAT,
+                 SGI_IMAGE_FORMAT,
+                 PNG_IMAGE_FORMAT } Image_file_formats;
+
+#ifndef  public
+#define       public   extern
+#define       public_was_defined_here
+#endif
+
+#include  <image_codec_prototypes.h>
+
+#ifdef  public_was_defined_here
+#undef       public
+#undef       public_was_defined_here
+#endif
+
+#endif
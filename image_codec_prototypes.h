@@ -0,0 +1,23 @@
+#ifndef  DEF_IMAGE_CODEC_PROTOTYPES
+#define  DEF_IMAGE_CODEC_PROTOTYPES
+
+public  Image_file_formats  get_image_file_format(
+    STRING   filename );
+
+public  Image_file_formats  get_image_output_format(
+    STRING   filename );
+
+public  Status  input_image_header(
+    STRING   filename,
+    int      *x_size,
+    int      *y_size,
+    int      *n_components );
+
+public  Status  input_image_file(
+    STRING         filename,
+    pixels_struct  *pixels );
+
+public  Status  output_image_file(
+    STRING         filename,
+    pixels_struct  *pixels );
+#endif
@@ -0,0 +1,353 @@
+#include  <volume_io/internal_volume_io.h>
+#include  <image_composite.h>
+#include  <image_codec.h>
+
+/*--- x / 255, rounded, for x in 0 .. 255*255 */
+
+#define  DIV_255( x )   (((x) + 128 + (((x) + 128) >> 8)) >> 8)
+
+public  void  initialize_image_layout(
+    image_layout_struct  *layout,
+    int                  x_size,
+    int                  y_size,
+    Colour               background )
+{
+    layout->x_size = x_size;
+    layout->y_size = y_size;
+    layout->background = background;
+    layout->n_layers = 0;
+    layout->layers = NULL;
+}
+
+public  void  add_image_layer(
+    image_layout_struct  *layout,
+    STRING               filename,
+    int                  x_offset,
+    int                  y_offset,
+    Blend_types          blend )
+{
+    image_layer_struct  layer;
+
+    layer.filename = create_string( filename );
+    layer.x_offset = x_offset;
+    layer.y_offset = y_offset;
+    layer.blend = blend;
+
+    ADD_ELEMENT_TO_ARRAY( layout->layers, layout->n_layers, layer,
+                          DEFAULT_CHUNK_SIZE );
+}
+
+public  void  delete_image_layout(
+    image_layout_struct  *layout )
+{
+    int   i;
+
+    for_less( i, 0, layout->n_layers )
+        delete_string( layout->layers[i].filename );
+
+    if( layout->n_layers > 0 )
+        FREE( layout->layers );
+
+    layout->n_layers = 0;
+}
+
+/* ----------------------------- MNI Header -----------------------------------
+@NAME       : input_image_layout
+@INPUT      : filename
+@OUTPUT     : layout
+@RETURNS    : OK or ERROR
+@DESCRIPTION: Reads a layout description, one entry per line:
+
+                  size        x_size y_size
+                  background  colour_name
+                  replace     image_file x_offset y_offset
+                  over        image_file x_offset y_offset
+                  add         image_file x_offset y_offset
+                  mask        image_file x_offset y_offset
+
+              Layers are blended in the order listed.  Blank lines and lines
+              starting with # are ignored.  Without a size line, the output
+              is just large enough for all the layers.
+@METHOD     :
+@GLOBALS    :
+@CALLS      :
+@CREATED    :
+@MODIFIED   :
+---------------------------------------------------------------------------- */
+
+public  Status  input_image_layout(
+    STRING               filename,
+    image_layout_struct  *layout )
+{
+    FILE          *file;
+    STRING        line, keyword, args[3];
+    int           line_number, n_args, x, y;
+    Blend_types   blend;
+    Status        status;
+
+    if( open_file( filename, READ_FILE, ASCII_FORMAT, &file ) != OK )
+        return( ERROR );
+
+    initialize_image_layout( layout, 0, 0, make_rgba_Colour( 0, 0, 0, 0 ) );
+
+    status = OK;
+    line_number = 0;
+
+    while( status == OK && input_line( file, &line ) == OK )
+    {
+        ++line_number;
+
+        keyword = strtok( line, " \t" );
+
+        if( keyword == NULL || keyword[0] == '#' )
+        {
+            delete_string( line );
+            continue;
+        }
+
+        for( n_args = 0;  n_args < 3;  ++n_args )
+        {
+            args[n_args] = strtok( NULL, " \t" );
+            if( args[n_args] == NULL )
+                break;
+        }
+
+        if( equal_strings( keyword, "size" ) )
+        {
+            if( n_args < 2 ||
+                sscanf( args[0], "%d", &layout->x_size ) != 1 ||
+                sscanf( args[1], "%d", &layout->y_size ) != 1 )
+                status = ERROR;
+        }
+        else if( equal_strings( keyword, "background" ) )
+        {
+            if( n_args < 1 )
+                status = ERROR;
+            else
+                layout->background = convert_string_to_colour( args[0] );
+        }
+        else
+        {
+            if( equal_strings( keyword, "replace" ) )
+                blend = REPLACE_BLEND;
+            else if( equal_strings( keyword, "over" ) )
+                blend = OVER_BLEND;
+            else if( equal_strings( keyword, "add" ) )
+                blend = ADD_BLEND;
+            else if( equal_strings( keyword, "mask" ) )
+                blend = MASK_BLEND;
+            else
+                status = ERROR;
+
+            if( status == OK &&
+                (n_args < 3 ||
+                 sscanf( args[1], "%d", &x ) != 1 ||
+                 sscanf( args[2], "%d", &y ) != 1) )
+                status = ERROR;
+
+            if( status == OK )
+                add_image_layer( layout, args[0], x, y, blend );
+        }
+
+        if( status != OK )
+            print_error( "Error in %s, line %d.\n", filename, line_number );
+
+        delete_string( line );
+    }
+
+    (void) close_file( file );
+
+    if( status != OK )
+        delete_image_layout( layout );
+
+    return( status );
+}
+
+/* ----------------------------- MNI Header -----------------------------------
+@NAME       : blend_pixel_row
+@INPUT      : blend
+              n_pixels
+              src
+              dest
+@OUTPUT     : dest
+@RETURNS    :
+@DESCRIPTION: Blends a row of source pixels onto a row of destination pixels:
+              replace copies them, over composites by the source alpha, add
+              sums the components saturating at 255, and mask copies only
+              the source pixels which are neither transparent nor black.
+@METHOD     : 8 bit integer arithmetic, with opaque and transparent source
+              pixels skipping the blend.
+@GLOBALS    :
+@CALLS      :
+@CREATED    :
+@MODIFIED   :
+---------------------------------------------------------------------------- */
+
+public  void  blend_pixel_row(
+    Blend_types   blend,
+    int           n_pixels,
+    Colour        src[],
+    Colour        dest[] )
+{
+    int      i, a, inv_a, r, g, b;
+    Colour   s, d;
+
+    switch( blend )
+    {
+    case REPLACE_BLEND:
+        (void) memcpy( dest, src, (size_t) n_pixels * sizeof(src[0]) );
+        break;
+
+    case OVER_BLEND:
+        for_less( i, 0, n_pixels )
+        {
+            s = src[i];
+            a = get_Colour_a( s );
+
+            if( a == 255 )
+                dest[i] = s;
+            else if( a != 0 )
+            {
+                d = dest[i];
+                inv_a = 255 - a;
+                r = DIV_255( get_Colour_r(s) * a + get_Colour_r(d) * inv_a );
+                g = DIV_255( get_Colour_g(s) * a + get_Colour_g(d) * inv_a );
+                b = DIV_255( get_Colour_b(s) * a + get_Colour_b(d) * inv_a );
+                dest[i] = make_rgba_Colour( r, g, b,
+                                    a + DIV_255( get_Colour_a(d) * inv_a ) );
+            }
+        }
+        break;
+
+    case ADD_BLEND:
+        for_less( i, 0, n_pixels )
+        {
+            s = src[i];
+            d = dest[i];
+            r = get_Colour_r(s) + get_Colour_r(d);
+            g = get_Colour_g(s) + get_Colour_g(d);
+            b = get_Colour_b(s) + get_Colour_b(d);
+            a = get_Colour_a(s) + get_Colour_a(d);
+
+            if( r > 255 )  r = 255;
+            if( g > 255 )  g = 255;
+            if( b > 255 )  b = 255;
+            if( a > 255 )  a = 255;
+
+            dest[i] = make_rgba_Colour( r, g, b, a );
+        }
+        break;
+
+    case MASK_BLEND:
+        for_less( i, 0, n_pixels )
+        {
+            s = src[i];
+            if( get_Colour_a(s) != 0 &&
+                (get_Colour_r(s) != 0 || get_Colour_g(s) != 0 ||
+                 get_Colour_b(s) != 0) )
+                dest[i] = s;
+        }
+        break;
+    }
+}
+
+/* ----------------------------- MNI Header -----------------------------------
+@NAME       : render_image_layout
+@INPUT      : layout
+@OUTPUT     : pixels
+@RETURNS    : OK or ERROR
+@DESCRIPTION: Creates the output image filled with the background and
+              blends each layer onto it in turn.  Only one layer image is
+              in memory at a time, and each is blended a row at a time over
+              the part which overlaps the output.
+@METHOD     :
+@GLOBALS    :
+@CALLS      :
+@CREATED    :
+@MODIFIED   :
+---------------------------------------------------------------------------- */
+
+public  Status  render_image_layout(
+    image_layout_struct  *layout,
+    pixels_struct        *pixels )
+{
+    int                  i, x, row, x_size, y_size, nc, w, h;
+    int                  x_min, x_max, row_min, row_max;
+    image_layer_struct   *layer;
+    pixels_struct        layer_pixels;
+    Colour               *first_row;
+
+    x_size = layout->x_size;
+    y_size = layout->y_size;
+
+    /*--- the default size just holds all the layers */
+
+    if( x_size <= 0 || y_size <= 0 )
+    {
+        x_size = 0;
+        y_size = 0;
+
+        for_less( i, 0, layout->n_layers )
+        {
+            layer = &layout->layers[i];
+            if( input_image_header( layer->filename, &w, &h, &nc ) != OK )
+            {
+                print_error( "Error reading %s.\n", layer->filename );
+                return( ERROR );
+            }
+
+            x_size = MAX( x_size, layer->x_offset + w );
+            y_size = MAX( y_size, layer->y_offset + h );
+        }
+    }
+
+    initialize_pixels( pixels, 0, 0, x_size, y_size, 1.0, 1.0, RGB_PIXEL );
+
+    if( x_size > 0 && y_size > 0 )
+    {
+        first_row = &PIXEL_RGB_COLOUR( *pixels, 0, 0 );
+        for_less( x, 0, x_size )
+            first_row[x] = layout->background;
+
+        for_less( row, 1, y_size )
+        {
+            (void) memcpy( &PIXEL_RGB_COLOUR( *pixels, 0, row ), first_row,
+                           (size_t) x_size * sizeof(first_row[0]) );
+        }
+    }
+
+    /*--- layer offsets are from the top left, pixel rows are stored
+          bottom to top */
+
+    for_less( i, 0, layout->n_layers )
+    {
+        layer = &layout->layers[i];
+
+        if( input_image_file( layer->filename, &layer_pixels ) != OK )
+        {
+            delete_pixels( pixels );
+            return( ERROR );
+        }
+
+        x_min = MAX( 0, -layer->x_offset );
+        x_max = MIN( layer_pixels.x_size, x_size - layer->x_offset );
+        row_min = MAX( 0, -layer->y_offset );
+        row_max = MIN( layer_pixels.y_size, y_size - layer->y_offset );
+
+        if( x_min < x_max )
+        {
+            for_less( row, row_min, row_max )
+            {
+                blend_pixel_row( layer->blend, x_max - x_min,
+                   &PIXEL_RGB_COLOUR( layer_pixels, x_min,
+                                      layer_pixels.y_size - 1 - row ),
+                   &PIXEL_RGB_COLOUR( *pixels, x_min + layer->x_offset,
+                                      y_size - 1 - (row + layer->y_offset) ) );
+            }
+        }
+
+        delete_pixels( &layer_pixels );
+    }
+
+    return( OK );
+}
@@ -0,0 +1,44 @@
+#ifndef  DEF_IMAGE_COMPOSITE_H
+#define  DEF_IMAGE_COMPOSITE_H
+
+#include  <bicpl.h>
+
+/*--- a mosaic of images: each layer is an image file placed with its top
+      left corner at an offset from the top left of the output, and
+      blended onto what is below it */
+
+typedef  enum  { REPLACE_BLEND,
+                 OVER_BLEND,
+                 ADD_BLEND,
+                 MASK_BLEND } Blend_types;
+
+typedef struct
+{
+    STRING        filename;
+    int           x_offset;
+    int           y_offset;
+    Blend_types   blend;
+} image_layer_struct;
+
+typedef struct
+{
+    int                  x_size;
+    int                  y_size;
+    Colour               background;
+    int                  n_layers;
+    image_layer_struct   *layers;
+} image_layout_struct;
+
+#ifndef  public
+#define       public   extern
+#define       public_was_defined_here
+#endif
+
+#include  <image_composite_prototypes.h>
+
+#ifdef  public_was_defined_here
+#undef       public
+#undef       public_was_defined_here
+#endif
+
+#endif
@@ -0,0 +1,33 @@
+#ifndef  DEF_IMAGE_COMPOSITE_PROTOTYPES
+#define  DEF_IMAGE_COMPOSITE_PROTOTYPES
+
+public  void  initialize_image_layout(
+    image_layout_struct  *layout,
+    int                  x_size,
+    int                  y_size,
+    Colour               background );
+
+public  void  add_image_layer(
+    image_layout_struct  *layout,
+    STRING               filename,
+    int                  x_offset,
+    int                  y_offset,
+    Blend_types          blend );
+
+public  void  delete_image_layout(
+    image_layout_struct  *layout );
+
+public  Status  input_image_layout(
+    STRING               filename,
+    image_layout_struct  *layout );
+
+public  void  blend_pixel_row(
+    Blend_types   blend,
+    int           n_pixels,
+    Colour        src[],
+    Colour        dest[] );
+
+public  Status  render_image_layout(
+    image_layout_struct  *layout,
+    pixels_struct        *pixels );
+#endif
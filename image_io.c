@@ -1,5 +1,6 @@
 #include <volume_io/internal_volume_io.h>
 #include <bicpl.h>
+#include <image_codec.h>
 
 public  Status  get_image_file_size(
     STRING         filename,
@@ -10,6 +11,11 @@ public  Status  get_image_file_size(
     char   command[EXTREMELY_LARGE_STRING_SIZE+1];
     FILE   *file;
 
+    /*---  formats read in process need no external command */
+
+    if( get_image_file_format( filename ) != UNKNOWN_IMAGE_FORMAT )
+        return( input_image_header( filename, x_size, y_size, nc ) );
+
     /*---  get the image size */
 
     (void) sprintf( command, "get_image_size.pl %s", filename );
@@ -41,6 +47,9 @@ public  Status  read_image_file(
     unsigned char  colour[4];
     Colour         col;
 
+    if( get_image_file_format( filename ) != UNKNOWN_IMAGE_FORMAT )
+        return( input_image_file( filename, pixels ) );
+
     if( get_image_file_size( filename, &x_size, &y_size, &nc ) != OK )
         return( ERROR );
 
@@ -62,6 +71,9 @@ public  Status  read_image_file(
         return( ERROR );
     }
 
+    /*--- convert gives the rows top to bottom, pixels hold them bottom to
+          top, as the formats read in process do */
+
     for_less( y, 0, y_size )
     {
         for_less( x, 0, x_size )
@@ -84,7 +96,7 @@ public  Status  read_image_file(
                                         (int) colour[2], (int) colour[3] );
             }
 
-            PIXEL_RGB_COLOUR(*pixels,x,y) = col;
+            PIXEL_RGB_COLOUR(*pixels,x,y_size-1-y) = col;
         }
     }
 
@@ -97,27 +109,28 @@ public  Status  write_image_file(
     STRING         filename,
     pixels_struct  *pixels )
 {
-    char           command[EXTREMELY_LARGE_STRING_SIZE+1];
-    int            x_size, y_size, x, y, r, g, b, a;
-    FILE           *file;
-    unsigned char  colour[4];
-    Colour         col;
+    char                command[EXTREMELY_LARGE_STRING_SIZE+1];
+    int                 x_size, y_size, x, y, r, g, b, a;
+    FILE                *file;
+    unsigned char       colour[4];
+    Colour              col;
+    Image_file_formats  format;
 
     x_size = pixels->x_size;
     y_size = pixels->y_size;
 
+    format = get_image_output_format( filename );
+
     if( find_character(filename,':') < 0 &&
-        string_ends_in( filename, ".rgb" ) )
+        (string_ends_in( filename, ".rgb" ) ||
+         (format != SGI_IMAGE_FORMAT && format != UNKNOWN_IMAGE_FORMAT)) )
     {
-        (void) sprintf( command, "convert -size %dx%d RGBA:- SGI:%s",
-                        x_size, y_size, filename );
-    }
-    else
-    {
-        (void) sprintf( command, "convert -size %dx%d RGBA:- %s",
-                        x_size, y_size, filename );
+        return( output_image_file( filename, pixels ) );
     }
 
+    (void) sprintf( command, "convert -size %dx%d RGBA:- %s",
+                    x_size, y_size, filename );
+
     if( (file = popen( command, "w")) == NULL )
     {
         print_error( "Error opening file %s or finding command 'convert'\n",
@@ -125,11 +138,13 @@ public  Status  write_image_file(
         return( ERROR );
     }
 
+    /*--- convert takes the rows top to bottom */
+
     for_less( y, 0, y_size )
     {
         for_less( x, 0, x_size )
         {
-            col = PIXEL_RGB_COLOUR(*pixels,x,y);
+            col = PIXEL_RGB_COLOUR(*pixels,x,y_size-1-y);
 
             r = get_Colour_r( col );
             g = get_Colour_g( col );
@@ -0,0 +1,199 @@
+#include  <volume_io/internal_volume_io.h>
+#include  <bicpl.h>
+#include  <voxel_histogram.h>
+#include  <volume_derivatives.h>
+
+#define  DEFAULT_N_BINS   100
+
+private  void  usage(
+    STRING  executable )
+{
+    STRING  usage_str = "\n\
+Usage: %s volume1.mnc volume2.mnc|gradient [n_bins1] [n_bins2] [mask.mnc]\n\
+\n\
+     Computes the joint histogram of the values of corresponding voxels of\n\
+     two volumes, or of the values and gradient magnitudes of one volume,\n\
+     in value units per world unit, and prints the centres of each\n\
+     nonempty pair of bins and its count.\n\
+     If n_bins1 is 0, volume1 is treated as a label volume with one bin\n\
+     per integer value, giving the histogram of volume2 within each label.\n\
+     If a mask volume is given, only voxels where it is nonzero are\n\
+     counted.  It must have the same sizes as volume1.\n\n";
+
+    print_error( usage_str, executable );
+}
+
+int  main(
+    int   argc,
+    char  *argv[] )
+{
+    STRING                  filename1, filename2, mask_filename;
+    Volume                  volume1, volume2, mask_volume;
+    int                     n_bins1, n_bins2, sizes[MAX_DIMENSIONS];
+    int                     mask_sizes[MAX_DIMENSIONS];
+    int                     i, j, dim, n_voxels, count;
+    Real                    min_value1, max_value1, min_value2, max_value2;
+    Real                    centre1, centre2, separations[MAX_DIMENSIONS];
+    float                   *values, *grad[N_DIMENSIONS], *mask_values;
+    float                   scale[N_DIMENSIONS], g, sum_squares;
+    BOOLEAN                 gradient;
+    joint_histogram_struct  histogram;
+
+    initialize_argument_processing( argc, argv );
+
+    if( !get_string_argument( NULL, &filename1 ) ||
+        !get_string_argument( NULL, &filename2 ) )
+    {
+        usage( argv[0] );
+        return( 1 );
+    }
+
+    (void) get_int_argument( DEFAULT_N_BINS, &n_bins1 );
+    (void) get_int_argument( DEFAULT_N_BINS, &n_bins2 );
+
+    gradient = equal_strings( filename2, "gradient" );
+
+    if( input_volume( filename1, 3, XYZ_dimension_names,
+                      NC_UNSPECIFIED, FALSE, 0.0, 0.0,
+                      TRUE, &volume1, (minc_input_options *) NULL ) != OK )
+        return( 1 );
+
+    mask_volume = NULL;
+    if( get_string_argument( NULL, &mask_filename ) &&
+        input_volume( mask_filename, 3, XYZ_dimension_names,
+                      NC_UNSPECIFIED, FALSE, 0.0, 0.0,
+                      TRUE, &mask_volume, (minc_input_options *) NULL ) != OK )
+        return( 1 );
+
+    get_volume_real_range( volume1, &min_value1, &max_value1 );
+
+    if( n_bins1 <= 0 )
+    {
+        min_value1 = (Real) ROUND( min_value1 ) - 0.5;
+        max_value1 = (Real) ROUND( max_value1 ) + 0.5;
+        n_bins1 = ROUND( max_value1 - min_value1 );
+    }
+
+    if( gradient )
+    {
+        get_volume_sizes( volume1, sizes );
+        n_voxels = sizes[X] * sizes[Y] * sizes[Z];
+
+        if( mask_volume != NULL )
+        {
+            get_volume_sizes( mask_volume, mask_sizes );
+            if( get_volume_n_dimensions( mask_volume ) != N_DIMENSIONS ||
+                mask_sizes[X] != sizes[X] || mask_sizes[Y] != sizes[Y] ||
+                mask_sizes[Z] != sizes[Z] )
+            {
+                print_error(
+                       "Mask volume does not match the volume sizes.\n" );
+                return( 1 );
+            }
+        }
+
+        ALLOC( values, n_voxels );
+        for_less( dim, 0, N_DIMENSIONS )
+        {
+            ALLOC( grad[dim], n_voxels );
+        }
+
+        get_volume_float_values( volume1, values );
+        compute_volume_derivatives( sizes, values, 0, GRADIENT_COMPONENTS,
+                                    grad );
+
+        /*--- the derivatives are per voxel, so divide by the separations
+              to give the gradient per world unit */
+
+        get_volume_separations( volume1, separations );
+        for_less( dim, 0, N_DIMENSIONS )
+            scale[dim] = (float) (1.0 / FABS( separations[dim] ));
+
+        for_less( i, 0, n_voxels )
+        {
+            sum_squares = 0.0f;
+            for_less( dim, 0, N_DIMENSIONS )
+            {
+                g = grad[dim][i] * scale[dim];
+                sum_squares += g * g;
+            }
+            grad[0][i] = (float) sqrt( (double) sum_squares );
+        }
+
+        FREE( grad[1] );
+        FREE( grad[2] );
+
+        if( mask_volume != NULL )
+        {
+            ALLOC( mask_values, n_voxels );
+            get_volume_float_values( mask_volume, mask_values );
+            for_less( i, 0, n_voxels )
+            {
+                if( mask_values[i] == 0.0f )
+                    grad[0][i] = -1.0f;
+            }
+            FREE( mask_values );
+        }
+
+        min_value2 = 0.0;
+        max_value2 = 0.0;
+        for_less( i, 0, n_voxels )
+        {
+            if( (Real) grad[0][i] > max_value2 )
+                max_value2 = (Real) grad[0][i];
+        }
+
+        initialize_joint_histogram( &histogram, min_value1, max_value1,
+                                    n_bins1, min_value2, max_value2, n_bins2 );
+
+        add_float_values_to_joint_histogram( &histogram, n_voxels,
+                                             values, grad[0] );
+
+        FREE( values );
+        FREE( grad[0] );
+    }
+    else
+    {
+        if( input_volume( filename2, 3, XYZ_dimension_names,
+                          NC_UNSPECIFIED, FALSE, 0.0, 0.0,
+                          TRUE, &volume2, (minc_input_options *) NULL ) != OK )
+            return( 1 );
+
+        get_volume_real_range( volume2, &min_value2, &max_value2 );
+
+        initialize_joint_histogram( &histogram, min_value1, max_value1,
+                                    n_bins1, min_value2, max_value2, n_bins2 );
+
+        if( add_volumes_to_joint_histogram( &histogram, volume1, volume2,
+                                            mask_volume ) != OK )
+            return( 1 );
+
+        delete_volume( volume2 );
+    }
+
+    for_less( i, 0, histogram.ranges[0].n_bins )
+    {
+        centre1 = histogram.ranges[0].min_value +
+                  ((Real) i + 0.5) * histogram.ranges[0].bin_width;
+
+        for_less( j, 0, histogram.ranges[1].n_bins )
+        {
+            count = histogram.counts[i*histogram.ranges[1].n_bins+j];
+            if( count == 0 )
+                continue;
+
+            centre2 = histogram.ranges[1].min_value +
+                      ((Real) j + 0.5) * histogram.ranges[1].bin_width;
+
+            print( "%g %g %d\n", centre1, centre2, count );
+        }
+    }
+
+    delete_joint_histogram( &histogram );
+
+    delete_volume( volume1 );
+    if( mask_volume != NULL )
+        delete_volume( mask_volume );
+
+    return( 0 );
+}
@@ -0,0 +1,431 @@
+#include  <volume_io/internal_volume_io.h>
+#include  <label_algebra.h>
+
+public  void  initialize_label_remap(
+    label_remap_struct  *remap )
+{
+    remap->min_value = 0;
+    remap->n_values = 0;
+    remap->remap = NULL;
+    remap->mapped = NULL;
+    remap->use_unmapped = FALSE;
+    remap->unmapped_value = 0;
+    initialize_voxel_table( &remap->table );
+}
+
+public  void  delete_label_remap(
+    label_remap_struct  *remap )
+{
+    if( remap->n_values > 0 )
+    {
+        FREE( remap->remap );
+        FREE( remap->mapped );
+    }
+
+    delete_voxel_table( &remap->table );
+}
+
+/* ----------------------------- MNI Header -----------------------------------
+@NAME       : set_label_remap_value
+@INPUT      : remap
+              from
+              to
+@OUTPUT     : remap
+@RETURNS    :
+@DESCRIPTION: Maps the label from to the label to, extending the dense table
+              to include from if necessary.
+@METHOD     :
+@GLOBALS    :
+@CALLS      :
+@CREATED    :
+@MODIFIED   :
+---------------------------------------------------------------------------- */
+
+public  void  set_label_remap_value(
+    label_remap_struct  *remap,
+    int                 from,
+    int                 to )
+{
+    int       i, new_min, new_n, offset;
+    int       *new_remap;
+    BOOLEAN   *new_mapped;
+
+    if( remap->n_values == 0 ||
+        from < remap->min_value ||
+        from >= remap->min_value + remap->n_values )
+    {
+        if( remap->n_values == 0 )
+        {
+            new_min = from;
+            new_n = 1;
+        }
+        else
+        {
+            new_min = MIN( from, remap->min_value );
+            new_n = MAX( from + 1, remap->min_value + remap->n_values ) -
+                    new_min;
+        }
+
+        ALLOC( new_remap, new_n );
+        ALLOC( new_mapped, new_n );
+
+        for_less( i, 0, new_n )
+        {
+            new_remap[i] = new_min + i;
+            new_mapped[i] = FALSE;
+        }
+
+        if( remap->n_values > 0 )
+        {
+            offset = remap->min_value - new_min;
+            for_less( i, 0, remap->n_values )
+            {
+                new_remap[offset+i] = remap->remap[i];
+                new_mapped[offset+i] = remap->mapped[i];
+            }
+
+            FREE( remap->remap );
+            FREE( remap->mapped );
+        }
+
+        remap->min_value = new_min;
+        remap->n_values = new_n;
+        remap->remap = new_remap;
+        remap->mapped = new_mapped;
+    }
+
+    remap->remap[from-remap->min_value] = to;
+    remap->mapped[from-remap->min_value] = TRUE;
+
+    delete_voxel_table( &remap->table );
+}
+
+/*--- sets the label given to all labels which have not been mapped */
+
+public  void  set_label_remap_unmapped(
+    label_remap_struct  *remap,
+    int                 unmapped_value )
+{
+    remap->use_unmapped = TRUE;
+    remap->unmapped_value = unmapped_value;
+
+    delete_voxel_table( &remap->table );
+}
+
+public  int  get_label_remap_value(
+    label_remap_struct  *remap,
+    int                 label )
+{
+    int   i;
+
+    i = label - remap->min_value;
+
+    if( i >= 0 && i < remap->n_values && remap->mapped[i] )
+        return( remap->remap[i] );
+    else if( remap->use_unmapped )
+        return( remap->unmapped_value );
+    else
+        return( label );
+}
+
+/* ----------------------------- MNI Header -----------------------------------
+@NAME       : input_label_remap
+@INPUT      : filename
+@OUTPUT     : remap
+@RETURNS    : OK or ERROR
+@DESCRIPTION: Adds to the mapping the pairs of labels in a file, one from and
+              to label at the start of each line, ignoring the rest of the
+              line and blank lines.  Any other line is an error.
+@METHOD     :
+@GLOBALS    :
+@CALLS      :
+@CREATED    :
+@MODIFIED   :
+---------------------------------------------------------------------------- */
+
+public  Status  input_label_remap(
+    STRING              filename,
+    label_remap_struct  *remap )
+{
+    FILE     *file;
+    STRING   line;
+    int      from, to, line_number;
+    char     ch;
+    Status   status;
+
+    if( open_file( filename, READ_FILE, ASCII_FORMAT, &file ) != OK )
+        return( ERROR );
+
+    status = OK;
+    line_number = 0;
+
+    while( status == OK && input_line( file, &line ) == OK )
+    {
+        ++line_number;
+
+        if( sscanf( line, "%d %d", &from, &to ) == 2 )
+            set_label_remap_value( remap, from, to );
+        else if( sscanf( line, " %c", &ch ) == 1 )
+        {
+            print_error( "Error in label remap file %s, line %d.\n",
+                         filename, line_number );
+            status = ERROR;
+        }
+
+        delete_string( line );
+    }
+
+    (void) close_file( file );
+
+    return( status );
+}
+
+/*--- finds a range containing every label that the labels min_label to
+      max_label may be mapped to */
+
+public  void  get_label_remap_range(
+    label_remap_struct  *remap,
+    int                 min_label,
+    int                 max_label,
+    int                 *min_result,
+    int                 *max_result )
+{
+    int   i, label;
+
+    if( remap->use_unmapped )
+    {
+        *min_result = remap->unmapped_value;
+        *max_result = remap->unmapped_value;
+    }
+    else
+    {
+        *min_result = min_label;
+        *max_result = max_label;
+    }
+
+    for_less( i, 0, remap->n_values )
+    {
+        label = remap->min_value + i;
+        if( remap->mapped[i] && label >= min_label && label <= max_label )
+        {
+            *min_result = MIN( *min_result, remap->remap[i] );
+            *max_result = MAX( *max_result, remap->remap[i] );
+        }
+    }
+}
+
+/*--- remaps an array of values, such as those of a texture file, each
+      rounded to the nearest label */
+
+public  void  remap_label_values(
+    label_remap_struct  *remap,
+    int                 n_values,
+    Real                values[] )
+{
+    int   i;
+
+    for_less( i, 0, n_values )
+        values[i] = (Real) get_label_remap_value( remap, ROUND( values[i] ) );
+}
+
+/*--- the label of a real value, in the form used to tabulate voxel values */
+
+private  int  get_label_remap_entry(
+    Real   value,
+    void   *remap )
+{
+    return( get_label_remap_value( (label_remap_struct *) remap,
+                                   ROUND( value ) ) );
+}
+
+#define  CONVERT_LABELS( type )                                             \
+    {                                                                       \
+        type  *ptr = (type *) span->voxels;                                 \
+                                                                            \
+        for_less( i, 0, span->n_voxels )                                    \
+        {                                                                   \
+            label = ROUND( span->scale * (Real) ptr[i] + span->translation );\
+            labels[i] = get_label_remap_value( remap, label );              \
+        }                                                                   \
+    }
+
+/* ----------------------------- MNI Header -----------------------------------
+@NAME       : get_voxel_span_labels
+@INPUT      : remap
+              span
+@OUTPUT     : labels
+@RETURNS    :
+@DESCRIPTION: Rounds the real value of each voxel of the span to a label and
+              maps it.  Byte and short voxels are mapped by lookup in a table
+              of all their possible values, without converting them to real
+              values.
+@METHOD     :
+@GLOBALS    :
+@CALLS      :
+@CREATED    :
+@MODIFIED   :
+---------------------------------------------------------------------------- */
+
+public  void  get_voxel_span_labels(
+    label_remap_struct  *remap,
+    voxel_span_struct   *span,
+    int                 labels[] )
+{
+    int   i, label;
+
+    if( get_voxel_span_table_entries( &remap->table, span,
+                                      get_label_remap_entry, (void *) remap,
+                                      labels ) )
+        return;
+
+    switch( span->data_type )
+    {
+    case UNSIGNED_INT:    CONVERT_LABELS( unsigned int );     break;
+    case SIGNED_INT:      CONVERT_LABELS( int );              break;
+    case FLOAT:           CONVERT_LABELS( float );            break;
+    case DOUBLE:          CONVERT_LABELS( double );           break;
+    default:
+        handle_internal_error( "get_voxel_span_labels" );
+        break;
+    }
+}
+
+/*--- merges new labels into the labels so far, according to the rule */
+
+public  void  merge_labels(
+    Label_merge_rules  rule,
+    int                n_labels,
+    int                labels[],
+    int                new_labels[] )
+{
+    int   i;
+
+    if( rule == LABEL_OVER )
+    {
+        for_less( i, 0, n_labels )
+        {
+            if( new_labels[i] != 0 )
+                labels[i] = new_labels[i];
+        }
+    }
+    else
+    {
+        for_less( i, 0, n_labels )
+        {
+            if( labels[i] == 0 )
+                labels[i] = new_labels[i];
+        }
+    }
+}
+
+/* ----------------------------- MNI Header -----------------------------------
+@NAME       : merge_label_volumes
+@INPUT      : n_volumes
+              volumes
+              remaps
+              rules
+@OUTPUT     : output
+@RETURNS    : OK or ERROR
+@DESCRIPTION: Maps the labels of each volume, or just rounds them where the
+              remap is NULL, merges each volume after the first into the
+              ones before it by its rule, and stores the result in the output
+              volume.  All the volumes are traversed together in a single
+              pass, and must have the same sizes.  The output may be one of
+              the input volumes.
+@METHOD     :
+@GLOBALS    :
+@CALLS      :
+@CREATED    :
+@MODIFIED   :
+---------------------------------------------------------------------------- */
+
+public  Status  merge_label_volumes(
+    int                 n_volumes,
+    Volume              volumes[],
+    label_remap_struct  *remaps[],
+    Label_merge_rules   rules[],
+    Volume              output )
+{
+    int                 i, v, dim, max_span;
+    int                 sizes[MAX_DIMENSIONS], output_sizes[MAX_DIMENSIONS];
+    int                 *labels, *new_labels;
+    Real                *values;
+    voxel_scan_struct   *scans, output_scan;
+    voxel_span_struct   span, output_span;
+    label_remap_struct  identity, *remap;
+
+    get_volume_sizes( output, output_sizes );
+
+    for_less( v, 0, n_volumes )
+    {
+        get_volume_sizes( volumes[v], sizes );
+
+        if( get_volume_n_dimensions( volumes[v] ) !=
+            get_volume_n_dimensions( output ) )
+        {
+            print_error( "Label volumes must have the same dimensions.\n" );
+            return( ERROR );
+        }
+
+        for_less( dim, 0, get_volume_n_dimensions( output ) )
+        {
+            if( sizes[dim] != output_sizes[dim] )
+            {
+                print_error( "Label volumes must have the same sizes.\n" );
+                return( ERROR );
+            }
+        }
+    }
+
+    initialize_label_remap( &identity );
+
+    ALLOC( scans, n_volumes );
+    for_less( v, 0, n_volumes )
+        initialize_voxel_scan( &scans[v], volumes[v], 0 );
+
+    initialize_voxel_scan( &output_scan, output, 0 );
+
+    max_span = get_voxel_scan_max_span( &output_scan );
+    ALLOC( labels, max_span );
+    ALLOC( new_labels, max_span );
+    ALLOC( values, max_span );
+
+    while( get_next_voxel_span( &output_scan, &output_span ) )
+    {
+        for_less( v, 0, n_volumes )
+        {
+            (void) get_next_voxel_span( &scans[v], &span );
+
+            if( remaps[v] != NULL )
+                remap = remaps[v];
+            else
+                remap = &identity;
+
+            if( v == 0 )
+                get_voxel_span_labels( remap, &span, labels );
+            else
+            {
+                get_voxel_span_labels( remap, &span, new_labels );
+                merge_labels( rules[v], span.n_voxels, labels, new_labels );
+            }
+        }
+
+        for_less( i, 0, output_span.n_voxels )
+            values[i] = (Real) labels[i];
+
+        set_voxel_span_values( &output_scan, &output_span, values );
+    }
+
+    FREE( values );
+    FREE( new_labels );
+    FREE( labels );
+
+    delete_voxel_scan( &output_scan );
+    for_less( v, 0, n_volumes )
+        delete_voxel_scan( &scans[v] );
+    FREE( scans );
+
+    delete_label_remap( &identity );
+
+    return( OK );
+}
@@ -0,0 +1,42 @@
+#ifndef  DEF_LABEL_ALGEBRA_H
+#define  DEF_LABEL_ALGEBRA_H
+
+#include  <bicpl.h>
+#include  <voxel_scan.h>
+
+/*--- a mapping of integer labels to labels, held as a dense table of the
+      labels min_value to min_value+n_values-1.  Labels which have not been
+      mapped are left unchanged, or set to unmapped_value if use_unmapped
+      is TRUE.  For byte and short voxels the label of every possible voxel
+      value is tabulated once, so that spans are remapped by table lookup. */
+
+typedef  struct
+{
+    int                  min_value;
+    int                  n_values;
+    int                  *remap;
+    BOOLEAN              *mapped;
+    BOOLEAN              use_unmapped;
+    int                  unmapped_value;
+    voxel_table_struct   table;
+} label_remap_struct;
+
+/*--- how a label volume is merged into the labels so far: LABEL_OVER
+      replaces them wherever it is nonzero, LABEL_UNDER only fills in where
+      they are zero */
+
+typedef  enum  { LABEL_OVER, LABEL_UNDER }  Label_merge_rules;
+
+#ifndef  public
+#define       public   extern
+#define       public_was_defined_here
+#endif
+
+#include  <label_algebra_prototypes.h>
+
+#ifdef  public_was_defined_here
+#undef       public
+#undef       public_was_defined_here
+#endif
+
+#endif
@@ -0,0 +1,56 @@
+#ifndef  DEF_LABEL_ALGEBRA_PROTOTYPES
+#define  DEF_LABEL_ALGEBRA_PROTOTYPES
+
+public  void  initialize_label_remap(
+    label_remap_struct  *remap );
+
+public  void  delete_label_remap(
+    label_remap_struct  *remap );
+
+public  void  set_label_remap_value(
+    label_remap_struct  *remap,
+    int                 from,
+    int                 to );
+
+public  void  set_label_remap_unmapped(
+    label_remap_struct  *remap,
+    int                 unmapped_value );
+
+public  int  get_label_remap_value(
+    label_remap_struct  *remap,
+    int                 label );
+
+public  Status  input_label_remap(
+    STRING              filename,
+    label_remap_struct  *remap );
+
+public  void  get_label_remap_range(
+    label_remap_struct  *remap,
+    int                 min_label,
+    int                 max_label,
+    int                 *min_result,
+    int                 *max_result );
+
+public  void  remap_label_values(
+    label_remap_struct  *remap,
+    int                 n_values,
+    Real                values[] );
+
+public  void  get_voxel_span_labels(
+    label_remap_struct  *remap,
+    voxel_span_struct   *span,
+    int                 labels[] );
+
+public  void  merge_labels(
+    Label_merge_rules  rule,
+    int                n_labels,
+    int                labels[],
+    int                new_labels[] );
+
+public  Status  merge_label_volumes(
+    int                 n_volumes,
+    Volume              volumes[],
+    label_remap_struct  *remaps[],
+    Label_merge_rules   rules[],
+    Volume              output );
+#endif
@@ -1,5 +1,6 @@
 #include  <volume_io/internal_volume_io.h>
 #include  <bicpl.h>
+#include  <winding_number.h>
 
 #define  TOLERANCE  1.0e-2
 
@@ -10,12 +11,17 @@ private  void   label_inside_convex_hull(
     object_struct    *object,
     int              value_to_set );
 
+private  void   label_inside_by_winding(
+    Volume           volume,
+    object_struct    *object,
+    int              value_to_set );
+
 int  main(
     int   argc,
     char  *argv[] )
 {
     char                 *input_volume_filename, *input_surface_filename;
-    char                 *output_volume_filename;
+    char                 *output_volume_filename, *method;
     int                  n_objects;
     Real                 value_to_set;
     STRING               history;
@@ -31,10 +37,12 @@ int  main(
     {
         print( "Usage: %s  in_volume.mnc  in_surface.obj  out_volume.mnc\n",
                argv[0] );
+        print( "      [value_to_set] [rays|winding]\n" );
         return( 1 );
     }
 
     (void) get_real_argument( 1.0, &value_to_set );
+    (void) get_string_argument( "rays", &method );
 
     if( input_volume( input_volume_filename, 3, XYZ_dimension_names,
                       NC_UNSPECIFIED, FALSE, 0.0, 0.0,
@@ -51,14 +59,19 @@ int  main(
         return( 1 );
     }
 
-    label_inside_convex_hull( volume, objects[0], (Real) value_to_set );
+    if( equal_strings( method, "winding" ) )
+        label_inside_by_winding( volume, objects[0], (int) value_to_set );
+    else
+        label_inside_convex_hull( volume, objects[0], (Real) value_to_set );
 
-    (void) strcpy( history, "Inside surface labeled." );
+    history = create_string( "Inside surface labeled.\n" );
 
     (void) output_volume( output_volume_filename, NC_UNSPECIFIED,
                           FALSE, 0.0, 0.0, volume, history,
                           (minc_output_options *) NULL );
 
+    delete_string( history );
+
     delete_volume( volume );
 
     return( 0 );
@@ -264,3 +277,96 @@ private  void   label_inside_convex_hull(
     FREE2D( enter_dist );
     FREE2D( exit_dist );
 }
+
+/* ----------------------------- MNI Header -----------------------------------
+@NAME       : label_inside_by_winding
+@INPUT      : volume
+              object
+              value_to_set
+@OUTPUT     :
+@RETURNS    :
+@DESCRIPTION: Labels the voxels inside the surface by its generalized winding
+              number, which is robust to holes and self intersections,
+              and need not be convex.  Each row of voxels along z is
+              evaluated as one batch.
+@METHOD     :
+@GLOBALS    :
+@CALLS      :
+@CREATED    :
+@MODIFIED   :
+---------------------------------------------------------------------------- */
+
+private  void   label_inside_by_winding(
+    Volume           volume,
+    object_struct    *object,
+    int              value_to_set )
+{
+    int                  x, y, z, dim, sizes[MAX_DIMENSIONS], n_set;
+    Real                 voxel[MAX_DIMENSIONS], start[N_DIMENSIONS];
+    Real                 step[N_DIMENSIONS], max_value, value;
+    Real                 (*points)[N_DIMENSIONS], *winding;
+    Real                 xw, yw, zw;
+    winding_tree         tree;
+
+    max_value = get_volume_real_max( volume );
+
+    tree = create_winding_tree( get_polygons_ptr( object ), 2.0 );
+
+    get_volume_sizes( volume, sizes );
+
+    ALLOC( points, sizes[Z] );
+    ALLOC( winding, sizes[Z] );
+
+    n_set = 0;
+
+    for_less( x, 0, sizes[X] )
+    {
+        voxel[X] = (Real) x;
+        for_less( y, 0, sizes[Y] )
+        {
+            voxel[Y] = (Real) y;
+
+            /*--- the row is a straight line in world space */
+
+            voxel[Z] = 0.0;
+            convert_voxel_to_world( volume, voxel, &xw, &yw, &zw );
+            start[X] = xw;
+            start[Y] = yw;
+            start[Z] = zw;
+
+            voxel[Z] = 1.0;
+            convert_voxel_to_world( volume, voxel, &xw, &yw, &zw );
+            step[X] = xw - start[X];
+            step[Y] = yw - start[Y];
+            step[Z] = zw - start[Z];
+
+            for_less( z, 0, sizes[Z] )
+            {
+                for_less( dim, 0, N_DIMENSIONS )
+                    points[z][dim] = start[dim] + (Real) z * step[dim];
+            }
+
+            evaluate_winding_numbers( tree, sizes[Z], points, winding );
+
+            for_less( z, 0, sizes[Z] )
+            {
+                if( FABS( winding[z] ) >= 0.5 )
+                {
+                    value = get_volume_real_value( volume, x, y, z, 0, 0);
+                    value = (int) value | value_to_set;
+                    if( value > max_value )
+                        value = max_value;
+                    set_volume_real_value( volume, x, y, z, 0, 0, value);
+                    ++n_set;
+                }
+            }
+        }
+    }
+
+    print( "Set %d out of %d\n", n_set, sizes[X] * sizes[Y] * sizes[Z] );
+
+    FREE( points );
+    FREE( winding );
+
+    delete_winding_tree( tree );
+}
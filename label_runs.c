@@ -0,0 +1,339 @@
+#include  <volume_io/internal_volume_io.h>
+#include  <label_runs.h>
+#include  <voxel_scan.h>
+
+public  void  initialize_label_runs(
+    label_runs_struct  *runs,
+    int                sizes[] )
+{
+    int   dim, row, n_rows;
+
+    for_less( dim, 0, N_DIMENSIONS )
+        runs->sizes[dim] = sizes[dim];
+
+    n_rows = sizes[X] * sizes[Y];
+
+    ALLOC( runs->n_runs, n_rows );
+    ALLOC( runs->runs, n_rows );
+
+    for_less( row, 0, n_rows )
+    {
+        runs->n_runs[row] = 0;
+        runs->runs[row] = NULL;
+    }
+}
+
+public  void  delete_label_runs(
+    label_runs_struct  *runs )
+{
+    int   row;
+
+    for_less( row, 0, runs->sizes[X] * runs->sizes[Y] )
+    {
+        if( runs->runs[row] != NULL )
+        {
+            FREE( runs->runs[row] );
+        }
+    }
+
+    FREE( runs->n_runs );
+    FREE( runs->runs );
+}
+
+/*--- returns the number of runs in the row, and a pointer to them */
+
+public  int  get_label_runs_row(
+    label_runs_struct  *runs,
+    int                x,
+    int                y,
+    label_run_struct   *row_runs[] )
+{
+    int   row;
+
+    row = x * runs->sizes[Y] + y;
+
+    *row_runs = runs->runs[row];
+
+    return( runs->n_runs[row] );
+}
+
+public  int  get_label_runs_value(
+    label_runs_struct  *runs,
+    int                x,
+    int                y,
+    int                z )
+{
+    int                low, high, mid, n_runs;
+    label_run_struct   *row_runs;
+
+    n_runs = get_label_runs_row( runs, x, y, &row_runs );
+
+    low = 0;
+    high = n_runs;
+
+    while( low < high )
+    {
+        mid = (low + high) / 2;
+        if( z < row_runs[mid].start )
+            high = mid;
+        else if( z >= row_runs[mid].end )
+            low = mid + 1;
+        else
+            return( row_runs[mid].label );
+    }
+
+    return( 0 );
+}
+
+/*--- appends a run to a row being built, joining it to the previous run if
+      they touch and have the same label */
+
+private  void  append_run(
+    label_run_struct   new_runs[],
+    int                *n_new,
+    int                start,
+    int                end,
+    int                label )
+{
+    if( start >= end || label == 0 )
+        return;
+
+    if( *n_new > 0 && new_runs[*n_new-1].end == start &&
+        new_runs[*n_new-1].label == label )
+    {
+        new_runs[*n_new-1].end = end;
+    }
+    else
+    {
+        new_runs[*n_new].start = start;
+        new_runs[*n_new].end = end;
+        new_runs[*n_new].label = label;
+        ++(*n_new);
+    }
+}
+
+/* ----------------------------- MNI Header -----------------------------------
+@NAME       : set_label_runs_range
+@INPUT      : runs
+              x
+              y
+              start
+              end
+              label
+@OUTPUT     : runs
+@RETURNS    :
+@DESCRIPTION: Sets voxels start to end-1 of the row to the label, splitting
+              and joining the runs of the row as needed.
+@METHOD     :
+@GLOBALS    :
+@CALLS      :
+@CREATED    :
+@MODIFIED   :
+---------------------------------------------------------------------------- */
+
+public  void  set_label_runs_range(
+    label_runs_struct  *runs,
+    int                x,
+    int                y,
+    int                start,
+    int                end,
+    int                label )
+{
+    int                row, r, n_runs, n_new;
+    label_run_struct   *row_runs, *new_runs;
+
+    start = MAX( start, 0 );
+    end = MIN( end, runs->sizes[Z] );
+
+    if( start >= end )
+        return;
+
+    row = x * runs->sizes[Y] + y;
+    n_runs = runs->n_runs[row];
+    row_runs = runs->runs[row];
+
+    ALLOC( new_runs, n_runs + 2 );
+    n_new = 0;
+
+    r = 0;
+    while( r < n_runs && row_runs[r].start < start )
+    {
+        append_run( new_runs, &n_new, row_runs[r].start,
+                    MIN( row_runs[r].end, start ), row_runs[r].label );
+        if( row_runs[r].end > end )
+            break;
+        ++r;
+    }
+
+    append_run( new_runs, &n_new, start, end, label );
+
+    for( ;  r < n_runs;  ++r )
+    {
+        if( row_runs[r].end > end )
+        {
+            append_run( new_runs, &n_new, MAX( row_runs[r].start, end ),
+                        row_runs[r].end, row_runs[r].label );
+        }
+    }
+
+    if( row_runs != NULL )
+    {
+        FREE( row_runs );
+    }
+
+    if( n_new == 0 )
+    {
+        FREE( new_runs );
+        runs->runs[row] = NULL;
+    }
+    else
+    {
+        REALLOC( new_runs, n_new );
+        runs->runs[row] = new_runs;
+    }
+
+    runs->n_runs[row] = n_new;
+}
+
+public  void  set_label_runs_value(
+    label_runs_struct  *runs,
+    int                x,
+    int                y,
+    int                z,
+    int                label )
+{
+    if( get_label_runs_value( runs, x, y, z ) != label )
+        set_label_runs_range( runs, x, y, z, z+1, label );
+}
+
+/* ----------------------------- MNI Header -----------------------------------
+@NAME       : load_label_runs
+@INPUT      : filename
+              volume
+@OUTPUT     : runs
+@RETURNS    : OK or ERROR
+@DESCRIPTION: Creates the runs, on the grid of volume, of the labels in a 3D
+              label file on any grid.  The file is read a slice at a time,
+              and each file voxel sets the rounded real value at the voxel
+              of volume nearest its centre, later voxels overwriting earlier
+              ones, as load_label_volume() does.  Neither the file nor the
+              resampled labels are ever held as a whole volume.
+@METHOD     : The voxel to world transforms are linear, so the target voxel
+              moves by a constant step along each file dimension.
+@GLOBALS    :
+@CALLS      :
+@CREATED    :
+@MODIFIED   :
+---------------------------------------------------------------------------- */
+
+public  Status  load_label_runs(
+    STRING             filename,
+    Volume             volume,
+    label_runs_struct  *runs )
+{
+    int                i, v, dim, label, start, n_span;
+    int                voxel[N_DIMENSIONS];
+    int                sizes[MAX_DIMENSIONS], file_sizes[MAX_DIMENSIONS];
+    Real               xw, yw, zw, amount_done, *values;
+    Real               file_voxel[MAX_DIMENSIONS], origin[N_DIMENSIONS];
+    Real               target[MAX_DIMENSIONS];
+    Real               step[N_DIMENSIONS][N_DIMENSIONS];
+    BOOLEAN            inside;
+    STRING             *dim_names;
+    Volume             header, slice;
+    Minc_file          file;
+    voxel_scan_struct  scan;
+
+    if( input_volume_header_only( filename, 3, File_order_dimension_names,
+                                  &header, (minc_input_options *) NULL )
+                                  != OK )
+        return( ERROR );
+
+    get_volume_sizes( volume, sizes );
+    get_volume_sizes( header, file_sizes );
+
+    /*--- the target voxel of the first file voxel, and its steps along each
+          file dimension */
+
+    for_less( dim, 0, N_DIMENSIONS )
+        file_voxel[dim] = 0.0;
+
+    convert_voxel_to_world( header, file_voxel, &xw, &yw, &zw );
+    convert_world_to_voxel( volume, xw, yw, zw, target );
+
+    for_less( dim, 0, N_DIMENSIONS )
+        origin[dim] = target[dim];
+
+    for_less( i, 0, N_DIMENSIONS )
+    {
+        file_voxel[i] = 1.0;
+        convert_voxel_to_world( header, file_voxel, &xw, &yw, &zw );
+        convert_world_to_voxel( volume, xw, yw, zw, target );
+        file_voxel[i] = 0.0;
+
+        for_less( dim, 0, N_DIMENSIONS )
+            step[i][dim] = target[dim] - origin[dim];
+    }
+
+    dim_names = get_volume_dimension_names( header );
+    slice = create_volume( 2, &dim_names[1], NC_UNSPECIFIED, FALSE,
+                           0.0, 0.0 );
+    delete_dimension_names( header, dim_names );
+    delete_volume( header );
+
+    file = initialize_minc_input( filename, slice,
+                                  (minc_input_options *) NULL );
+
+    if( file == (Minc_file) NULL )
+    {
+        delete_volume( slice );
+        return( ERROR );
+    }
+
+    initialize_label_runs( runs, sizes );
+
+    for_less( i, 0, file_sizes[0] )
+    {
+        while( input_more_minc_file( file, &amount_done ) )
+        {}
+
+        initialize_voxel_scan( &scan, slice, 0 );
+
+        while( get_next_voxel_span_values( &scan, TRUE, &start, &n_span,
+                                           &values ) )
+        {
+            for_less( v, 0, n_span )
+            {
+                inside = TRUE;
+                for_less( dim, 0, N_DIMENSIONS )
+                {
+                    voxel[dim] = ROUND( origin[dim] +
+                                 (Real) i * step[0][dim] +
+                                 (Real) ((start+v) / file_sizes[2]) *
+                                 step[1][dim] +
+                                 (Real) ((start+v) % file_sizes[2]) *
+                                 step[2][dim] );
+
+                    if( voxel[dim] < 0 || voxel[dim] >= sizes[dim] )
+                        inside = FALSE;
+                }
+
+                if( inside )
+                {
+                    label = ROUND( values[v] );
+                    set_label_runs_value( runs, voxel[X], voxel[Y],
+                                          voxel[Z], label );
+                }
+            }
+        }
+
+        delete_voxel_scan( &scan );
+
+        (void) advance_input_volume( file );
+    }
+
+    (void) close_minc_input( file );
+    delete_volume( slice );
+
+    return( OK );
+}
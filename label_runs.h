@@ -0,0 +1,39 @@
+#ifndef  DEF_LABEL_RUNS_H
+#define  DEF_LABEL_RUNS_H
+
+#include  <bicpl.h>
+
+/*--- a compact form of 3D label volumes, held as rows along the last
+      dimension, row x * sizes[Y] + y.
+
+      label_runs_struct keeps, for each row, the runs of voxels with the
+      same nonzero label in increasing order, voxels start to end-1 of the
+      row having the label and voxels outside all runs being zero. */
+
+typedef  struct
+{
+    int    start;
+    int    end;
+    int    label;
+} label_run_struct;
+
+typedef  struct
+{
+    int                sizes[N_DIMENSIONS];
+    int                *n_runs;
+    label_run_struct   **runs;
+} label_runs_struct;
+
+#ifndef  public
+#define       public   extern
+#define       public_was_defined_here
+#endif
+
+#include  <label_runs_prototypes.h>
+
+#ifdef  public_was_defined_here
+#undef       public
+#undef       public_was_defined_here
+#endif
+
+#endif
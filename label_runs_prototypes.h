@@ -0,0 +1,42 @@
+#ifndef  DEF_LABEL_RUNS_PROTOTYPES
+#define  DEF_LABEL_RUNS_PROTOTYPES
+
+public  void  initialize_label_runs(
+    label_runs_struct  *runs,
+    int                sizes[] );
+
+public  void  delete_label_runs(
+    label_runs_struct  *runs );
+
+public  int  get_label_runs_row(
+    label_runs_struct  *runs,
+    int                x,
+    int                y,
+    label_run_struct   *row_runs[] );
+
+public  int  get_label_runs_value(
+    label_runs_struct  *runs,
+    int                x,
+    int                y,
+    int                z );
+
+public  void  set_label_runs_range(
+    label_runs_struct  *runs,
+    int                x,
+    int                y,
+    int                start,
+    int                end,
+    int                label );
+
+public  void  set_label_runs_value(
+    label_runs_struct  *runs,
+    int                x,
+    int                y,
+    int                z,
+    int                label );
+
+public  Status  load_label_runs(
+    STRING             filename,
+    Volume             volume,
+    label_runs_struct  *runs );
+#endif
@@ -0,0 +1,674 @@
+#include  <volume_io/internal_volume_io.h>
+#include  <lbfgs_min.h>
+
+#define  DEFAULT_N_CORRECTIONS    7
+
+/*--- line search constants: sufficient decrease, curvature condition,
+      relative width of the interval of uncertainty, and step limits */
+
+#define  FTOL                     1.0e-4
+#define  GTOL                     0.9
+#define  XTOL                     1.0e-16
+#define  MIN_STEP                 1.0e-20
+#define  MAX_STEP                 1.0e20
+#define  MAX_LINE_EVALUATIONS     20
+
+struct  lbfgs_min_struct
+{
+    int              n_parameters;
+    Real             *parameters;
+    Real             *derivative;
+    Real             *direction;
+    Real             *test_parameters;
+    Real             *test_derivative;
+    Real             current_value;
+    Real             (*function) ( Real [], void * );
+    void             (*deriv_function) ( Real [], void *, Real [] );
+    void             *function_data;
+    Real             termination_range_tolerance;
+    Real             termination_domain_tolerance;
+    int              n_iterations;
+    int              max_iterations;
+    int              n_evaluations;
+    int              n_deriv_evaluations;
+    int              n_restarts;
+
+    int              max_corrections;
+    int              n_corrections;
+    int              newest_correction;
+    Real             **s;
+    Real             **y;
+    Real             *rho;
+    Real             *alpha;
+};
+
+private  Real  evaluate_function(
+    lbfgs_min   lbfgs,
+    Real        parameters[] )
+{
+    ++lbfgs->n_evaluations;
+    return( (*lbfgs->function) ( parameters, lbfgs->function_data ) );
+}
+
+private  void  evaluate_derivative(
+    lbfgs_min   lbfgs,
+    Real        parameters[],
+    Real        deriv[] )
+{
+    ++lbfgs->n_deriv_evaluations;
+    (*lbfgs->deriv_function) ( parameters, lbfgs->function_data, deriv );
+}
+
+private  Real  dot_product(
+    int    n,
+    Real   a[],
+    Real   b[] )
+{
+    int    i;
+    Real   sum;
+
+    sum = 0.0;
+    for_less( i, 0, n )
+        sum += a[i] * b[i];
+
+    return( sum );
+}
+
+public   lbfgs_min  lbfgs_min_initialize(
+    int                    n_parameters,
+    Real                   initial[],
+    Real                   (*function) ( Real [], void * ),
+    void                   (*deriv_function) ( Real [], void *, Real [] ),
+    void                   *function_data,
+    Real                   termination_range_tolerance,
+    Real                   termination_domain_tolerance,
+    int                    n_corrections,
+    int                    max_iterations,
+    Real                   *current_value )
+{
+    int               parm;
+    lbfgs_min         lbfgs;
+
+    ALLOC( lbfgs, 1 );
+
+    if( n_corrections <= 0 )
+        n_corrections = DEFAULT_N_CORRECTIONS;
+
+    lbfgs->n_parameters = n_parameters;
+    if( n_parameters > 0 )
+    {
+        ALLOC( lbfgs->parameters, n_parameters );
+        ALLOC( lbfgs->derivative, n_parameters );
+        ALLOC( lbfgs->direction, n_parameters );
+        ALLOC( lbfgs->test_parameters, n_parameters );
+        ALLOC( lbfgs->test_derivative, n_parameters );
+        ALLOC2D( lbfgs->s, n_corrections, n_parameters );
+        ALLOC2D( lbfgs->y, n_corrections, n_parameters );
+    }
+    ALLOC( lbfgs->rho, n_corrections );
+    ALLOC( lbfgs->alpha, n_corrections );
+
+    for_less( parm, 0, n_parameters )
+        lbfgs->parameters[parm] = initial[parm];
+    lbfgs->function = function;
+    lbfgs->deriv_function = deriv_function;
+    lbfgs->function_data = function_data;
+    lbfgs->termination_range_tolerance = termination_range_tolerance;
+    lbfgs->termination_domain_tolerance = termination_domain_tolerance;
+    lbfgs->n_iterations = 0;
+    lbfgs->max_iterations = max_iterations;
+    lbfgs->n_evaluations = 0;
+    lbfgs->n_deriv_evaluations = 0;
+    lbfgs->n_restarts = 0;
+    lbfgs->max_corrections = n_corrections;
+    lbfgs->n_corrections = 0;
+    lbfgs->newest_correction = -1;
+
+    lbfgs->current_value = evaluate_function( lbfgs, lbfgs->parameters );
+
+    if( n_parameters > 0 )
+        evaluate_derivative( lbfgs, lbfgs->parameters, lbfgs->derivative );
+
+    if( current_value != NULL )
+        *current_value = lbfgs->current_value;
+
+    return( lbfgs );
+}
+
+/*--- two-loop recursion:  direction = - H * derivative, where H is the
+      inverse Hessian approximation built from the stored corrections */
+
+private  void  get_search_direction(
+    lbfgs_min   lbfgs )
+{
+    int    i, k, c, n;
+    Real   beta, gamma, *dir;
+
+    n = lbfgs->n_parameters;
+    dir = lbfgs->direction;
+
+    for_less( i, 0, n )
+        dir[i] = -lbfgs->derivative[i];
+
+    c = lbfgs->newest_correction;
+    for_less( k, 0, lbfgs->n_corrections )
+    {
+        lbfgs->alpha[c] = lbfgs->rho[c] * dot_product( n, lbfgs->s[c], dir );
+        for_less( i, 0, n )
+            dir[i] -= lbfgs->alpha[c] * lbfgs->y[c][i];
+        c = (c - 1 + lbfgs->max_corrections) % lbfgs->max_corrections;
+    }
+
+    if( lbfgs->n_corrections > 0 )
+    {
+        c = lbfgs->newest_correction;
+        gamma = 1.0 / (lbfgs->rho[c] *
+                       dot_product( n, lbfgs->y[c], lbfgs->y[c] ));
+        for_less( i, 0, n )
+            dir[i] *= gamma;
+    }
+
+    c = (lbfgs->newest_correction - lbfgs->n_corrections + 1 +
+         lbfgs->max_corrections) % lbfgs->max_corrections;
+    for_less( k, 0, lbfgs->n_corrections )
+    {
+        beta = lbfgs->rho[c] * dot_product( n, lbfgs->y[c], dir );
+        for_less( i, 0, n )
+            dir[i] += (lbfgs->alpha[c] - beta) * lbfgs->s[c][i];
+        c = (c + 1) % lbfgs->max_corrections;
+    }
+}
+
+/* ----------------------------- MNI Header -----------------------------------
+@NAME       : update_step_interval
+@INPUT      : stx, fx, dx  - step with the least function value so far
+              sty, fy, dy  - other end of the interval of uncertainty
+              stp, fp, dp  - current step
+              bracketed    - whether the minimum is bracketed
+              min_step
+              max_step
+@OUTPUT     : updated interval, new trial step in stp
+@RETURNS    : FALSE if the inputs are inconsistent
+@DESCRIPTION: Safeguarded cubic/quadratic step selection of More and Thuente,
+              "Line search algorithms with guaranteed sufficient decrease",
+              ACM TOMS 20(3), 1994.
+@METHOD     :
+@GLOBALS    :
+@CALLS      :
+@CREATED    :
+@MODIFIED   :
+---------------------------------------------------------------------------- */
+
+private  BOOLEAN  update_step_interval(
+    Real      *stx,
+    Real      *fx,
+    Real      *dx,
+    Real      *sty,
+    Real      *fy,
+    Real      *dy,
+    Real      *stp,
+    Real      fp,
+    Real      dp,
+    BOOLEAN   *bracketed,
+    Real      min_step,
+    Real      max_step )
+{
+    BOOLEAN  bound;
+    Real     sgnd, theta, s, gamma, p, q, r, stpc, stpq, stpf;
+
+    if( (*bracketed && (*stp <= MIN( *stx, *sty ) ||
+                        *stp >= MAX( *stx, *sty ))) ||
+        *dx * (*stp - *stx) >= 0.0 || max_step < min_step )
+        return( FALSE );
+
+    sgnd = dp * (*dx / FABS( *dx ));
+
+    if( fp > *fx )
+    {
+        /*--- higher function value: the minimum is bracketed */
+
+        bound = TRUE;
+        theta = 3.0 * (*fx - fp) / (*stp - *stx) + *dx + dp;
+        s = MAX3( FABS(theta), FABS(*dx), FABS(dp) );
+        gamma = s * sqrt( (theta/s) * (theta/s) - (*dx/s) * (dp/s) );
+        if( *stp < *stx )
+            gamma = -gamma;
+        p = (gamma - *dx) + theta;
+        q = ((gamma - *dx) + gamma) + dp;
+        r = p / q;
+        stpc = *stx + r * (*stp - *stx);
+        stpq = *stx + ((*dx / ((*fx - fp) / (*stp - *stx) + *dx)) / 2.0) *
+                      (*stp - *stx);
+        if( FABS( stpc - *stx ) < FABS( stpq - *stx ) )
+            stpf = stpc;
+        else
+            stpf = stpc + (stpq - stpc) / 2.0;
+        *bracketed = TRUE;
+    }
+    else if( sgnd < 0.0 )
+    {
+        /*--- derivatives of opposite sign: the minimum is bracketed */
+
+        bound = FALSE;
+        theta = 3.0 * (*fx - fp) / (*stp - *stx) + *dx + dp;
+        s = MAX3( FABS(theta), FABS(*dx), FABS(dp) );
+        gamma = s * sqrt( (theta/s) * (theta/s) - (*dx/s) * (dp/s) );
+        if( *stp > *stx )
+            gamma = -gamma;
+        p = (gamma - dp) + theta;
+        q = ((gamma - dp) + gamma) + *dx;
+        r = p / q;
+        stpc = *stp + r * (*stx - *stp);
+        stpq = *stp + (dp / (dp - *dx)) * (*stx - *stp);
+        if( FABS( stpc - *stp ) > FABS( stpq - *stp ) )
+            stpf = stpc;
+        else
+            stpf = stpq;
+        *bracketed = TRUE;
+    }
+    else if( FABS( dp ) < FABS( *dx ) )
+    {
+        /*--- same sign, derivative decreasing in magnitude */
+
+        bound = TRUE;
+        theta = 3.0 * (*fx - fp) / (*stp - *stx) + *dx + dp;
+        s = MAX3( FABS(theta), FABS(*dx), FABS(dp) );
+        gamma = s * sqrt( MAX( 0.0, (theta/s) * (theta/s) - (*dx/s) * (dp/s) ));
+        if( *stp > *stx )
+            gamma = -gamma;
+        p = (gamma - dp) + theta;
+        q = (gamma + (*dx - dp)) + gamma;
+        r = p / q;
+        if( r < 0.0 && gamma != 0.0 )
+            stpc = *stp + r * (*stx - *stp);
+        else if( *stp > *stx )
+            stpc = max_step;
+        else
+            stpc = min_step;
+        stpq = *stp + (dp / (dp - *dx)) * (*stx - *stp);
+
+        if( *bracketed )
+        {
+            if( FABS( *stp - stpc ) < FABS( *stp - stpq ) )
+                stpf = stpc;
+            else
+                stpf = stpq;
+        }
+        else
+        {
+            if( FABS( *stp - stpc ) > FABS( *stp - stpq ) )
+                stpf = stpc;
+            else
+                stpf = stpq;
+        }
+    }
+    else
+    {
+        /*--- same sign, derivative not decreasing in magnitude */
+
+        bound = FALSE;
+        if( *bracketed )
+        {
+            theta = 3.0 * (fp - *fy) / (*sty - *stp) + *dy + dp;
+            s = MAX3( FABS(theta), FABS(*dy), FABS(dp) );
+            gamma = s * sqrt( (theta/s) * (theta/s) - (*dy/s) * (dp/s) );
+            if( *stp > *sty )
+                gamma = -gamma;
+            p = (gamma - dp) + theta;
+            q = ((gamma - dp) + gamma) + *dy;
+            r = p / q;
+            stpf = *stp + r * (*sty - *stp);
+        }
+        else if( *stp > *stx )
+            stpf = max_step;
+        else
+            stpf = min_step;
+    }
+
+    /*--- update the interval of uncertainty */
+
+    if( fp > *fx )
+    {
+        *sty = *stp;
+        *fy = fp;
+        *dy = dp;
+    }
+    else
+    {
+        if( sgnd < 0.0 )
+        {
+            *sty = *stx;
+            *fy = *fx;
+            *dy = *dx;
+        }
+        *stx = *stp;
+        *fx = fp;
+        *dx = dp;
+    }
+
+    stpf = MIN( max_step, stpf );
+    stpf = MAX( min_step, stpf );
+    *stp = stpf;
+
+    if( *bracketed && bound )
+    {
+        if( *sty > *stx )
+            *stp = MIN( *stx + 0.66 * (*sty - *stx), *stp );
+        else
+            *stp = MAX( *stx + 0.66 * (*sty - *stx), *stp );
+    }
+
+    return( TRUE );
+}
+
+/*--- searches along lbfgs->direction from lbfgs->parameters for a step
+      satisfying the strong Wolfe conditions, leaving the point, its value
+      and derivative in the test arrays; returns FALSE if no such step was
+      found with a lower function value */
+
+private  BOOLEAN  line_search(
+    lbfgs_min   lbfgs,
+    Real        step,
+    Real        *new_value )
+{
+    int       i, n, n_evals;
+    BOOLEAN   bracketed, stage1, ok, converged;
+    Real      dginit, dgtest, dg, f, ftest, width, prev_width;
+    Real      stx, fx, dgx, sty, fy, dgy, stmin, stmax;
+    Real      fm, fxm, fym, dgm, dgxm, dgym;
+
+    n = lbfgs->n_parameters;
+
+    dginit = dot_product( n, lbfgs->derivative, lbfgs->direction );
+    if( dginit >= 0.0 )
+        return( FALSE );
+
+    bracketed = FALSE;
+    stage1 = TRUE;
+    ok = TRUE;
+    converged = FALSE;
+    dgtest = FTOL * dginit;
+    width = MAX_STEP - MIN_STEP;
+    prev_width = 2.0 * width;
+
+    stx = 0.0;
+    fx = lbfgs->current_value;
+    dgx = dginit;
+    sty = 0.0;
+    fy = lbfgs->current_value;
+    dgy = dginit;
+
+    f = lbfgs->current_value;
+
+    for( n_evals = 0;  n_evals < MAX_LINE_EVALUATIONS;  ++n_evals )
+    {
+        if( bracketed )
+        {
+            stmin = MIN( stx, sty );
+            stmax = MAX( stx, sty );
+        }
+        else
+        {
+            stmin = stx;
+            stmax = step + 4.0 * (step - stx);
+        }
+
+        step = MAX( step, MIN_STEP );
+        step = MIN( step, MAX_STEP );
+
+        if( (bracketed && (step <= stmin || step >= stmax)) || !ok ||
+            n_evals == MAX_LINE_EVALUATIONS - 1 ||
+            (bracketed && stmax - stmin <= XTOL * stmax) )
+            step = stx;
+
+        for_less( i, 0, n )
+            lbfgs->test_parameters[i] = lbfgs->parameters[i] +
+                                        step * lbfgs->direction[i];
+
+        f = evaluate_function( lbfgs, lbfgs->test_parameters );
+        evaluate_derivative( lbfgs, lbfgs->test_parameters,
+                             lbfgs->test_derivative );
+
+        dg = dot_product( n, lbfgs->test_derivative, lbfgs->direction );
+        ftest = lbfgs->current_value + step * dgtest;
+
+        if( f <= ftest && FABS( dg ) <= -GTOL * dginit )
+        {
+            converged = TRUE;
+            break;
+        }
+
+        if( (bracketed && (step <= stmin || step >= stmax)) || !ok ||
+            (bracketed && stmax - stmin <= XTOL * stmax) ||
+            (step == MAX_STEP && f <= ftest && dg <= dgtest) ||
+            (step == MIN_STEP && (f > ftest || dg >= dgtest)) )
+            break;
+
+        if( stage1 && f <= ftest && dg >= MIN( FTOL, GTOL ) * dginit )
+            stage1 = FALSE;
+
+        /*--- in the first stage use the modified function, which has
+              a minimum where the sufficient decrease condition holds */
+
+        if( stage1 && f <= fx && f > ftest )
+        {
+            fm = f - step * dgtest;
+            fxm = fx - stx * dgtest;
+            fym = fy - sty * dgtest;
+            dgm = dg - dgtest;
+            dgxm = dgx - dgtest;
+            dgym = dgy - dgtest;
+
+            ok = update_step_interval( &stx, &fxm, &dgxm, &sty, &fym, &dgym,
+                                       &step, fm, dgm, &bracketed,
+                                       stmin, stmax );
+
+            fx = fxm + stx * dgtest;
+            fy = fym + sty * dgtest;
+            dgx = dgxm + dgtest;
+            dgy = dgym + dgtest;
+        }
+        else
+        {
+            ok = update_step_interval( &stx, &fx, &dgx, &sty, &fy, &dgy,
+                                       &step, f, dg, &bracketed,
+                                       stmin, stmax );
+        }
+
+        if( bracketed )
+        {
+            if( FABS( sty - stx ) >= 0.66 * prev_width )
+                step = stx + 0.5 * (sty - stx);
+            prev_width = width;
+            width = FABS( sty - stx );
+        }
+    }
+
+    *new_value = f;
+
+    return( converged || f < lbfgs->current_value );
+}
+
+public  BOOLEAN  lbfgs_min_do_one_iteration(
+    lbfgs_min         lbfgs,
+    Real              *resulting_value )
+{
+    int      i, n, c;
+    BOOLEAN  success;
+    Real     new_value, max_movement, sy, step, len;
+
+    if( lbfgs->max_iterations >= 0 &&
+        lbfgs->n_iterations >= lbfgs->max_iterations )
+        return( FALSE );
+
+    ++lbfgs->n_iterations;
+
+    n = lbfgs->n_parameters;
+
+    get_search_direction( lbfgs );
+
+    if( dot_product( n, lbfgs->direction, lbfgs->derivative ) >= 0.0 )
+    {
+        lbfgs->n_corrections = 0;
+        get_search_direction( lbfgs );
+    }
+
+    /*--- without curvature information, take a unit length first step */
+
+    if( lbfgs->n_corrections == 0 )
+    {
+        len = sqrt( dot_product( n, lbfgs->direction, lbfgs->direction ) );
+        if( len == 0.0 )
+            return( FALSE );
+        step = 1.0 / len;
+    }
+    else
+        step = 1.0;
+
+    success = line_search( lbfgs, step, &new_value );
+
+    if( !success )
+    {
+        /*--- discard the curvature history and try steepest descent once */
+
+        if( lbfgs->n_corrections > 0 )
+        {
+            lbfgs->n_corrections = 0;
+            ++lbfgs->n_restarts;
+            success = TRUE;
+        }
+
+        if( resulting_value != NULL )
+            *resulting_value = lbfgs->current_value;
+
+        return( success );
+    }
+
+    max_movement = 0.0;
+    c = (lbfgs->newest_correction + 1) % lbfgs->max_corrections;
+
+    for_less( i, 0, n )
+    {
+        lbfgs->s[c][i] = lbfgs->test_parameters[i] - lbfgs->parameters[i];
+        lbfgs->y[c][i] = lbfgs->test_derivative[i] - lbfgs->derivative[i];
+        max_movement = MAX( max_movement, FABS( lbfgs->s[c][i] ) );
+        lbfgs->parameters[i] = lbfgs->test_parameters[i];
+        lbfgs->derivative[i] = lbfgs->test_derivative[i];
+    }
+
+    sy = dot_product( n, lbfgs->s[c], lbfgs->y[c] );
+
+    if( sy > 0.0 )
+    {
+        lbfgs->rho[c] = 1.0 / sy;
+        lbfgs->newest_correction = c;
+        if( lbfgs->n_corrections < lbfgs->max_corrections )
+            ++lbfgs->n_corrections;
+    }
+
+    if( lbfgs->current_value - new_value <=
+                           lbfgs->termination_range_tolerance &&
+        max_movement <= lbfgs->termination_domain_tolerance )
+    {
+        success = FALSE;
+    }
+
+    lbfgs->current_value = new_value;
+
+    if( resulting_value != NULL )
+        *resulting_value = lbfgs->current_value;
+
+    return( success );
+}
+
+public  void  lbfgs_min_get_current_position(
+    lbfgs_min         lbfgs,
+    Real              parameters[] )
+{
+    int    parm;
+
+    for_less( parm, 0, lbfgs->n_parameters )
+        parameters[parm] = lbfgs->parameters[parm];
+}
+
+public  int  lbfgs_min_get_n_iterations(
+    lbfgs_min         lbfgs )
+{
+    return( lbfgs->n_iterations );
+}
+
+public  int  lbfgs_min_get_n_evaluations(
+    lbfgs_min         lbfgs )
+{
+    return( lbfgs->n_evaluations );
+}
+
+public  int  lbfgs_min_get_n_deriv_evaluations(
+    lbfgs_min         lbfgs )
+{
+    return( lbfgs->n_deriv_evaluations );
+}
+
+public  void  lbfgs_min_print_iteration_info(
+    lbfgs_min         lbfgs )
+{
+    print( "Iter  %5d:   Value: %30.16g    Evals: %5d %5d  N restarts: %2d\n",
+           lbfgs->n_iterations, lbfgs->current_value,
+           lbfgs->n_evaluations, lbfgs->n_deriv_evaluations,
+           lbfgs->n_restarts );
+}
+
+public  void  lbfgs_min_terminate(
+    lbfgs_min         lbfgs )
+{
+    if( lbfgs->n_parameters > 0 )
+    {
+        FREE( lbfgs->parameters );
+        FREE( lbfgs->derivative );
+        FREE( lbfgs->direction );
+        FREE( lbfgs->test_parameters );
+        FREE( lbfgs->test_derivative );
+        FREE2D( lbfgs->s );
+        FREE2D( lbfgs->y );
+    }
+
+    FREE( lbfgs->rho );
+    FREE( lbfgs->alpha );
+    FREE( lbfgs );
+}
+
+public  Real  lbfgs_minimize_function(
+    int                    n_parameters,
+    Real                   initial[],
+    Real                   (*function) ( Real [], void * ),
+    void                   (*deriv_function) ( Real [], void *, Real [] ),
+    void                   *function_data,
+    Real                   termination_range_tolerance,
+    Real                   termination_domain_tolerance,
+    int                    n_corrections,
+    int                    max_iterations,
+    Real                   solution[] )
+{
+    Real            value;
+    lbfgs_min       lbfgs;
+
+    lbfgs = lbfgs_min_initialize( n_parameters, initial,
+                                  function, deriv_function,
+                                  function_data,
+                                  termination_range_tolerance,
+                                  termination_domain_tolerance,
+                                  n_corrections, max_iterations, &value );
+
+    lbfgs_min_print_iteration_info( lbfgs );
+
+    while( lbfgs_min_do_one_iteration( lbfgs, &value ) )
+    {
+        lbfgs_min_print_iteration_info( lbfgs );
+    }
+
+    lbfgs_min_get_current_position( lbfgs, solution );
+
+    lbfgs_min_terminate( lbfgs );
+
+    return( value );
+}
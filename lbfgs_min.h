@@ -0,0 +1,22 @@
+#ifndef  DEF_LBFGS_MIN_H
+#define  DEF_LBFGS_MIN_H
+
+struct  lbfgs_min_struct;
+
+typedef  struct  lbfgs_min_struct  *lbfgs_min;
+
+
+#ifndef  public
+#define       public   extern
+#define       public_was_defined_here
+#endif
+
+#include  <lbfgs_min_prototypes.h>
+
+#ifdef  public_was_defined_here
+#undef       public
+#undef       public_was_defined_here
+#endif
+
+
+#endif
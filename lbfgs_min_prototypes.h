@@ -0,0 +1,50 @@
+#ifndef  DEF_LBFGS_MIN_PROTOTYPES
+#define  DEF_LBFGS_MIN_PROTOTYPES
+
+public   lbfgs_min  lbfgs_min_initialize(
+    int                    n_parameters,
+    Real                   initial[],
+    Real                   (*function) ( Real [], void * ),
+    void                   (*deriv_function) ( Real [], void *, Real [] ),
+    void                   *function_data,
+    Real                   termination_range_tolerance,
+    Real                   termination_domain_tolerance,
+    int                    n_corrections,
+    int                    max_iterations,
+    Real                   *current_value );
+
+public  BOOLEAN  lbfgs_min_do_one_iteration(  
+    lbfgs_min         lbfgs,
+    Real              *resulting_value );
+
+public  void  lbfgs_min_get_current_position(  
+    lbfgs_min         lbfgs,
+    Real              parameters[] );
+
+public  int  lbfgs_min_get_n_iterations(  
+    lbfgs_min         lbfgs );
+
+public  int  lbfgs_min_get_n_evaluations(  
+    lbfgs_min         lbfgs );
+
+public  int  lbfgs_min_get_n_deriv_evaluations(  
+    lbfgs_min         lbfgs );
+
+public  void  lbfgs_min_print_iteration_info(  
+    lbfgs_min         lbfgs );
+
+public  void  lbfgs_min_terminate(  
+    lbfgs_min         lbfgs );
+
+public  Real  lbfgs_minimize_function(
+    int                    n_parameters,
+    Real                   initial[],
+    Real                   (*function) ( Real [], void * ),
+    void                   (*deriv_function) ( Real [], void *, Real [] ),
+    void                   *function_data,
+    Real                   termination_range_tolerance,
+    Real                   termination_domain_tolerance,
+    int                    n_corrections,
+    int                    max_iterations,
+    Real                   solution[] );
+#endif
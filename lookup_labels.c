@@ -75,9 +75,7 @@ int  main(
 {
     STRING     input_filename, label;
     int        i, a, in_minc_id, value;
-    int        n_labels;
-    int        *values;
-    STRING     *labels;
+    label_table_struct  table;
     BOOLEAN    list_all, by_value;
 
     /* --- check for enough arguments */
@@ -114,7 +112,7 @@ int  main(
 
     /* --- read the label lookup from the minc file */
 
-    if( !read_label_lookup( in_minc_id, &n_labels, &values, &labels ) )
+    if( !read_label_table( in_minc_id, &table ) )
     {
         print_error( "Error reading current label lookup.\n" );
         return( 1 );
@@ -124,8 +122,11 @@ int  main(
 
     if( list_all )
     {
-        for_less( i, 0, n_labels )
-            print_label( values[i], labels[i] );
+        for_less( i, 0, table.n_labels )
+        {
+            if( table.labels[i] != NULL )
+                print_label( table.values[i], table.labels[i] );
+        }
     }
     else
     {
@@ -138,28 +139,19 @@ int  main(
                     usage( argv[0] );
                     return( 1 );
                 }
-                (void) lookup_label_for_value( n_labels, values, labels,
-                                               value, &label );
+                (void) lookup_label_in_table( &table, value, &label );
             }
             else
             {
                 label = argv[a];
-                (void) lookup_value_for_label( n_labels, values, labels,
-                                               label, &value );
+                (void) lookup_value_in_table( &table, label, &value );
             }
 
             print_label( value, label );
         }
     }
 
-    if( n_labels > 0 )
-    {
-        for_less( i, 0, n_labels )
-            FREE( labels[i] );
-
-        FREE( values );
-        FREE( labels );
-    }
+    delete_label_table( &table );
 
     return( 0 );
 }
@@ -1,6 +1,7 @@
 #include  <math.h>
 #include  <bicpl.h>
 #include  <volume_io/internal_volume_io.h>
+#include  <volume_derivatives.h>
 
 private  void  usage(
     STRING   executable_name )
@@ -76,15 +77,11 @@ private  Volume  create_gradient_volume(
     int             continuity,
     int             deriv_number )
 {
-    Volume           gradient_volume;
-    int              volume_sizes[N_DIMENSIONS];
-    int              x, y, z;
-    Real             dx, dy, dz;
-    Real             voxel[MAX_DIMENSIONS];
-    Real             grad, value;
-    Real             **first_deriv, ***second_deriv;
-    Real             min_value, max_value;
-    progress_struct  progress;
+    Volume             gradient_volume;
+    int                volume_sizes[N_DIMENSIONS], i, n_voxels;
+    float              *values, *grad;
+    Real               min_value, max_value;
+    Derivative_types   type;
 
     gradient_volume = copy_volume_definition( volume, NC_FLOAT, FALSE,
                                               0.0, 0.0 );
@@ -98,82 +95,50 @@ private  Volume  create_gradient_volume(
     {
 	printf( "Computing first derivative with continuity = %d\n", 
 		continuity );
-        ALLOC2D( first_deriv, 1, N_DIMENSIONS );
-        second_deriv = NULL;
+        type = GRADIENT_MAGNITUDE;
     }
     else
     {
 	printf( "Computing second derivative with continuity = %d\n", 
 		continuity );
-        first_deriv = NULL;
-        ALLOC3D( second_deriv, 1, N_DIMENSIONS, N_DIMENSIONS );
+        type = SECOND_DERIVATIVE_MAGNITUDE;
     }
 
+    n_voxels = volume_sizes[X] * volume_sizes[Y] * volume_sizes[Z];
+
+    ALLOC( values, n_voxels );
+    ALLOC( grad, n_voxels );
+
+    get_volume_float_values( volume, values );
+
+    compute_volume_derivatives( volume_sizes, values, continuity, type,
+                                &grad );
+
+    FREE( values );
+
     min_value = 0.0;
     max_value = 0.0;
 
-    initialize_progress_report( &progress, FALSE,
-                                volume_sizes[X] * volume_sizes[Y],
-                                "Creating Gradient" );
-
-    for_less( x, 0, volume_sizes[X] )
+    for_less( i, 0, n_voxels )
     {
-        voxel[X] = (Real) x;
-        for_less( y, 0, volume_sizes[Y] )
+        if( i == 0 )
         {
-            voxel[Y] = (Real) y;
-            for_less( z, 0, volume_sizes[Z] )
-            {
-                voxel[Z] = (Real) z;
-                evaluate_volume( volume, voxel, NULL, continuity,
-                                 FALSE, 0.0, &value, first_deriv, second_deriv);
-
-                if( deriv_number == 1 )
-                {
-                    dx = first_deriv[0][0];
-                    dy = first_deriv[0][1];
-                    dz = first_deriv[0][2];
-                }
-                else
-                {
-                    dx = second_deriv[0][0][0];
-                    dy = second_deriv[0][1][1];
-                    dz = second_deriv[0][2][2];
-                }
-
-                grad = sqrt(dx * dx + dy * dy + dz * dz);
-
-                set_volume_real_value( gradient_volume, x, y, z, 0, 0, grad );
-
-                if( x == 0 && y == 0 && z == 0 )
-                {
-                    min_value = grad;
-                    max_value = grad;
-                }
-                else if( grad < min_value )
-                    min_value = grad;
-                else if( grad > max_value )
-                    max_value = grad;
-            }
-
-            update_progress_report( &progress, x * volume_sizes[Y] + y + 1 );
+            min_value = (Real) grad[i];
+            max_value = (Real) grad[i];
         }
+        else if( (Real) grad[i] < min_value )
+            min_value = (Real) grad[i];
+        else if( (Real) grad[i] > max_value )
+            max_value = (Real) grad[i];
     }
 
     set_volume_real_range( gradient_volume, min_value - 1.0, max_value + 1.0 );
 
-    print( "%g %g\n", min_value, max_value );
+    set_volume_float_values( gradient_volume, grad );
 
-    terminate_progress_report( &progress );
+    FREE( grad );
 
-    if( deriv_number == 1 )
-    {
-        FREE2D( first_deriv );
-    }
-    else
-    {
-        FREE3D( second_deriv );
-    }
+    print( "%g %g\n", min_value, max_value );
 
     return( gradient_volume );
 }
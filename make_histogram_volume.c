@@ -1,6 +1,7 @@
 #include  <volume_io/internal_volume_io.h>
 #include  <bicpl.h>
 #include  <bicpl/images.h>
+#include  <voxel_histogram.h>
 
 #define  TWO_D
 
@@ -15,10 +16,14 @@ int  main(
     int                sizes[MAX_DIMENSIONS], n_dims;
     int                new_sizes[MAX_DIMENSIONS];
     int                n_slices, min_v1, max_v1, min_v2, max_v2, **total_counts;
-    int                v1;
+    int                v1, i, n_counts, *bins;
     STRING             *new_dim_names;
     Real               value, min_value, max_value;
     Real               separations[MAX_DIMENSIONS], bin_separation;
+    Real               *counts;
+    bin_range_struct   range;
+    voxel_scan_struct  scan;
+    voxel_span_struct  span;
     progress_struct    progress;
 
     initialize_argument_processing( argc, argv );
@@ -88,87 +93,97 @@ int  main(
     alloc_volume_data( new_volume );
     set_volume_separations( new_volume, separations );
 
-    v[0] = 0;
-    v[1] = 0;
-    v[2] = 0;
+    n_counts = new_sizes[0] * new_sizes[1] * new_sizes[2];
+    ALLOC( counts, n_counts );
+    for_less( i, 0, n_counts )
+        counts[i] = 0.0;
 
     if( n_dims == 2 )
     {
         for_less( v[dim1], 0, sizes[dim1] )
         for_less( v[dim2], 0, sizes[dim2] )
-        {
             total_counts[v[dim1]][v[dim2]] = 0;
-            for_less( v[dim3], 0, n_bins )
-                set_volume_real_value( new_volume, v[0], v[1], v[2], 0, 0, 0.0);
-        }
     }
     else
     {
         for_less( v1, 0, sizes[dim1] )
-        {
             total_counts[0][v1] = 0;
-            for_less( bin, 0, n_bins )
-                set_volume_real_value( new_volume, 0, v1, bin, 0, 0, 0.0);
-        }
     }
 
-    initialize_progress_report( &progress, FALSE, sizes[0] * sizes[1],
+    /*--- bin the voxels a span at a time, accumulating the counts in memory
+          rather than in the output volume */
+
+    initialize_bin_range( &range, min_value, max_value, n_bins );
+    initialize_voxel_scan( &scan, volume, 0 );
+    ALLOC( bins, get_voxel_scan_max_span( &scan ) );
+
+    initialize_progress_report( &progress, FALSE, sizes[0],
                                 "Histogramming" );
 
-    for_less( v[0], 0, sizes[0] )
-    for_less( v[1], 0, sizes[1] )
-    {
-    for_less( v[2], 0, sizes[2] )
+    while( get_next_voxel_span( &scan, &span ) )
     {
-        value = get_volume_real_value( volume, v[0], v[1], v[2], 0, 0 );
-
-        bin = (value - min_value) / (max_value - min_value) * n_bins;
+        get_voxel_span_bins( &range, &span, bins );
+        get_voxel_scan_position( &scan, span.start, v );
 
-        if( bin == n_bins )
-            bin = n_bins-1;
+        for_less( i, 0, span.n_voxels )
+        {
+            bin = bins[i];
 
-        min_v1 = MAX( 0, v[dim1] - n_slices );
-        max_v1 = MIN( sizes[dim1]-1, v[dim1] + n_slices );
+            min_v1 = MAX( 0, v[dim1] - n_slices );
+            max_v1 = MIN( sizes[dim1]-1, v[dim1] + n_slices );
 
-        if( n_dims == 1 )
-        {
-            for_inclusive( v1, min_v1, max_v1 )
+            if( bin >= 0 && n_dims == 1 )
             {
-                value = get_volume_real_value( new_volume, 0, v1, bin, 0, 0 );
-                set_volume_real_value( new_volume, 0, v1, bin, 0, 0,
-                                       value + 1.0 );
-                ++total_counts[0][v1];
+                for_inclusive( v1, min_v1, max_v1 )
+                {
+                    counts[v1*n_bins+bin] += 1.0;
+                    ++total_counts[0][v1];
+                }
+            }
+            else if( bin >= 0 )
+            {
+                vv[dim3] = bin;
+
+                min_v2 = MAX( 0, v[dim2] - n_slices );
+                max_v2 = MIN( sizes[dim2]-1, v[dim2] + n_slices );
+
+                for_inclusive( vv[dim1], min_v1, max_v1 )
+                for_inclusive( vv[dim2], min_v2, max_v2 )
+                {
+                    counts[IJK(vv[0],vv[1],vv[2],new_sizes[1],new_sizes[2])]
+                                                               += 1.0;
+                    ++total_counts[vv[dim1]][vv[dim2]];
+                }
             }
-        }
-        else
-        {
-            vv[dim3] = bin;
-
-            min_v2 = MAX( 0, v[dim2] - n_slices );
-            max_v2 = MIN( sizes[dim2]-1, v[dim2] + n_slices );
 
-            for_inclusive( vv[dim1], min_v1, max_v1 )
-            for_inclusive( vv[dim2], min_v2, max_v2 )
+            ++v[2];
+            if( v[2] == sizes[2] )
             {
-                value = get_volume_real_value( new_volume, vv[0], vv[1], vv[2],
-                                               0, 0 );
-                set_volume_real_value( new_volume, vv[0], vv[1], vv[2], 0, 0,
-                                       value + 1.0 );
-                ++total_counts[vv[dim1]][vv[dim2]];
+                v[2] = 0;
+                ++v[1];
+                if( v[1] == sizes[1] )
+                {
+                    v[1] = 0;
+                    ++v[0];
+                }
             }
         }
-    }
-    update_progress_report( &progress, v[0] * sizes[1] + v[1] + 1 );
+
+        update_progress_report( &progress, v[0] );
     }
 
     terminate_progress_report( &progress );
 
+    FREE( bins );
+    delete_voxel_scan( &scan );
+    delete_bin_range( &range );
+
     if( n_dims == 1 )
     {
         for_less( v1, 0, sizes[dim1] )
         for_less( bin, 0, n_bins )
         {
-            value = get_volume_real_value( new_volume, 0, v1, bin, 0, 0 );
+            value = counts[v1*n_bins+bin];
             set_volume_real_value( new_volume, 0, v1, bin, 0, 0,
                                 10000.0 * value / (Real) total_counts[0][v1] );
         }
@@ -179,12 +194,14 @@ int  main(
         for_less( v[dim2], 0, sizes[dim2] )
         for_less( v[dim3], 0, n_bins )
         {
-            value = get_volume_real_value( new_volume, v[0], v[1], v[2], 0, 0 );
+            value = counts[IJK(v[0],v[1],v[2],new_sizes[1],new_sizes[2])];
             set_volume_real_value( new_volume, v[0], v[1], v[2], 0, 0,
                     10000.0 * value / (Real) total_counts[v[dim1]][v[dim2]] );
         }
     }
 
+    FREE( counts );
+
     set_volume_voxel_range( new_volume, 0.0, 10000.0 );
     set_volume_real_range( new_volume, 0.0, 10000.0 );
 
@@ -0,0 +1,109 @@
+#include  <volume_io/internal_volume_io.h>
+#include  <bicpl.h>
+#include  <volume_derivatives.h>
+#include  <volume_pyramid.h>
+
+private  void  usage(
+    STRING   executable_name )
+{
+    STRING  usage_str = "\n\
+Usage: %s  input.mnc  output_prefix  n_levels  [box|gaussian]\n\
+\n\
+     Creates a pyramid of n_levels, including the input volume, each level\n\
+     half the size of the previous one along each axis, and writes levels\n\
+     1 to n_levels-1 to output_prefix_<level>.mnc.\n\n";
+
+     print_error( usage_str, executable_name );
+}
+
+int  main(
+    int    argc,
+    char   *argv[] )
+{
+    STRING               input_filename, output_prefix, filter_name;
+    char                 output_filename[EXTREMELY_LARGE_STRING_SIZE];
+    int                  level, n_levels, dim, sizes[MAX_DIMENSIONS];
+    int                  (*level_sizes)[N_DIMENSIONS];
+    float                **level_values;
+    Real                 ratios[N_DIMENSIONS];
+    Downsample_filters   filter;
+    Volume               volume, level_volume;
+
+    initialize_argument_processing( argc, argv );
+
+    if( !get_string_argument( NULL, &input_filename ) ||
+        !get_string_argument( NULL, &output_prefix ) ||
+        !get_int_argument( 0, &n_levels ) || n_levels < 1 )
+    {
+        usage( argv[0] );
+        return( 1 );
+    }
+
+    (void) get_string_argument( "box", &filter_name );
+
+    if( equal_strings( filter_name, "gaussian" ) )
+        filter = GAUSSIAN_FILTER;
+    else if( equal_strings( filter_name, "box" ) )
+        filter = BOX_FILTER;
+    else
+    {
+        usage( argv[0] );
+        return( 1 );
+    }
+
+    if( input_volume( input_filename, 3, XYZ_dimension_names,
+                      NC_UNSPECIFIED, FALSE, 0.0, 0.0,
+                      TRUE, &volume, (minc_input_options *) NULL ) != OK )
+        return( 1 );
+
+    get_volume_sizes( volume, sizes );
+
+    ALLOC( level_sizes, n_levels );
+    ALLOC( level_values, n_levels );
+    ALLOC( level_values[0], sizes[X] * sizes[Y] * sizes[Z] );
+
+    get_volume_float_values( volume, level_values[0] );
+
+    n_levels = create_float_pyramid( sizes, level_values[0], n_levels,
+                                     filter, level_sizes, level_values );
+
+    for_less( dim, 0, N_DIMENSIONS )
+        ratios[dim] = 1.0;
+
+    for_less( level, 1, n_levels )
+    {
+        /*--- each level halves the axes that were longer than one voxel */
+
+        for_less( dim, 0, N_DIMENSIONS )
+        {
+            if( level_sizes[level-1][dim] > 1 )
+                ratios[dim] *= 2.0;
+        }
+
+        level_volume = create_downsampled_volume( volume, ratios,
+                                                  level_sizes[level],
+                                                  level_values[level] );
+
+        (void) sprintf( output_filename, "%s_%d.mnc", output_prefix, level );
+
+        print( "Level %d: %d by %d by %d\n", level, level_sizes[level][X],
+               level_sizes[level][Y], level_sizes[level][Z] );
+
+        if( output_modified_volume( output_filename, NC_UNSPECIFIED,
+                                    FALSE, 0.0, 0.0, level_volume,
+                                    input_filename, "make_volume_pyramid\n",
+                                    (minc_output_options *) NULL ) != OK )
+            return( 1 );
+
+        delete_volume( level_volume );
+        FREE( level_values[level] );
+    }
+
+    FREE( level_values[0] );
+    FREE( level_values );
+    FREE( level_sizes );
+
+    delete_volume( volume );
+
+    return( 0 );
+}
@@ -1,5 +1,6 @@
 #include  <volume_io/internal_volume_io.h>
 #include  <bicpl.h>
+#include  <label_runs.h>
 
 private  void  usage(
     STRING   executable )
@@ -27,9 +28,12 @@ int  main(
     Real                 mask_value, min_mask, max_mask;
     Real                 value_to_set;
     int                  x, y, z, sizes[MAX_DIMENSIONS], n_changed;
+    int                  r, n_runs;
     progress_struct      progress;
     Volume               volume, mask_volume;
-    BOOLEAN              value_specified, same_grid;
+    BOOLEAN              value_specified, same_grid, runs_present;
+    label_runs_struct    mask_runs;
+    label_run_struct     *row_runs;
     minc_input_options   options;
 
     initialize_argument_processing( argc, argv );
@@ -55,6 +59,8 @@ int  main(
                       TRUE, &volume, &options ) != OK )
         return( 1 );
 
+    runs_present = FALSE;
+
     if( equal_strings( volume_filename, mask_volume_filename ) )
     {
         mask_volume = volume;
@@ -78,12 +84,15 @@ int  main(
         }
         else
         {
-            mask_volume = create_label_volume( volume, NC_UNSPECIFIED );
-
-            set_all_volume_label_data( mask_volume, 0 );
+            /*--- the mask is pushed onto the input grid a slice at a time,
+                  and kept as runs, as the resampled labels are mostly
+                  zero */
 
-            if( load_label_volume( mask_volume_filename, mask_volume ) != OK )
+            if( load_label_runs( mask_volume_filename, volume,
+                                 &mask_runs ) != OK )
                 return( 1 );
+
+            runs_present = TRUE;
         }
     }
 
@@ -101,9 +110,28 @@ int  main(
     {
         for_less( y, 0, sizes[Y] )
         {
+            if( runs_present )
+            {
+                n_runs = get_label_runs_row( &mask_runs, x, y, &row_runs );
+                r = 0;
+            }
+
             for_less( z, 0, sizes[Z] )
             {
-                mask_value = get_volume_real_value( mask_volume, x, y, z, 0, 0);
+                if( runs_present )
+                {
+                    while( r < n_runs && row_runs[r].end <= z )
+                        ++r;
+
+                    if( r < n_runs && row_runs[r].start <= z )
+                        mask_value = (Real) row_runs[r].label;
+                    else
+                        mask_value = 0.0;
+                }
+                else
+                    mask_value = get_volume_real_value( mask_volume, x, y, z,
+                                                        0, 0 );
+
                 if( min_mask <= mask_value && mask_value <= max_mask )
                 {
                     set_volume_real_value( volume, x, y, z, 0, 0, value_to_set);
@@ -117,6 +145,9 @@ int  main(
 
     terminate_progress_report( &progress );
 
+    if( runs_present )
+        delete_label_runs( &mask_runs );
+
     print( "Masked %d voxels\n", n_changed );
 
     (void) output_modified_volume( output_filename, NC_UNSPECIFIED, FALSE,
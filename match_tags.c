@@ -29,6 +29,7 @@ static char rcsid[]="$Header: /private-cvsroot/libraries/conglomerate/match_tags
 #include <time_stamp.h>
 #include <volume_io.h>
 #include <ParseArgv.h>
+#include <tag_index.h>
 
 /* Constants */
 #ifndef TRUE
@@ -43,6 +44,10 @@ static char rcsid[]="$Header: /private-cvsroot/libraries/conglomerate/match_tags
 #define WORLD_NDIMS 3
 
 #define SEP_STRING " : "
+#define NOT_FOUND_STRING "not found"
+
+/* Room for the distance string appended to each label */
+#define DIST_STRING_LENGTH 64
 
 /* Macros */
 #ifdef MALLOC
@@ -68,11 +73,17 @@ static char rcsid[]="$Header: /private-cvsroot/libraries/conglomerate/match_tags
 
 /* Argument variables */
 double maximum_distance = FLT_MAX;
+int n_nearest = 1;
+int all_within = FALSE;
 
 /* Argument table */
 ArgvInfo argTable[] = {
    {"-max_distance", ARGV_FLOAT, (char *) 1, (char *) &maximum_distance,
     "Maximum distance for two tags to be considered close"},
+   {"-k", ARGV_INT, (char *) 1, (char *) &n_nearest,
+    "Number of nearest tags to match to each tag"},
+   {"-all", ARGV_CONSTANT, (char *) TRUE, (char *) &all_within,
+    "Match every tag within -max_distance"},
 
    {NULL, ARGV_END, NULL, NULL, NULL}
 };
@@ -82,21 +93,24 @@ ArgvInfo argTable[] = {
 int main(int argc, char *argv[])
 {
    char *pname, *tagfile1, *tagfile2, *outtag, *history;
-   Real **tags1, **tags2, **new_tags, *this_tag;
+   Real **tags1, **tags2, **out_tags1, **out_tags2, *this_tag, this_dist;
    int n_volumes1, n_volumes2, n_tag_points1, n_tag_points2;
-   int ipoint1, ipoint2, icoord, near_tag;
+   int ipoint1, ifound, n_found, n_out, n_out_alloced, n_all_alloced;
+   int *found, *k_found, *all_found;
+   Real *distances, *k_distances, *all_distances, nearest_dist;
    STRING *labels1, *labels2, *new_labels, this_label;
-   double min_distsq, distsq, diff, maximum_distsq;
-   size_t string_length;
+   size_t *label_offsets, label_length, label_alloced, needed;
+   char *label_buffer;
+   tag_index index;
    FILE *fp;
-   char dist_string[64];
 
    /* Save history */
    history = time_stamp(argc, argv);
 
    /* Parse arguments */
    pname = argv[0];
-   if (ParseArgv(&argc, argv, argTable, 0) || (argc != 4)) {
+   if (ParseArgv(&argc, argv, argTable, 0) || (argc != 4) ||
+       (n_nearest < 1)) {
       (void) fprintf(stderr, 
                      "\nUsage: %s [<options>] infile1.tag file2.tag outfile2.tag\n\n",
                      pname);
@@ -105,7 +119,6 @@ int main(int argc, char *argv[])
    tagfile1 = argv[1];
    tagfile2 = argv[2];
    outtag = argv[3];
-   maximum_distsq = maximum_distance * maximum_distance;
 
    /* Read in first tag file */
    if ((open_file_with_default_suffix(tagfile1,
@@ -134,55 +147,105 @@ int main(int argc, char *argv[])
    }
    (void) close_file(fp);
 
-   /* Allocate space for output tags */
-   new_tags = MALLOC(n_tag_points1 * sizeof(*new_tags));
-   new_labels = MALLOC(n_tag_points1 * sizeof(*new_labels));
+   /* Build the search tree on the second set of tags */
+   index = create_tag_index(n_tag_points2, tags2);
+
+   /* Buffers for the query results, reused for every tag */
+   k_found = MALLOC(n_nearest * sizeof(*k_found));
+   k_distances = MALLOC(n_nearest * sizeof(*k_distances));
+   n_all_alloced = 0;
+   all_found = NULL;
+   all_distances = NULL;
+
+   /* Allocate space for output tags, at least one per tag in file 1.
+      The labels all go in one buffer and are pointed to at the end,
+      since the buffer may move as it grows. */
+   n_out = 0;
+   n_out_alloced = (n_tag_points1 > 0) ? n_tag_points1 : 1;
+   out_tags1 = MALLOC(n_out_alloced * sizeof(*out_tags1));
+   out_tags2 = MALLOC(n_out_alloced * sizeof(*out_tags2));
+   label_offsets = MALLOC(n_out_alloced * sizeof(*label_offsets));
+   label_length = 0;
+   label_alloced = 64 * (size_t) n_out_alloced;
+   label_buffer = MALLOC(label_alloced);
 
    /* Loop through tags in first file */
    for (ipoint1=0; ipoint1 < n_tag_points1; ipoint1++) {
 
-      /* Look for nearest tag in second file */
-      min_distsq = 0.0;
-      for (ipoint2=0; ipoint2 < n_tag_points2; ipoint2++) {
+      /* Look for the nearest tags in second file */
+      if (all_within) {
+         n_found = tag_index_find_within_distance(index, tags1[ipoint1],
+                                                  maximum_distance,
+                                                  &n_all_alloced, &all_found,
+                                                  &all_distances);
+         found = all_found;
+         distances = all_distances;
+      }
+      else {
+         n_found = tag_index_find_k_nearest(index, tags1[ipoint1],
+                                            n_nearest, maximum_distance,
+                                            k_found, k_distances);
+         found = k_found;
+         distances = k_distances;
+      }
+
+      /* If nothing is close enough, report the distance to the nearest */
+      nearest_dist = 0.0;
+      if (n_found == 0) {
+         (void) tag_index_find_nearest(index, tags1[ipoint1], -1.0,
+                                       &nearest_dist);
+      }
+
+      for (ifound=0; ifound < n_found || (ifound == 0 && n_found == 0);
+           ifound++) {
 
-         /* Calculate distance-squared */
-         distsq = 0;
-         for (icoord=0; icoord < WORLD_NDIMS; icoord++) {
-            diff = tags1[ipoint1][icoord] - tags2[ipoint2][icoord];
-            distsq += diff * diff;
+         /* Save the matched tag */
+         if (n_found > 0) {
+            this_tag = tags2[found[ifound]];
+            this_label = labels2[found[ifound]];
+            this_dist = distances[ifound];
+         }
+         else {
+            this_tag = tags1[ipoint1];
+            this_label = NOT_FOUND_STRING;
+            this_dist = nearest_dist;
          }
 
-         /* Check if this is the minimum */
-         if ((ipoint2 == 0) || (min_distsq > distsq)) {
-            near_tag = ipoint2;
-            min_distsq = distsq;
+         if (n_out >= n_out_alloced) {
+            n_out_alloced *= 2;
+            out_tags1 = REALLOC(out_tags1, n_out_alloced * sizeof(*out_tags1));
+            out_tags2 = REALLOC(out_tags2, n_out_alloced * sizeof(*out_tags2));
+            label_offsets = REALLOC(label_offsets, 
+                                    n_out_alloced * sizeof(*label_offsets));
          }
 
-      }
+         needed = strlen(labels1[ipoint1]) + strlen(this_label) + 
+            strlen(SEP_STRING) + DIST_STRING_LENGTH;
+         if (label_length + needed > label_alloced) {
+            while (label_length + needed > label_alloced)
+               label_alloced *= 2;
+            label_buffer = REALLOC(label_buffer, label_alloced);
+         }
 
-      /* Save the nearest tag */
-      if (min_distsq <= maximum_distsq) {
-         this_tag = tags2[near_tag];
-         this_label = labels2[near_tag];
+         out_tags1[n_out] = tags1[ipoint1];
+         out_tags2[n_out] = this_tag;
+         label_offsets[n_out] = label_length;
+         label_length += sprintf(&label_buffer[label_length], 
+                                 "%s%s%s (%.2f mm)", labels1[ipoint1],
+                                 SEP_STRING, this_label, this_dist) + 1;
+         n_out++;
       }
-      else {
-         this_tag = tags1[ipoint1];
-         this_label = "not found";
-      }
-      (void) sprintf(dist_string, " (%.2f mm)", sqrt(min_distsq));
-      new_tags[ipoint1] = this_tag;
-      string_length = strlen(labels1[ipoint1]) + strlen(this_label) + 
-         strlen(SEP_STRING) + strlen(dist_string) + 1;
-      new_labels[ipoint1] = MALLOC(string_length);
-      (void) strcpy(new_labels[ipoint1], labels1[ipoint1]);
-      (void) strcat(new_labels[ipoint1], SEP_STRING);
-      (void) strcat(new_labels[ipoint1], this_label);
-      (void) strcat(new_labels[ipoint1], dist_string);
 
    }
 
-   if (output_tag_file(outtag, history, 2, n_tag_points1, 
-                       tags1, new_tags, 
+   new_labels = MALLOC(n_out_alloced * sizeof(*new_labels));
+   for (ifound=0; ifound < n_out; ifound++)
+      new_labels[ifound] = &label_buffer[label_offsets[ifound]];
+
+   delete_tag_index(index);
+
+   if (output_tag_file(outtag, history, 2, n_out, 
+                       out_tags1, out_tags2, 
                        NULL, NULL, NULL, new_labels) != OK) {
       (void) fprintf(stderr, "Error writing out labels\n");
       return EXIT_FAILURE;
@@ -47,4 +47,41 @@ public  BOOLEAN  lookup_label_for_value(
 public  void  print_label(
     int      value,
     STRING   label );
+public  void  initialize_label_table(
+    label_table_struct  *table );
+
+public  void  delete_label_table(
+    label_table_struct  *table );
+
+public  void  add_label_to_table(
+    label_table_struct  *table,
+    int                 value_to_add,
+    STRING              label_to_add );
+
+public  BOOLEAN  delete_label_from_table(
+    label_table_struct  *table,
+    int                 value_to_delete );
+
+public  BOOLEAN  lookup_value_in_table(
+    label_table_struct  *table,
+    STRING              label,
+    int                 *value );
+
+public  BOOLEAN  lookup_label_in_table(
+    label_table_struct  *table,
+    int                 value,
+    STRING              *label );
+
+public  BOOLEAN  read_label_table(
+    int                 minc_id,
+    label_table_struct  *table );
+
+public  BOOLEAN  write_label_table(
+    int                 minc_id,
+    label_table_struct  *table );
+
+public  void  create_label_table_remap(
+    label_table_struct  *from_table,
+    label_table_struct  *to_table,
+    label_remap_struct  *remap );
 #endif
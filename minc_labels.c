@@ -1,4 +1,5 @@
 #include  <volume_io/internal_volume_io.h>
+#include  <minc_labels.h>
 
 /* ----------------------------------------------------------------------------
                define the minc variable and attribute names
@@ -574,3 +575,403 @@ public  void  print_label(
 
     print( "%6d \"%s\"\n", value, l );
 }
+
+/*--- initial size of the hash tables of a label table */
+
+#define  INITIAL_LABEL_TABLE_SIZE   100
+
+/* ----------------------------- MNI Header -----------------------------------
+@NAME       : get_label_key
+@INPUT      : label
+@OUTPUT     :
+@RETURNS    : hash key
+@DESCRIPTION: Computes a nonnegative integer hash key from a label string.
+@METHOD     :
+@GLOBALS    :
+@CALLS      :
+@CREATED    :
+@MODIFIED   :
+---------------------------------------------------------------------------- */
+
+private  int  get_label_key(
+    STRING   label )
+{
+    unsigned int   key;
+    int            c;
+
+    key = 5381;
+
+    for( c = 0;  label[c] != END_OF_STRING;  ++c )
+        key = key * 33 + (unsigned int) (unsigned char) label[c];
+
+    return( (int) (key & 0x7fffffff) );
+}
+
+/*--- links entry ind into the chain of its label's key.  The chain is kept
+      in increasing order of index, so that a lookup finds the entry added
+      first, as in the list. */
+
+private  void  insert_label_key(
+    label_table_struct  *table,
+    int                 ind )
+{
+    int   key, head, prev;
+
+    key = get_label_key( table->labels[ind] );
+
+    if( !lookup_in_hash_table( &table->label_lookup, key, (void *) &head ) )
+    {
+        table->next_same_key[ind] = -1;
+        insert_in_hash_table( &table->label_lookup, key, (void *) &ind );
+    }
+    else if( ind < head )
+    {
+        (void) remove_from_hash_table( &table->label_lookup, key,
+                                       (void *) &head );
+        table->next_same_key[ind] = head;
+        insert_in_hash_table( &table->label_lookup, key, (void *) &ind );
+    }
+    else
+    {
+        prev = head;
+        while( table->next_same_key[prev] >= 0 &&
+               table->next_same_key[prev] < ind )
+            prev = table->next_same_key[prev];
+
+        table->next_same_key[ind] = table->next_same_key[prev];
+        table->next_same_key[prev] = ind;
+    }
+}
+
+/*--- unlinks entry ind from the chain of its label's key */
+
+private  void  remove_label_key(
+    label_table_struct  *table,
+    int                 ind )
+{
+    int   key, head, prev;
+
+    key = get_label_key( table->labels[ind] );
+
+    if( !lookup_in_hash_table( &table->label_lookup, key, (void *) &head ) )
+    {
+        handle_internal_error( "remove_label_key" );
+        return;
+    }
+
+    if( head == ind )
+    {
+        (void) remove_from_hash_table( &table->label_lookup, key,
+                                       (void *) &head );
+        if( table->next_same_key[ind] >= 0 )
+        {
+            insert_in_hash_table( &table->label_lookup, key,
+                                  (void *) &table->next_same_key[ind] );
+        }
+    }
+    else
+    {
+        prev = head;
+        while( table->next_same_key[prev] != ind )
+            prev = table->next_same_key[prev];
+
+        table->next_same_key[prev] = table->next_same_key[ind];
+    }
+}
+
+private  int  find_label_index(
+    label_table_struct  *table,
+    STRING              label )
+{
+    int   ind;
+
+    if( !lookup_in_hash_table( &table->label_lookup, get_label_key( label ),
+                               (void *) &ind ) )
+        return( -1 );
+
+    while( ind >= 0 && !equal_strings( table->labels[ind], label ) )
+        ind = table->next_same_key[ind];
+
+    return( ind );
+}
+
+private  int  find_value_index(
+    label_table_struct  *table,
+    int                 value )
+{
+    int   ind;
+
+    if( !lookup_in_hash_table( &table->value_lookup, value, (void *) &ind ) )
+        return( -1 );
+
+    return( ind );
+}
+
+/* ----------------------------- MNI Header -----------------------------------
+@NAME       : initialize_label_table
+@INPUT      : 
+@OUTPUT     : table
+@RETURNS    : 
+@DESCRIPTION: Initializes an empty label table.
+@METHOD     : 
+@GLOBALS    : 
+@CALLS      : 
+@CREATED    : 
+@MODIFIED   : 
+---------------------------------------------------------------------------- */
+
+public  void  initialize_label_table(
+    label_table_struct  *table )
+{
+    table->n_labels = 0;
+    table->n_deleted = 0;
+    table->values = NULL;
+    table->labels = NULL;
+    table->next_same_key = NULL;
+
+    initialize_hash_table( &table->value_lookup, INITIAL_LABEL_TABLE_SIZE,
+                           sizeof(int), 0.5, 0.25 );
+    initialize_hash_table( &table->label_lookup, INITIAL_LABEL_TABLE_SIZE,
+                           sizeof(int), 0.5, 0.25 );
+}
+
+public  void  delete_label_table(
+    label_table_struct  *table )
+{
+    int   i;
+
+    if( table->n_labels > 0 )
+    {
+        for_less( i, 0, table->n_labels )
+            delete_string( table->labels[i] );
+
+        FREE( table->values );
+        FREE( table->labels );
+        FREE( table->next_same_key );
+    }
+
+    delete_hash_table( &table->value_lookup );
+    delete_hash_table( &table->label_lookup );
+}
+
+/* ----------------------------- MNI Header -----------------------------------
+@NAME       : add_label_to_table
+@INPUT      : table
+              value_to_add
+              label_to_add
+@OUTPUT     : 
+@RETURNS    : 
+@DESCRIPTION: Adds the value-label pair to the table, replacing the label of
+              the value if it is already present, as add_label_to_list().
+@METHOD     : 
+@GLOBALS    : 
+@CALLS      : 
+@CREATED    : 
+@MODIFIED   : 
+---------------------------------------------------------------------------- */
+
+public  void  add_label_to_table(
+    label_table_struct  *table,
+    int                 value_to_add,
+    STRING              label_to_add )
+{
+    int    ind;
+
+    ind = find_value_index( table, value_to_add );
+
+    if( ind >= 0 )
+    {
+        remove_label_key( table, ind );
+        delete_string( table->labels[ind] );
+    }
+    else
+    {
+        SET_ARRAY_SIZE( table->values, table->n_labels, table->n_labels+1,
+                        DEFAULT_CHUNK_SIZE );
+        SET_ARRAY_SIZE( table->labels, table->n_labels, table->n_labels+1,
+                        DEFAULT_CHUNK_SIZE );
+        SET_ARRAY_SIZE( table->next_same_key, table->n_labels,
+                        table->n_labels+1, DEFAULT_CHUNK_SIZE );
+        ind = table->n_labels;
+        ++table->n_labels;
+
+        table->values[ind] = value_to_add;
+        insert_in_hash_table( &table->value_lookup, value_to_add,
+                              (void *) &ind );
+    }
+
+    table->labels[ind] = create_string( label_to_add );
+    insert_label_key( table, ind );
+}
+
+/*--- removes the value from the table, returning FALSE if it is not there,
+      as delete_label_from_list() */
+
+public  BOOLEAN  delete_label_from_table(
+    label_table_struct  *table,
+    int                 value_to_delete )
+{
+    int    ind;
+
+    ind = find_value_index( table, value_to_delete );
+
+    if( ind < 0 )
+        return( FALSE );
+
+    remove_label_key( table, ind );
+    (void) remove_from_hash_table( &table->value_lookup, value_to_delete,
+                                   (void *) &ind );
+
+    delete_string( table->labels[ind] );
+    table->labels[ind] = NULL;
+    ++table->n_deleted;
+
+    return( TRUE );
+}
+
+public  BOOLEAN  lookup_value_in_table(
+    label_table_struct  *table,
+    STRING              label,
+    int                 *value )
+{
+    int   ind;
+
+    ind = find_label_index( table, label );
+
+    if( ind >= 0 )
+        *value = table->values[ind];
+    else
+        *value = -1;
+
+    return( ind >= 0 );
+}
+
+public  BOOLEAN  lookup_label_in_table(
+    label_table_struct  *table,
+    int                 value,
+    STRING              *label )
+{
+    int   ind;
+
+    ind = find_value_index( table, value );
+
+    if( ind >= 0 )
+        *label = table->labels[ind];
+    else
+        *label = NULL;
+
+    return( ind >= 0 );
+}
+
+/* ----------------------------- MNI Header -----------------------------------
+@NAME       : read_label_table
+@INPUT      : minc_id
+@OUTPUT     : table
+@RETURNS    : TRUE if successful
+@DESCRIPTION: Reads the label lookup from the open MINC file into a new
+              label table.
+@METHOD     : 
+@GLOBALS    : 
+@CALLS      : 
+@CREATED    : 
+@MODIFIED   : 
+---------------------------------------------------------------------------- */
+
+public  BOOLEAN  read_label_table(
+    int                 minc_id,
+    label_table_struct  *table )
+{
+    int      i, n_labels, *values;
+    STRING   *labels;
+
+    initialize_label_table( table );
+
+    if( !read_label_lookup( minc_id, &n_labels, &values, &labels ) )
+        return( FALSE );
+
+    if( n_labels > 0 )
+    {
+        for_less( i, 0, n_labels )
+        {
+            add_label_to_table( table, values[i], labels[i] );
+            delete_string( labels[i] );
+        }
+
+        FREE( values );
+        FREE( labels );
+    }
+
+    return( TRUE );
+}
+
+/*--- writes the entries of the table that have not been deleted, in the
+      order they were added */
+
+public  BOOLEAN  write_label_table(
+    int                 minc_id,
+    label_table_struct  *table )
+{
+    int      i, n_labels, *values;
+    STRING   *labels;
+    BOOLEAN  okay;
+
+    n_labels = table->n_labels - table->n_deleted;
+
+    if( n_labels == 0 )
+        return( TRUE );
+
+    ALLOC( values, n_labels );
+    ALLOC( labels, n_labels );
+
+    n_labels = 0;
+    for_less( i, 0, table->n_labels )
+    {
+        if( table->labels[i] != NULL )
+        {
+            values[n_labels] = table->values[i];
+            labels[n_labels] = table->labels[i];
+            ++n_labels;
+        }
+    }
+
+    okay = write_label_lookup( minc_id, n_labels, values, labels );
+
+    FREE( values );
+    FREE( labels );
+
+    return( okay );
+}
+
+/* ----------------------------- MNI Header -----------------------------------
+@NAME       : create_label_table_remap
+@INPUT      : from_table
+              to_table
+@OUTPUT     : remap
+@RETURNS    : 
+@DESCRIPTION: Maps each value of from_table to the value with the same label
+              in to_table, adding to a remap which has been initialized.
+              Values whose label is not in to_table are not mapped, so they
+              are left unchanged or set to the unmapped value of the remap.
+@METHOD     : 
+@GLOBALS    : 
+@CALLS      : 
+@CREATED    : 
+@MODIFIED   : 
+---------------------------------------------------------------------------- */
+
+public  void  create_label_table_remap(
+    label_table_struct  *from_table,
+    label_table_struct  *to_table,
+    label_remap_struct  *remap )
+{
+    int      i, value;
+
+    for_less( i, 0, from_table->n_labels )
+    {
+        if( from_table->labels[i] != NULL &&
+            lookup_value_in_table( to_table, from_table->labels[i], &value ) )
+        {
+            set_label_remap_value( remap, from_table->values[i], value );
+        }
+    }
+}
@@ -2,6 +2,24 @@
 #define  DEF_MINC_LABELS
 
 #include  <bicpl.h>
+#include  <label_algebra.h>
+
+/*--- a label lookup held with hash tables in both directions, for files
+      with many labels.  Deleted entries keep their place, with a NULL
+      label, so that the order of the remaining ones is preserved.
+      Labels whose strings hash to the same key are chained through
+      next_same_key[]. */
+
+typedef  struct
+{
+    int                 n_labels;
+    int                 n_deleted;
+    int                 *values;
+    STRING              *labels;
+    int                 *next_same_key;
+    hash_table_struct   value_lookup;
+    hash_table_struct   label_lookup;
+} label_table_struct;
 
 #ifndef  public
 #define       public   extern
@@ -27,11 +27,17 @@
 #include <time_stamp.h>
 #include <ParseArgv.h>
 #include <bicpl.h>
+#include <voxel_scan.h>
 
 #ifndef DBL_MAX
 #define DBL_MAX 99999999
 #endif /* DBL_MAX not defined */
 
+/* largest difference in the voxel to world transforms of the input and
+   mask for them to be treated as the same grid */
+
+#define GRID_TOLERANCE 1.0e-6
+
 				/* globals */
 
 static char *default_dim_names[3] = { MIxspace, MIyspace, MIzspace };
@@ -42,6 +48,7 @@ static int invert_mask,
            debug,
            verbose;
 static int clobber_flag = FALSE;
+static int stream_flag = TRUE;
 static double MaskZeroThresh = 0.0;
 
 static ArgvInfo argTable[] = {
@@ -53,6 +60,10 @@ static ArgvInfo argTable[] = {
      "Erase where mask==1."},
   {"-normalize", ARGV_CONSTANT, (char *) TRUE, (char *) &normalize,
      "Intensity normalize the resulting volume."},
+  {"-stream", ARGV_CONSTANT, (char *) TRUE, (char *) &stream_flag,
+     "Mask the volume a slice at a time (default)."},
+  {"-no_stream", ARGV_CONSTANT, (char *) FALSE, (char *) &stream_flag,
+     "Read the whole volume into memory (implied by -normalize)."},
   {NULL, ARGV_HELP, NULL, NULL,
      "Options for logging progress. Default = -verbose."},
   {"-verbose", ARGV_CONSTANT, (char *) TRUE, (char *) &verbose,
@@ -84,6 +95,403 @@ static int point_not_masked(Volume volume, Real wx, Real wy, Real wz) {
 }
 
 
+// Evaluate a zero threshold for the mask (to protect against the possibility
+// of having small values like 1.0e-12 in the background, due to the way minc
+// stores values by ranges.
+static double get_mask_zero_threshold(Volume mask) {
+
+  if( mask->real_range_set ) {
+    // Mask uses an integer data type of some sort.
+    int v0 = convert_value_to_voxel( mask, 0.0 );
+    double r0 = convert_voxel_to_value( mask, v0 );
+    double r1 = convert_voxel_to_value( mask, v0+1 );
+    return( 0.50 * ( r0 + r1 ) );
+  } else {
+    // Cannot do better than this if mask is float or double.
+    return( 0.0 );
+  }
+}
+
+/* TRUE if the two volumes have the same voxel grid, so that the mask can
+   be read a slice at a time alongside the input. */
+
+static int same_voxel_grid(Volume volume1, Volume volume2) {
+
+  int
+    sizes1[MAX_DIMENSIONS],
+    sizes2[MAX_DIMENSIONS],
+    i, j;
+  Transform
+    *transform1, *transform2;
+
+  get_volume_sizes(volume1, sizes1);
+  get_volume_sizes(volume2, sizes2);
+
+  for_less(i, 0, 3) {
+    if (sizes1[i] != sizes2[i])
+      return(FALSE);
+  }
+
+  if (get_transform_type(get_voxel_to_world_transform(volume1)) != LINEAR ||
+      get_transform_type(get_voxel_to_world_transform(volume2)) != LINEAR)
+    return(FALSE);
+
+  transform1 = get_linear_transform_ptr(get_voxel_to_world_transform(volume1));
+  transform2 = get_linear_transform_ptr(get_voxel_to_world_transform(volume2));
+
+  for_less(i, 0, 3) {
+    for_less(j, 0, 4) {
+      if (fabs(Transform_elem(*transform1, i, j) -
+               Transform_elem(*transform2, i, j)) > GRID_TOLERANCE)
+        return(FALSE);
+    }
+  }
+
+  return(TRUE);
+}
+
+/* Linearly interpolates the mask at a voxel position, treating positions
+   more than half a voxel outside it as zero, as evaluate_volume_in_world()
+   does with degree 0. */
+
+static Real interpolate_mask(Volume mask, int sizes[], Real voxel[]) {
+
+  int
+    d, corner, index[3], v[3];
+  Real
+    pos, fraction[3], weight, result;
+
+  for_less(d, 0, 3) {
+    pos = voxel[d];
+    if (pos < -0.5 || pos > (Real) sizes[d] - 0.5)
+      return(0.0);
+
+    if (pos < 0.0)
+      pos = 0.0;
+    else if (pos > (Real) (sizes[d] - 1))
+      pos = (Real) (sizes[d] - 1);
+
+    index[d] = MIN(FLOOR(pos), sizes[d] - 2);
+    index[d] = MAX(index[d], 0);
+    fraction[d] = pos - (Real) index[d];
+  }
+
+  result = 0.0;
+
+  for_less(corner, 0, 8) {
+    weight = 1.0;
+    for_less(d, 0, 3) {
+      v[d] = index[d];
+      if ((corner & (1 << d)) != 0) {
+        ++v[d];
+        weight *= fraction[d];
+      }
+      else
+        weight *= 1.0 - fraction[d];
+    }
+
+    if (weight > 0.0)
+      result += weight * get_volume_real_value(mask, v[0], v[1], v[2], 0, 0);
+  }
+
+  return(result);
+}
+
+/* Flags the voxels of slice i of the input which the mask keeps, stepping
+   through the mask voxel positions incrementally when both voxel to world
+   transforms are linear, instead of converting each voxel through world
+   coordinates. */
+
+static void get_resampled_mask_slice(Volume data, Volume mask, int i,
+                                     Smallest_int keep[]) {
+
+  int
+    data_size[MAX_DIMENSIONS],
+    mask_size[MAX_DIMENSIONS],
+    j, k, d, linear;
+  Real
+    wx, wy, wz,
+    origin[MAX_DIMENSIONS], row[MAX_DIMENSIONS], voxel[MAX_DIMENSIONS],
+    j_step[MAX_DIMENSIONS], k_step[MAX_DIMENSIONS];
+
+  get_volume_sizes(data, data_size);
+  get_volume_sizes(mask, mask_size);
+
+  linear = get_transform_type(get_voxel_to_world_transform(data)) == LINEAR &&
+           get_transform_type(get_voxel_to_world_transform(mask)) == LINEAR;
+
+  if (linear) {
+    convert_3D_voxel_to_world(data, (Real) i, 0.0, 0.0, &wx, &wy, &wz);
+    convert_world_to_voxel(mask, wx, wy, wz, origin);
+    convert_3D_voxel_to_world(data, (Real) i, 1.0, 0.0, &wx, &wy, &wz);
+    convert_world_to_voxel(mask, wx, wy, wz, j_step);
+    convert_3D_voxel_to_world(data, (Real) i, 0.0, 1.0, &wx, &wy, &wz);
+    convert_world_to_voxel(mask, wx, wy, wz, k_step);
+
+    for_less(d, 0, 3) {
+      j_step[d] -= origin[d];
+      k_step[d] -= origin[d];
+      row[d] = origin[d];
+    }
+  }
+
+  for_less(j, 0, data_size[1]) {
+    if (linear) {
+      for_less(d, 0, 3)
+        voxel[d] = row[d];
+    }
+
+    for_less(k, 0, data_size[2]) {
+      if (linear) {
+        if (k > 0) {
+          for_less(d, 0, 3)
+            voxel[d] += k_step[d];
+        }
+      }
+      else {
+        convert_3D_voxel_to_world(data, (Real) i, (Real) j, (Real) k,
+                                  &wx, &wy, &wz);
+        convert_world_to_voxel(mask, wx, wy, wz, voxel);
+      }
+
+      keep[j*data_size[2]+k] =
+          (interpolate_mask(mask, mask_size, voxel) > MaskZeroThresh) !=
+          (invert_mask != FALSE);
+    }
+
+    if (linear) {
+      for_less(d, 0, 3)
+        row[d] += j_step[d];
+    }
+  }
+}
+
+/* Flags the voxels which a mask slice on the same grid keeps. */
+
+static void get_mask_slice(Volume mask_slice, Smallest_int keep[]) {
+
+  int
+    v, start, n_voxels;
+  Real
+    *values;
+  voxel_scan_struct
+    scan;
+
+  initialize_voxel_scan(&scan, mask_slice, 0);
+
+  while (get_next_voxel_span_values(&scan, TRUE, &start, &n_voxels, &values)) {
+    for_less(v, 0, n_voxels)
+      keep[start+v] = (values[v] > MaskZeroThresh) != (invert_mask != FALSE);
+  }
+
+  delete_voxel_scan(&scan);
+}
+
+/* Sets the voxels of a slice which are not kept to the zero voxel value,
+   working directly on the stored voxels of each type. */
+
+#define MASK_SPAN( type ) \
+  { \
+    type *ptr = (type *) span.voxels; \
+ \
+    for_less(v, 0, span.n_voxels) { \
+      if (!keep[span.start+v]) \
+        ptr[v] = (type) zero; \
+    } \
+  }
+
+static void mask_slice_voxels(Volume slice, Smallest_int keep[], Real zero) {
+
+  int
+    v;
+  Real
+    *values;
+  voxel_scan_struct
+    scan;
+  voxel_span_struct
+    span;
+
+  initialize_voxel_scan(&scan, slice, 0);
+
+  while (get_next_voxel_span(&scan, &span)) {
+    if (!scan.in_memory) {
+      ALLOC(values, span.n_voxels);
+      get_voxel_span_values(&span, TRUE, values);
+      for_less(v, 0, span.n_voxels) {
+        if (!keep[span.start+v])
+          values[v] = 0.0;
+      }
+      set_voxel_span_values(&scan, &span, values);
+      FREE(values);
+      continue;
+    }
+
+    switch (span.data_type) {
+    case UNSIGNED_BYTE:   MASK_SPAN( unsigned char );    break;
+    case SIGNED_BYTE:     MASK_SPAN( signed char );      break;
+    case UNSIGNED_SHORT:  MASK_SPAN( unsigned short );   break;
+    case SIGNED_SHORT:    MASK_SPAN( short );            break;
+    case UNSIGNED_INT:    MASK_SPAN( unsigned int );     break;
+    case SIGNED_INT:      MASK_SPAN( int );              break;
+    case FLOAT:           MASK_SPAN( float );            break;
+    case DOUBLE:          MASK_SPAN( double );           break;
+    default:
+      break;
+    }
+  }
+
+  delete_voxel_scan(&scan);
+}
+
+/* Reads one slice of a minc file into a 2D volume. */
+
+static void input_slice(Minc_file file) {
+
+  Real
+    amount_done;
+
+  while (input_more_minc_file(file, &amount_done))
+    {}
+
+  (void) advance_input_volume(file);
+}
+
+/* Masks the input a slice at a time, writing each slice of the output as
+   soon as it is masked, so that only a slice of the input, and of the mask
+   when it is on the same grid, is held in memory.  A mask on a different
+   grid is read whole and resampled incrementally. */
+
+static Status mask_volume_in_slices(char *infilename, char *maskfilename,
+                                    char *outfilename, char *history) {
+
+  Volume
+    header, mask_header, mask, slice, mask_slice;
+  Minc_file
+    in_file, mask_file, out_file;
+  STRING
+    *dim_names;
+  nc_type
+    data_type;
+  BOOLEAN
+    signed_flag;
+  Real
+    zero, voxel_min, voxel_max, real_min, real_max;
+  int
+    sizes[MAX_DIMENSIONS],
+    i, same_grid;
+  Smallest_int
+    *keep;
+  minc_output_options
+    options;
+  progress_struct
+    progress;
+
+  if (input_volume_header_only(infilename, 3, File_order_dimension_names,
+                               &header, (minc_input_options *)NULL) != OK ||
+      input_volume_header_only(maskfilename, 3, File_order_dimension_names,
+                               &mask_header, (minc_input_options *)NULL) != OK)
+    return(ERROR);
+
+  get_volume_sizes(header, sizes);
+  dim_names = get_volume_dimension_names(header);
+  same_grid = same_voxel_grid(header, mask_header);
+
+  MaskZeroThresh = get_mask_zero_threshold(mask_header);
+
+  if (debug)
+    print("mask is %son the input grid\n", same_grid ? "" : "not ");
+
+  slice = create_volume(2, &dim_names[1], NC_UNSPECIFIED, FALSE, 0.0, 0.0);
+  in_file = initialize_minc_input(infilename, slice,
+                                  (minc_input_options *)NULL);
+  if (in_file == (Minc_file)NULL)
+    return(ERROR);
+
+  mask = (Volume)NULL;
+  mask_slice = (Volume)NULL;
+  mask_file = (Minc_file)NULL;
+
+  if (same_grid) {
+    mask_slice = create_volume(2, &dim_names[1], NC_UNSPECIFIED, FALSE,
+                               0.0, 0.0);
+    mask_file = initialize_minc_input(maskfilename, mask_slice,
+                                      (minc_input_options *)NULL);
+    if (mask_file == (Minc_file)NULL)
+      return(ERROR);
+  }
+  else {
+    if (verbose)
+      printf ("Reading in mask data.\n");
+    if (input_volume(maskfilename, 3, File_order_dimension_names,
+                     NC_UNSPECIFIED, FALSE, 0.0, 0.0,
+                     TRUE, &mask, (minc_input_options *)NULL) != OK)
+      return(ERROR);
+  }
+
+  data_type = get_volume_nc_data_type(slice, &signed_flag);
+  get_volume_voxel_range(slice, &voxel_min, &voxel_max);
+  get_volume_real_range(slice, &real_min, &real_max);
+
+  set_default_minc_output_options(&options);
+  set_minc_output_real_range(&options, real_min, real_max);
+
+  out_file = initialize_minc_output(outfilename, 3, dim_names, sizes,
+                                    data_type, signed_flag,
+                                    voxel_min, voxel_max,
+                                    get_voxel_to_world_transform(header),
+                                    slice, &options);
+
+  if (out_file == (Minc_file)NULL ||
+      copy_auxiliary_data_from_minc_file(out_file, infilename,
+                                         history) != OK)
+    return(ERROR);
+
+  zero = CONVERT_VALUE_TO_VOXEL(slice, 0.0);
+
+  ALLOC(keep, sizes[1] * sizes[2]);
+
+  if (verbose) initialize_progress_report( &progress, TRUE, sizes[0], "Masking volume");
+  for_less(i, 0, sizes[0]) {
+
+    input_slice(in_file);
+
+    if (same_grid) {
+      input_slice(mask_file);
+      get_mask_slice(mask_slice, keep);
+    }
+    else
+      get_resampled_mask_slice(header, mask, i, keep);
+
+    mask_slice_voxels(slice, keep, zero);
+
+    if (output_minc_volume(out_file) != OK)
+      return(ERROR);
+
+    if (verbose) update_progress_report( &progress, i+1 );
+  }
+
+  if (verbose) terminate_progress_report( &progress );
+
+  FREE(keep);
+
+  (void) close_minc_output(out_file);
+  (void) close_minc_input(in_file);
+  delete_volume(slice);
+
+  if (same_grid) {
+    (void) close_minc_input(mask_file);
+    delete_volume(mask_slice);
+  }
+  else
+    delete_volume(mask);
+
+  delete_dimension_names(header, dim_names);
+  delete_volume(header);
+  delete_volume(mask_header);
+
+  return(OK);
+}
+
 int 
 main ( argc, argv )
      int argc;
@@ -155,6 +563,12 @@ main ( argc, argv )
   }
 
   
+				/* mask a slice at a time unless the whole
+				   volume is needed to normalize it */
+  if (stream_flag && !normalize)
+    return(mask_volume_in_slices(infilename, maskfilename, outfilename,
+                                 history));
+
 				/* check file to be used.  */
   
   
@@ -193,19 +607,7 @@ main ( argc, argv )
 				/* mask the data volume */
   zero = CONVERT_VALUE_TO_VOXEL(data, 0.0);
 
-  // Evaluate a zero threshold for the mask (to protect against the possibility
-  // of having small values like 1.0e-12 in the background, due to the way minc
-  // stores values by ranges.
-  if( mask->real_range_set ) {
-    // Mask uses an integer data type of some sort.
-    int v0 = convert_value_to_voxel( mask, 0.0 );
-    double r0 = convert_voxel_to_value( mask, v0 );
-    double r1 = convert_voxel_to_value( mask, v0+1 );
-    MaskZeroThresh = 0.50 * ( r0 + r1 );
-  } else {
-    // Cannot do better than this if mask is float or double.
-    MaskZeroThresh = 0.0;
-  }
+  MaskZeroThresh = get_mask_zero_threshold(mask);
 
   if (verbose) initialize_progress_report( &progress, TRUE, data_size[0], "Masking volume");
   for_less(i, 0, data_size[0]) {
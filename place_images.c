@@ -1,19 +1,23 @@
 #include  <volume_io/internal_volume_io.h>
 #include  <bicpl.h>
+#include  <image_codec.h>
+#include  <image_composite.h>
 
 int  main(
     int   argc,
     char  *argv[] )
 {
-    STRING            input_filename, colour_name, output_filename;
-    int               i, x, y, x_min, x_max, y_min, y_max, x_size, y_size;
-    int               image_x_min, image_x_max, image_y_min, image_y_max;
-    int               x_pos, y_pos, *x_poses, *y_poses, n_images;
-    int               start_x, end_x, start_y, end_y;
-    pixels_struct     in_pixels, *images, pixels;
-    Colour            background;
-    int               desired_x_size, desired_y_size;
-    BOOLEAN           desired_size_flag;
+    STRING               input_filename, colour_name, output_filename;
+    STRING               *filenames;
+    int                  i, x_min, x_max, y_min, y_max, x_size, y_size, nc;
+    int                  image_x_min, image_x_max, image_y_min, image_y_max;
+    int                  x_pos, y_pos, *x_poses, *y_poses, n_images;
+    int                  *x_sizes, *y_sizes;
+    pixels_struct        pixels;
+    Colour               background;
+    int                  desired_x_size, desired_y_size;
+    BOOLEAN              desired_size_flag;
+    image_layout_struct  layout;
 
     initialize_argument_processing( argc, argv );
 
@@ -26,11 +30,16 @@ int  main(
 
     background = convert_string_to_colour( colour_name );
 
-    images = NULL;
+    filenames = NULL;
     x_poses = NULL;
     y_poses = NULL;
+    x_sizes = NULL;
+    y_sizes = NULL;
     desired_size_flag = FALSE;
 
+    /*--- only the image sizes are read here, the images themselves are
+          read one at a time when the layout is rendered */
+
     n_images = 0;
     while( get_string_argument( NULL, &input_filename ) &&
            get_int_argument( 0, &x_pos ) &&
@@ -41,21 +50,29 @@ int  main(
             desired_size_flag = TRUE;
             desired_x_size = x_pos;
             desired_y_size = y_pos;
+            continue;
         }
         else if( equal_strings( input_filename, "-" ) )
         {
-            initialize_pixels( &in_pixels, 0, 0, 0, 0, 1.0, 1.0, RGB_PIXEL );
+            x_size = 0;
+            y_size = 0;
         }
         else
         {
-            if( input_rgb_file( input_filename, &in_pixels ) != OK )
+            if( input_image_header( input_filename, &x_size, &y_size,
+                                    &nc ) != OK )
             {
                 print( "Error in %s.\n", input_filename );
                 return( 1 );
             }
         }
 
-        ADD_ELEMENT_TO_ARRAY( images, n_images, in_pixels, DEFAULT_CHUNK_SIZE );
+        ADD_ELEMENT_TO_ARRAY( filenames, n_images, input_filename,
+                              DEFAULT_CHUNK_SIZE );
+        --n_images;
+        ADD_ELEMENT_TO_ARRAY( x_sizes, n_images, x_size, DEFAULT_CHUNK_SIZE );
+        --n_images;
+        ADD_ELEMENT_TO_ARRAY( y_sizes, n_images, y_size, DEFAULT_CHUNK_SIZE );
         --n_images;
         ADD_ELEMENT_TO_ARRAY( x_poses, n_images, x_pos, DEFAULT_CHUNK_SIZE );
         --n_images;
@@ -79,9 +96,9 @@ int  main(
         for_less( i, 0, n_images )
         {
             x_min = x_poses[i];
-            x_max = x_poses[i] + images[i].x_size - 1;
+            x_max = x_poses[i] + x_sizes[i] - 1;
             y_min = y_poses[i];
-            y_max = y_poses[i] + images[i].y_size - 1;
+            y_max = y_poses[i] + y_sizes[i] - 1;
 
             if( x_min < image_x_min )
                 image_x_min = x_min;
@@ -97,26 +114,28 @@ int  main(
     x_size = image_x_max - image_x_min + 1;
     y_size = image_y_max - image_y_min + 1;
 
-    initialize_pixels( &pixels, 0, 0, x_size, y_size, 1.0, 1.0, RGB_PIXEL );
+    /*--- positions are of the bottom left corner, layout offsets of the
+          top left */
 
-    for_less( x, 0, x_size )
-    for_less( y, 0, y_size )
-        PIXEL_RGB_COLOUR( pixels, x, y ) = background;
+    initialize_image_layout( &layout, x_size, y_size, background );
 
     for_less( i, 0, n_images )
     {
-        start_x = MAX( 0, image_x_min - x_poses[i] );
-        end_x =   MIN( images[i].x_size-1, image_x_max - x_poses[i] );
-        start_y = MAX( 0, image_y_min - y_poses[i] );
-        end_y =   MIN( images[i].y_size-1, image_y_max - y_poses[i] );
-        for_inclusive( x, start_x, end_x )
-        for_inclusive( y, start_y, end_y )
-            PIXEL_RGB_COLOUR( pixels, x + x_poses[i] - image_x_min,
-                                      y + y_poses[i] - image_y_min ) =
-                            PIXEL_RGB_COLOUR( images[i], x, y );
+        if( x_sizes[i] > 0 && y_sizes[i] > 0 )
+        {
+            add_image_layer( &layout, filenames[i],
+                             x_poses[i] - image_x_min,
+                             image_y_max - (y_poses[i] + y_sizes[i] - 1),
+                             REPLACE_BLEND );
+        }
     }
 
-    if( output_rgb_file( output_filename, &pixels ) != OK )
+    if( render_image_layout( &layout, &pixels ) != OK )
+        return( 1 );
+
+    delete_image_layout( &layout );
+
+    if( output_image_file( output_filename, &pixels ) != OK )
         return( 1 );
 
     return( 0 );
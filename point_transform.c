@@ -0,0 +1,651 @@
+#include  <volume_io/internal_volume_io.h>
+#include  <point_transform.h>
+
+#define   INVERSE_TOLERANCE          0.01
+#define   MAX_INVERSE_ITERATIONS     20
+
+/*--- the inverse displacements of a grid are cached when a batch has at
+      least this fraction of the number of grid nodes */
+
+#define   INVERSE_FIELD_FRACTION     0.25
+
+private  point_transform_stage_struct  *add_point_transform_stage(
+    point_transform_struct        *point_transform,
+    Point_transform_stage_types   type,
+    BOOLEAN                       inverse_flag )
+{
+    point_transform_stage_struct   *stage;
+
+    SET_ARRAY_SIZE( point_transform->stages, point_transform->n_stages,
+                    point_transform->n_stages+1, DEFAULT_CHUNK_SIZE );
+
+    stage = &point_transform->stages[point_transform->n_stages];
+    ++point_transform->n_stages;
+
+    stage->type = type;
+    stage->inverse_flag = inverse_flag;
+    stage->displacements = NULL;
+    stage->inverse_displacements = NULL;
+    stage->spline = NULL;
+    stage->transform = NULL;
+
+    return( stage );
+}
+
+/*--- appends a linear transform, composing it with the previous stage if
+      that is also affine */
+
+private  void  add_affine_stage(
+    point_transform_struct   *point_transform,
+    Transform                *linear )
+{
+    int                            i, j;
+    Real                           prev[N_DIMENSIONS][N_DIMENSIONS+1];
+    point_transform_stage_struct   *stage;
+
+    if( point_transform->n_stages > 0 &&
+        point_transform->stages[point_transform->n_stages-1].type ==
+                                                        AFFINE_STAGE )
+    {
+        stage = &point_transform->stages[point_transform->n_stages-1];
+
+        for_less( i, 0, N_DIMENSIONS )
+        for_less( j, 0, N_DIMENSIONS+1 )
+            prev[i][j] = stage->affine[i][j];
+
+        for_less( i, 0, N_DIMENSIONS )
+        {
+            for_less( j, 0, N_DIMENSIONS+1 )
+            {
+                stage->affine[i][j] =
+                              Transform_elem(*linear,i,0) * prev[0][j] +
+                              Transform_elem(*linear,i,1) * prev[1][j] +
+                              Transform_elem(*linear,i,2) * prev[2][j];
+            }
+            stage->affine[i][N_DIMENSIONS] += Transform_elem(*linear,i,3);
+        }
+    }
+    else
+    {
+        stage = add_point_transform_stage( point_transform, AFFINE_STAGE,
+                                           FALSE );
+
+        for_less( i, 0, N_DIMENSIONS )
+        for_less( j, 0, N_DIMENSIONS+1 )
+            stage->affine[i][j] = Transform_elem(*linear,i,j);
+    }
+}
+
+/*--- copies the displacement volume of a grid transform into a float
+      buffer over its three spatial dimensions, and finds the affine maps
+      between its voxels and world space */
+
+private  void  add_grid_stage(
+    point_transform_struct   *point_transform,
+    General_transform        *transform,
+    BOOLEAN                  inverse_flag )
+{
+    int                            d, a, b, c, v, n_dims, vector_dim;
+    int                            spatial_dims[N_DIMENSIONS], n_spatial;
+    int                            sizes[MAX_DIMENSIONS];
+    int                            index[MAX_DIMENSIONS];
+    Real                           voxel[MAX_DIMENSIONS];
+    Real                           origin[N_DIMENSIONS], world[N_DIMENSIONS];
+    STRING                         *dim_names;
+    Volume                         volume;
+    point_transform_stage_struct   *stage;
+    float                          *disp;
+
+    volume = (Volume) transform->displacement_volume;
+
+    n_dims = get_volume_n_dimensions( volume );
+    dim_names = get_volume_dimension_names( volume );
+    get_volume_sizes( volume, sizes );
+
+    vector_dim = -1;
+    n_spatial = 0;
+    for_less( d, 0, n_dims )
+    {
+        if( equal_strings( dim_names[d], MIvector_dimension ) )
+            vector_dim = d;
+        else if( n_spatial < N_DIMENSIONS )
+            spatial_dims[n_spatial++] = d;
+    }
+
+    delete_dimension_names( volume, dim_names );
+
+    if( vector_dim < 0 || n_spatial != N_DIMENSIONS ||
+        sizes[vector_dim] != N_DIMENSIONS )
+    {
+        stage = add_point_transform_stage( point_transform, GENERAL_STAGE,
+                                           inverse_flag );
+        stage->transform = transform;
+        return;
+    }
+
+    stage = add_point_transform_stage( point_transform, GRID_STAGE,
+                                       inverse_flag );
+
+    for_less( d, 0, N_DIMENSIONS )
+        stage->sizes[d] = sizes[spatial_dims[d]];
+
+    /*--- the world to voxel map from the images of the origin and the unit
+          vectors, and the voxel to world map likewise */
+
+    convert_world_to_voxel( volume, 0.0, 0.0, 0.0, voxel );
+    for_less( d, 0, N_DIMENSIONS )
+        origin[d] = voxel[spatial_dims[d]];
+
+    for_less( v, 0, N_DIMENSIONS )
+    {
+        convert_world_to_voxel( volume, v == X ? 1.0 : 0.0,
+                                v == Y ? 1.0 : 0.0,
+                                v == Z ? 1.0 : 0.0, voxel );
+        for_less( d, 0, N_DIMENSIONS )
+            stage->world_to_voxel[d][v] = voxel[spatial_dims[d]] - origin[d];
+    }
+
+    for_less( d, 0, N_DIMENSIONS )
+        stage->world_to_voxel[d][N_DIMENSIONS] = origin[d];
+
+    for_less( d, 0, MAX_DIMENSIONS )
+        voxel[d] = 0.0;
+
+    convert_voxel_to_world( volume, voxel, &world[X], &world[Y], &world[Z] );
+    for_less( v, 0, N_DIMENSIONS )
+        stage->voxel_to_world[v][N_DIMENSIONS] = world[v];
+
+    for_less( d, 0, N_DIMENSIONS )
+    {
+        voxel[spatial_dims[d]] = 1.0;
+        convert_voxel_to_world( volume, voxel,
+                                &world[X], &world[Y], &world[Z] );
+        voxel[spatial_dims[d]] = 0.0;
+
+        for_less( v, 0, N_DIMENSIONS )
+            stage->voxel_to_world[v][d] = world[v] -
+                                   stage->voxel_to_world[v][N_DIMENSIONS];
+    }
+
+    ALLOC( stage->displacements, N_DIMENSIONS *
+           stage->sizes[0] * stage->sizes[1] * stage->sizes[2] );
+
+    for_less( d, 0, MAX_DIMENSIONS )
+        index[d] = 0;
+
+    disp = stage->displacements;
+    for_less( a, 0, stage->sizes[0] )
+    {
+        index[spatial_dims[0]] = a;
+        for_less( b, 0, stage->sizes[1] )
+        {
+            index[spatial_dims[1]] = b;
+            for_less( c, 0, stage->sizes[2] )
+            {
+                index[spatial_dims[2]] = c;
+                for_less( v, 0, N_DIMENSIONS )
+                {
+                    index[vector_dim] = v;
+                    *disp = (float) get_volume_real_value( volume,
+                                     index[0], index[1], index[2],
+                                     index[3], index[4] );
+                    ++disp;
+                }
+            }
+        }
+    }
+}
+
+private  void  add_spline_stage(
+    point_transform_struct   *point_transform,
+    General_transform        *transform,
+    BOOLEAN                  inverse_flag )
+{
+    point_transform_stage_struct   *stage;
+
+    stage = add_point_transform_stage( point_transform, SPLINE_STAGE,
+                                       inverse_flag );
+
+    stage->spline = initialize_fast_thin_plate_spline(
+                              transform->n_dimensions, transform->n_dimensions,
+                              transform->n_points, transform->points,
+                              transform->displacements, 0.0 );
+}
+
+private  void  flatten_transform(
+    point_transform_struct   *point_transform,
+    General_transform        *transform,
+    BOOLEAN                  invert )
+{
+    int                            i, n_transforms;
+    point_transform_stage_struct   *stage;
+
+    if( transform->inverse_flag )
+        invert = !invert;
+
+    switch( get_transform_type( transform ) )
+    {
+    case LINEAR:
+        if( invert )
+            add_affine_stage( point_transform,
+                              transform->inverse_linear_transform );
+        else
+            add_affine_stage( point_transform, transform->linear_transform );
+        break;
+
+    case GRID_TRANSFORM:
+        add_grid_stage( point_transform, transform, invert );
+        break;
+
+    case THIN_PLATE_SPLINE:
+        if( transform->n_dimensions == N_DIMENSIONS )
+            add_spline_stage( point_transform, transform, invert );
+        else
+        {
+            stage = add_point_transform_stage( point_transform, GENERAL_STAGE,
+                                               invert );
+            stage->transform = transform;
+        }
+        break;
+
+    case CONCATENATED_TRANSFORM:
+        n_transforms = get_n_concated_transforms( transform );
+
+        for_less( i, 0, n_transforms )
+        {
+            flatten_transform( point_transform,
+                      get_nth_general_transform( transform,
+                                      invert ? n_transforms - 1 - i : i ),
+                      invert );
+        }
+        break;
+
+    default:
+        stage = add_point_transform_stage( point_transform, GENERAL_STAGE,
+                                           invert );
+        stage->transform = transform;
+        break;
+    }
+}
+
+/* ----------------------------- MNI Header -----------------------------------
+@NAME       : initialize_point_transform
+@INPUT      : transform
+              invert
+@OUTPUT     : point_transform
+@RETURNS    :
+@DESCRIPTION: Prepares the transform, or its inverse, for transforming
+              arrays of points.  The transform must not be deleted while
+              the point transform is in use.
+@METHOD     :
+@GLOBALS    :
+@CALLS      :
+@CREATED    :
+@MODIFIED   :
+---------------------------------------------------------------------------- */
+
+public  void  initialize_point_transform(
+    point_transform_struct   *point_transform,
+    General_transform        *transform,
+    BOOLEAN                  invert )
+{
+    point_transform->n_stages = 0;
+    point_transform->stages = NULL;
+
+    flatten_transform( point_transform, transform, invert );
+}
+
+public  void  delete_point_transform(
+    point_transform_struct   *point_transform )
+{
+    int                            s;
+    point_transform_stage_struct   *stage;
+
+    for_less( s, 0, point_transform->n_stages )
+    {
+        stage = &point_transform->stages[s];
+
+        if( stage->displacements != NULL )
+            FREE( stage->displacements );
+        if( stage->inverse_displacements != NULL )
+            FREE( stage->inverse_displacements );
+        if( stage->spline != NULL )
+            delete_fast_thin_plate_spline( stage->spline );
+    }
+
+    if( point_transform->n_stages > 0 )
+        FREE( point_transform->stages );
+
+    point_transform->n_stages = 0;
+}
+
+/*--- cubic interpolating spline weights, as for volume_io's cubic
+      interpolation */
+
+private  void  get_cubic_weights(
+    Real   t,
+    Real   weights[] )
+{
+    Real   t2, t3;
+
+    t2 = t * t;
+    t3 = t2 * t;
+
+    weights[0] = 0.5 * (-t3 + 2.0 * t2 - t);
+    weights[1] = 0.5 * (3.0 * t3 - 5.0 * t2 + 2.0);
+    weights[2] = 0.5 * (-3.0 * t3 + 4.0 * t2 + t);
+    weights[3] = 0.5 * (t3 - t2);
+}
+
+/*--- interpolates a displacement field at a world position: cubically
+      where the 4x4x4 neighbourhood is inside the grid, linearly near the
+      edges, from the nearest voxel within half a voxel of them, and zero
+      outside */
+
+private  void  evaluate_displacement_field(
+    point_transform_stage_struct   *stage,
+    float                          field[],
+    Real                           position[],
+    Real                           displacement[] )
+{
+    int     dim, a, b, c, n_taps, first[N_DIMENSIONS], index;
+    Real    voxel[N_DIMENSIONS], weights[N_DIMENSIONS][4], w_ab, w;
+    Real    t;
+    float   *value;
+
+    n_taps = 4;
+
+    for_less( dim, 0, N_DIMENSIONS )
+    {
+        voxel[dim] = stage->world_to_voxel[dim][0] * position[X] +
+                     stage->world_to_voxel[dim][1] * position[Y] +
+                     stage->world_to_voxel[dim][2] * position[Z] +
+                     stage->world_to_voxel[dim][3];
+
+        if( voxel[dim] < -0.5 || voxel[dim] > (Real) stage->sizes[dim] - 0.5 )
+        {
+            displacement[X] = 0.0;
+            displacement[Y] = 0.0;
+            displacement[Z] = 0.0;
+            return;
+        }
+
+        first[dim] = FLOOR( voxel[dim] );
+
+        if( first[dim] < 1 || first[dim] + 2 >= stage->sizes[dim] )
+            n_taps = MIN( n_taps, 2 );
+        if( first[dim] < 0 || first[dim] + 1 >= stage->sizes[dim] )
+            n_taps = 1;
+    }
+
+    for_less( dim, 0, N_DIMENSIONS )
+    {
+        t = voxel[dim] - (Real) first[dim];
+
+        if( n_taps == 4 )
+        {
+            get_cubic_weights( t, weights[dim] );
+            first[dim] -= 1;
+        }
+        else if( n_taps == 2 )
+        {
+            weights[dim][0] = 1.0 - t;
+            weights[dim][1] = t;
+        }
+        else
+        {
+            first[dim] = ROUND( voxel[dim] );
+            if( first[dim] < 0 )
+                first[dim] = 0;
+            else if( first[dim] >= stage->sizes[dim] )
+                first[dim] = stage->sizes[dim] - 1;
+            weights[dim][0] = 1.0;
+        }
+    }
+
+    displacement[X] = 0.0;
+    displacement[Y] = 0.0;
+    displacement[Z] = 0.0;
+
+    for_less( a, 0, n_taps )
+    {
+        for_less( b, 0, n_taps )
+        {
+            w_ab = weights[0][a] * weights[1][b];
+            index = ((first[0] + a) * stage->sizes[1] + first[1] + b) *
+                    stage->sizes[2] + first[2];
+            value = &field[N_DIMENSIONS * index];
+
+            for_less( c, 0, n_taps )
+            {
+                w = w_ab * weights[2][c];
+                displacement[X] += w * (Real) value[0];
+                displacement[Y] += w * (Real) value[1];
+                displacement[Z] += w * (Real) value[2];
+                value += N_DIMENSIONS;
+            }
+        }
+    }
+}
+
+/*--- finds x with x + d(x) = target by fixed point iteration from guess,
+      result may be the same as target */
+
+private  void  invert_displacement_field(
+    point_transform_stage_struct   *stage,
+    Real                           target_position[],
+    Real                           guess[],
+    Real                           result[] )
+{
+    int    iter, dim;
+    Real   displacement[N_DIMENSIONS], error, max_error;
+    Real   target[N_DIMENSIONS];
+
+    for_less( dim, 0, N_DIMENSIONS )
+    {
+        target[dim] = target_position[dim];
+        result[dim] = guess[dim];
+    }
+
+    for_less( iter, 0, MAX_INVERSE_ITERATIONS )
+    {
+        evaluate_displacement_field( stage, stage->displacements, result,
+                                     displacement );
+
+        max_error = 0.0;
+        for_less( dim, 0, N_DIMENSIONS )
+        {
+            error = result[dim] + displacement[dim] - target[dim];
+            result[dim] -= error;
+            max_error = MAX( max_error, FABS( error ) );
+        }
+
+        if( max_error < INVERSE_TOLERANCE )
+            break;
+    }
+}
+
+/*--- inverts the displacements at every grid node, each starting from the
+      inverse found at the previous node */
+
+private  void  create_inverse_displacements(
+    point_transform_stage_struct   *stage )
+{
+    int     a, b, c, dim;
+    Real    node[N_DIMENSIONS], guess[N_DIMENSIONS];
+    Real    result[N_DIMENSIONS], displacement[N_DIMENSIONS];
+    float   *inverse;
+
+    ALLOC( stage->inverse_displacements, N_DIMENSIONS *
+           stage->sizes[0] * stage->sizes[1] * stage->sizes[2] );
+
+    inverse = stage->inverse_displacements;
+
+    for_less( a, 0, stage->sizes[0] )
+    for_less( b, 0, stage->sizes[1] )
+    {
+        for_less( c, 0, stage->sizes[2] )
+        {
+            for_less( dim, 0, N_DIMENSIONS )
+            {
+                node[dim] = stage->voxel_to_world[dim][0] * (Real) a +
+                            stage->voxel_to_world[dim][1] * (Real) b +
+                            stage->voxel_to_world[dim][2] * (Real) c +
+                            stage->voxel_to_world[dim][3];
+            }
+
+            if( c == 0 )
+            {
+                evaluate_displacement_field( stage, stage->displacements,
+                                             node, displacement );
+                for_less( dim, 0, N_DIMENSIONS )
+                    guess[dim] = node[dim] - displacement[dim];
+            }
+            else
+            {
+                for_less( dim, 0, N_DIMENSIONS )
+                    guess[dim] = node[dim] + (Real) inverse[dim-N_DIMENSIONS];
+            }
+
+            invert_displacement_field( stage, node, guess, result );
+
+            for_less( dim, 0, N_DIMENSIONS )
+                inverse[dim] = (float) (result[dim] - node[dim]);
+
+            inverse += N_DIMENSIONS;
+        }
+    }
+}
+
+private  void  apply_grid_stage(
+    point_transform_stage_struct   *stage,
+    int                            n_points,
+    Real                           positions[] )
+{
+    int    p, dim, n_nodes;
+    Real   *pos, displacement[N_DIMENSIONS], guess[N_DIMENSIONS];
+
+    if( !stage->inverse_flag )
+    {
+        for_less( p, 0, n_points )
+        {
+            pos = &positions[N_DIMENSIONS*p];
+            evaluate_displacement_field( stage, stage->displacements, pos,
+                                         displacement );
+            for_less( dim, 0, N_DIMENSIONS )
+                pos[dim] += displacement[dim];
+        }
+        return;
+    }
+
+    /*--- the inverse is solved at each point, starting from the cached
+          inverse field for large batches, otherwise from the negated
+          forward displacement */
+
+    n_nodes = stage->sizes[0] * stage->sizes[1] * stage->sizes[2];
+
+    if( stage->inverse_displacements == NULL &&
+        (Real) n_points >= INVERSE_FIELD_FRACTION * (Real) n_nodes )
+        create_inverse_displacements( stage );
+
+    for_less( p, 0, n_points )
+    {
+        pos = &positions[N_DIMENSIONS*p];
+
+        if( stage->inverse_displacements != NULL )
+        {
+            evaluate_displacement_field( stage, stage->inverse_displacements,
+                                         pos, displacement );
+            for_less( dim, 0, N_DIMENSIONS )
+                guess[dim] = pos[dim] + displacement[dim];
+        }
+        else
+        {
+            evaluate_displacement_field( stage, stage->displacements, pos,
+                                         displacement );
+            for_less( dim, 0, N_DIMENSIONS )
+                guess[dim] = pos[dim] - displacement[dim];
+        }
+
+        invert_displacement_field( stage, pos, guess, pos );
+    }
+}
+
+/* ----------------------------- MNI Header -----------------------------------
+@NAME       : transform_point_array
+@INPUT      : point_transform
+              n_points
+              positions[n_points*N_DIMENSIONS]
+@OUTPUT     : positions
+@RETURNS    :
+@DESCRIPTION: Transforms the points in place, applying each stage to all the
+              points before the next.
+@METHOD     :
+@GLOBALS    :
+@CALLS      :
+@CREATED    :
+@MODIFIED   :
+---------------------------------------------------------------------------- */
+
+public  void  transform_point_array(
+    point_transform_struct   *point_transform,
+    int                      n_points,
+    Real                     positions[] )
+{
+    int                            s, p, dim;
+    Real                           x, y, z, *pos;
+    point_transform_stage_struct   *stage;
+
+    for_less( s, 0, point_transform->n_stages )
+    {
+        stage = &point_transform->stages[s];
+
+        switch( stage->type )
+        {
+        case AFFINE_STAGE:
+            for_less( p, 0, n_points )
+            {
+                pos = &positions[N_DIMENSIONS*p];
+                x = pos[X];
+                y = pos[Y];
+                z = pos[Z];
+                for_less( dim, 0, N_DIMENSIONS )
+                {
+                    pos[dim] = stage->affine[dim][0] * x +
+                               stage->affine[dim][1] * y +
+                               stage->affine[dim][2] * z +
+                               stage->affine[dim][3];
+                }
+            }
+            break;
+
+        case GRID_STAGE:
+            apply_grid_stage( stage, n_points, positions );
+            break;
+
+        case SPLINE_STAGE:
+            fast_thin_plate_spline_transform_points( stage->spline,
+                                   stage->inverse_flag, n_points,
+                                   positions, positions );
+            break;
+
+        case GENERAL_STAGE:
+            for_less( p, 0, n_points )
+            {
+                pos = &positions[N_DIMENSIONS*p];
+
+                /*--- the stage's own inverse flag is already included */
+
+                if( stage->inverse_flag != stage->transform->inverse_flag )
+                    general_inverse_transform_point( stage->transform,
+                                  pos[X], pos[Y], pos[Z],
+                                  &pos[X], &pos[Y], &pos[Z] );
+                else
+                    general_transform_point( stage->transform,
+                                  pos[X], pos[Y], pos[Z],
+                                  &pos[X], &pos[Y], &pos[Z] );
+            }
+            break;
+        }
+    }
+}
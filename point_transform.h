@@ -0,0 +1,61 @@
+#ifndef  DEF_POINT_TRANSFORM_H
+#define  DEF_POINT_TRANSFORM_H
+
+#include  <bicpl.h>
+#include  <fast_thin_plate_spline.h>
+
+/*--- a general transform flattened into a list of stages, applied in turn
+      to whole arrays of points: consecutive linear transforms are composed
+      into one affine, grid transforms hold their displacements in a float
+      buffer, and thin plate splines are evaluated by the fast spline code.
+      Other transforms are passed to volume_io point by point. */
+
+typedef  enum  { AFFINE_STAGE, GRID_STAGE, SPLINE_STAGE, GENERAL_STAGE }
+               Point_transform_stage_types;
+
+typedef  struct
+{
+    Point_transform_stage_types  type;
+    BOOLEAN                      inverse_flag;
+
+    /*--- AFFINE_STAGE */
+
+    Real                         affine[N_DIMENSIONS][N_DIMENSIONS+1];
+
+    /*--- GRID_STAGE, displacements[((a*sizes[1]+b)*sizes[2]+c)*3+dim] at
+          voxel a, b, c, and the inverse displacements, when cached */
+
+    int                          sizes[N_DIMENSIONS];
+    Real                         world_to_voxel[N_DIMENSIONS][N_DIMENSIONS+1];
+    Real                         voxel_to_world[N_DIMENSIONS][N_DIMENSIONS+1];
+    float                        *displacements;
+    float                        *inverse_displacements;
+
+    /*--- SPLINE_STAGE */
+
+    fast_thin_plate_spline       spline;
+
+    /*--- GENERAL_STAGE */
+
+    General_transform            *transform;
+} point_transform_stage_struct;
+
+typedef  struct
+{
+    int                            n_stages;
+    point_transform_stage_struct   *stages;
+} point_transform_struct;
+
+#ifndef  public
+#define       public   extern
+#define       public_was_defined_here
+#endif
+
+#include  <point_transform_prototypes.h>
+
+#ifdef  public_was_defined_here
+#undef       public
+#undef       public_was_defined_here
+#endif
+
+#endif
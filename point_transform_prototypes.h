@@ -0,0 +1,16 @@
+#ifndef  DEF_POINT_TRANSFORM_PROTOTYPES
+#define  DEF_POINT_TRANSFORM_PROTOTYPES
+
+public  void  initialize_point_transform(
+    point_transform_struct   *point_transform,
+    General_transform        *transform,
+    BOOLEAN                  invert );
+
+public  void  delete_point_transform(
+    point_transform_struct   *point_transform );
+
+public  void  transform_point_array(
+    point_transform_struct   *point_transform,
+    int                      n_points,
+    Real                     positions[] );
+#endif
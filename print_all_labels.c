@@ -1,5 +1,6 @@
 #include  <volume_io/internal_volume_io.h>
 #include  <bicpl.h>
+#include  <voxel_scan.h>
 
 private  void  usage(
     STRING   executable )
@@ -19,10 +20,11 @@ int  main(
 {
     STRING               volume_filename;
     Real                 min_volume, max_volume;
-    Real                 min_value, max_value, label;
-    int                  v0, v1, v2, v3, v4, n_labels;
+    Real                 min_value, max_value, *labels;
+    int                  n_labels, min_label, start, n_voxels;
     int                  i, *counts;
     Volume               volume;
+    voxel_scan_struct    scan;
 
     initialize_argument_processing( argc, argv );
 
@@ -49,10 +51,18 @@ int  main(
     for_less( i, 0, n_labels )
         counts[i] = 0;
 
-    BEGIN_ALL_VOXELS( volume, v0, v1, v2, v3, v4 )
-        label = get_volume_real_value( volume, v0, v1, v2, v3, v4 );
-        ++counts[ROUND(label) - ROUND(min_volume)];
-    END_ALL_VOXELS
+    min_label = ROUND( min_volume );
+
+    initialize_voxel_scan( &scan, volume, 0 );
+
+    while( get_next_voxel_span_values( &scan, TRUE, &start, &n_voxels,
+                                       &labels ) )
+    {
+        for_less( i, 0, n_voxels )
+            ++counts[ROUND(labels[i]) - min_label];
+    }
+
+    delete_voxel_scan( &scan );
 
     for_inclusive( i, ROUND(min_volume), ROUND(max_volume) )
     {
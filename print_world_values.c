@@ -21,8 +21,8 @@
 * 
 * Reads the list of minc files in <minclist> (note that to handle
 * glim_image files, it only reads the first word per line).  Reads the
-* list of world coordinates in <coordlist> assuming that each line (up
-* to a max of 255) contains space separated x, y, and z coordinates -
+* list of world coordinates in <coordlist> assuming that each line
+* contains space separated x, y, and z coordinates -
 * implicitly this means that this program only deals with 3D volumes.
 * Finally, for each minc it reads the real value of each coordinate
 * specified in the coordlist and writes it out as a tab separated list
@@ -32,9 +32,10 @@
 #include  <stdio.h>
 #include  <volume_io/internal_volume_io.h>
 #include  <bicpl.h>
+#include  <volume_sampler.h>
 
 void usage(char* progname) {
-	printf("Usage: %s <glimfile> <coordlist file> <outputfile>\n\nNote that the glimfile is the list of minc files, using the first column of the file as the list of minc files.\nThe coordlist file contains one world coordinate in the form 'x y z' per line with up to 255 lines.\n", progname);
+	printf("Usage: %s <glimfile> <coordlist file> <outputfile>\n\nNote that the glimfile is the list of minc files, using the first column of the file as the list of minc files.\nThe coordlist file contains one world coordinate in the form 'x y z' per line.\n", progname);
 }
 
 int  main(
@@ -43,13 +44,13 @@ int  main(
 {
 	STRING     glim_filename, coordlist_filename, output_filename;
 	char       cur_minc[255];
-	float      x[255], y[255], z[255];
-	double       value;
+	float      *x, *y, *z;
 	Volume     volume;
 	float      curx, cury, curz;
-	int        voxx, voxy, voxz, sizes[MAX_DIMENSIONS];
-	Real       voxel[MAX_DIMENSIONS];
-	int        i, r, keep_looping, n_coords;
+	Real       *values;
+	BOOLEAN    *inside;
+	int        i, keep_looping, n_coords;
+	volume_sampler_struct  sampler;
 	FILE*      coordfile;
 	FILE*      glimfile;
 	FILE*      outputfile;
@@ -78,13 +79,16 @@ int  main(
 	coordfile = fopen(coordlist_filename, "r");
 	i = 0;
 	keep_looping = 1;
-	while(keep_looping && i < 255) {
+	while(keep_looping) {
 		curx = 0;
 		cury = 0;
 		curz = 0;
 		if(fscanf(coordfile, "%f%f%f", &curx, &cury, &curz) != 3)
 			keep_looping = 0;
 		else {
+			SET_ARRAY_SIZE( x, i, i+1, DEFAULT_CHUNK_SIZE );
+			SET_ARRAY_SIZE( y, i, i+1, DEFAULT_CHUNK_SIZE );
+			SET_ARRAY_SIZE( z, i, i+1, DEFAULT_CHUNK_SIZE );
 			x[i] = curx;
 			y[i] = cury;
 			z[i] = curz;
@@ -98,6 +102,17 @@ int  main(
 	for(i = 0; i < n_coords; ++i)
 		printf("%d: %f %f %f\n", i, x[i], y[i], z[i]);
 
+	/* the coordinates are only transformed again when a volume is on a
+	   different grid than the previous one */
+	initialize_volume_sampler( &sampler, n_coords );
+	for(i = 0; i < n_coords; ++i)
+		set_volume_sampler_point( &sampler, i, x[i], y[i], z[i] );
+
+	if( n_coords > 0 ) {
+		ALLOC( values, n_coords );
+		ALLOC( inside, n_coords );
+	}
+
  
 	/* read the glim file to get the minc filenames */
 	keep_looping = 1;
@@ -128,28 +143,16 @@ int  main(
 			
 			fprintf(outputfile, "%s\t", cur_minc);
 
-			for(i = 0; i < n_coords ; ++i) {
-
-				get_volume_sizes( volume, sizes );
+			sample_volumes_at_points( &sampler, 1, &volume, -1, 0.0,
+											  &values, &inside );
 
-				convert_world_to_voxel(volume, x[i], y[i], z[i], voxel);
-
-				printf("Reading %f %f %f (%d %d %d) from %s\n", x[i], y[i], z[i], voxx, voxy, voxz, cur_minc);
-
-				voxx = ROUND( voxel[0] );
-				voxy = ROUND( voxel[1] );
-				voxz = ROUND( voxel[2] );
-
-				if( voxx >= 0 && voxx < sizes[0] &&
-					 voxy >= 0 && voxy < sizes[1] &&
-					 voxz >= 0 && voxz < sizes[2] )
-					{
-						value = (double) get_volume_real_value( volume, voxx, voxy, voxz, 0, 0);
-						fprintf(outputfile, "%lf\t", value );
-					} else {
-						printf("Voxel %d %d %d is outside %s\n", voxx, voxy, voxz, cur_minc);
-						fprintf(outputfile, "\t");
-					}
+			for(i = 0; i < n_coords ; ++i) {
+				if( inside[i] )
+					fprintf(outputfile, "%lf\t", (double) values[i] );
+				else {
+					printf("Point %f %f %f is outside %s\n", x[i], y[i], z[i], cur_minc);
+					fprintf(outputfile, "\t");
+				}
 			}
 			fprintf(outputfile, "\n");
 
@@ -161,6 +164,15 @@ int  main(
 	}
 	fclose(glimfile);
 	fclose(outputfile);
+
+	delete_volume_sampler( &sampler );
+	if( n_coords > 0 ) {
+		FREE( values );
+		FREE( inside );
+		FREE( x );
+		FREE( y );
+		FREE( z );
+	}
 		
 	return(0);
 
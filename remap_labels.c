@@ -0,0 +1,348 @@
+#include  <volume_io/internal_volume_io.h>
+#include  <bicpl.h>
+#include  <label_algebra.h>
+#include  <minc_labels.h>
+
+private  void  usage(
+    STRING  executable )
+{
+    STRING  usage_str = "\n\
+Usage: %s input output remap.txt|names.mnc|none [-unmapped value]\n\
+           [-over|-under input2 remap2.txt|names.mnc|none\n\
+            [-unmapped value]] ...\n\
+\n\
+     Maps the labels of a label volume or texture file through a remap\n\
+     file of pairs of from and to labels, one pair per line, and writes\n\
+     the result.  A remap given as a MINC file instead maps each named\n\
+     label of an input volume to the label with the same name in the\n\
+     label lookup of that file.  Labels not in the remap are left\n\
+     unchanged, or set to the -unmapped value given after it.  Each\n\
+     further input, remapped the same way, is merged into the labels so\n\
+     far, replacing them where it is nonzero for -over, or only filling in\n\
+     where they are zero for -under.  Inputs are volumes if the first ends\n\
+     in .mnc, otherwise texture files.\n\n";
+
+    print_error( usage_str, executable );
+}
+
+/*--- maps each named label of a volume to the label with the same name in
+      the label lookup of another MINC file */
+
+private  Status  input_label_table_remap(
+    STRING              input_filename,
+    STRING              names_filename,
+    label_remap_struct  *remap )
+{
+    int                 minc_id;
+    BOOLEAN             okay;
+    label_table_struct  from_table, to_table;
+
+    minc_id = miopen( input_filename, NC_NOWRITE );
+    if( minc_id == MI_ERROR )
+        return( ERROR );
+
+    okay = read_label_table( minc_id, &from_table );
+    (void) miclose( minc_id );
+
+    if( okay )
+    {
+        minc_id = miopen( names_filename, NC_NOWRITE );
+        okay = (minc_id != MI_ERROR);
+
+        if( okay )
+        {
+            okay = read_label_table( minc_id, &to_table );
+            (void) miclose( minc_id );
+        }
+
+        if( okay )
+        {
+            create_label_table_remap( &from_table, &to_table, remap );
+            delete_label_table( &to_table );
+        }
+    }
+
+    delete_label_table( &from_table );
+
+    if( !okay )
+    {
+        print_error( "Error reading the label lookups of %s and %s.\n",
+                     input_filename, names_filename );
+        return( ERROR );
+    }
+
+    return( OK );
+}
+
+/*--- adds an input and its remap, named by a remap file, a MINC file whose
+      label names are matched, or "none" */
+
+private  BOOLEAN  add_input(
+    STRING              input_filename,
+    STRING              remap_filename,
+    Label_merge_rules   rule,
+    int                 *n_inputs,
+    STRING              *input_filenames[],
+    label_remap_struct  *remaps[],
+    Label_merge_rules   *rules[] )
+{
+    SET_ARRAY_SIZE( *input_filenames, *n_inputs, *n_inputs+1,
+                    DEFAULT_CHUNK_SIZE );
+    SET_ARRAY_SIZE( *remaps, *n_inputs, *n_inputs+1, DEFAULT_CHUNK_SIZE );
+    SET_ARRAY_SIZE( *rules, *n_inputs, *n_inputs+1, DEFAULT_CHUNK_SIZE );
+
+    (*input_filenames)[*n_inputs] = input_filename;
+    (*rules)[*n_inputs] = rule;
+    initialize_label_remap( &(*remaps)[*n_inputs] );
+    ++(*n_inputs);
+
+    if( equal_strings( remap_filename, "none" ) )
+        return( TRUE );
+    else if( string_ends_in( remap_filename, ".mnc" ) )
+        return( input_label_table_remap( input_filename, remap_filename,
+                                         &(*remaps)[*n_inputs-1] ) == OK );
+    else
+        return( input_label_remap( remap_filename,
+                                   &(*remaps)[*n_inputs-1] ) == OK );
+}
+
+private  Status  remap_volumes(
+    int                 n_inputs,
+    STRING              input_filenames[],
+    label_remap_struct  remaps[],
+    Label_merge_rules   rules[],
+    STRING              output_filename )
+{
+    int                 i, min_label, max_label, min_result, max_result;
+    Real                min_value, max_value;
+    nc_type             type;
+    BOOLEAN             signed_flag;
+    Volume              *volumes, output;
+    label_remap_struct  **remap_ptrs;
+    Status              status;
+
+    ALLOC( volumes, n_inputs );
+    ALLOC( remap_ptrs, n_inputs );
+
+    for_less( i, 0, n_inputs )
+    {
+        if( input_volume( input_filenames[i], 3, XYZ_dimension_names,
+                          NC_UNSPECIFIED, FALSE, 0.0, 0.0,
+                          TRUE, &volumes[i],
+                          (minc_input_options *) NULL ) != OK )
+            return( ERROR );
+
+        remap_ptrs[i] = &remaps[i];
+
+        get_volume_real_range( volumes[i], &min_value, &max_value );
+        get_label_remap_range( &remaps[i], ROUND( min_value ),
+                               ROUND( max_value ), &min_result, &max_result );
+
+        if( i == 0 || min_result < min_label )
+            min_label = min_result;
+        if( i == 0 || max_result > max_label )
+            max_label = max_result;
+    }
+
+    /*--- store the labels in the smallest type which holds all of them */
+
+    if( max_label == min_label )
+        ++max_label;
+
+    if( min_label >= 0 && max_label <= 255 )
+    {
+        type = NC_BYTE;
+        signed_flag = FALSE;
+    }
+    else if( min_label >= -32768 && max_label <= 32767 )
+    {
+        type = NC_SHORT;
+        signed_flag = TRUE;
+    }
+    else
+    {
+        type = NC_INT;
+        signed_flag = TRUE;
+    }
+
+    output = copy_volume_definition( volumes[0], type, signed_flag,
+                                     (Real) min_label, (Real) max_label );
+    set_volume_real_range( output, (Real) min_label, (Real) max_label );
+
+    status = merge_label_volumes( n_inputs, volumes, remap_ptrs, rules,
+                                  output );
+
+    for_less( i, 0, n_inputs )
+        delete_volume( volumes[i] );
+
+    FREE( volumes );
+    FREE( remap_ptrs );
+
+    if( status == OK )
+    {
+        status = output_modified_volume( output_filename, NC_UNSPECIFIED,
+                                         FALSE, 0.0, 0.0, output,
+                                         input_filenames[0],
+                                         "Remapped labels\n",
+                                         (minc_output_options *) NULL );
+    }
+
+    delete_volume( output );
+
+    return( status );
+}
+
+private  Status  remap_textures(
+    int                 n_inputs,
+    STRING              input_filenames[],
+    label_remap_struct  remaps[],
+    Label_merge_rules   rules[],
+    STRING              output_filename )
+{
+    int            i, v, n_labels, n_values;
+    int            *labels, *new_labels;
+    Real           *values;
+    File_formats   format;
+
+    labels = NULL;
+    new_labels = NULL;
+    n_labels = 0;
+
+    for_less( v, 0, n_inputs )
+    {
+        if( input_texture_values( input_filenames[v], &n_values,
+                                  &values ) != OK )
+            return( ERROR );
+
+        if( v == 0 )
+        {
+            n_labels = n_values;
+            ALLOC( labels, n_labels );
+            ALLOC( new_labels, n_labels );
+        }
+        else if( n_values != n_labels )
+        {
+            print_error( "Texture files %s and %s differ in length.\n",
+                         input_filenames[0], input_filenames[v] );
+            return( ERROR );
+        }
+
+        remap_label_values( &remaps[v], n_values, values );
+
+        for_less( i, 0, n_values )
+            new_labels[i] = ROUND( values[i] );
+
+        FREE( values );
+
+        if( v == 0 )
+        {
+            for_less( i, 0, n_labels )
+                labels[i] = new_labels[i];
+        }
+        else
+            merge_labels( rules[v], n_labels, labels, new_labels );
+    }
+
+    ALLOC( values, n_labels );
+    for_less( i, 0, n_labels )
+        values[i] = (Real) labels[i];
+
+    if( string_ends_in( output_filename, ".mnc" ) )
+        format = BINARY_FORMAT;
+    else
+        format = ASCII_FORMAT;
+
+    (void) output_texture_values( output_filename, format,
+                                  n_labels, values );
+
+    FREE( values );
+    FREE( labels );
+    FREE( new_labels );
+
+    return( OK );
+}
+
+int  main(
+    int   argc,
+    char  *argv[] )
+{
+    STRING              input_filename, output_filename, remap_filename;
+    STRING              option, *input_filenames;
+    int                 i, n_inputs, unmapped_value;
+    Status              status;
+    Label_merge_rules   rule, *rules;
+    label_remap_struct  *remaps;
+
+    initialize_argument_processing( argc, argv );
+
+    n_inputs = 0;
+    input_filenames = NULL;
+    remaps = NULL;
+    rules = NULL;
+
+    if( !get_string_argument( NULL, &input_filename ) ||
+        !get_string_argument( NULL, &output_filename ) ||
+        !get_string_argument( NULL, &remap_filename ) )
+    {
+        usage( argv[0] );
+        return( 1 );
+    }
+
+    if( !add_input( input_filename, remap_filename, LABEL_OVER, &n_inputs,
+                    &input_filenames, &remaps, &rules ) )
+        return( 1 );
+
+    while( get_string_argument( NULL, &option ) )
+    {
+        if( equal_strings( option, "-unmapped" ) )
+        {
+            if( !get_int_argument( 0, &unmapped_value ) )
+            {
+                usage( argv[0] );
+                return( 1 );
+            }
+
+            set_label_remap_unmapped( &remaps[n_inputs-1], unmapped_value );
+        }
+        else if( equal_strings( option, "-over" ) ||
+                 equal_strings( option, "-under" ) )
+        {
+            if( equal_strings( option, "-over" ) )
+                rule = LABEL_OVER;
+            else
+                rule = LABEL_UNDER;
+
+            if( !get_string_argument( NULL, &input_filename ) ||
+                !get_string_argument( NULL, &remap_filename ) )
+            {
+                usage( argv[0] );
+                return( 1 );
+            }
+
+            if( !add_input( input_filename, remap_filename, rule, &n_inputs,
+                            &input_filenames, &remaps, &rules ) )
+                return( 1 );
+        }
+        else
+        {
+            usage( argv[0] );
+            return( 1 );
+        }
+    }
+
+    if( string_ends_in( input_filenames[0], ".mnc" ) )
+        status = remap_volumes( n_inputs, input_filenames, remaps, rules,
+                                output_filename );
+    else
+        status = remap_textures( n_inputs, input_filenames, remaps, rules,
+                                 output_filename );
+
+    for_less( i, 0, n_inputs )
+        delete_label_remap( &remaps[i] );
+
+    FREE( input_filenames );
+    FREE( remaps );
+    FREE( rules );
+
+    return( status != OK );
+}
@@ -1,5 +1,6 @@
 #include  <volume_io/internal_volume_io.h>
 #include  <bicpl.h>
+#include  <voxelize_polygons.h>
 
 int  main(
     int   argc,
@@ -9,9 +10,11 @@ int  main(
     STRING               output_filename;
     Volume               volume, label_volume;
     File_formats         format;
-    int                  obj, n_objects, scan_value;
+    int                  obj, n_objects, scan_value, inside_value;
+    int                  x, y, z, sizes[MAX_DIMENSIONS], n_voxels, index;
     object_struct        **objects;
     Real                 max_distance;
+    unsigned char        *labels;
 
     initialize_argument_processing( argc, argv );
 
@@ -21,11 +24,14 @@ int  main(
     {
         print_error(
            "Usage: %s  volume.mnc  object.obj  output_file.mnc\n", argv[0]);
+        print_error(
+           "      [scan_value] [max_distance] [inside_value]\n" );
         return( 1 );
     }
 
     (void) get_int_argument( 1, &scan_value );
     (void) get_real_argument( 1.0, &max_distance );
+    (void) get_int_argument( 0, &inside_value );
 
     if( input_volume_header_only( input_volume_filename, 3,
                             File_order_dimension_names, &volume, NULL) != OK )
@@ -47,6 +53,40 @@ int  main(
                                volume, label_volume, scan_value, max_distance );
     }
 
+    /*--- voxels inside closed polygon surfaces, found along voxel rows */
+
+    if( inside_value > 0 )
+    {
+        get_volume_sizes( volume, sizes );
+        n_voxels = sizes[X] * sizes[Y] * sizes[Z];
+        ALLOC( labels, n_voxels );
+        for_less( index, 0, n_voxels )
+            labels[index] = 0;
+
+        for_less( obj, 0, n_objects )
+        {
+            if( get_object_type( objects[obj] ) == POLYGONS )
+            {
+                voxelize_polygons( get_polygons_ptr( objects[obj] ), volume,
+                                   0, 1, labels );
+            }
+        }
+
+        for_less( x, 0, sizes[X] )
+        for_less( y, 0, sizes[Y] )
+        for_less( z, 0, sizes[Z] )
+        {
+            if( labels[VOXEL_LABEL_INDEX( sizes, x, y, z )] != 0 &&
+                get_volume_label_data_5d( label_volume, x, y, z, 0, 0 ) == 0 )
+            {
+                set_volume_label_data_5d( label_volume, x, y, z, 0, 0,
+                                          inside_value );
+            }
+        }
+
+        FREE( labels );
+    }
+
     print( "Done scanning\n" );
 
     (void) output_volume( output_filename, NC_UNSPECIFIED, FALSE,
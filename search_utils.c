@@ -421,3 +421,104 @@ public  void  delete_lookup_volume_coeficients(
     if( lookup->n_in_hash > 0 )
         delete_hash_table( &lookup->hash );
 }
+
+/*--- records, for each block of voxels, the range of values in the
+      interpolation neighbourhoods of its voxels, so a ray search can reject
+      an empty region with one lookup instead of a hyperslab per voxel */
+
+public  void  initialize_voxel_block_ranges(
+    voxel_block_range_struct  *blocks,
+    Volume                    volume,
+    int                       degrees_continuity,
+    int                       block_size )
+{
+    int    dim, sizes[N_DIMENSIONS], v[N_DIMENSIONS], start, end;
+    int    b[N_DIMENSIONS], first[N_DIMENSIONS], last[N_DIMENSIONS];
+    int    n_blocks, ind;
+    float  value;
+
+    if( block_size < 1 )
+        block_size = DEFAULT_VOXEL_BLOCK_SIZE;
+
+    get_volume_sizes( volume, sizes );
+
+    blocks->degrees_continuity = degrees_continuity;
+    blocks->block_size = block_size;
+
+    n_blocks = 1;
+    for_less( dim, 0, N_DIMENSIONS )
+    {
+        blocks->n_blocks[dim] = (sizes[dim] + block_size - 1) / block_size;
+        n_blocks *= blocks->n_blocks[dim];
+    }
+
+    ALLOC( blocks->min_values, n_blocks );
+    ALLOC( blocks->max_values, n_blocks );
+
+    for_less( ind, 0, n_blocks )
+    {
+        blocks->min_values[ind] = 1.0e30f;
+        blocks->max_values[ind] = -1.0e30f;
+    }
+
+    /*--- the neighbourhood of voxel i covers i+start to i+end-1, so the
+          value at v contributes to voxels v-end+1 to v-start */
+
+    start = -(degrees_continuity + 1) / 2;
+    end = start + degrees_continuity + 2;
+
+    for_less( v[X], 0, sizes[X] )
+    for_less( v[Y], 0, sizes[Y] )
+    for_less( v[Z], 0, sizes[Z] )
+    {
+        value = (float) get_volume_real_value( volume, v[X], v[Y], v[Z], 0, 0);
+
+        for_less( dim, 0, N_DIMENSIONS )
+        {
+            first[dim] = MAX( 0, v[dim] - end + 1 ) / block_size;
+            last[dim] = MIN( sizes[dim]-1, v[dim] - start ) / block_size;
+        }
+
+        for_inclusive( b[X], first[X], last[X] )
+        for_inclusive( b[Y], first[Y], last[Y] )
+        for_inclusive( b[Z], first[Z], last[Z] )
+        {
+            ind = IJK( b[X], b[Y], b[Z],
+                       blocks->n_blocks[Y], blocks->n_blocks[Z] );
+            if( value < blocks->min_values[ind] )
+                blocks->min_values[ind] = value;
+            if( value > blocks->max_values[ind] )
+                blocks->max_values[ind] = value;
+        }
+    }
+}
+
+public  BOOLEAN  voxel_block_might_contain_range(
+    voxel_block_range_struct  *blocks,
+    int                       voxel[],
+    Real                      min_value,
+    Real                      max_value )
+{
+    int   dim, b[N_DIMENSIONS], ind;
+
+    for_less( dim, 0, N_DIMENSIONS )
+    {
+        if( voxel[dim] < 0 )
+            return( TRUE );
+        b[dim] = voxel[dim] / blocks->block_size;
+        if( b[dim] >= blocks->n_blocks[dim] )
+            return( TRUE );
+    }
+
+    ind = IJK( b[X], b[Y], b[Z], blocks->n_blocks[Y], blocks->n_blocks[Z] );
+
+    return( (Real) blocks->max_values[ind] >= min_value &&
+            (Real) blocks->min_values[ind] <= max_value );
+}
+
+public  void  delete_voxel_block_ranges(
+    voxel_block_range_struct  *blocks )
+{
+    FREE( blocks->min_values );
+    FREE( blocks->max_values );
+}
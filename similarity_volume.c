@@ -1,5 +1,6 @@
 #include  <bicpl.h>
 #include  <volume_io/internal_volume_io.h>
+#include  <volume_derivatives.h>
 
 private  void  usage(
     STRING   executable_name )
@@ -13,22 +14,50 @@ Usage: %s  output.mnc w1 w2 w3  [w input.mnc] [w input.mnc]\n\
 
 }
 
+private  BOOLEAN  same_voxel_grid(
+    Volume   volume1,
+    Volume   volume2 );
+
+private  void  accumulate_similarity_on_grid(
+    Volume   volume,
+    int      degrees_continuity,
+    Real     weight,
+    Real     value_weight,
+    Real     deriv1_weight,
+    Real     deriv2_weight,
+    Real     test_value,
+    Real     test_deriv1_mag,
+    Real     test_deriv2_mag,
+    float    similarity[] );
+
+private  void  accumulate_similarity_resampled(
+    Volume   similarity_volume,
+    Volume   volume,
+    int      degrees_continuity,
+    Real     weight,
+    Real     value_weight,
+    Real     deriv1_weight,
+    Real     deriv2_weight,
+    Real     test_value,
+    Real     test_deriv1_mag,
+    Real     test_deriv2_mag,
+    float    similarity[] );
+
 int  main(
     int    argc,
     char   *argv[] )
 {
-    int                  v0, v1, v2, v3, v4;
+    int                  i, n_voxels;
     Real                 weight, value_weight, deriv1_weight, deriv2_weight;
-    Real                 xw, yw, zw, add;
+    Real                 xw, yw, zw;
     Real                 test_deriv1_mag, test_deriv2_mag;
-    Real                 deriv1_mag, deriv2_mag;
     Real                 v[MAX_DIMENSIONS], xv, yv, zv;
-    Real                 diff, value, test_value;
-    Real                 deriv1[3], test_deriv1[3];
-    Real                 deriv2[6], test_deriv2[6], sim;
+    Real                 test_value;
+    Real                 test_deriv1[3];
+    Real                 test_deriv2[6];
     Real                 min_value, max_value;
+    float                *similarity;
     int                  degrees_continuity, sizes[MAX_DIMENSIONS];
-    progress_struct      progress;
     STRING               input_filename;
     STRING               output_filename;
     STRING               history;
@@ -78,10 +107,12 @@ int  main(
             similarity_volume = copy_volume_definition( volume, NC_FLOAT, FALSE,
                                                         0.0, 0.0 );
 
-            BEGIN_ALL_VOXELS( similarity_volume, v0, v1, v2, v3, v4 )
-                set_volume_real_value( similarity_volume, v0, v1, v2, v3, v4,
-                                       0.0 );
-            END_ALL_VOXELS
+            get_volume_sizes( similarity_volume, sizes );
+            n_voxels = sizes[X] * sizes[Y] * sizes[Z];
+
+            ALLOC( similarity, n_voxels );
+            for_less( i, 0, n_voxels )
+                similarity[i] = 0.0f;
         }
 
         v[X] = xv;
@@ -105,93 +136,287 @@ int  main(
                                 test_deriv2[4] * test_deriv2[4] +
                                 test_deriv2[5] * test_deriv2[5] );
 
-        get_volume_sizes( volume, sizes );
+        /*--- inputs on the grid of the similarity volume are
+              differentiated directly from their voxel values */
+
+        if( same_voxel_grid( similarity_volume, volume ) )
+        {
+            accumulate_similarity_on_grid( volume, degrees_continuity,
+                                           weight, value_weight,
+                                           deriv1_weight, deriv2_weight,
+                                           test_value, test_deriv1_mag,
+                                           test_deriv2_mag, similarity );
+        }
+        else
+        {
+            accumulate_similarity_resampled( similarity_volume, volume,
+                                             degrees_continuity,
+                                             weight, value_weight,
+                                             deriv1_weight, deriv2_weight,
+                                             test_value, test_deriv1_mag,
+                                             test_deriv2_mag, similarity );
+        }
+
+        delete_volume( volume );
+    }
+
+    min_value = (Real) similarity[0];
+    max_value = min_value;
+
+    for_less( i, 0, n_voxels )
+    {
+        if( (Real) similarity[i] < min_value )
+            min_value = (Real) similarity[i];
+        else if( (Real) similarity[i] > max_value )
+            max_value = (Real) similarity[i];
+    }
+
+    print( "Range: %g %g\n", min_value, max_value );
+
+    set_volume_voxel_range( similarity_volume, min_value, max_value );
+    set_volume_real_range( similarity_volume, min_value, max_value );
+
+    set_volume_float_values( similarity_volume, similarity );
+    FREE( similarity );
+
+    history = create_string( "similarity_volume\n" );
+
+    (void) output_modified_volume( output_filename, NC_SHORT, FALSE,
+                           0.0, 0.0, similarity_volume, input_filename,
+                           history, (minc_output_options *) NULL );
+
 
-        initialize_progress_report( &progress, FALSE,
-                                sizes[X] * sizes[Y] * sizes[Z], "Similarity:" );
+    return( 0 );
+}
+
+private  BOOLEAN  same_voxel_grid(
+    Volume   volume1,
+    Volume   volume2 )
+{
+    int    dim, axis, sizes1[MAX_DIMENSIONS], sizes2[MAX_DIMENSIONS];
+    Real   voxel[N_DIMENSIONS], world1[N_DIMENSIONS], world2[N_DIMENSIONS];
 
-        BEGIN_ALL_VOXELS( similarity_volume, v0, v1, v2, v3, v4 )
-            v[0] = (Real) v0;
-            v[1] = (Real) v1;
-            v[2] = (Real) v2;
-            v[3] = (Real) v3;
-            v[4] = (Real) v4;
-            convert_voxel_to_world( similarity_volume, v, &xw, &yw, &zw );
-            evaluate_volume_in_world( volume, xw, yw, zw, degrees_continuity,
-                                      FALSE, 0.0, &value,
-                                      &deriv1[0], &deriv1[1], &deriv1[2],
-                                      &deriv2[0], &deriv2[1], &deriv2[2],
-                                      &deriv2[3], &deriv2[4], &deriv2[5] );
+    get_volume_sizes( volume1, sizes1 );
+    get_volume_sizes( volume2, sizes2 );
+
+    for_less( dim, 0, N_DIMENSIONS )
+    {
+        if( sizes1[dim] != sizes2[dim] )
+            return( FALSE );
+    }
+
+    /*--- compare the world positions of the origin and the unit voxel
+          steps, which fixes the linear voxel to world transform */
+
+    for_less( axis, -1, N_DIMENSIONS )
+    {
+        for_less( dim, 0, N_DIMENSIONS )
+            voxel[dim] = (dim == axis) ? 1.0 : 0.0;
+
+        convert_voxel_to_world( volume1, voxel,
+                                &world1[X], &world1[Y], &world1[Z] );
+        convert_voxel_to_world( volume2, voxel,
+                                &world2[X], &world2[Y], &world2[Z] );
+
+        for_less( dim, 0, N_DIMENSIONS )
+        {
+            if( FABS( world1[dim] - world2[dim] ) > 1.0e-6 )
+                return( FALSE );
+        }
+    }
+
+    return( TRUE );
+}
+
+/*--- adds the similarity of an input on the same grid, computing only the
+      derivatives whose weights are non-zero.  Voxel derivatives are
+      converted to world derivatives by the inverse transpose, G, of the
+      voxel to world transform: grad_w = G grad_v, hess_w = G hess_v G^T. */
+
+private  void  accumulate_similarity_on_grid(
+    Volume   volume,
+    int      degrees_continuity,
+    Real     weight,
+    Real     value_weight,
+    Real     deriv1_weight,
+    Real     deriv2_weight,
+    Real     test_value,
+    Real     test_deriv1_mag,
+    Real     test_deriv2_mag,
+    float    similarity[] )
+{
+    static  int   hessian_index[N_DIMENSIONS][N_DIMENSIONS] =
+                      { { 0, 1, 2 }, { 1, 3, 4 }, { 2, 4, 5 } };
+    int     i, a, b, c, d, sizes[MAX_DIMENSIONS], n_voxels;
+    Real    G[N_DIMENSIONS][N_DIMENSIONS], axis_vector[N_DIMENSIONS];
+    Real    deriv1[N_DIMENSIONS];
+    Real    grad[N_DIMENSIONS], mag, sum, diff;
+    float   *values, *derivs[6];
+
+    get_volume_sizes( volume, sizes );
+    n_voxels = sizes[X] * sizes[Y] * sizes[Z];
+
+    for_less( a, 0, N_DIMENSIONS )
+    {
+        for_less( b, 0, N_DIMENSIONS )
+            axis_vector[b] = (a == b) ? 1.0 : 0.0;
+
+        convert_voxel_normal_vector_to_world( volume, axis_vector,
+                                              &G[X][a], &G[Y][a], &G[Z][a] );
+    }
 
-            add = 0.0;
+    ALLOC( values, n_voxels );
+    get_volume_float_values( volume, values );
 
-            if( value_weight != 0.0 )
+    if( value_weight != 0.0 )
+    {
+        for_less( i, 0, n_voxels )
+        {
+            diff = (Real) values[i] - test_value;
+            similarity[i] += (float) (weight * value_weight * diff * diff);
+        }
+    }
+
+    if( deriv1_weight != 0.0 )
+    {
+        for_less( c, 0, N_DIMENSIONS )
+            ALLOC( derivs[c], n_voxels );
+
+        compute_volume_derivatives( sizes, values, degrees_continuity,
+                                    GRADIENT_COMPONENTS, derivs );
+
+        for_less( i, 0, n_voxels )
+        {
+            for_less( c, 0, N_DIMENSIONS )
+                grad[c] = (Real) derivs[c][i];
+
+            mag = 0.0;
+            for_less( a, 0, N_DIMENSIONS )
             {
-                diff = value - test_value;
-                add += value_weight * diff * diff;
+                deriv1[a] = G[a][X] * grad[X] + G[a][Y] * grad[Y] +
+                            G[a][Z] * grad[Z];
+                mag += deriv1[a] * deriv1[a];
             }
 
-            if( deriv1_weight != 0.0 )
-            {
-                deriv1_mag = sqrt( deriv1[0] * deriv1[0] +
-                                   deriv1[1] * deriv1[1] +
-                                   deriv1[2] * deriv1[2] );
+            diff = test_deriv1_mag - sqrt( mag );
+            similarity[i] += (float) (weight * deriv1_weight * diff * diff);
+        }
 
-                diff = test_deriv1_mag - deriv1_mag;
-                add += deriv1_weight * diff * diff;
-            }
+        for_less( c, 0, N_DIMENSIONS )
+            FREE( derivs[c] );
+    }
+
+    if( deriv2_weight != 0.0 )
+    {
+        for_less( c, 0, 6 )
+            ALLOC( derivs[c], n_voxels );
+
+        compute_volume_derivatives( sizes, values, degrees_continuity,
+                                    FULL_HESSIAN, derivs );
+
+        for_less( i, 0, n_voxels )
+        {
+            /*--- the magnitude counts each off-diagonal term once, as
+                  evaluate_volume_in_world() returns them */
 
-            if( deriv2_weight != 0.0 )
+            mag = 0.0;
+            for_less( a, 0, N_DIMENSIONS )
+            for_less( b, a, N_DIMENSIONS )
             {
-                deriv2_mag = sqrt( deriv2[0] * deriv2[0] +
-                                   deriv2[1] * deriv2[1] +
-                                   deriv2[2] * deriv2[2] +
-                                   deriv2[3] * deriv2[3] +
-                                   deriv2[4] * deriv2[4] +
-                                   deriv2[5] * deriv2[5] );
-
-                diff = test_deriv2_mag - deriv2_mag;
-                add += deriv2_weight * diff * diff;
+                sum = 0.0;
+                for_less( c, 0, N_DIMENSIONS )
+                for_less( d, 0, N_DIMENSIONS )
+                    sum += G[a][c] * G[b][d] *
+                           (Real) derivs[hessian_index[c][d]][i];
+
+                mag += sum * sum;
             }
 
-            sim = get_volume_real_value( similarity_volume,
-                                         v[0], v[1], v[2], v[3], v[4] );
-            set_volume_real_value( similarity_volume,
-                                   v[0], v[1], v[2], v[3], v[4],
-                                   sim + weight * add );
+            diff = test_deriv2_mag - sqrt( mag );
+            similarity[i] += (float) (weight * deriv2_weight * diff * diff);
+        }
 
-            update_progress_report( &progress, v0 * sizes[Y] * sizes[Z] +
-                                               v1 * sizes[Z] + v2 + 1 );
+        for_less( c, 0, 6 )
+            FREE( derivs[c] );
+    }
 
-        END_ALL_VOXELS
+    FREE( values );
+}
 
-        terminate_progress_report( &progress );
+private  void  accumulate_similarity_resampled(
+    Volume   similarity_volume,
+    Volume   volume,
+    int      degrees_continuity,
+    Real     weight,
+    Real     value_weight,
+    Real     deriv1_weight,
+    Real     deriv2_weight,
+    Real     test_value,
+    Real     test_deriv1_mag,
+    Real     test_deriv2_mag,
+    float    similarity[] )
+{
+    int              v0, v1, v2, v3, v4, sizes[MAX_DIMENSIONS];
+    Real             v[MAX_DIMENSIONS], xw, yw, zw, add;
+    Real             diff, value, deriv1[3], deriv2[6];
+    Real             deriv1_mag, deriv2_mag;
+    progress_struct  progress;
 
-        delete_volume( volume );
-    }
+    get_volume_sizes( similarity_volume, sizes );
 
-    min_value = get_volume_real_value( similarity_volume, 0, 0, 0, 0, 0 );
-    max_value = min_value;
+    initialize_progress_report( &progress, FALSE,
+                            sizes[X] * sizes[Y] * sizes[Z], "Similarity:" );
 
     BEGIN_ALL_VOXELS( similarity_volume, v0, v1, v2, v3, v4 )
-        sim = get_volume_real_value( similarity_volume, v0, v1, v2, v3, v4 );
-        if( sim < min_value )
-            min_value = sim;
-        else if( sim > max_value )
-            max_value = sim;
-    END_ALL_VOXELS
+        v[0] = (Real) v0;
+        v[1] = (Real) v1;
+        v[2] = (Real) v2;
+        v[3] = (Real) v3;
+        v[4] = (Real) v4;
+        convert_voxel_to_world( similarity_volume, v, &xw, &yw, &zw );
+        evaluate_volume_in_world( volume, xw, yw, zw, degrees_continuity,
+                                  FALSE, 0.0, &value,
+                                  &deriv1[0], &deriv1[1], &deriv1[2],
+                                  &deriv2[0], &deriv2[1], &deriv2[2],
+                                  &deriv2[3], &deriv2[4], &deriv2[5] );
 
-    print( "Range: %g %g\n", min_value, max_value );
+        add = 0.0;
 
-    set_volume_voxel_range( similarity_volume, min_value, max_value );
-    set_volume_real_range( similarity_volume, min_value, max_value );
+        if( value_weight != 0.0 )
+        {
+            diff = value - test_value;
+            add += value_weight * diff * diff;
+        }
 
-    history = create_string( "similarity_volume\n" );
+        if( deriv1_weight != 0.0 )
+        {
+            deriv1_mag = sqrt( deriv1[0] * deriv1[0] +
+                               deriv1[1] * deriv1[1] +
+                               deriv1[2] * deriv1[2] );
 
-    (void) output_modified_volume( output_filename, NC_SHORT, FALSE,
-                           0.0, 0.0, similarity_volume, input_filename,
-                           history, (minc_output_options *) NULL );
+            diff = test_deriv1_mag - deriv1_mag;
+            add += deriv1_weight * diff * diff;
+        }
+
+        if( deriv2_weight != 0.0 )
+        {
+            deriv2_mag = sqrt( deriv2[0] * deriv2[0] +
+                               deriv2[1] * deriv2[1] +
+                               deriv2[2] * deriv2[2] +
+                               deriv2[3] * deriv2[3] +
+                               deriv2[4] * deriv2[4] +
+                               deriv2[5] * deriv2[5] );
+
+            diff = test_deriv2_mag - deriv2_mag;
+            add += deriv2_weight * diff * diff;
+        }
 
+        similarity[IJK(v0,v1,v2,sizes[Y],sizes[Z])] += (float) (weight * add);
 
-    return( 0 );
+        update_progress_report( &progress, v0 * sizes[Y] * sizes[Z] +
+                                           v1 * sizes[Z] + v2 + 1 );
+
+    END_ALL_VOXELS
+
+    terminate_progress_report( &progress );
 }
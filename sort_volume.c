@@ -1,5 +1,6 @@
 #include  <volume_io/internal_volume_io.h>
 #include  <bicpl.h>
+#include  <voxel_scan.h>
 
 private  void  usage(
     STRING   executable )
@@ -17,12 +18,13 @@ int  main(
     char  *argv[] )
 {
     STRING               input_filename, output_filename, avg_filename;
-    int                  v0, v1, v2, sizes[MAX_DIMENSIONS];
-    int                  w0, w1, w2, index;
-    int                  i, n_bins, *counts, count, sum;
+    int                  sizes[MAX_DIMENSIONS];
+    int                  w0, w1, w2, index, bin;
+    int                  i, n_bins, *counts, count, sum, start, n_voxels;
     Volume               volume, avg, new_volume;
-    Real                 min_voxel, max_voxel, voxel;
+    Real                 min_voxel, max_voxel, *avg_voxels, *voxels;
     int                  int_min_voxel, int_max_voxel;
+    voxel_scan_struct    avg_scan, scan;
 
     initialize_argument_processing( argc, argv );
 
@@ -66,18 +68,17 @@ int  main(
     for_less( i, 0, n_bins )
         counts[i] = 0;
 
-    for_less( v0, 0, sizes[0] )
+    initialize_voxel_scan( &avg_scan, avg, 0 );
+
+    while( get_next_voxel_span_values( &avg_scan, FALSE, &start, &n_voxels,
+                                       &avg_voxels ) )
     {
-        for_less( v1, 0, sizes[1] )
-        {
-            for_less( v2, 0, sizes[2] )
-            {
-                voxel = get_volume_voxel_value( avg, v0, v1, v2, 0, 0 );
-                ++counts[ROUND(voxel)-int_min_voxel];
-            }
-        }
+        for_less( i, 0, n_voxels )
+            ++counts[ROUND(avg_voxels[i])-int_min_voxel];
     }
 
+    delete_voxel_scan( &avg_scan );
+
     print( "Counted\n" );
 
     sum = 0;
@@ -88,28 +89,33 @@ int  main(
         sum += count;
     }
 
-    for_less( v0, 0, sizes[0] )
+    initialize_voxel_scan( &avg_scan, avg, 0 );
+    initialize_voxel_scan( &scan, volume, 0 );
+
+    while( get_next_voxel_span_values( &avg_scan, FALSE, &start, &n_voxels,
+                                       &avg_voxels ) &&
+           get_next_voxel_span_values( &scan, FALSE, &start, &n_voxels,
+                                       &voxels ) )
     {
-        for_less( v1, 0, sizes[1] )
+        for_less( i, 0, n_voxels )
         {
-            for_less( v2, 0, sizes[2] )
-            {
-                voxel = get_volume_voxel_value( avg, v0, v1, v2, 0, 0 );
-                index = counts[ROUND(voxel)-int_min_voxel];
-                ++counts[ROUND(voxel)-int_min_voxel];
-
-                w2 = index % sizes[2];
-                index /= sizes[2];
-                w1 = index % sizes[1];
-                index /= sizes[1];
-                w0 = index;
-
-                voxel = get_volume_voxel_value( volume, v0, v1, v2, 0, 0 );
-                set_volume_voxel_value( new_volume, w0, w1, w2, 0, 0, voxel );
-            }
+            bin = ROUND(avg_voxels[i]) - int_min_voxel;
+            index = counts[bin];
+            ++counts[bin];
+
+            w2 = index % sizes[2];
+            index /= sizes[2];
+            w1 = index % sizes[1];
+            index /= sizes[1];
+            w0 = index;
+
+            set_volume_voxel_value( new_volume, w0, w1, w2, 0, 0, voxels[i] );
         }
     }
 
+    delete_voxel_scan( &avg_scan );
+    delete_voxel_scan( &scan );
+
     (void) output_modified_volume( output_filename, NC_UNSPECIFIED, FALSE,
                                    0.0, 0.0, new_volume, input_filename,
                                    "Reordered\n", NULL );
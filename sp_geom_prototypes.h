@@ -83,4 +83,15 @@ public  Status  output_mesh_fixed_midpoints(
 public  void  tri_mesh_reconcile_points(
     tri_mesh_struct  *dest_mesh,
     tri_mesh_struct  *src_mesh );
+
+public  int  tri_mesh_get_point_levels(
+    tri_mesh_struct  *mesh,
+    int              point_levels[],
+    int              parents[][2] );
+
+public  int  tri_mesh_extract_level(
+    tri_mesh_struct   *mesh,
+    int               level,
+    polygons_struct   *polygons,
+    int               mesh_indices[] );
 #endif
@@ -1,26 +1,41 @@
+#include  <volume_io/internal_volume_io.h>
 #include  <bicpl.h>
+#include  <volume_derivatives.h>
+#include  <volume_pyramid.h>
 
 int  main(
     int   argc,
     char  *argv[] )
 {
-    Volume     volume, new_volume;
-    Status     status;
-    int        nx, ny, nz;
-    STRING     input_filename, output_filename, history;
+    Volume               volume, new_volume;
+    Status               status;
+    int                  nx, ny, nz, dim, sizes[MAX_DIMENSIONS];
+    int                  new_sizes[N_DIMENSIONS];
+    Real                 ratios[N_DIMENSIONS];
+    float                *values, *new_values;
+    STRING               input_filename, output_filename, history;
+    STRING               filter_name;
+    Downsample_filters   filter;
 
     initialize_argument_processing( argc, argv );
 
     if( !get_string_argument( "", &input_filename ) ||
         !get_string_argument( "", &output_filename ) )
     {
-        print( "Usage: %s input.mnc output.mnc nx ny nz\n", argv[0] );
+        print( "Usage: %s input.mnc output.mnc nx ny nz [box|gaussian]\n",
+               argv[0] );
         return( 1 );
     }
 
     (void) get_int_argument( 50, &nx );
     (void) get_int_argument( 50, &ny );
     (void) get_int_argument( 50, &nz );
+    (void) get_string_argument( "box", &filter_name );
+
+    if( equal_strings( filter_name, "gaussian" ) )
+        filter = GAUSSIAN_FILTER;
+    else
+        filter = BOX_FILTER;
 
     status = input_volume( input_filename, 3, XYZ_dimension_names,
                       NC_UNSPECIFIED, FALSE, 0.0, 0.0,
@@ -29,7 +44,32 @@ int  main(
     if( status != OK )
         return( 1 );
 
-    new_volume = smooth_resample_volume( volume, nx, ny, nz );
+    get_volume_sizes( volume, sizes );
+
+    new_sizes[X] = nx;
+    new_sizes[Y] = ny;
+    new_sizes[Z] = nz;
+
+    for_less( dim, 0, N_DIMENSIONS )
+    {
+        if( new_sizes[dim] <= 0 )
+            new_sizes[dim] = sizes[dim];
+        ratios[dim] = (Real) sizes[dim] / (Real) new_sizes[dim];
+    }
+
+    ALLOC( values, sizes[X] * sizes[Y] * sizes[Z] );
+    ALLOC( new_values, new_sizes[X] * new_sizes[Y] * new_sizes[Z] );
+
+    get_volume_float_values( volume, values );
+
+    downsample_float_values( sizes, values, ratios, new_sizes, filter,
+                             new_values );
+
+    new_volume = create_downsampled_volume( volume, ratios, new_sizes,
+                                            new_values );
+
+    FREE( values );
+    FREE( new_values );
 
     history = "resampled";
 
@@ -0,0 +1,167 @@
+#include  <volume_io/internal_volume_io.h>
+#include  <bicpl.h>
+#include  <closest_point_tree.h>
+
+private  Status  output_distances(
+    STRING   filename,
+    int      n_points,
+    Real     distances[] );
+
+int  main(
+    int    argc,
+    char   *argv[] )
+{
+    STRING               input_filenames[2], output_filenames[2];
+    int                  i, n_objects, which;
+    File_formats         format;
+    object_struct        **object_list[2];
+    polygons_struct      *polygons[2];
+    closest_point_tree   tree;
+    Real                 *distances[2], dist, sum_x, sum_abs, sum_xx;
+    Real                 max_abs, total_abs, total_xx, hausdorff;
+    int                  n_total;
+
+    initialize_argument_processing( argc, argv );
+
+    if( !get_string_argument( NULL, &input_filenames[0] ) ||
+        !get_string_argument( NULL, &input_filenames[1] ) )
+    {
+        print_error(
+          "Usage: %s  input1.obj  input2.obj  [dist1.dat]  [dist2.dat]\n",
+          argv[0] );
+        print_error( "\n" );
+        print_error(
+          "     Prints the mean, RMS and Hausdorff distances between the\n" );
+        print_error(
+          "     surfaces, and optionally writes the signed distance from each\n");
+        print_error(
+          "     vertex to the other surface as binary floats.  Distances are\n");
+        print_error(
+          "     negative inside the other surface.\n" );
+        return( 1 );
+    }
+
+    (void) get_string_argument( NULL, &output_filenames[0] );
+    (void) get_string_argument( NULL, &output_filenames[1] );
+
+    for_less( which, 0, 2 )
+    {
+        if( input_graphics_file( input_filenames[which], &format, &n_objects,
+                                 &object_list[which] ) != OK ||
+            n_objects != 1 ||
+            get_object_type(object_list[which][0]) != POLYGONS )
+        {
+            print_error( "Error reading %s.\n", input_filenames[which] );
+            return( 1 );
+        }
+
+        polygons[which] = get_polygons_ptr( object_list[which][0] );
+    }
+
+    /*--- each surface's tree is built once, and all the vertices of the
+          other surface are queried against it */
+
+    for_less( which, 0, 2 )
+    {
+        ALLOC( distances[which], polygons[which]->n_points );
+
+        tree = create_closest_point_tree( polygons[1-which] );
+
+        evaluate_signed_surface_distances( tree, polygons[which]->n_points,
+                                           polygons[which]->points,
+                                           distances[which] );
+
+        delete_closest_point_tree( tree );
+    }
+
+    total_abs = 0.0;
+    total_xx = 0.0;
+    n_total = 0;
+    hausdorff = 0.0;
+
+    for_less( which, 0, 2 )
+    {
+        sum_x = 0.0;
+        sum_abs = 0.0;
+        sum_xx = 0.0;
+        max_abs = 0.0;
+
+        for_less( i, 0, polygons[which]->n_points )
+        {
+            dist = distances[which][i];
+            sum_x += dist;
+            sum_abs += FABS( dist );
+            sum_xx += dist * dist;
+            max_abs = MAX( max_abs, FABS( dist ) );
+        }
+
+        if( polygons[which]->n_points > 0 )
+        {
+            print( "%s to %s:\n", input_filenames[which],
+                   input_filenames[1-which] );
+            print( "    Mean Signed Distance: %g\n",
+                   sum_x / (Real) polygons[which]->n_points );
+            print( "      Mean Abs. Distance: %g\n",
+                   sum_abs / (Real) polygons[which]->n_points );
+            print( "            RMS Distance: %g\n",
+                   sqrt( sum_xx / (Real) polygons[which]->n_points ) );
+            print( "            Max Distance: %g\n", max_abs );
+        }
+
+        total_abs += sum_abs;
+        total_xx += sum_xx;
+        n_total += polygons[which]->n_points;
+        hausdorff = MAX( hausdorff, max_abs );
+    }
+
+    if( n_total > 0 )
+    {
+        print( "Symmetric:\n" );
+        print( "      Mean Abs. Distance: %g\n", total_abs / (Real) n_total );
+        print( "            RMS Distance: %g\n",
+               sqrt( total_xx / (Real) n_total ) );
+        print( "      Hausdorff Distance: %g\n", hausdorff );
+    }
+
+    for_less( which, 0, 2 )
+    {
+        if( output_filenames[which] != NULL &&
+            output_distances( output_filenames[which],
+                              polygons[which]->n_points,
+                              distances[which] ) != OK )
+            return( 1 );
+
+        FREE( distances[which] );
+        delete_object_list( 1, object_list[which] );
+    }
+
+    return( 0 );
+}
+
+private  Status  output_distances(
+    STRING   filename,
+    int      n_points,
+    Real     distances[] )
+{
+    FILE     *file;
+    int      i;
+    float    *buffer;
+    Status   status;
+
+    if( open_file( filename, WRITE_FILE, BINARY_FORMAT, &file ) != OK )
+        return( ERROR );
+
+    ALLOC( buffer, n_points );
+
+    for_less( i, 0, n_points )
+        buffer[i] = (float) distances[i];
+
+    status = io_binary_data( file, WRITE_FILE, (void *) buffer, sizeof(float),
+                             n_points );
+
+    FREE( buffer );
+
+    (void) close_file( file );
+
+    return( status );
+}
@@ -1,5 +1,6 @@
 #include  <volume_io/internal_volume_io.h>
 #include  <bicpl.h>
+#include  <voxelize_polygons.h>
 
 int  main(
     int   argc,
@@ -11,10 +12,10 @@ int  main(
     Real                 min_value, max_value, value;
     STRING               history;
     File_formats         format;
-    Volume               volume, label_volume;
-    int                  x, y, z, n_objects, label, voxel[MAX_DIMENSIONS];
+    Volume               volume;
+    int                  x, y, z, n_objects, n_voxels, index;
     int                  sizes[MAX_DIMENSIONS];
-    int                  range_changed[2][N_DIMENSIONS];
+    unsigned char        *labels;
     object_struct        **objects;
     BOOLEAN              set_value_specified;
 
@@ -40,8 +41,6 @@ int  main(
                       TRUE, &volume, NULL ) != OK )
         return( 1 );
 
-    label_volume = create_label_volume( volume, NC_BYTE );
-
     STRING * original_dimnames = create_output_dim_names( volume, 
                                                           input_volume_filename,
                                                           NULL, sizes );
@@ -50,9 +49,9 @@ int  main(
                              &format, &n_objects, &objects ) != OK )
         return( 1 );
 
-    if( n_objects < 1 )
+    if( n_objects < 1 || get_object_type( objects[0] ) != POLYGONS )
     {
-        print( "No objects in %s.\n", input_surface_filename);
+        print( "No polygons in %s.\n", input_surface_filename);
         return( 1 );
     }
 
@@ -61,25 +60,14 @@ int  main(
 
     print( "Scanning object to volume.\n" );
 
-    scan_object_to_volume( objects[0], volume, label_volume, 1, 0.0 );
-
-/*
-    dilate_voxels_3d( volume, label_volume,
-                      1.0, 1.0, 0.0, -1.0, 
-                      0.0, 0.0, 0.0, -1.0,
-                      1.0, EIGHT_NEIGHBOURS, range_changed );
+    /*--- 1 on the surface, 2 inside it, 0 outside */
 
-    dilate_voxels_3d( volume, label_volume,
-                      0.0, 0.0, 0.0, -1.0,
-                      1.0, 1.0, 0.0, -1.0, 
-                      0.0, EIGHT_NEIGHBOURS, range_changed );
-*/
+    n_voxels = sizes[X] * sizes[Y] * sizes[Z];
+    ALLOC( labels, n_voxels );
+    for_less( index, 0, n_voxels )
+        labels[index] = 0;
 
-    voxel[0] = 0;
-    voxel[1] = 0;
-    voxel[2] = 0;
-    fill_connected_voxels( volume, label_volume, EIGHT_NEIGHBOURS,
-                           voxel, 0, 0, 2, 0.0, -1.0, range_changed );
+    voxelize_polygons( get_polygons_ptr( objects[0] ), volume, 1, 2, labels );
 
     print( "Masking off external voxels.\n" );
 
@@ -92,9 +80,7 @@ int  main(
         {
             for_less( z, 0, sizes[Z] )
             {
-                label = (int) get_volume_real_value( label_volume, x, y, z,
-                                                     0, 0 );
-                if( label == 2 )
+                if( labels[VOXEL_LABEL_INDEX( sizes, x, y, z )] == 0 )
                 {
                     if( min_value <= max_value )
                     {
@@ -110,7 +96,7 @@ int  main(
     }
     
     delete_object_list( n_objects, objects );
-    delete_volume( label_volume );
+    FREE( labels );
 
     history = create_string( "Surface masked.\n" );
 
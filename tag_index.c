@@ -0,0 +1,772 @@
+#include  <volume_io/internal_volume_io.h>
+#include  <tag_index.h>
+
+/*--- a k-d tree over tag positions: each node covers a contiguous run of
+      the tags in tree order, and stores the bounding box of that run */
+
+#define  MAX_TAGS_IN_LEAF   8
+
+typedef  struct
+{
+    int     start;
+    int     end;
+    int     children[2];
+    Real    limits[2][N_DIMENSIONS];
+} tag_node_struct;
+
+struct  tag_index_struct
+{
+    int               n_tags;
+    int               *tag_ids;
+    Real              *coords;
+    int               n_nodes;
+    tag_node_struct   *nodes;
+};
+
+#define  TAG_COORD( index, i, dim )  ((index)->coords[(i)*N_DIMENSIONS+(dim)])
+
+private  void  select_tag_median(
+    Real    **tags,
+    int     tag_ids[],
+    int     axis,
+    int     start,
+    int     end,
+    int     median )
+{
+    int    lo, hi, i, j, swap;
+    Real   pivot;
+
+    lo = start;
+    hi = end - 1;
+
+    while( lo < hi )
+    {
+        pivot = tags[tag_ids[(lo+hi)/2]][axis];
+        i = lo;
+        j = hi;
+
+        do
+        {
+            while( tags[tag_ids[i]][axis] < pivot )
+                ++i;
+            while( pivot < tags[tag_ids[j]][axis] )
+                --j;
+
+            if( i <= j )
+            {
+                swap = tag_ids[i];
+                tag_ids[i] = tag_ids[j];
+                tag_ids[j] = swap;
+                ++i;
+                --j;
+            }
+        }
+        while( i <= j );
+
+        if( median <= j )
+            hi = j;
+        else if( median >= i )
+            lo = i;
+        else
+            break;
+    }
+}
+
+private  int  build_tag_node(
+    tag_index   index,
+    Real        **tags,
+    int         start,
+    int         end )
+{
+    int               node_index, i, dim, axis, median, left, right;
+    Real              width, max_width;
+    tag_node_struct   *node;
+
+    node_index = index->n_nodes;
+    SET_ARRAY_SIZE( index->nodes, index->n_nodes, index->n_nodes+1,
+                    DEFAULT_CHUNK_SIZE );
+    ++index->n_nodes;
+
+    node = &index->nodes[node_index];
+    node->start = start;
+    node->end = end;
+    node->children[0] = -1;
+    node->children[1] = -1;
+
+    for_less( dim, 0, N_DIMENSIONS )
+    {
+        node->limits[0][dim] = tags[index->tag_ids[start]][dim];
+        node->limits[1][dim] = tags[index->tag_ids[start]][dim];
+    }
+
+    for_less( i, start+1, end )
+    {
+        for_less( dim, 0, N_DIMENSIONS )
+        {
+            node->limits[0][dim] = MIN( node->limits[0][dim],
+                                        tags[index->tag_ids[i]][dim] );
+            node->limits[1][dim] = MAX( node->limits[1][dim],
+                                        tags[index->tag_ids[i]][dim] );
+        }
+    }
+
+    if( end - start <= MAX_TAGS_IN_LEAF )
+        return( node_index );
+
+    axis = 0;
+    max_width = -1.0;
+    for_less( dim, 0, N_DIMENSIONS )
+    {
+        width = node->limits[1][dim] - node->limits[0][dim];
+        if( width > max_width )
+        {
+            axis = dim;
+            max_width = width;
+        }
+    }
+
+    if( max_width <= 0.0 )
+        return( node_index );
+
+    median = (start + end) / 2;
+    select_tag_median( tags, index->tag_ids, axis, start, end, median );
+
+    /*--- the node array may move while the children are built */
+
+    left = build_tag_node( index, tags, start, median );
+    right = build_tag_node( index, tags, median, end );
+
+    index->nodes[node_index].children[0] = left;
+    index->nodes[node_index].children[1] = right;
+
+    return( node_index );
+}
+
+public  tag_index  create_tag_index(
+    int     n_tags,
+    Real    **tags )
+{
+    int         i, dim;
+    tag_index   index;
+
+    ALLOC( index, 1 );
+
+    index->n_tags = n_tags;
+    index->n_nodes = 0;
+    index->nodes = NULL;
+
+    if( n_tags == 0 )
+        return( index );
+
+    ALLOC( index->tag_ids, n_tags );
+    for_less( i, 0, n_tags )
+        index->tag_ids[i] = i;
+
+    (void) build_tag_node( index, tags, 0, n_tags );
+
+    ALLOC( index->coords, N_DIMENSIONS * n_tags );
+    for_less( i, 0, n_tags )
+    {
+        for_less( dim, 0, N_DIMENSIONS )
+            TAG_COORD( index, i, dim ) = tags[index->tag_ids[i]][dim];
+    }
+
+    return( index );
+}
+
+public  void  delete_tag_index(
+    tag_index   index )
+{
+    if( index->n_tags > 0 )
+    {
+        FREE( index->tag_ids );
+        FREE( index->coords );
+        FREE( index->nodes );
+    }
+
+    FREE( index );
+}
+
+public  int  tag_index_get_n_tags(
+    tag_index   index )
+{
+    return( index->n_tags );
+}
+
+private  Real  sq_distance_to_node(
+    tag_node_struct  *node,
+    Real             point[] )
+{
+    int    dim;
+    Real   diff, dist_sq;
+
+    dist_sq = 0.0;
+    for_less( dim, 0, N_DIMENSIONS )
+    {
+        if( point[dim] < node->limits[0][dim] )
+            diff = node->limits[0][dim] - point[dim];
+        else if( point[dim] > node->limits[1][dim] )
+            diff = point[dim] - node->limits[1][dim];
+        else
+            continue;
+
+        dist_sq += diff * diff;
+    }
+
+    return( dist_sq );
+}
+
+private  Real  sq_distance_to_tag(
+    tag_index   index,
+    int         i,
+    Real        point[] )
+{
+    Real   dx, dy, dz;
+
+    dx = TAG_COORD( index, i, X ) - point[X];
+    dy = TAG_COORD( index, i, Y ) - point[Y];
+    dz = TAG_COORD( index, i, Z ) - point[Z];
+
+    return( dx * dx + dy * dy + dz * dz );
+}
+
+/*--- orders candidates by distance, then by tag number, so that results
+      match a brute force search over the tags in file order */
+
+private  BOOLEAN  closer_tag(
+    Real   dist_sq1,
+    int    tag1,
+    Real   dist_sq2,
+    int    tag2 )
+{
+    return( dist_sq1 < dist_sq2 || (dist_sq1 == dist_sq2 && tag1 < tag2) );
+}
+
+/*--- k-nearest search, keeping found[] sorted and at most k long */
+
+private  void  search_k_nearest(
+    tag_index   index,
+    int         node_index,
+    Real        point[],
+    int         k,
+    Real        max_dist_sq,
+    int         *n_found,
+    int         found[],
+    Real        dist_sq[] )
+{
+    int               i, pos, tag, first, second;
+    Real              d, bound;
+    tag_node_struct   *node;
+
+    node = &index->nodes[node_index];
+
+    /*--- a negative max_dist_sq means no limit */
+
+    if( *n_found == k )
+        bound = dist_sq[k-1];
+    else
+        bound = max_dist_sq;
+
+    if( bound >= 0.0 && sq_distance_to_node( node, point ) > bound )
+        return;
+
+    if( node->children[0] < 0 )
+    {
+        for_less( i, node->start, node->end )
+        {
+            d = sq_distance_to_tag( index, i, point );
+            tag = index->tag_ids[i];
+
+            if( (max_dist_sq >= 0.0 && d > max_dist_sq) ||
+                (*n_found == k && !closer_tag( d, tag, dist_sq[k-1],
+                                               found[k-1] )) )
+                continue;
+
+            if( *n_found < k )
+                ++(*n_found);
+
+            pos = *n_found - 1;
+            while( pos > 0 && closer_tag( d, tag, dist_sq[pos-1], found[pos-1]))
+            {
+                found[pos] = found[pos-1];
+                dist_sq[pos] = dist_sq[pos-1];
+                --pos;
+            }
+
+            found[pos] = tag;
+            dist_sq[pos] = d;
+        }
+        return;
+    }
+
+    if( sq_distance_to_node( &index->nodes[node->children[0]], point ) <=
+        sq_distance_to_node( &index->nodes[node->children[1]], point ) )
+    {
+        first = node->children[0];
+        second = node->children[1];
+    }
+    else
+    {
+        first = node->children[1];
+        second = node->children[0];
+    }
+
+    search_k_nearest( index, first, point, k, max_dist_sq,
+                      n_found, found, dist_sq );
+    search_k_nearest( index, second, point, k, max_dist_sq,
+                      n_found, found, dist_sq );
+}
+
+/*--- returns the tag closest to point, or -1 if there is none within
+      max_distance; a negative max_distance means no limit */
+
+public  int  tag_index_find_nearest(
+    tag_index   index,
+    Real        point[],
+    Real        max_distance,
+    Real        *distance )
+{
+    int    found;
+    Real   dist;
+
+    if( tag_index_find_k_nearest( index, point, 1, max_distance,
+                                  &found, &dist ) == 0 )
+        return( -1 );
+
+    if( distance != NULL )
+        *distance = dist;
+
+    return( found );
+}
+
+/*--- finds up to k tags closest to point, in increasing order of
+      distance, and returns how many were found */
+
+public  int  tag_index_find_k_nearest(
+    tag_index   index,
+    Real        point[],
+    int         k,
+    Real        max_distance,
+    int         found[],
+    Real        distances[] )
+{
+    int    n_found, i;
+    Real   max_dist_sq;
+
+    if( index->n_tags == 0 || k <= 0 )
+        return( 0 );
+
+    if( max_distance < 0.0 )
+        max_dist_sq = -1.0;
+    else
+        max_dist_sq = max_distance * max_distance;
+
+    n_found = 0;
+    search_k_nearest( index, 0, point, k, max_dist_sq,
+                      &n_found, found, distances );
+
+    for_less( i, 0, n_found )
+        distances[i] = sqrt( distances[i] );
+
+    return( n_found );
+}
+
+private  void  add_found_tag(
+    int     tag,
+    Real    dist,
+    int     n_found,
+    int     *n_alloced,
+    int     *found[],
+    Real    *distances[] )
+{
+    int   new_n_alloced;
+
+    if( n_found >= *n_alloced )
+    {
+        new_n_alloced = MAX( 2 * *n_alloced, DEFAULT_CHUNK_SIZE );
+        SET_ARRAY_SIZE( *found, *n_alloced, new_n_alloced,
+                        DEFAULT_CHUNK_SIZE );
+        if( distances != NULL )
+        {
+            SET_ARRAY_SIZE( *distances, *n_alloced, new_n_alloced,
+                            DEFAULT_CHUNK_SIZE );
+        }
+        *n_alloced = new_n_alloced;
+    }
+
+    (*found)[n_found] = tag;
+    if( distances != NULL )
+        (*distances)[n_found] = dist;
+}
+
+/*--- shell sort by distance and tag number, or by tag number alone if
+      there are no distances */
+
+private  void  sort_found_tags(
+    int     n_found,
+    int     found[],
+    Real    distances[] )
+{
+    int    gap, i, j, tag;
+    Real   dist;
+
+    for( gap = 1;  gap < n_found / 3;  gap = 3 * gap + 1 )
+    {}
+
+    for( ;  gap > 0;  gap /= 3 )
+    {
+        for_less( i, gap, n_found )
+        {
+            tag = found[i];
+            if( distances != NULL )
+                dist = distances[i];
+            else
+                dist = 0.0;
+
+            for( j = i;  j >= gap;  j -= gap )
+            {
+                if( distances != NULL )
+                {
+                    if( !closer_tag( dist, tag, distances[j-gap], found[j-gap]))
+                        break;
+                    distances[j] = distances[j-gap];
+                }
+                else if( tag > found[j-gap] )
+                    break;
+
+                found[j] = found[j-gap];
+            }
+
+            found[j] = tag;
+            if( distances != NULL )
+                distances[j] = dist;
+        }
+    }
+}
+
+private  void  search_within_distance(
+    tag_index   index,
+    int         node_index,
+    Real        point[],
+    Real        max_dist_sq,
+    int         *n_found,
+    int         *n_alloced,
+    int         *found[],
+    Real        *distances[] )
+{
+    int               i;
+    Real              d;
+    tag_node_struct   *node;
+
+    node = &index->nodes[node_index];
+
+    if( sq_distance_to_node( node, point ) > max_dist_sq )
+        return;
+
+    if( node->children[0] < 0 )
+    {
+        for_less( i, node->start, node->end )
+        {
+            d = sq_distance_to_tag( index, i, point );
+            if( d <= max_dist_sq )
+            {
+                add_found_tag( index->tag_ids[i], sqrt( d ), *n_found,
+                               n_alloced, found, distances );
+                ++(*n_found);
+            }
+        }
+        return;
+    }
+
+    search_within_distance( index, node->children[0], point, max_dist_sq,
+                            n_found, n_alloced, found, distances );
+    search_within_distance( index, node->children[1], point, max_dist_sq,
+                            n_found, n_alloced, found, distances );
+}
+
+/*--- finds all tags within max_distance of point, in increasing order of
+      distance.  The found and distances arrays are grown as needed and
+      may be reused between calls; *n_alloced should start at 0. */
+
+public  int  tag_index_find_within_distance(
+    tag_index   index,
+    Real        point[],
+    Real        max_distance,
+    int         *n_alloced,
+    int         *found[],
+    Real        *distances[] )
+{
+    int    n_found;
+
+    n_found = 0;
+
+    if( index->n_tags == 0 || max_distance < 0.0 )
+        return( 0 );
+
+    search_within_distance( index, 0, point, max_distance * max_distance,
+                            &n_found, n_alloced, found, distances );
+
+    if( distances != NULL )
+        sort_found_tags( n_found, *found, *distances );
+    else
+        sort_found_tags( n_found, *found, NULL );
+
+    return( n_found );
+}
+
+private  void  add_node_tags(
+    tag_index         index,
+    tag_node_struct   *node,
+    int               *n_found,
+    int               *n_alloced,
+    int               *found[] )
+{
+    int   i;
+
+    for_less( i, node->start, node->end )
+    {
+        add_found_tag( index->tag_ids[i], 0.0, *n_found, n_alloced, found,
+                       NULL );
+        ++(*n_found);
+    }
+}
+
+private  void  search_in_box(
+    tag_index   index,
+    int         node_index,
+    Real        min_pos[],
+    Real        max_pos[],
+    int         *n_found,
+    int         *n_alloced,
+    int         *found[] )
+{
+    int               i, dim;
+    BOOLEAN           inside;
+    tag_node_struct   *node;
+
+    node = &index->nodes[node_index];
+
+    inside = TRUE;
+    for_less( dim, 0, N_DIMENSIONS )
+    {
+        if( node->limits[1][dim] < min_pos[dim] ||
+            node->limits[0][dim] > max_pos[dim] )
+            return;
+
+        if( node->limits[0][dim] < min_pos[dim] ||
+            node->limits[1][dim] > max_pos[dim] )
+            inside = FALSE;
+    }
+
+    if( inside )
+    {
+        add_node_tags( index, node, n_found, n_alloced, found );
+        return;
+    }
+
+    if( node->children[0] < 0 )
+    {
+        for_less( i, node->start, node->end )
+        {
+            for_less( dim, 0, N_DIMENSIONS )
+            {
+                if( TAG_COORD( index, i, dim ) < min_pos[dim] ||
+                    TAG_COORD( index, i, dim ) > max_pos[dim] )
+                    break;
+            }
+
+            if( dim == N_DIMENSIONS )
+            {
+                add_found_tag( index->tag_ids[i], 0.0, *n_found,
+                               n_alloced, found, NULL );
+                ++(*n_found);
+            }
+        }
+        return;
+    }
+
+    search_in_box( index, node->children[0], min_pos, max_pos,
+                   n_found, n_alloced, found );
+    search_in_box( index, node->children[1], min_pos, max_pos,
+                   n_found, n_alloced, found );
+}
+
+/*--- finds all tags inside the box, inclusive, in increasing tag order */
+
+public  int  tag_index_find_in_box(
+    tag_index   index,
+    Real        min_pos[],
+    Real        max_pos[],
+    int         *n_alloced,
+    int         *found[] )
+{
+    int    n_found;
+
+    n_found = 0;
+
+    if( index->n_tags == 0 )
+        return( 0 );
+
+    search_in_box( index, 0, min_pos, max_pos, &n_found, n_alloced, found );
+
+    sort_found_tags( n_found, *found, NULL );
+
+    return( n_found );
+}
+
+private  void  search_between_planes(
+    tag_index   index,
+    int         node_index,
+    Real        normal[],
+    Real        constant,
+    Real        min_dist,
+    Real        max_dist,
+    int         *n_found,
+    int         *n_alloced,
+    int         *found[] )
+{
+    int               i, dim;
+    Real              low, high, dist;
+    tag_node_struct   *node;
+
+    node = &index->nodes[node_index];
+
+    low = constant;
+    high = constant;
+    for_less( dim, 0, N_DIMENSIONS )
+    {
+        if( normal[dim] >= 0.0 )
+        {
+            low += normal[dim] * node->limits[0][dim];
+            high += normal[dim] * node->limits[1][dim];
+        }
+        else
+        {
+            low += normal[dim] * node->limits[1][dim];
+            high += normal[dim] * node->limits[0][dim];
+        }
+    }
+
+    if( high < min_dist || low > max_dist )
+        return;
+
+    if( low >= min_dist && high <= max_dist )
+    {
+        add_node_tags( index, node, n_found, n_alloced, found );
+        return;
+    }
+
+    if( node->children[0] < 0 )
+    {
+        for_less( i, node->start, node->end )
+        {
+            dist = constant + normal[X] * TAG_COORD( index, i, X ) +
+                              normal[Y] * TAG_COORD( index, i, Y ) +
+                              normal[Z] * TAG_COORD( index, i, Z );
+
+            if( dist >= min_dist && dist <= max_dist )
+            {
+                add_found_tag( index->tag_ids[i], 0.0, *n_found,
+                               n_alloced, found, NULL );
+                ++(*n_found);
+            }
+        }
+        return;
+    }
+
+    search_between_planes( index, node->children[0], normal, constant,
+                           min_dist, max_dist, n_found, n_alloced, found );
+    search_between_planes( index, node->children[1], normal, constant,
+                           min_dist, max_dist, n_found, n_alloced, found );
+}
+
+/*--- finds all tags whose plane distance, normal . tag + constant, lies
+      between min_dist and max_dist, inclusive, in increasing tag order */
+
+public  int  tag_index_find_between_planes(
+    tag_index   index,
+    Real        normal[],
+    Real        constant,
+    Real        min_dist,
+    Real        max_dist,
+    int         *n_alloced,
+    int         *found[] )
+{
+    int    n_found;
+
+    n_found = 0;
+
+    if( index->n_tags == 0 )
+        return( 0 );
+
+    search_between_planes( index, 0, normal, constant, min_dist, max_dist,
+                           &n_found, n_alloced, found );
+
+    sort_found_tags( n_found, *found, NULL );
+
+    return( n_found );
+}
+
+/*--- copies the listed tags into new arrays, allocated in one pass so that
+      they can be released with free_tag_points() */
+
+public  void  extract_tag_subset(
+    int         n_volumes,
+    int         n_subset,
+    int         subset[],
+    Real        **tags1,
+    Real        **tags2,
+    Real        weights[],
+    int         structure_ids[],
+    int         patient_ids[],
+    STRING      labels[],
+    Real        ***new_tags1,
+    Real        ***new_tags2,
+    Real        *new_weights[],
+    int         *new_structure_ids[],
+    int         *new_patient_ids[],
+    STRING      *new_labels[] )
+{
+    int    i, tag;
+
+    *new_tags1 = NULL;
+    *new_tags2 = NULL;
+    *new_weights = NULL;
+    *new_structure_ids = NULL;
+    *new_patient_ids = NULL;
+    *new_labels = NULL;
+
+    if( n_subset == 0 )
+        return;
+
+    ALLOC( *new_tags1, n_subset );
+    if( n_volumes == 2 )
+        ALLOC( *new_tags2, n_subset );
+    ALLOC( *new_weights, n_subset );
+    ALLOC( *new_structure_ids, n_subset );
+    ALLOC( *new_patient_ids, n_subset );
+    ALLOC( *new_labels, n_subset );
+
+    for_less( i, 0, n_subset )
+    {
+        tag = subset[i];
+
+        ALLOC( (*new_tags1)[i], 3 );
+        (*new_tags1)[i][0] = tags1[tag][0];
+        (*new_tags1)[i][1] = tags1[tag][1];
+        (*new_tags1)[i][2] = tags1[tag][2];
+
+        if( n_volumes == 2 )
+        {
+            ALLOC( (*new_tags2)[i], 3 );
+            (*new_tags2)[i][0] = tags2[tag][0];
+            (*new_tags2)[i][1] = tags2[tag][1];
+            (*new_tags2)[i][2] = tags2[tag][2];
+        }
+
+        (*new_weights)[i] = weights[tag];
+        (*new_structure_ids)[i] = structure_ids[tag];
+        (*new_patient_ids)[i] = patient_ids[tag];
+        (*new_labels)[i] = create_string( labels[tag] );
+    }
+}
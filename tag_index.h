@@ -0,0 +1,22 @@
+#ifndef  DEF_TAG_INDEX_H
+#define  DEF_TAG_INDEX_H
+
+struct  tag_index_struct;
+
+typedef  struct  tag_index_struct  *tag_index;
+
+
+#ifndef  public
+#define       public   extern
+#define       public_was_defined_here
+#endif
+
+#include  <tag_index_prototypes.h>
+
+#ifdef  public_was_defined_here
+#undef       public
+#undef       public_was_defined_here
+#endif
+
+
+#endif
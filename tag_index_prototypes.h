@@ -0,0 +1,68 @@
+#ifndef  DEF_TAG_INDEX_PROTOTYPES
+#define  DEF_TAG_INDEX_PROTOTYPES
+
+public  tag_index  create_tag_index(
+    int     n_tags,
+    Real    **tags );
+
+public  void  delete_tag_index(
+    tag_index   index );
+
+public  int  tag_index_get_n_tags(
+    tag_index   index );
+
+public  int  tag_index_find_nearest(
+    tag_index   index,
+    Real        point[],
+    Real        max_distance,
+    Real        *distance );
+
+public  int  tag_index_find_k_nearest(
+    tag_index   index,
+    Real        point[],
+    int         k,
+    Real        max_distance,
+    int         found[],
+    Real        distances[] );
+
+public  int  tag_index_find_within_distance(
+    tag_index   index,
+    Real        point[],
+    Real        max_distance,
+    int         *n_alloced,
+    int         *found[],
+    Real        *distances[] );
+
+public  int  tag_index_find_in_box(
+    tag_index   index,
+    Real        min_pos[],
+    Real        max_pos[],
+    int         *n_alloced,
+    int         *found[] );
+
+public  int  tag_index_find_between_planes(
+    tag_index   index,
+    Real        normal[],
+    Real        constant,
+    Real        min_dist,
+    Real        max_dist,
+    int         *n_alloced,
+    int         *found[] );
+
+public  void  extract_tag_subset(
+    int         n_volumes,
+    int         n_subset,
+    int         subset[],
+    Real        **tags1,
+    Real        **tags2,
+    Real        weights[],
+    int         structure_ids[],
+    int         patient_ids[],
+    STRING      labels[],
+    Real        ***new_tags1,
+    Real        ***new_tags2,
+    Real        *new_weights[],
+    int         *new_structure_ids[],
+    int         *new_patient_ids[],
+    STRING      *new_labels[] );
+#endif
@@ -142,14 +142,15 @@ public  void  evaluate_thin_plate_spline(
 
         if( derivs != NULL )
         {
-            for_less( v, 0, n_values )
+            /* --- the derivative of U depends only on the landmark and the
+                   dimension, so compute it once and apply it to all values */
+
+            for_less( d, 0, n_dims )
             {
-                for_less( d, 0, n_dims )
-                {
-                    dist_deriv = thin_plate_spline_U_deriv( pos, points[p],
-                                                            n_dims, d );
-                    derivs[v][d] += (Real) weights[p][v] * dist_deriv;
-                }
+                dist_deriv = thin_plate_spline_U_deriv( pos, points[p],
+                                                        n_dims, d );
+                for_less( v, 0, n_values )
+                    derivs[v][d] += weight_ptr[v] * dist_deriv;
             }
         }
     }
@@ -1,5 +1,6 @@
 #include  <volume_io/internal_volume_io.h>
 #include  <bicpl.h>
+#include  <voxel_scan.h>
 
 private  BOOLEAN  fast_get_voxel_value(
     int        voxel_x2,
@@ -9,13 +10,29 @@ private  BOOLEAN  fast_get_voxel_value(
     Volume     labels,
     Real       *label_value );
 
+private  Status  transform_multiple_labels(
+    Volume      labels,
+    Volume      like_volume,
+    Transform   *new_labels_to_labels,
+    int         super_sample,
+    BOOLEAN     fractions_flag,
+    STRING      output_filename,
+    STRING      labels_filename );
+
 private  void  usage(
     STRING   executable )
 {
     STRING  usage_str = "\n\
-Usage: %s  labels.mnc  like.mnc  output.mnc\n\
+Usage: %s  labels.mnc  like.mnc  output.mnc|output_prefix\n\
+                 [super_sample] [degrees_continuity] [majority|fractions]\n\
 \n\
-\n";
+     Resamples a label volume onto the grid of like.mnc, supersampling each\n\
+     output voxel.  If there is one label, outputs the percentage of each\n\
+     voxel covered by it.  If there are several, outputs the majority label\n\
+     of each voxel, or, with fractions, one percentage volume for each\n\
+     label, named output_prefix_<label>.mnc.  Several labels are always\n\
+     sampled at the nearest voxel, so degrees_continuity must then be\n\
+     negative.\n\n";
 
     print_error( usage_str, executable );
 }
@@ -25,6 +42,11 @@ int  main(
     char  *argv[] )
 {
     STRING               labels_filename, like_filename, output_filename;
+    STRING               mode;
+    BOOLEAN              multiple_labels;
+    int                  i, start, n_voxels;
+    Real                 *values;
+    voxel_scan_struct    scan;
     int                  sizes[MAX_DIMENSIONS];
     int                  x, y, z;
     int                  label_sizes[MAX_DIMENSIONS];
@@ -56,6 +78,14 @@ int  main(
 
     (void) get_int_argument( 1, &super_sample );
     (void) get_int_argument( -1, &degrees_continuity );
+    (void) get_string_argument( "majority", &mode );
+
+    if( !equal_strings( mode, "majority" ) &&
+        !equal_strings( mode, "fractions" ) )
+    {
+        usage( argv[0] );
+        return( 1 );
+    }
 
     if( input_volume( labels_filename, 3, XYZ_dimension_names,
                       NC_UNSPECIFIED, FALSE, 0.0, 0.0, TRUE, &labels,
@@ -74,34 +104,44 @@ int  main(
 
     n_found = 0;
     target_label = 0.0;
+    multiple_labels = FALSE;
 
-    for_less( x, 0, label_sizes[X] )
-    for_less( y, 0, label_sizes[Y] )
-    for_less( z, 0, label_sizes[Z] )
+    initialize_voxel_scan( &scan, labels, 0 );
+
+    while( !multiple_labels &&
+           get_next_voxel_span_values( &scan, TRUE, &start, &n_voxels,
+                                       &values ) )
     {
-        label = get_volume_real_value( labels, x, y, z, 0, 0 );
-        if( label != 0.0 )
+        for_less( i, 0, n_voxels )
         {
-            if( n_found > 0 )
+            if( values[i] != 0.0 )
             {
-                if( label != target_label )
+                if( n_found == 0 )
                 {
-                    print_error( "    Found: %g %g at %d %d %d\n",
-                                  label, target_label, x, y, z );
-                    ++n_found;
+                    target_label = values[i];
+                    n_found = 1;
+                }
+                else if( values[i] != target_label )
+                {
+                    multiple_labels = TRUE;
+                    break;
                 }
-            }
-            else
-            {
-                target_label = label;
-                n_found = 1;
             }
         }
     }
 
-    if( n_found != 1 )
+    delete_voxel_scan( &scan );
+
+    if( n_found == 0 )
+    {
+        print_error( "Label volume contains no labels.\n");
+        return( 1 );
+    }
+
+    if( multiple_labels && degrees_continuity >= 0 )
     {
-        print_error( "Label volume must contain only one label.\n");
+        print_error( "Several labels are only resampled by nearest neighbour, "
+                     "so degrees_continuity must be negative.\n" );
         return( 1 );
     }
 
@@ -124,6 +164,18 @@ int  main(
     concat_transforms( &new_labels_to_labels, new_labels_to_world,
                        &world_to_labels );
 
+    if( multiple_labels )
+    {
+        if( transform_multiple_labels( labels, new_labels,
+                                       &new_labels_to_labels, super_sample,
+                                       equal_strings( mode, "fractions" ),
+                                       output_filename,
+                                       labels_filename ) != OK )
+            return( 1 );
+
+        return( 0 );
+    }
+
     n_samples = super_sample * super_sample * super_sample;
 
     weighted_n_voxels = 0.0;
@@ -330,3 +382,409 @@ private  BOOLEAN  fast_get_voxel_value(
 
     return( TRUE );
 }
+
+#define  MAX_LABELS_PER_VOXEL   4
+#define  MAX_LABEL_RANGE        16777216
+
+/*--- reads the label volume into an array of label indices, index 0 being
+      the background and the others the distinct non-zero labels in
+      increasing order, label_values[index] */
+
+private  Status  get_label_indices(
+    Volume   labels,
+    int      *label_indices[],
+    int      *n_labels,
+    int      *label_values[] )
+{
+    int                i, start, n_span, n_voxels;
+    int                min_label, max_label, label, *table;
+    Real               *values;
+    voxel_scan_struct  scan;
+
+    n_voxels = (int) get_volume_total_n_voxels( labels );
+
+    ALLOC( *label_indices, n_voxels );
+
+    initialize_voxel_scan( &scan, labels, 0 );
+
+    while( get_next_voxel_span_values( &scan, TRUE, &start, &n_span,
+                                       &values ) )
+    {
+        for_less( i, 0, n_span )
+            (*label_indices)[start+i] = ROUND( values[i] );
+    }
+
+    delete_voxel_scan( &scan );
+
+    min_label = 0;
+    max_label = 0;
+    for_less( i, 0, n_voxels )
+    {
+        if( (*label_indices)[i] < min_label )
+            min_label = (*label_indices)[i];
+        else if( (*label_indices)[i] > max_label )
+            max_label = (*label_indices)[i];
+    }
+
+    if( max_label - min_label >= MAX_LABEL_RANGE )
+    {
+        print_error( "Label values range from %d to %d, too many to index.\n",
+                     min_label, max_label );
+        FREE( *label_indices );
+        return( ERROR );
+    }
+
+    ALLOC( table, max_label - min_label + 1 );
+
+    for_inclusive( label, min_label, max_label )
+        table[label-min_label] = -1;
+
+    for_less( i, 0, n_voxels )
+        table[(*label_indices)[i]-min_label] = 0;
+
+    table[-min_label] = 0;
+
+    *n_labels = 1;
+    for_inclusive( label, min_label, max_label )
+    {
+        if( label != 0 && table[label-min_label] == 0 )
+            ++(*n_labels);
+    }
+
+    ALLOC( *label_values, *n_labels );
+    (*label_values)[0] = 0;
+
+    i = 1;
+    for_inclusive( label, min_label, max_label )
+    {
+        if( label != 0 && table[label-min_label] == 0 )
+        {
+            table[label-min_label] = i;
+            (*label_values)[i] = label;
+            ++i;
+        }
+    }
+
+    for_less( i, 0, n_voxels )
+        (*label_indices)[i] = table[(*label_indices)[i]-min_label];
+
+    FREE( table );
+
+    return( OK );
+}
+
+/* ----------------------------- MNI Header -----------------------------------
+@NAME       : transform_multiple_labels
+@INPUT      : labels
+              like_volume
+              new_labels_to_labels
+              super_sample
+              fractions_flag
+              output_filename
+              labels_filename
+@OUTPUT     :
+@RETURNS    : OK or ERROR
+@DESCRIPTION: Resamples all the labels of a label volume in one pass over
+              the output grid.  Each output voxel is supersampled with
+              nearest neighbour lookups, stepping each sample point along
+              the z rows by the affine voxel to voxel transform, and the
+              samples are tallied by label.  Either the majority label is
+              written to output_filename, or the largest
+              MAX_LABELS_PER_VOXEL fractions of each voxel are kept and a
+              percentage volume is written for each label.
+@METHOD     :
+@GLOBALS    :
+@CALLS      :
+@CREATED    :
+@MODIFIED   :
+---------------------------------------------------------------------------- */
+
+private  Status  transform_multiple_labels(
+    Volume      labels,
+    Volume      like_volume,
+    Transform   *new_labels_to_labels,
+    int         super_sample,
+    BOOLEAN     fractions_flag,
+    STRING      output_filename,
+    STRING      labels_filename )
+{
+    Status           status;
+    int              x, y, z, s, t, i, dim, xs, ys, zs, n_samples;
+    int              sizes[MAX_DIMENSIONS], label_sizes[MAX_DIMENSIONS];
+    int              n_labels, *label_values, *label_indices;
+    int              n_tallied, *tally_index, *tally_count, best, tmp;
+    int              ix, iy, iz, index, n_kept, voxel_index, slice_size;
+    int              top;
+    unsigned short   *top_labels;
+    unsigned char    *top_percents;
+    Real             (*offsets)[N_DIMENSIONS], delta[N_DIMENSIONS];
+    Real             row_start[N_DIMENSIONS], step[N_DIMENSIONS];
+    Real             pos[N_DIMENSIONS], separations[MAX_DIMENSIONS];
+    Real             *slice, *label_volumes, min_value, max_value;
+    Real             voxel_min, voxel_max;
+    nc_type          nc_data_type;
+    BOOLEAN          signed_flag;
+    Volume           output;
+    char             filename[EXTREMELY_LARGE_STRING_SIZE];
+    progress_struct  progress;
+
+    if( get_label_indices( labels, &label_indices, &n_labels,
+                           &label_values ) != OK )
+        return( ERROR );
+
+    if( fractions_flag && n_labels > 65536 )
+    {
+        print_error( "Too many labels: %d\n", n_labels );
+        FREE( label_indices );
+        FREE( label_values );
+        return( ERROR );
+    }
+
+    get_volume_sizes( labels, label_sizes );
+    get_volume_sizes( like_volume, sizes );
+    slice_size = sizes[Y] * sizes[Z];
+
+    /*--- the sample offsets within an output voxel, in label voxels, and
+          the step between consecutive voxels of a z row */
+
+    n_samples = super_sample * super_sample * super_sample;
+    ALLOC( offsets, n_samples );
+
+    s = 0;
+    for_less( xs, 0, super_sample )
+    for_less( ys, 0, super_sample )
+    for_less( zs, 0, super_sample )
+    {
+        delta[X] = ((Real) xs + 0.5) / (Real) super_sample - 0.5;
+        delta[Y] = ((Real) ys + 0.5) / (Real) super_sample - 0.5;
+        delta[Z] = ((Real) zs + 0.5) / (Real) super_sample - 0.5;
+
+        for_less( dim, 0, N_DIMENSIONS )
+        {
+            offsets[s][dim] =
+                     Transform_elem(*new_labels_to_labels,dim,X) * delta[X] +
+                     Transform_elem(*new_labels_to_labels,dim,Y) * delta[Y] +
+                     Transform_elem(*new_labels_to_labels,dim,Z) * delta[Z];
+        }
+        ++s;
+    }
+
+    for_less( dim, 0, N_DIMENSIONS )
+        step[dim] = Transform_elem(*new_labels_to_labels,dim,Z);
+
+    ALLOC( tally_index, n_samples );
+    ALLOC( tally_count, n_samples );
+    ALLOC( label_volumes, n_labels );
+    for_less( i, 0, n_labels )
+        label_volumes[i] = 0.0;
+
+    ALLOC( slice, slice_size );
+
+    if( fractions_flag )
+    {
+        ALLOC( top_labels, sizes[X] * slice_size * MAX_LABELS_PER_VOXEL );
+        ALLOC( top_percents, sizes[X] * slice_size * MAX_LABELS_PER_VOXEL );
+        output = copy_volume_definition( like_volume, NC_BYTE, FALSE,
+                                         0.0, 0.0 );
+        set_volume_real_range( output, 0.0, 100.0 );
+    }
+    else
+    {
+        nc_data_type = get_volume_nc_data_type( labels, &signed_flag );
+        get_volume_voxel_range( labels, &voxel_min, &voxel_max );
+        get_volume_real_range( labels, &min_value, &max_value );
+        output = copy_volume_definition( like_volume, nc_data_type,
+                                         signed_flag, voxel_min, voxel_max );
+        set_volume_real_range( output, min_value, max_value );
+    }
+
+    initialize_progress_report( &progress, FALSE, sizes[X], "Transforming" );
+
+    for_less( x, 0, sizes[X] )
+    {
+        for_less( y, 0, sizes[Y] )
+        {
+            transform_point( new_labels_to_labels, (Real) x, (Real) y, 0.0,
+                             &row_start[X], &row_start[Y], &row_start[Z] );
+
+            for_less( z, 0, sizes[Z] )
+            {
+                n_tallied = 0;
+
+                for_less( s, 0, n_samples )
+                {
+                    for_less( dim, 0, N_DIMENSIONS )
+                        pos[dim] = row_start[dim] + (Real) z * step[dim] +
+                                   offsets[s][dim];
+
+                    ix = ROUND( pos[X] );
+                    iy = ROUND( pos[Y] );
+                    iz = ROUND( pos[Z] );
+
+                    if( ix >= 0 && ix < label_sizes[X] &&
+                        iy >= 0 && iy < label_sizes[Y] &&
+                        iz >= 0 && iz < label_sizes[Z] )
+                    {
+                        index = label_indices[IJK(ix,iy,iz,label_sizes[Y],
+                                                  label_sizes[Z])];
+                    }
+                    else
+                        index = 0;
+
+                    for_less( t, 0, n_tallied )
+                    {
+                        if( tally_index[t] == index )
+                            break;
+                    }
+
+                    if( t == n_tallied )
+                    {
+                        tally_index[t] = index;
+                        tally_count[t] = 0;
+                        ++n_tallied;
+                    }
+
+                    ++tally_count[t];
+                }
+
+                for_less( t, 0, n_tallied )
+                {
+                    label_volumes[tally_index[t]] += (Real) tally_count[t] /
+                                                     (Real) n_samples;
+                }
+
+                voxel_index = IJK( x, y, z, sizes[Y], sizes[Z] );
+
+                if( !fractions_flag )
+                {
+                    best = 0;
+                    for_less( t, 1, n_tallied )
+                    {
+                        if( tally_count[t] > tally_count[best] )
+                            best = t;
+                    }
+
+                    slice[y*sizes[Z]+z] =
+                                   (Real) label_values[tally_index[best]];
+                    continue;
+                }
+
+                /*--- keep the largest fractions of the non-zero labels */
+
+                n_kept = 0;
+                for_less( t, 0, n_tallied )
+                {
+                    if( n_kept == MAX_LABELS_PER_VOXEL )
+                        break;
+
+                    best = t;
+                    for_less( s, t+1, n_tallied )
+                    {
+                        if( tally_count[s] > tally_count[best] )
+                            best = s;
+                    }
+
+                    tmp = tally_index[t];
+                    tally_index[t] = tally_index[best];
+                    tally_index[best] = tmp;
+                    tmp = tally_count[t];
+                    tally_count[t] = tally_count[best];
+                    tally_count[best] = tmp;
+
+                    if( tally_index[t] != 0 )
+                    {
+                        top = voxel_index * MAX_LABELS_PER_VOXEL + n_kept;
+                        top_labels[top] = (unsigned short) tally_index[t];
+                        top_percents[top] = (unsigned char) ROUND( 100.0 *
+                                    (Real) tally_count[t] / (Real) n_samples );
+                        ++n_kept;
+                    }
+                }
+
+                for_less( t, n_kept, MAX_LABELS_PER_VOXEL )
+                {
+                    top = voxel_index * MAX_LABELS_PER_VOXEL + t;
+                    top_labels[top] = 0;
+                    top_percents[top] = 0;
+                }
+            }
+        }
+
+        if( !fractions_flag )
+        {
+            set_volume_value_hyperslab_3d( output, x, 0, 0,
+                                           1, sizes[Y], sizes[Z], slice );
+        }
+
+        update_progress_report( &progress, x + 1 );
+    }
+
+    terminate_progress_report( &progress );
+
+    get_volume_separations( like_volume, separations );
+
+    for_less( i, 1, n_labels )
+    {
+        print( "Label %d Volume  : %g\n", label_values[i], label_volumes[i] *
+               separations[0] * separations[1] * separations[2] );
+    }
+
+    status = OK;
+
+    if( !fractions_flag )
+    {
+        status = output_modified_volume( output_filename, NC_UNSPECIFIED,
+                                         FALSE, 0.0, 0.0, output,
+                                         labels_filename,
+                                         "transform_labels\n", NULL );
+    }
+    else
+    {
+        for_less( i, 1, n_labels )
+        {
+            for_less( x, 0, sizes[X] )
+            {
+                for_less( s, 0, slice_size )
+                {
+                    top = (x * slice_size + s) * MAX_LABELS_PER_VOXEL;
+                    slice[s] = 0.0;
+                    for_less( t, 0, MAX_LABELS_PER_VOXEL )
+                    {
+                        if( (int) top_labels[top+t] == i )
+                            slice[s] = (Real) top_percents[top+t];
+                    }
+                }
+
+                set_volume_value_hyperslab_3d( output, x, 0, 0,
+                                               1, sizes[Y], sizes[Z], slice );
+            }
+
+            (void) sprintf( filename, "%s_%d.mnc", output_filename,
+                            label_values[i] );
+
+            if( output_modified_volume( filename, NC_UNSPECIFIED,
+                                        FALSE, 0.0, 0.0, output,
+                                        labels_filename,
+                                        "transform_labels\n", NULL ) != OK )
+            {
+                status = ERROR;
+                break;
+            }
+        }
+
+        FREE( top_labels );
+        FREE( top_percents );
+    }
+
+    delete_volume( output );
+
+    FREE( slice );
+    FREE( offsets );
+    FREE( tally_index );
+    FREE( tally_count );
+    FREE( label_volumes );
+    FREE( label_values );
+    FREE( label_indices );
+
+    return( status );
+}
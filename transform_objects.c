@@ -1,5 +1,6 @@
 #include  <volume_io/internal_volume_io.h>
 #include  <bicpl.h>
+#include  <point_transform.h>
 
 public  Status  process_object(
     object_struct  *object );
@@ -17,24 +18,36 @@ Usage: transform_objects  input.obj  input.xfm  [output.obj]\n\
 }
 
 private  void  transform_object(
-    General_transform      *transform,
+    point_transform_struct *transform,
     object_struct          *object )
 {
     int    i, n_points;
     Point  *points;
-    Real   x, y, z;
+    Real   *positions;
 
     n_points = get_object_points( object, &points );
 
+    if( n_points <= 0 )
+        return;
+
+    ALLOC( positions, N_DIMENSIONS * n_points );
+
     for_less( i, 0, n_points )
     {
-        general_transform_point( transform,
-                                 (Real) Point_x(points[i]),
-                                 (Real) Point_y(points[i]),
-                                 (Real) Point_z(points[i]), &x, &y, &z );
+        positions[N_DIMENSIONS*i+X] = (Real) Point_x(points[i]);
+        positions[N_DIMENSIONS*i+Y] = (Real) Point_y(points[i]);
+        positions[N_DIMENSIONS*i+Z] = (Real) Point_z(points[i]);
+    }
 
-        fill_Point( points[i], x, y, z );
+    transform_point_array( transform, n_points, positions );
+
+    for_less( i, 0, n_points )
+    {
+        fill_Point( points[i], positions[N_DIMENSIONS*i+X],
+                    positions[N_DIMENSIONS*i+Y], positions[N_DIMENSIONS*i+Z] );
     }
+
+    FREE( positions );
 }
 
 int  main(
@@ -46,6 +59,7 @@ int  main(
     int                 i, n_objects;
     BOOLEAN             invert;
     General_transform   transform;
+    point_transform_struct  point_transform;
     File_formats        format;
     object_struct       **object_list;
     BOOLEAN             is_left_handed;
@@ -80,9 +94,11 @@ int  main(
     else
         is_left_handed = FALSE;
 
+    initialize_point_transform( &point_transform, &transform, FALSE );
+
     for_less( i, 0, n_objects )
     {
-        transform_object( &transform, object_list[i] );
+        transform_object( &point_transform, object_list[i] );
         switch( get_object_type(object_list[i]) )
         {
         case POLYGONS:
@@ -102,6 +118,8 @@ int  main(
         }
     }
 
+    delete_point_transform( &point_transform );
+
     (void) output_graphics_file( output_filename, format,
                                  n_objects, object_list );
 
@@ -1,5 +1,6 @@
 #include  <volume_io/internal_volume_io.h>
 #include  <bicpl.h>
+#include  <point_transform.h>
 
 private  void  usage(
     STRING   executable )
@@ -22,9 +23,11 @@ int  main(
     Status              status;
     STRING              input_filename, output_filename, transform_filename;
     STRING              dummy;
-    int                 i;
+    int                 i, v, dim, n_positions;
     BOOLEAN             invert;
     General_transform   transform;
+    point_transform_struct  point_transform;
+    Real                **tags[2], *positions;
     int                 n_volumes, n_tag_points;
     Real                **tags_volume1, **tags_volume2, *weights;
     int                 *structure_ids, *patient_ids;
@@ -53,41 +56,33 @@ int  main(
     if( input_transform_file( transform_filename, &transform ) != OK )
         return( 1 );
 
-    if( status == OK )
+    /*--- the tags of both volumes are transformed as one batch */
+
+    tags[0] = tags_volume1;
+    tags[1] = tags_volume2;
+    n_positions = n_volumes * n_tag_points;
+
+    if( status == OK && n_positions > 0 )
     {
+        initialize_point_transform( &point_transform, &transform, invert );
+
+        ALLOC( positions, N_DIMENSIONS * n_positions );
+
+        for_less( v, 0, n_volumes )
         for_less( i, 0, n_tag_points )
-        {
-            if( invert )
-            {
-                general_inverse_transform_point( &transform,
-                 tags_volume1[i][X], tags_volume1[i][Y], tags_volume1[i][Z],
-                 &tags_volume1[i][X], &tags_volume1[i][Y], &tags_volume1[i][Z]);
-            }
-            else
-            {
-                general_transform_point( &transform,
-                 tags_volume1[i][X], tags_volume1[i][Y], tags_volume1[i][Z],
-                 &tags_volume1[i][X], &tags_volume1[i][Y], &tags_volume1[i][Z]);
-            }
-
-            if( n_volumes == 2 )
-            {
-                if( invert )
-                {
-                    general_inverse_transform_point( &transform,
-                     tags_volume2[i][X], tags_volume2[i][Y], tags_volume2[i][Z],
-                     &tags_volume2[i][X], &tags_volume2[i][Y],
-                     &tags_volume2[i][Z] );
-                }
-                else
-                {
-                    general_transform_point( &transform,
-                     tags_volume2[i][X], tags_volume2[i][Y], tags_volume2[i][Z],
-                     &tags_volume2[i][X], &tags_volume2[i][Y],
-                     &tags_volume2[i][Z] );
-                }
-            }
-        }
+        for_less( dim, 0, N_DIMENSIONS )
+            positions[N_DIMENSIONS*(v*n_tag_points+i)+dim] = tags[v][i][dim];
+
+        transform_point_array( &point_transform, n_positions, positions );
+
+        for_less( v, 0, n_volumes )
+        for_less( i, 0, n_tag_points )
+        for_less( dim, 0, N_DIMENSIONS )
+            tags[v][i][dim] = positions[N_DIMENSIONS*(v*n_tag_points+i)+dim];
+
+        FREE( positions );
+
+        delete_point_transform( &point_transform );
     }
 
     status = output_tag_file( output_filename, (char *) NULL,
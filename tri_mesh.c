@@ -1371,3 +1371,158 @@ public  void  tri_mesh_reconcile_points(
                                     &src_mesh->triangles[tri] );
     }
 }
+
+/* ------------------------ resolution levels ---------------------------- */
+
+private  void   get_midpoint_levels(
+    tri_node_struct  *node,
+    int              level,
+    int              point_levels[],
+    int              parents[][2] )
+{
+    int   edge, midpoint, child;
+
+    if( node->children[0] == NULL )
+        return;
+
+    for_less( edge, 0, 3 )
+    {
+        midpoint = node->children[2]->nodes[edge];
+
+        if( point_levels[midpoint] < 0 || point_levels[midpoint] > level+1 )
+        {
+            point_levels[midpoint] = level + 1;
+            parents[midpoint][0] = node->nodes[edge];
+            parents[midpoint][1] = node->nodes[(edge+1)%3];
+        }
+    }
+
+    for_less( child, 0, 4 )
+        get_midpoint_levels( node->children[child], level+1,
+                             point_levels, parents );
+}
+
+/*--- fills in the subdivision level at which each point first appears,
+      and for points above level 0, the two ends of the edge it bisects;
+      returns the finest level */
+
+public  int  tri_mesh_get_point_levels(
+    tri_mesh_struct  *mesh,
+    int              point_levels[],
+    int              parents[][2] )
+{
+    int   point, tri, node, max_level;
+
+    for_less( point, 0, mesh->n_points )
+    {
+        point_levels[point] = -1;
+        parents[point][0] = -1;
+        parents[point][1] = -1;
+    }
+
+    for_less( tri, 0, mesh->n_triangles )
+    {
+        for_less( node, 0, 3 )
+            point_levels[mesh->triangles[tri].nodes[node]] = 0;
+    }
+
+    for_less( tri, 0, mesh->n_triangles )
+        get_midpoint_levels( &mesh->triangles[tri], 0, point_levels, parents );
+
+    max_level = 0;
+    for_less( point, 0, mesh->n_points )
+        max_level = MAX( max_level, point_levels[point] );
+
+    return( max_level );
+}
+
+private  void   add_level_triangles(
+    tri_node_struct          *node,
+    int                      level,
+    int                      *n_items,
+    int                      *end_indices[],
+    int                      *indices[],
+    int                      *n_indices )
+{
+    int   child;
+
+    if( level > 0 && node->children[0] != NULL )
+    {
+        for_less( child, 0, 4 )
+            add_level_triangles( node->children[child], level-1,
+                                 n_items, end_indices, indices, n_indices );
+        return;
+    }
+
+    ADD_ELEMENT_TO_ARRAY( *indices, *n_indices, node->nodes[0],
+                          DEFAULT_CHUNK_SIZE );
+    ADD_ELEMENT_TO_ARRAY( *indices, *n_indices, node->nodes[1],
+                          DEFAULT_CHUNK_SIZE );
+    ADD_ELEMENT_TO_ARRAY( *indices, *n_indices, node->nodes[2],
+                          DEFAULT_CHUNK_SIZE );
+    ADD_ELEMENT_TO_ARRAY( *end_indices, *n_items, *n_indices,
+                          DEFAULT_CHUNK_SIZE );
+}
+
+/*--- creates the triangulation formed by the tree nodes at the given depth
+      (or the leaves, where shallower), containing only the points it uses;
+      mesh_indices[i] is set to the mesh point of polygon point i, and must
+      have room for all the mesh points.  Returns the number of points. */
+
+public  int  tri_mesh_extract_level(
+    tri_mesh_struct   *mesh,
+    int               level,
+    polygons_struct   *polygons,
+    int               mesh_indices[] )
+{
+    int     tri, point, n_indices, n_points, *new_id, i;
+
+    initialize_polygons( polygons, WHITE, NULL );
+
+    polygons->end_indices = NULL;
+    polygons->n_items = 0;
+    polygons->indices = NULL;
+    n_indices = 0;
+
+    for_less( tri, 0, mesh->n_triangles )
+    {
+        add_level_triangles( &mesh->triangles[tri], level,
+                             &polygons->n_items, &polygons->end_indices,
+                             &polygons->indices, &n_indices );
+    }
+
+    ALLOC( new_id, mesh->n_points );
+
+    for_less( point, 0, mesh->n_points )
+        new_id[point] = -1;
+
+    for_less( i, 0, n_indices )
+        new_id[polygons->indices[i]] = 0;
+
+    n_points = 0;
+    for_less( point, 0, mesh->n_points )
+    {
+        if( new_id[point] >= 0 )
+        {
+            new_id[point] = n_points;
+            mesh_indices[n_points] = point;
+            ++n_points;
+        }
+    }
+
+    for_less( i, 0, n_indices )
+        polygons->indices[i] = new_id[polygons->indices[i]];
+
+    FREE( new_id );
+
+    polygons->n_points = n_points;
+    ALLOC( polygons->points, n_points );
+    ALLOC( polygons->normals, n_points );
+
+    for_less( point, 0, n_points )
+        polygons->points[point] = mesh->points[mesh_indices[point]];
+
+    compute_polygon_normals( polygons );
+
+    return( n_points );
+}
@@ -0,0 +1,361 @@
+#include  <volume_io/internal_volume_io.h>
+#include  <triangle_tree.h>
+
+/*--- bounding volume hierarchy over the triangles of a set of polygons,
+      split with the surface area heuristic on the triangle bounding boxes.
+      It is shared by the closest point and winding number searches, which
+      keep their own data per node or per triangle in tree order. */
+
+#define  MAX_SAH_LEAF_SIZE       16
+#define  N_SAH_BINS              16
+#define  TRAVERSAL_COST          1.0
+
+private  Real  box_surface_area(
+    Real   limits[2][N_DIMENSIONS] )
+{
+    Real   dx, dy, dz;
+
+    dx = limits[1][X] - limits[0][X];
+    dy = limits[1][Y] - limits[0][Y];
+    dz = limits[1][Z] - limits[0][Z];
+
+    return( 2.0 * (dx * dy + dy * dz + dz * dx) );
+}
+
+private  void  empty_box(
+    Real   limits[2][N_DIMENSIONS] )
+{
+    int   dim;
+
+    for_less( dim, 0, N_DIMENSIONS )
+    {
+        limits[0][dim] = 1.0e30;
+        limits[1][dim] = -1.0e30;
+    }
+}
+
+private  void  add_box_to_box(
+    Real   limits[2][N_DIMENSIONS],
+    Real   other[2][N_DIMENSIONS] )
+{
+    int   dim;
+
+    for_less( dim, 0, N_DIMENSIONS )
+    {
+        limits[0][dim] = MIN( limits[0][dim], other[0][dim] );
+        limits[1][dim] = MAX( limits[1][dim], other[1][dim] );
+    }
+}
+
+private  int  build_triangle_node(
+    triangle_tree_struct   *tree,
+    int                    max_triangles_in_leaf,
+    Real                   (*boxes)[2][N_DIMENSIONS],
+    Real                   **centroids,
+    int                    ids[],
+    int                    start,
+    int                    end,
+    int                    depth )
+{
+    int                    node_index, i, j, dim, axis, b, best_bin;
+    int                    n, mid, swap, left, right;
+    int                    bin_counts[N_SAH_BINS], n_left;
+    int                    right_counts[N_SAH_BINS];
+    Real                   limits[2][N_DIMENSIONS];
+    Real                   centre_limits[2][N_DIMENSIONS];
+    Real                   bin_boxes[N_SAH_BINS][2][N_DIMENSIONS];
+    Real                   sweep[2][N_DIMENSIONS];
+    Real                   right_areas[N_SAH_BINS];
+    Real                   width, max_width, scale, cost, best_cost;
+    triangle_node_struct   *node;
+
+    node_index = tree->n_nodes;
+    SET_ARRAY_SIZE( tree->nodes, tree->n_nodes, tree->n_nodes+1,
+                    DEFAULT_CHUNK_SIZE );
+    ++tree->n_nodes;
+
+    tree->max_depth = MAX( tree->max_depth, depth );
+
+    empty_box( limits );
+    empty_box( centre_limits );
+
+    for_less( i, start, end )
+    {
+        add_box_to_box( limits, boxes[ids[i]] );
+        for_less( dim, 0, N_DIMENSIONS )
+        {
+            centre_limits[0][dim] = MIN( centre_limits[0][dim],
+                                         centroids[ids[i]][dim] );
+            centre_limits[1][dim] = MAX( centre_limits[1][dim],
+                                         centroids[ids[i]][dim] );
+        }
+    }
+
+    node = &tree->nodes[node_index];
+    node->start = start;
+    node->end = end;
+    node->children[0] = -1;
+    node->children[1] = -1;
+    for_less( dim, 0, N_DIMENSIONS )
+    {
+        node->limits[0][dim] = limits[0][dim];
+        node->limits[1][dim] = limits[1][dim];
+    }
+
+    n = end - start;
+
+    if( n <= max_triangles_in_leaf )
+        return( node_index );
+
+    axis = 0;
+    max_width = -1.0;
+    for_less( dim, 0, N_DIMENSIONS )
+    {
+        width = centre_limits[1][dim] - centre_limits[0][dim];
+        if( width > max_width )
+        {
+            axis = dim;
+            max_width = width;
+        }
+    }
+
+    mid = start;
+
+    if( max_width > 0.0 )
+    {
+        /*--- bin the centroids along the widest axis and choose the split
+              between bins with the least surface area cost */
+
+        for_less( b, 0, N_SAH_BINS )
+        {
+            bin_counts[b] = 0;
+            empty_box( bin_boxes[b] );
+        }
+
+        scale = (Real) N_SAH_BINS / max_width;
+
+        for_less( i, start, end )
+        {
+            b = (int) ((centroids[ids[i]][axis] - centre_limits[0][axis]) *
+                       scale);
+            if( b >= N_SAH_BINS )
+                b = N_SAH_BINS - 1;
+            ++bin_counts[b];
+            add_box_to_box( bin_boxes[b], boxes[ids[i]] );
+        }
+
+        empty_box( sweep );
+        n_left = 0;
+        for( b = N_SAH_BINS-1;  b > 0;  --b )
+        {
+            n_left += bin_counts[b];
+            if( bin_counts[b] > 0 )
+                add_box_to_box( sweep, bin_boxes[b] );
+            right_counts[b] = n_left;
+            right_areas[b] = (n_left > 0) ? box_surface_area( sweep ) : 0.0;
+        }
+
+        best_bin = -1;
+        best_cost = 0.0;
+        empty_box( sweep );
+        n_left = 0;
+        for_less( b, 0, N_SAH_BINS-1 )
+        {
+            n_left += bin_counts[b];
+            if( bin_counts[b] > 0 )
+                add_box_to_box( sweep, bin_boxes[b] );
+
+            if( n_left == 0 || right_counts[b+1] == 0 )
+                continue;
+
+            cost = (Real) n_left * box_surface_area( sweep ) +
+                   (Real) right_counts[b+1] * right_areas[b+1];
+
+            if( best_bin < 0 || cost < best_cost )
+            {
+                best_bin = b;
+                best_cost = cost;
+            }
+        }
+
+        if( best_bin >= 0 )
+        {
+            best_cost = TRAVERSAL_COST * box_surface_area( limits ) +
+                        best_cost;
+
+            if( n <= MAX_SAH_LEAF_SIZE &&
+                best_cost >= (Real) n * box_surface_area( limits ) )
+                return( node_index );
+
+            i = start;
+            j = end - 1;
+            while( i <= j )
+            {
+                b = (int) ((centroids[ids[i]][axis] -
+                            centre_limits[0][axis]) * scale);
+                if( b >= N_SAH_BINS )
+                    b = N_SAH_BINS - 1;
+
+                if( b <= best_bin )
+                    ++i;
+                else
+                {
+                    swap = ids[i];
+                    ids[i] = ids[j];
+                    ids[j] = swap;
+                    --j;
+                }
+            }
+            mid = i;
+        }
+    }
+
+    /*--- coincident centroids are split in the middle */
+
+    if( mid <= start || mid >= end )
+        mid = (start + end) / 2;
+
+    /*--- the node array may move while the children are built */
+
+    left = build_triangle_node( tree, max_triangles_in_leaf, boxes,
+                                centroids, ids, start, mid, depth + 1 );
+    right = build_triangle_node( tree, max_triangles_in_leaf, boxes,
+                                 centroids, ids, mid, end, depth + 1 );
+
+    tree->nodes[node_index].children[0] = left;
+    tree->nodes[node_index].children[1] = right;
+
+    return( node_index );
+}
+
+/* ----------------------------- MNI Header -----------------------------------
+@NAME       : create_triangle_tree
+@INPUT      : polygons
+              max_triangles_in_leaf
+@OUTPUT     : tree
+@RETURNS    :
+@DESCRIPTION: Splits the polygons into triangles around their first vertex
+              and builds a bounding volume hierarchy on them.  Leaves hold
+              at most max_triangles_in_leaf triangles, or up to 16 if the
+              surface area heuristic finds splitting them no cheaper.
+@METHOD     :
+@GLOBALS    :
+@CALLS      :
+@CREATED    :
+@MODIFIED   :
+---------------------------------------------------------------------------- */
+
+public  void  create_triangle_tree(
+    polygons_struct        *polygons,
+    int                    max_triangles_in_leaf,
+    triangle_tree_struct   *tree )
+{
+    int    poly, size, k, t, i, dim, n_triangles, *ids, *vertices;
+    int    corner_points[3];
+    Real   *corners, **centroids, (*boxes)[2][N_DIMENSIONS];
+
+    tree->n_nodes = 0;
+    tree->nodes = NULL;
+    tree->max_depth = 0;
+    tree->corners = NULL;
+    tree->vertices = NULL;
+
+    n_triangles = 0;
+    for_less( poly, 0, polygons->n_items )
+    {
+        size = GET_OBJECT_SIZE( *polygons, poly );
+        if( size >= 3 )
+            n_triangles += size - 2;
+    }
+
+    tree->n_triangles = n_triangles;
+
+    if( n_triangles == 0 )
+        return;
+
+    ALLOC( corners, 9 * n_triangles );
+    ALLOC( vertices, 3 * n_triangles );
+    ALLOC( boxes, n_triangles );
+    ALLOC2D( centroids, n_triangles, N_DIMENSIONS );
+    ALLOC( ids, n_triangles );
+
+    t = 0;
+    for_less( poly, 0, polygons->n_items )
+    {
+        size = GET_OBJECT_SIZE( *polygons, poly );
+        corner_points[0] = polygons->indices[
+                          POINT_INDEX( polygons->end_indices, poly, 0 )];
+
+        for_less( k, 1, size - 1 )
+        {
+            corner_points[1] = polygons->indices[
+                          POINT_INDEX( polygons->end_indices, poly, k )];
+            corner_points[2] = polygons->indices[
+                          POINT_INDEX( polygons->end_indices, poly, k+1 )];
+
+            for_less( i, 0, 3 )
+            {
+                vertices[t*3+i] = corner_points[i];
+                for_less( dim, 0, N_DIMENSIONS )
+                {
+                    corners[(t*3+i)*N_DIMENSIONS+dim] = (Real)
+                          Point_coord( polygons->points[corner_points[i]],
+                                       dim );
+                }
+            }
+
+            for_less( dim, 0, N_DIMENSIONS )
+            {
+                boxes[t][0][dim] = corners[(t*3)*N_DIMENSIONS+dim];
+                boxes[t][1][dim] = corners[(t*3)*N_DIMENSIONS+dim];
+                for_less( i, 1, 3 )
+                {
+                    boxes[t][0][dim] = MIN( boxes[t][0][dim],
+                                       corners[(t*3+i)*N_DIMENSIONS+dim] );
+                    boxes[t][1][dim] = MAX( boxes[t][1][dim],
+                                       corners[(t*3+i)*N_DIMENSIONS+dim] );
+                }
+                centroids[t][dim] = (boxes[t][0][dim] +
+                                     boxes[t][1][dim]) / 2.0;
+            }
+
+            ids[t] = t;
+            ++t;
+        }
+    }
+
+    (void) build_triangle_node( tree, max_triangles_in_leaf, boxes,
+                                centroids, ids, 0, n_triangles, 0 );
+
+    /*--- store the triangles in tree order, so each leaf is contiguous */
+
+    ALLOC( tree->corners, 9 * n_triangles );
+    ALLOC( tree->vertices, 3 * n_triangles );
+
+    for_less( t, 0, n_triangles )
+    {
+        for_less( i, 0, 9 )
+            tree->corners[t*9+i] = corners[ids[t]*9+i];
+        for_less( i, 0, 3 )
+            tree->vertices[t*3+i] = vertices[ids[t]*3+i];
+    }
+
+    FREE( corners );
+    FREE( vertices );
+    FREE( boxes );
+    FREE2D( centroids );
+    FREE( ids );
+}
+
+public  void  delete_triangle_tree(
+    triangle_tree_struct   *tree )
+{
+    if( tree->n_triangles > 0 )
+    {
+        FREE( tree->corners );
+        FREE( tree->vertices );
+    }
+
+    if( tree->n_nodes > 0 )
+        FREE( tree->nodes );
+}
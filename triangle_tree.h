@@ -0,0 +1,44 @@
+#ifndef  DEF_TRIANGLE_TREE_H
+#define  DEF_TRIANGLE_TREE_H
+
+#include  <bicpl.h>
+
+/*--- a bounding volume hierarchy over the triangles of a set of polygons.
+      The triangles are stored in tree order, so those of a node are start
+      to end-1, with their corner points and the indices of the polygon
+      points they came from.  A node with no children is a leaf. */
+
+typedef  struct
+{
+    Real    limits[2][N_DIMENSIONS];
+    int     start;
+    int     end;
+    int     children[2];
+} triangle_node_struct;
+
+typedef  struct
+{
+    int                    n_triangles;
+    Real                   *corners;
+    int                    *vertices;
+    int                    n_nodes;
+    triangle_node_struct   *nodes;
+    int                    max_depth;
+} triangle_tree_struct;
+
+#define  TRIANGLE_CORNER( tree, t, k )  \
+             (&(tree)->corners[((t)*3+(k))*N_DIMENSIONS])
+
+#ifndef  public
+#define       public   extern
+#define       public_was_defined_here
+#endif
+
+#include  <triangle_tree_prototypes.h>
+
+#ifdef  public_was_defined_here
+#undef       public
+#undef       public_was_defined_here
+#endif
+
+#endif
@@ -0,0 +1,11 @@
+#ifndef  DEF_TRIANGLE_TREE_PROTOTYPES
+#define  DEF_TRIANGLE_TREE_PROTOTYPES
+
+public  void  create_triangle_tree(
+    polygons_struct        *polygons,
+    int                    max_triangles_in_leaf,
+    triangle_tree_struct   *tree );
+
+public  void  delete_triangle_tree(
+    triangle_tree_struct   *tree );
+#endif
@@ -0,0 +1,413 @@
+#include  <volume_io/internal_volume_io.h>
+#include  <volume_derivatives.h>
+
+#define  MAX_STENCIL_TAPS  4
+
+/*--- copies the values of a 3D volume into values[], one x slice at a time,
+      with z varying fastest */
+
+public  void  get_volume_float_values(
+    Volume   volume,
+    float    values[] )
+{
+    int    x, i, sizes[N_DIMENSIONS], slice_size;
+    Real   *slice;
+
+    get_volume_sizes( volume, sizes );
+    slice_size = sizes[Y] * sizes[Z];
+
+    ALLOC( slice, slice_size );
+
+    for_less( x, 0, sizes[X] )
+    {
+        get_volume_value_hyperslab_3d( volume, x, 0, 0,
+                                       1, sizes[Y], sizes[Z], slice );
+
+        for_less( i, 0, slice_size )
+            values[x*slice_size+i] = (float) slice[i];
+    }
+
+    FREE( slice );
+}
+
+public  void  set_volume_float_values(
+    Volume   volume,
+    float    values[] )
+{
+    int    x, i, sizes[N_DIMENSIONS], slice_size;
+    Real   *slice;
+
+    get_volume_sizes( volume, sizes );
+    slice_size = sizes[Y] * sizes[Z];
+
+    ALLOC( slice, slice_size );
+
+    for_less( x, 0, sizes[X] )
+    {
+        for_less( i, 0, slice_size )
+            slice[i] = (Real) values[x*slice_size+i];
+
+        set_volume_value_hyperslab_3d( volume, x, 0, 0,
+                                       1, sizes[Y], sizes[Z], slice );
+    }
+
+    FREE( slice );
+}
+
+public  int  get_n_derivative_components(
+    Derivative_types  type )
+{
+    switch( type )
+    {
+    case GRADIENT_COMPONENTS:
+    case HESSIAN_DIAGONAL:
+        return( N_DIMENSIONS );
+
+    case FULL_HESSIAN:
+        return( 6 );
+
+    default:
+        return( 1 );
+    }
+}
+
+/*--- the 1D stencils are those of the interpolating splines of
+      evaluate_volume() at a knot: linear interpolation gives a forward
+      difference, the quadratic B-spline is evaluated half way through a
+      span and so also smooths the value, and the Catmull-Rom cubic gives a
+      central first difference and a one-sided second difference.
+      Neighbours past either end of the axis are clamped to the edge. */
+
+private  BOOLEAN  is_identity_stencil(
+    int   continuity,
+    int   order )
+{
+    return( order == 0 && continuity != 1 );
+}
+
+private  int  get_axis_stencil(
+    int     continuity,
+    int     order,
+    int     n,
+    int     indices[],
+    float   weights[] )
+{
+    int     k, t, n_taps, first;
+    float   taps[MAX_STENCIL_TAPS];
+
+    if( order == 0 )
+    {
+        first = -1;
+        taps[0] = 0.125f;
+        taps[1] = 0.75f;
+        taps[2] = 0.125f;
+        n_taps = 3;
+    }
+    else if( order == 1 && continuity <= 0 )
+    {
+        first = 0;
+        taps[0] = -1.0f;
+        taps[1] = 1.0f;
+        n_taps = 2;
+    }
+    else if( order == 1 )
+    {
+        first = -1;
+        taps[0] = -0.5f;
+        taps[1] = 0.0f;
+        taps[2] = 0.5f;
+        n_taps = 3;
+    }
+    else if( continuity <= 0 )
+    {
+        n_taps = 0;
+        first = 0;
+    }
+    else if( continuity == 1 )
+    {
+        first = -1;
+        taps[0] = 1.0f;
+        taps[1] = -2.0f;
+        taps[2] = 1.0f;
+        n_taps = 3;
+    }
+    else
+    {
+        first = -1;
+        taps[0] = 2.0f;
+        taps[1] = -5.0f;
+        taps[2] = 4.0f;
+        taps[3] = -1.0f;
+        n_taps = 4;
+    }
+
+    for_less( k, 0, n )
+    {
+        for_less( t, 0, n_taps )
+        {
+            indices[k*MAX_STENCIL_TAPS+t] = k + first + t;
+            weights[k*MAX_STENCIL_TAPS+t] = taps[t];
+        }
+
+        /*--- the linear forward difference becomes a backward difference
+              on the last voxel, as the last span is used there */
+
+        if( order == 1 && continuity <= 0 && k == n-1 && n > 1 )
+        {
+            indices[k*MAX_STENCIL_TAPS+0] = k - 1;
+            indices[k*MAX_STENCIL_TAPS+1] = k;
+        }
+
+        for_less( t, 0, n_taps )
+        {
+            if( indices[k*MAX_STENCIL_TAPS+t] < 0 )
+                indices[k*MAX_STENCIL_TAPS+t] = 0;
+            else if( indices[k*MAX_STENCIL_TAPS+t] >= n )
+                indices[k*MAX_STENCIL_TAPS+t] = n - 1;
+        }
+    }
+
+    return( n_taps );
+}
+
+/*--- applies the stencil along one axis, viewing the buffer as
+      [n_outer][n][n_inner].  For the x and y axes each output row is a
+      weighted sum of whole contiguous input rows, and for z the taps are
+      summed along each line. */
+
+private  void  apply_axis_stencil(
+    int     sizes[],
+    int     axis,
+    int     continuity,
+    int     order,
+    float   src[],
+    float   dst[] )
+{
+    int     dim, n, n_outer, n_inner, o, k, t, j, n_taps, *indices;
+    float   *weights, *dst_row, *src_row, *src_line, *dst_line, w, sum;
+
+    n = sizes[axis];
+    n_outer = 1;
+    n_inner = 1;
+    for_less( dim, 0, N_DIMENSIONS )
+    {
+        if( dim < axis )
+            n_outer *= sizes[dim];
+        else if( dim > axis )
+            n_inner *= sizes[dim];
+    }
+
+    ALLOC( indices, n * MAX_STENCIL_TAPS );
+    ALLOC( weights, n * MAX_STENCIL_TAPS );
+
+    n_taps = get_axis_stencil( continuity, order, n, indices, weights );
+
+    if( n_taps == 0 )
+    {
+        for_less( j, 0, n_outer * n * n_inner )
+            dst[j] = 0.0f;
+    }
+    else if( n_inner == 1 )
+    {
+        for_less( o, 0, n_outer )
+        {
+            src_line = &src[o*n];
+            dst_line = &dst[o*n];
+
+            for_less( k, 0, n )
+            {
+                sum = 0.0f;
+                for_less( t, 0, n_taps )
+                    sum += weights[k*MAX_STENCIL_TAPS+t] *
+                           src_line[indices[k*MAX_STENCIL_TAPS+t]];
+                dst_line[k] = sum;
+            }
+        }
+    }
+    else
+    {
+        for_less( o, 0, n_outer )
+        {
+            for_less( k, 0, n )
+            {
+                dst_row = &dst[(o*n+k)*n_inner];
+
+                src_row = &src[(o*n+indices[k*MAX_STENCIL_TAPS])*n_inner];
+                w = weights[k*MAX_STENCIL_TAPS];
+                for_less( j, 0, n_inner )
+                    dst_row[j] = w * src_row[j];
+
+                for_less( t, 1, n_taps )
+                {
+                    src_row = &src[(o*n+indices[k*MAX_STENCIL_TAPS+t])*
+                                   n_inner];
+                    w = weights[k*MAX_STENCIL_TAPS+t];
+                    if( w == 0.0f )
+                        continue;
+
+                    for_less( j, 0, n_inner )
+                        dst_row[j] += w * src_row[j];
+                }
+            }
+        }
+    }
+
+    FREE( indices );
+    FREE( weights );
+}
+
+/*--- computes one partial derivative, orders[dim] being the order of
+      differentiation along each axis, with the passes along z first */
+
+private  void  compute_derivative_component(
+    int     sizes[],
+    float   values[],
+    int     continuity,
+    int     orders[],
+    float   *scratch[],
+    float   result[] )
+{
+    int     dim, axis, n_passes, pass, n_voxels, axes[N_DIMENSIONS], i;
+    float   *src, *dst;
+
+    n_passes = 0;
+    for( axis = N_DIMENSIONS-1;  axis >= 0;  --axis )
+    {
+        if( !is_identity_stencil( continuity, orders[axis] ) )
+        {
+            axes[n_passes] = axis;
+            ++n_passes;
+        }
+    }
+
+    if( n_passes == 0 )
+    {
+        n_voxels = 1;
+        for_less( dim, 0, N_DIMENSIONS )
+            n_voxels *= sizes[dim];
+
+        for_less( i, 0, n_voxels )
+            result[i] = values[i];
+        return;
+    }
+
+    src = values;
+
+    for_less( pass, 0, n_passes )
+    {
+        if( pass == n_passes-1 )
+            dst = result;
+        else
+            dst = scratch[pass % 2];
+
+        apply_axis_stencil( sizes, axes[pass], continuity,
+                            orders[axes[pass]], src, dst );
+        src = dst;
+    }
+}
+
+/* ----------------------------- MNI Header -----------------------------------
+@NAME       : compute_volume_derivatives
+@INPUT      : sizes
+              values
+              continuity
+              type
+@OUTPUT     : derivatives
+@RETURNS    :
+@DESCRIPTION: Computes the derivatives of the given type at every voxel of
+              the float buffer, each component into its own buffer of the
+              same size, derivatives[comp].  The continuity is that of
+              evaluate_volume(), 0 for linear, 1 for quadratic and 2 for
+              cubic.
+@METHOD     :
+@GLOBALS    :
+@CALLS      :
+@CREATED    :
+@MODIFIED   :
+---------------------------------------------------------------------------- */
+
+public  void  compute_volume_derivatives(
+    int               sizes[],
+    float             values[],
+    int               continuity,
+    Derivative_types  type,
+    float             *derivatives[] )
+{
+    static  int  first_orders[N_DIMENSIONS][N_DIMENSIONS] =
+                     { { 1, 0, 0 }, { 0, 1, 0 }, { 0, 0, 1 } };
+    static  int  second_orders[N_DIMENSIONS][N_DIMENSIONS] =
+                     { { 2, 0, 0 }, { 0, 2, 0 }, { 0, 0, 2 } };
+    static  int  hessian_orders[6][N_DIMENSIONS] =
+                     { { 2, 0, 0 }, { 1, 1, 0 }, { 1, 0, 1 },
+                       { 0, 2, 0 }, { 0, 1, 1 }, { 0, 0, 2 } };
+    int      dim, comp, i, n_voxels, n_components;
+    int      (*orders)[N_DIMENSIONS];
+    BOOLEAN  magnitude;
+    float    *scratch[2], *component, *sum_squares;
+
+    n_voxels = 1;
+    for_less( dim, 0, N_DIMENSIONS )
+        n_voxels *= sizes[dim];
+
+    switch( type )
+    {
+    case GRADIENT_MAGNITUDE:
+    case GRADIENT_COMPONENTS:
+        orders = first_orders;
+        n_components = N_DIMENSIONS;
+        break;
+
+    case SECOND_DERIVATIVE_MAGNITUDE:
+    case HESSIAN_DIAGONAL:
+        orders = second_orders;
+        n_components = N_DIMENSIONS;
+        break;
+
+    case FULL_HESSIAN:
+    default:
+        orders = hessian_orders;
+        n_components = 6;
+        break;
+    }
+
+    magnitude = (type == GRADIENT_MAGNITUDE ||
+                 type == SECOND_DERIVATIVE_MAGNITUDE);
+
+    ALLOC( scratch[0], n_voxels );
+    ALLOC( scratch[1], n_voxels );
+
+    if( magnitude )
+    {
+        sum_squares = derivatives[0];
+        ALLOC( component, n_voxels );
+
+        for_less( i, 0, n_voxels )
+            sum_squares[i] = 0.0f;
+
+        for_less( comp, 0, n_components )
+        {
+            compute_derivative_component( sizes, values, continuity,
+                                          orders[comp], scratch, component );
+
+            for_less( i, 0, n_voxels )
+                sum_squares[i] += component[i] * component[i];
+        }
+
+        for_less( i, 0, n_voxels )
+            sum_squares[i] = (float) sqrt( (double) sum_squares[i] );
+
+        FREE( component );
+    }
+    else
+    {
+        for_less( comp, 0, n_components )
+        {
+            compute_derivative_component( sizes, values, continuity,
+                                          orders[comp], scratch,
+                                          derivatives[comp] );
+        }
+    }
+
+    FREE( scratch[0] );
+    FREE( scratch[1] );
+}
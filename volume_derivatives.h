@@ -0,0 +1,41 @@
+#ifndef  DEF_VOLUME_DERIVATIVES_H
+#define  DEF_VOLUME_DERIVATIVES_H
+
+#include  <bicpl.h>
+
+/*--- derivatives of a volume at every voxel, in voxel units, computed by
+      separable 1D stencils on a float buffer of the voxel values, stored
+      values[(x*sizes[Y]+y)*sizes[Z]+z].  At integer positions the stencils
+      give the same result as evaluate_volume() with the same continuity,
+      except within a voxel of the border.  There the neighbours past the
+      edge are clamped to the edge voxel, whereas evaluate_volume() lowers
+      the continuity until its neighbourhood fits inside the volume, so the
+      border values differ, most for second derivatives.
+
+      GRADIENT_MAGNITUDE             1 component
+      GRADIENT_COMPONENTS            3 components: dx, dy, dz
+      SECOND_DERIVATIVE_MAGNITUDE    1 component, of the Hessian diagonal
+      HESSIAN_DIAGONAL               3 components: dxx, dyy, dzz
+      FULL_HESSIAN                   6 components: dxx, dxy, dxz, dyy, dyz, dzz
+*/
+
+typedef  enum  { GRADIENT_MAGNITUDE,
+                 GRADIENT_COMPONENTS,
+                 SECOND_DERIVATIVE_MAGNITUDE,
+                 HESSIAN_DIAGONAL,
+                 FULL_HESSIAN }
+               Derivative_types;
+
+#ifndef  public
+#define       public   extern
+#define       public_was_defined_here
+#endif
+
+#include  <volume_derivatives_prototypes.h>
+
+#ifdef  public_was_defined_here
+#undef       public
+#undef       public_was_defined_here
+#endif
+
+#endif
@@ -0,0 +1,21 @@
+#ifndef  DEF_VOLUME_DERIVATIVES_PROTOTYPES
+#define  DEF_VOLUME_DERIVATIVES_PROTOTYPES
+
+public  void  get_volume_float_values(
+    Volume   volume,
+    float    values[] );
+
+public  void  set_volume_float_values(
+    Volume   volume,
+    float    values[] );
+
+public  int  get_n_derivative_components(
+    Derivative_types  type );
+
+public  void  compute_volume_derivatives(
+    int               sizes[],
+    float             values[],
+    int               continuity,
+    Derivative_types  type,
+    float             *derivatives[] );
+#endif
@@ -1,11 +1,13 @@
 #include  <volume_io/internal_volume_io.h>
 #include  <bicpl.h>
+#include  <volume_sampler.h>
 
 #include  "ParseArgv.h"
 
 /* argument defaults */
 int                  degrees_continuity = 0; /* default: linear */
 int                  rgb_conversion = 0;     /* default: colour flag */
+int                  binary_output = 0;      /* default: ascii */
 
 /* the argument table */
 ArgvInfo argTable[] = {
@@ -21,6 +23,9 @@ ArgvInfo argTable[] = {
   { "-rgb", ARGV_CONSTANT, (char *) 1,
     (char *) &rgb_conversion,
         "Convert rgb colour to colour flag." },
+  { "-binary", ARGV_CONSTANT, (char *) 1,
+    (char *) &binary_output,
+        "Write the values as binary floats, all volumes for each point." },
   
   { NULL, ARGV_END, NULL, NULL, NULL }
 };
@@ -29,29 +34,36 @@ int  main(
     int   argc,
     char  *argv[] )
 {
-    STRING               input_volume_filename, object_filename;
+    STRING               *input_volume_filenames, object_filename;
     STRING               output_filename;
     File_formats         format;
     minc_input_options   options;
-    Volume               volume;
-    int                  point, n_points, n_objects;
+    Volume               *volumes;
+    int                  point, n_points, n_objects, n_volumes, v;
     Point                *points;
     object_struct        **objects;
-    Real                 value;
+    Real                 **values;
+    float                *buffer;
+    volume_sampler_struct  sampler;
 //    Real                 rgb_values[4];
     FILE                 *file;
 
     /* Call ParseArgv */
-    if ( ParseArgv( &argc, argv, argTable, 0 ) || ( argc != 4 ) ) {
+    if ( ParseArgv( &argc, argv, argTable, 0 ) || ( argc < 4 ) ) {
       (void) fprintf( stderr,
-                      "\nUsage: %s [options] <volume.mnc> <object.obj> <output.txt>\n", argv[0] );
+                      "\nUsage: %s [options] <volume.mnc> [<volume.mnc> ...] <object.obj> <output.txt>\n", argv[0] );
       exit( 1 );
     }
 
     initialize_argument_processing( argc, argv );
 
-    if( !get_string_argument( NULL, &input_volume_filename ) ||
-        !get_string_argument( NULL, &object_filename ) ||
+    n_volumes = argc - 3;
+    ALLOC( input_volume_filenames, n_volumes );
+
+    for_less( v, 0, n_volumes )
+        (void) get_string_argument( NULL, &input_volume_filenames[v] );
+
+    if( !get_string_argument( NULL, &object_filename ) ||
         !get_string_argument( NULL, &output_filename ) )
     {
         print_error(
@@ -66,10 +78,16 @@ int  main(
       set_minc_input_vector_to_scalar_flag( &options, FALSE );
     }
 
-    if( input_volume( input_volume_filename, 3, File_order_dimension_names,
-                      NC_UNSPECIFIED, FALSE, 0.0, 0.0,
-                      TRUE, &volume, &options ) != OK )
-        return( 1 );
+    ALLOC( volumes, n_volumes );
+
+    for_less( v, 0, n_volumes )
+    {
+        if( input_volume( input_volume_filenames[v], 3,
+                          File_order_dimension_names,
+                          NC_UNSPECIFIED, FALSE, 0.0, 0.0,
+                          TRUE, &volumes[v], &options ) != OK )
+            return( 1 );
+    }
 
     if( input_graphics_file( object_filename,
                              &format, &n_objects, &objects ) != OK )
@@ -80,37 +98,82 @@ int  main(
 
     n_points = get_object_points( objects[0], &points );
 
-    if( open_file( output_filename, WRITE_FILE, ASCII_FORMAT, &file ) != OK )
-        return( 1 );
+    /*--- sample all the volumes at once, volumes on the same grid share
+          one transformation and traversal of the points */
+
+    initialize_volume_sampler( &sampler, n_points );
 
     for_less( point, 0, n_points )
     {
-        evaluate_volume_in_world( volume,
+        set_volume_sampler_point( &sampler, point,
                                   RPoint_x(points[point]),
                                   RPoint_y(points[point]),
-                                  RPoint_z(points[point]),
-                                  degrees_continuity, 
-                                  FALSE, 0.0,
-                                  &value,
-                                  NULL, NULL, NULL,
-                                  NULL, NULL, NULL, NULL, NULL, NULL );
-
-        if( rgb_conversion ) {
-          // rgb_values[0] = get_Colour_r_0_1( value );
-          // rgb_values[1] = get_Colour_g_0_1( value );
-          // rgb_values[2] = get_Colour_b_0_1( value );
-          if( output_int( file, (int)value ) != OK ||
-              output_newline( file ) != OK )
-              return( 1 );
-        } else {
-          if( output_real( file, value ) != OK ||
-              output_newline( file ) != OK )
-              return( 1 );
+                                  RPoint_z(points[point]) );
+    }
+
+    ALLOC2D( values, n_volumes, n_points );
+
+    sample_volumes_at_points( &sampler, n_volumes, volumes,
+                              degrees_continuity, 0.0, values, NULL );
+
+    delete_volume_sampler( &sampler );
+
+    for_less( v, 0, n_volumes )
+        delete_volume( volumes[v] );
+    FREE( volumes );
+
+    if( binary_output )
+    {
+        if( open_file( output_filename, WRITE_FILE, BINARY_FORMAT,
+                       &file ) != OK )
+            return( 1 );
+
+        ALLOC( buffer, n_volumes * n_points );
+
+        for_less( point, 0, n_points )
+        {
+            for_less( v, 0, n_volumes )
+                buffer[IJ(point,v,n_volumes)] = (float) values[v][point];
+        }
+
+        if( io_binary_data( file, WRITE_FILE, (void *) buffer, sizeof(float),
+                            n_volumes * n_points ) != OK )
+            return( 1 );
+
+        FREE( buffer );
+    }
+    else
+    {
+        if( open_file( output_filename, WRITE_FILE, ASCII_FORMAT,
+                       &file ) != OK )
+            return( 1 );
+
+        for_less( point, 0, n_points )
+        {
+            for_less( v, 0, n_volumes )
+            {
+                if( rgb_conversion ) {
+                  // rgb_values[0] = get_Colour_r_0_1( value );
+                  // rgb_values[1] = get_Colour_g_0_1( value );
+                  // rgb_values[2] = get_Colour_b_0_1( value );
+                  if( output_int( file, (int) values[v][point] ) != OK )
+                      return( 1 );
+                } else {
+                  if( output_real( file, values[v][point] ) != OK )
+                      return( 1 );
+                }
+            }
+
+            if( output_newline( file ) != OK )
+                return( 1 );
         }
     }
 
     (void) close_file( file );
 
+    FREE2D( values );
+    FREE( input_volume_filenames );
+
     delete_object_list( n_objects, objects );
 
     return( 0 );
@@ -0,0 +1,381 @@
+#include  <volume_io/internal_volume_io.h>
+#include  <volume_pyramid.h>
+#include  <volume_derivatives.h>
+
+/*--- ratio of the full width at half maximum of a Gaussian to its
+      standard deviation, 2 sqrt( 2 ln 2 ) */
+
+#define  FWHM_TO_SIGMA   2.354820045
+
+/*--- computes the weights of the input voxels for each of the new_n output
+      voxels along an axis, weights[i*max_taps+t] applying to input voxel
+      first[i]+t, for t less than n_taps[i] */
+
+private  int  get_axis_weights(
+    int                 n,
+    int                 new_n,
+    Real                ratio,
+    Downsample_filters  filter,
+    int                 *first[],
+    int                 *n_taps[],
+    float               *weights[] )
+{
+    int     i, j, start, end, max_taps;
+    Real    lo, hi, centre, sigma, half_width, w, sum;
+
+    if( filter == GAUSSIAN_FILTER && ratio <= 1.0 )
+        filter = BOX_FILTER;
+
+    sigma = ratio / FWHM_TO_SIGMA;
+    half_width = 3.0 * sigma;
+
+    if( filter == BOX_FILTER )
+        max_taps = (int) ceil( ratio ) + 2;
+    else
+        max_taps = 2 * (int) ceil( half_width ) + 2;
+
+    ALLOC( *first, new_n );
+    ALLOC( *n_taps, new_n );
+    ALLOC( *weights, new_n * max_taps );
+
+    for_less( i, 0, new_n )
+    {
+        if( filter == BOX_FILTER )
+        {
+            lo = (Real) i * ratio;
+            hi = MIN( (Real) (i+1) * ratio, (Real) n );
+            if( lo > (Real) n - 1.0 )
+                lo = (Real) n - 1.0;
+            if( hi <= lo )
+                hi = lo + 1.0;
+
+            start = (int) lo;
+            end = MIN( n, (int) ceil( hi ) );
+        }
+        else
+        {
+            centre = ((Real) i + 0.5) * ratio - 0.5;
+            start = MAX( 0, (int) ceil( centre - half_width ) );
+            end = MIN( n, (int) floor( centre + half_width ) + 1 );
+            if( end <= start )
+            {
+                start = MIN( n-1, MAX( 0, ROUND( centre ) ) );
+                end = start + 1;
+            }
+        }
+
+        if( end - start > max_taps )
+            end = start + max_taps;
+
+        sum = 0.0;
+        for_less( j, start, end )
+        {
+            if( filter == BOX_FILTER )
+                w = MIN( hi, (Real) (j+1) ) - MAX( lo, (Real) j );
+            else
+                w = exp( -((Real) j - centre) * ((Real) j - centre) /
+                         (2.0 * sigma * sigma) );
+
+            (*weights)[i*max_taps+j-start] = (float) w;
+            sum += w;
+        }
+
+        if( sum <= 0.0 )
+        {
+            (*weights)[i*max_taps] = 1.0f;
+            end = start + 1;
+            sum = 1.0;
+        }
+
+        for_less( j, start, end )
+            (*weights)[i*max_taps+j-start] /= (float) sum;
+
+        (*first)[i] = start;
+        (*n_taps)[i] = end - start;
+    }
+
+    return( max_taps );
+}
+
+/*--- filters and decimates along one axis, viewing the input as
+      [n_outer][sizes[axis]][n_inner] and the output as
+      [n_outer][new_n][n_inner] */
+
+private  void  downsample_axis(
+    int                 sizes[],
+    int                 axis,
+    int                 new_n,
+    Real                ratio,
+    Downsample_filters  filter,
+    float               src[],
+    float               dst[] )
+{
+    int     dim, n, n_outer, n_inner, o, i, t, j, max_taps;
+    int     *first, *n_taps;
+    float   *weights, *dst_row, *src_row, *src_line, w, sum;
+
+    n = sizes[axis];
+    n_outer = 1;
+    n_inner = 1;
+    for_less( dim, 0, N_DIMENSIONS )
+    {
+        if( dim < axis )
+            n_outer *= sizes[dim];
+        else if( dim > axis )
+            n_inner *= sizes[dim];
+    }
+
+    max_taps = get_axis_weights( n, new_n, ratio, filter,
+                                 &first, &n_taps, &weights );
+
+    if( n_inner == 1 )
+    {
+        for_less( o, 0, n_outer )
+        {
+            for_less( i, 0, new_n )
+            {
+                src_line = &src[o*n+first[i]];
+                sum = 0.0f;
+                for_less( t, 0, n_taps[i] )
+                    sum += weights[i*max_taps+t] * src_line[t];
+                dst[o*new_n+i] = sum;
+            }
+        }
+    }
+    else
+    {
+        for_less( o, 0, n_outer )
+        {
+            for_less( i, 0, new_n )
+            {
+                dst_row = &dst[(o*new_n+i)*n_inner];
+
+                src_row = &src[(o*n+first[i])*n_inner];
+                w = weights[i*max_taps];
+                for_less( j, 0, n_inner )
+                    dst_row[j] = w * src_row[j];
+
+                for_less( t, 1, n_taps[i] )
+                {
+                    src_row = &src[(o*n+first[i]+t)*n_inner];
+                    w = weights[i*max_taps+t];
+                    for_less( j, 0, n_inner )
+                        dst_row[j] += w * src_row[j];
+                }
+            }
+        }
+    }
+
+    FREE( first );
+    FREE( n_taps );
+    FREE( weights );
+}
+
+/* ----------------------------- MNI Header -----------------------------------
+@NAME       : downsample_float_values
+@INPUT      : sizes
+              values
+              ratios
+              new_sizes
+              filter
+@OUTPUT     : new_values
+@RETURNS    :
+@DESCRIPTION: Downsamples the buffer to new_sizes, each output voxel
+              covering ratios[dim] input voxels, by filtering and decimating
+              along z, y, then x, so that each pass works on the output of
+              the previous, smaller one.  A ratio of 1 along an axis with
+              the same size leaves that axis alone.
+@METHOD     :
+@GLOBALS    :
+@CALLS      :
+@CREATED    :
+@MODIFIED   :
+---------------------------------------------------------------------------- */
+
+public  void  downsample_float_values(
+    int                 sizes[],
+    float               values[],
+    Real                ratios[],
+    int                 new_sizes[],
+    Downsample_filters  filter,
+    float               new_values[] )
+{
+    int     axis, dim, pass, n_passes, axes[N_DIMENSIONS];
+    int     current_sizes[N_DIMENSIONS], n_voxels, i;
+    float   *src, *dst, *scratch[2];
+
+    n_passes = 0;
+    for( axis = N_DIMENSIONS-1;  axis >= 0;  --axis )
+    {
+        if( new_sizes[axis] != sizes[axis] || ratios[axis] != 1.0 )
+        {
+            axes[n_passes] = axis;
+            ++n_passes;
+        }
+    }
+
+    for_less( dim, 0, N_DIMENSIONS )
+        current_sizes[dim] = sizes[dim];
+
+    if( n_passes == 0 )
+    {
+        n_voxels = sizes[X] * sizes[Y] * sizes[Z];
+        for_less( i, 0, n_voxels )
+            new_values[i] = values[i];
+        return;
+    }
+
+    scratch[0] = NULL;
+    scratch[1] = NULL;
+    src = values;
+
+    for_less( pass, 0, n_passes )
+    {
+        axis = axes[pass];
+
+        if( pass == n_passes-1 )
+            dst = new_values;
+        else
+        {
+            n_voxels = current_sizes[X] * current_sizes[Y] *
+                       current_sizes[Z] / current_sizes[axis] *
+                       new_sizes[axis];
+            ALLOC( scratch[pass % 2], n_voxels );
+            dst = scratch[pass % 2];
+        }
+
+        downsample_axis( current_sizes, axis, new_sizes[axis], ratios[axis],
+                         filter, src, dst );
+
+        if( pass > 0 )
+            FREE( scratch[(pass-1) % 2] );
+
+        current_sizes[axis] = new_sizes[axis];
+        src = dst;
+    }
+}
+
+/* ----------------------------- MNI Header -----------------------------------
+@NAME       : create_float_pyramid
+@INPUT      : sizes
+              values
+              n_levels
+              filter
+@OUTPUT     : level_sizes
+              level_values
+@RETURNS    : number of levels
+@DESCRIPTION: Creates up to n_levels levels of a pyramid, level 0 being the
+              given buffer itself and each following level half the size of
+              the previous one along each axis that is still longer than
+              one voxel.  Stops early once every axis is one voxel long.
+              Levels from 1 on are allocated, and freed by the caller.
+@METHOD     :
+@GLOBALS    :
+@CALLS      :
+@CREATED    :
+@MODIFIED   :
+---------------------------------------------------------------------------- */
+
+public  int  create_float_pyramid(
+    int                 sizes[],
+    float               values[],
+    int                 n_levels,
+    Downsample_filters  filter,
+    int                 level_sizes[][N_DIMENSIONS],
+    float               *level_values[] )
+{
+    int       level, dim;
+    Real      ratios[N_DIMENSIONS];
+    BOOLEAN   shrinks;
+
+    for_less( dim, 0, N_DIMENSIONS )
+        level_sizes[0][dim] = sizes[dim];
+    level_values[0] = values;
+
+    for_less( level, 1, n_levels )
+    {
+        shrinks = FALSE;
+        for_less( dim, 0, N_DIMENSIONS )
+        {
+            if( level_sizes[level-1][dim] > 1 )
+            {
+                level_sizes[level][dim] = (level_sizes[level-1][dim] + 1) / 2;
+                ratios[dim] = 2.0;
+                shrinks = TRUE;
+            }
+            else
+            {
+                level_sizes[level][dim] = 1;
+                ratios[dim] = 1.0;
+            }
+        }
+
+        if( !shrinks )
+            break;
+
+        ALLOC( level_values[level], level_sizes[level][X] *
+                                    level_sizes[level][Y] *
+                                    level_sizes[level][Z] );
+
+        downsample_float_values( level_sizes[level-1], level_values[level-1],
+                                 ratios, level_sizes[level], filter,
+                                 level_values[level] );
+    }
+
+    return( level );
+}
+
+/*--- creates a volume of the same type as the given one, with voxels
+      ratios[dim] times as large and the first voxel centred on the first
+      block of the original, and fills it with new_values */
+
+public  Volume  create_downsampled_volume(
+    Volume   volume,
+    Real     ratios[],
+    int      new_sizes[],
+    float    new_values[] )
+{
+    int      dim, i, n_voxels;
+    Real     separations[MAX_DIMENSIONS];
+    Real     voxel[MAX_DIMENSIONS], world[N_DIMENSIONS];
+    Real     min_value, max_value;
+    Volume   new_volume;
+
+    new_volume = copy_volume_definition_no_alloc( volume, NC_UNSPECIFIED,
+                                                  FALSE, 0.0, 0.0 );
+
+    set_volume_sizes( new_volume, new_sizes );
+    alloc_volume_data( new_volume );
+
+    get_volume_separations( volume, separations );
+    for_less( dim, 0, N_DIMENSIONS )
+    {
+        separations[dim] *= ratios[dim];
+        voxel[dim] = (ratios[dim] - 1.0) / 2.0;
+    }
+    set_volume_separations( new_volume, separations );
+
+    convert_voxel_to_world( volume, voxel, &world[X], &world[Y], &world[Z] );
+
+    for_less( dim, 0, N_DIMENSIONS )
+        voxel[dim] = 0.0;
+    set_volume_translation( new_volume, voxel, world );
+
+    n_voxels = new_sizes[X] * new_sizes[Y] * new_sizes[Z];
+
+    min_value = (Real) new_values[0];
+    max_value = min_value;
+    for_less( i, 1, n_voxels )
+    {
+        if( (Real) new_values[i] < min_value )
+            min_value = (Real) new_values[i];
+        else if( (Real) new_values[i] > max_value )
+            max_value = (Real) new_values[i];
+    }
+
+    set_volume_real_range( new_volume, min_value, max_value );
+
+    set_volume_float_values( new_volume, new_values );
+
+    return( new_volume );
+}
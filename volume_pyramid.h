@@ -0,0 +1,27 @@
+#ifndef  DEF_VOLUME_PYRAMID_H
+#define  DEF_VOLUME_PYRAMID_H
+
+#include  <bicpl.h>
+
+/*--- downsampling of float voxel buffers, stored
+      values[(x*sizes[Y]+y)*sizes[Z]+z], by a separable prefilter evaluated
+      only at the output voxel centres.  Each output voxel covers ratio
+      input voxels along each axis: BOX_FILTER averages the input voxels
+      weighted by their overlap with it, GAUSSIAN_FILTER weights them by a
+      Gaussian whose FWHM is the ratio.  */
+
+typedef  enum  { BOX_FILTER, GAUSSIAN_FILTER }  Downsample_filters;
+
+#ifndef  public
+#define       public   extern
+#define       public_was_defined_here
+#endif
+
+#include  <volume_pyramid_prototypes.h>
+
+#ifdef  public_was_defined_here
+#undef       public
+#undef       public_was_defined_here
+#endif
+
+#endif
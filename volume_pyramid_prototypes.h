@@ -0,0 +1,25 @@
+#ifndef  DEF_VOLUME_PYRAMID_PROTOTYPES
+#define  DEF_VOLUME_PYRAMID_PROTOTYPES
+
+public  void  downsample_float_values(
+    int                 sizes[],
+    float               values[],
+    Real                ratios[],
+    int                 new_sizes[],
+    Downsample_filters  filter,
+    float               new_values[] );
+
+public  int  create_float_pyramid(
+    int                 sizes[],
+    float               values[],
+    int                 n_levels,
+    Downsample_filters  filter,
+    int                 level_sizes[][N_DIMENSIONS],
+    float               *level_values[] );
+
+public  Volume  create_downsampled_volume(
+    Volume   volume,
+    Real     ratios[],
+    int      new_sizes[],
+    float    new_values[] );
+#endif
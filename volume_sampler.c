@@ -0,0 +1,392 @@
+#include  <volume_io/internal_volume_io.h>
+#include  <volume_sampler.h>
+
+/*--- points are evaluated in order of the voxel block they fall in, so
+      that consecutive evaluations touch nearby memory */
+
+#define  SAMPLE_BLOCK_SIZE  4
+
+public  void  initialize_volume_sampler(
+    volume_sampler_struct  *sampler,
+    int                    n_points )
+{
+    int   dim;
+
+    sampler->n_points = n_points;
+    sampler->grid_valid = FALSE;
+
+    for_less( dim, 0, N_DIMENSIONS )
+    {
+        sampler->world[dim] = NULL;
+        sampler->voxels[dim] = NULL;
+    }
+    sampler->order = NULL;
+
+    if( n_points > 0 )
+    {
+        for_less( dim, 0, N_DIMENSIONS )
+        {
+            ALLOC( sampler->world[dim], n_points );
+            ALLOC( sampler->voxels[dim], n_points );
+        }
+        ALLOC( sampler->order, n_points );
+    }
+}
+
+public  void  set_volume_sampler_point(
+    volume_sampler_struct  *sampler,
+    int                    point,
+    Real                   x,
+    Real                   y,
+    Real                   z )
+{
+    sampler->world[X][point] = x;
+    sampler->world[Y][point] = y;
+    sampler->world[Z][point] = z;
+
+    sampler->grid_valid = FALSE;
+}
+
+public  void  delete_volume_sampler(
+    volume_sampler_struct  *sampler )
+{
+    int   dim;
+
+    if( sampler->n_points > 0 )
+    {
+        for_less( dim, 0, N_DIMENSIONS )
+        {
+            FREE( sampler->world[dim] );
+            FREE( sampler->voxels[dim] );
+        }
+        FREE( sampler->order );
+    }
+}
+
+/*--- the world to voxel mapping of a volume is affine, so it is found
+      from the images of the origin and the three unit vectors */
+
+private  void  get_volume_grid(
+    Volume    volume,
+    int       sizes[],
+    Real      origin[],
+    Real      axes[N_DIMENSIONS][N_DIMENSIONS] )
+{
+    int    dim, axis;
+    Real   voxel[MAX_DIMENSIONS], world[N_DIMENSIONS];
+
+    get_volume_sizes( volume, sizes );
+
+    convert_world_to_voxel( volume, 0.0, 0.0, 0.0, voxel );
+    for_less( dim, 0, N_DIMENSIONS )
+        origin[dim] = voxel[dim];
+
+    for_less( axis, 0, N_DIMENSIONS )
+    {
+        world[X] = 0.0;
+        world[Y] = 0.0;
+        world[Z] = 0.0;
+        world[axis] = 1.0;
+
+        convert_world_to_voxel( volume, world[X], world[Y], world[Z], voxel );
+
+        for_less( dim, 0, N_DIMENSIONS )
+            axes[axis][dim] = voxel[dim] - origin[dim];
+    }
+}
+
+private  BOOLEAN  same_grid(
+    volume_sampler_struct  *sampler,
+    int                    sizes[],
+    Real                   origin[],
+    Real                   axes[N_DIMENSIONS][N_DIMENSIONS] )
+{
+    int   dim, axis;
+
+    if( !sampler->grid_valid )
+        return( FALSE );
+
+    for_less( dim, 0, N_DIMENSIONS )
+    {
+        if( sizes[dim] != sampler->sizes[dim] ||
+            origin[dim] != sampler->origin[dim] )
+            return( FALSE );
+
+        for_less( axis, 0, N_DIMENSIONS )
+        {
+            if( axes[axis][dim] != sampler->axes[axis][dim] )
+                return( FALSE );
+        }
+    }
+
+    return( TRUE );
+}
+
+typedef  struct
+{
+    int   key;
+    int   point;
+} sample_order_struct;
+
+private  int  compare_sample_order(
+    const void  *p1,
+    const void  *p2 )
+{
+    const sample_order_struct  *s1 = (const sample_order_struct *) p1;
+    const sample_order_struct  *s2 = (const sample_order_struct *) p2;
+
+    if( s1->key < s2->key )
+        return( -1 );
+    else if( s1->key > s2->key )
+        return( 1 );
+    else
+        return( s1->point - s2->point );
+}
+
+/*--- transforms all the points to voxel coordinates of the grid, one
+      coordinate at a time, and sorts them by the voxel block they are in */
+
+private  void  set_sampler_grid(
+    volume_sampler_struct  *sampler,
+    int                    sizes[],
+    Real                   origin[],
+    Real                   axes[N_DIMENSIONS][N_DIMENSIONS] )
+{
+    int                  point, dim, axis, n_blocks[N_DIMENSIONS];
+    int                  block, key;
+    Real                 *voxel, *world;
+    sample_order_struct  *order;
+
+    for_less( dim, 0, N_DIMENSIONS )
+    {
+        sampler->sizes[dim] = sizes[dim];
+        sampler->origin[dim] = origin[dim];
+        for_less( axis, 0, N_DIMENSIONS )
+            sampler->axes[axis][dim] = axes[axis][dim];
+
+        voxel = sampler->voxels[dim];
+
+        for_less( point, 0, sampler->n_points )
+            voxel[point] = origin[dim];
+
+        for_less( axis, 0, N_DIMENSIONS )
+        {
+            world = sampler->world[axis];
+            for_less( point, 0, sampler->n_points )
+                voxel[point] += axes[axis][dim] * world[point];
+        }
+
+        n_blocks[dim] = (sizes[dim] + SAMPLE_BLOCK_SIZE - 1) /
+                        SAMPLE_BLOCK_SIZE;
+    }
+
+    if( sampler->n_points > 0 )
+        ALLOC( order, sampler->n_points );
+
+    for_less( point, 0, sampler->n_points )
+    {
+        key = 0;
+        for_less( dim, 0, N_DIMENSIONS )
+        {
+            block = FLOOR( sampler->voxels[dim][point] ) / SAMPLE_BLOCK_SIZE;
+            if( block < 0 )
+                block = 0;
+            else if( block >= n_blocks[dim] )
+                block = n_blocks[dim] - 1;
+            key = key * n_blocks[dim] + block;
+        }
+
+        order[point].key = key;
+        order[point].point = point;
+    }
+
+    if( sampler->n_points > 0 )
+    {
+        qsort( (void *) order, (size_t) sampler->n_points, sizeof(order[0]),
+               compare_sample_order );
+
+        for_less( point, 0, sampler->n_points )
+            sampler->order[point] = order[point].point;
+
+        FREE( order );
+    }
+
+    sampler->grid_valid = TRUE;
+}
+
+private  Real  sample_one_volume(
+    Volume    volume,
+    int       sizes[],
+    Real      voxel[],
+    int       degrees_continuity,
+    Real      outside_value,
+    BOOLEAN   *inside )
+{
+    int    dim, i[N_DIMENSIONS];
+    Real   f[N_DIMENSIONS], value, v00, v01, v10, v11, v0, v1;
+
+    if( degrees_continuity < 0 )
+    {
+        for_less( dim, 0, N_DIMENSIONS )
+        {
+            i[dim] = ROUND( voxel[dim] );
+            if( i[dim] < 0 || i[dim] >= sizes[dim] )
+            {
+                *inside = FALSE;
+                return( outside_value );
+            }
+        }
+
+        *inside = TRUE;
+        return( get_volume_real_value( volume, i[0], i[1], i[2], 0, 0 ) );
+    }
+
+    *inside = TRUE;
+    for_less( dim, 0, N_DIMENSIONS )
+    {
+        if( voxel[dim] < -0.5 || voxel[dim] > (Real) sizes[dim] - 0.5 )
+            *inside = FALSE;
+    }
+
+    /*--- interior linear interpolation is done here, anything else by
+          the general evaluation */
+
+    if( degrees_continuity == 0 )
+    {
+        for_less( dim, 0, N_DIMENSIONS )
+        {
+            i[dim] = FLOOR( voxel[dim] );
+            if( i[dim] < 0 || i[dim] >= sizes[dim] - 1 )
+                break;
+            f[dim] = voxel[dim] - (Real) i[dim];
+        }
+
+        if( dim == N_DIMENSIONS )
+        {
+            v00 = INTERPOLATE( f[2],
+                    get_volume_real_value( volume, i[0], i[1], i[2], 0, 0 ),
+                    get_volume_real_value( volume, i[0], i[1], i[2]+1, 0, 0 ));
+            v01 = INTERPOLATE( f[2],
+                    get_volume_real_value( volume, i[0], i[1]+1, i[2], 0, 0 ),
+                    get_volume_real_value( volume, i[0], i[1]+1, i[2]+1, 0,0));
+            v10 = INTERPOLATE( f[2],
+                    get_volume_real_value( volume, i[0]+1, i[1], i[2], 0, 0 ),
+                    get_volume_real_value( volume, i[0]+1, i[1], i[2]+1, 0,0));
+            v11 = INTERPOLATE( f[2],
+                    get_volume_real_value( volume, i[0]+1, i[1]+1, i[2], 0,0),
+                    get_volume_real_value( volume, i[0]+1, i[1]+1, i[2]+1,
+                                           0, 0 ) );
+
+            v0 = INTERPOLATE( f[1], v00, v01 );
+            v1 = INTERPOLATE( f[1], v10, v11 );
+
+            return( INTERPOLATE( f[0], v0, v1 ) );
+        }
+    }
+
+    (void) evaluate_volume( volume, voxel, NULL, degrees_continuity, FALSE,
+                            outside_value, &value, NULL, NULL );
+
+    return( value );
+}
+
+/* ----------------------------- MNI Header -----------------------------------
+@NAME       : sample_volumes_at_points
+@INPUT      : sampler
+              n_volumes
+              volumes
+              degrees_continuity  - -1 nearest, 0 linear, 2 cubic
+              outside_value
+@OUTPUT     : values              - values[v][p] for volume v, point p
+              inside              - if not NULL, whether each point is
+                                    within each volume
+@RETURNS    :
+@DESCRIPTION: Evaluates several volumes at all the points.  Consecutive
+              volumes on the same voxel grid share one transformation and
+              sorting of the points, and are evaluated in a single pass
+              over them.  Volumes which are not 3D are evaluated point by
+              point in world coordinates.
+@METHOD     :
+@GLOBALS    :
+@CALLS      :
+@CREATED    :
+@MODIFIED   :
+---------------------------------------------------------------------------- */
+
+public  void  sample_volumes_at_points(
+    volume_sampler_struct  *sampler,
+    int                    n_volumes,
+    Volume                 volumes[],
+    int                    degrees_continuity,
+    Real                   outside_value,
+    Real                   *values[],
+    BOOLEAN                *inside[] )
+{
+    int       v, first, last, p, point, dim, sizes[MAX_DIMENSIONS];
+    Real      origin[N_DIMENSIONS], axes[N_DIMENSIONS][N_DIMENSIONS];
+    Real      voxel[MAX_DIMENSIONS];
+    BOOLEAN   point_inside;
+
+    first = 0;
+    while( first < n_volumes )
+    {
+        if( get_volume_n_dimensions( volumes[first] ) != N_DIMENSIONS )
+        {
+            for_less( point, 0, sampler->n_points )
+            {
+                evaluate_volume_in_world( volumes[first],
+                                          sampler->world[X][point],
+                                          sampler->world[Y][point],
+                                          sampler->world[Z][point],
+                                          degrees_continuity, FALSE,
+                                          outside_value,
+                                          &values[first][point],
+                                          NULL, NULL, NULL,
+                                          NULL, NULL, NULL, NULL, NULL, NULL );
+                if( inside != NULL )
+                    inside[first][point] = TRUE;
+            }
+
+            ++first;
+            continue;
+        }
+
+        get_volume_grid( volumes[first], sizes, origin, axes );
+
+        if( !same_grid( sampler, sizes, origin, axes ) )
+            set_sampler_grid( sampler, sizes, origin, axes );
+
+        /*--- find the run of volumes sharing this grid */
+
+        last = first + 1;
+        while( last < n_volumes &&
+               get_volume_n_dimensions( volumes[last] ) == N_DIMENSIONS )
+        {
+            get_volume_grid( volumes[last], sizes, origin, axes );
+            if( !same_grid( sampler, sizes, origin, axes ) )
+                break;
+            ++last;
+        }
+
+        for_less( p, 0, sampler->n_points )
+        {
+            point = sampler->order[p];
+
+            for_less( dim, 0, N_DIMENSIONS )
+                voxel[dim] = sampler->voxels[dim][point];
+
+            for_less( v, first, last )
+            {
+                values[v][point] = sample_one_volume( volumes[v],
+                                                      sampler->sizes, voxel,
+                                                      degrees_continuity,
+                                                      outside_value,
+                                                      &point_inside );
+                if( inside != NULL )
+                    inside[v][point] = point_inside;
+            }
+        }
+
+        first = last;
+    }
+}
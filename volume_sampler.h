@@ -0,0 +1,35 @@
+#ifndef  DEF_VOLUME_SAMPLER_H
+#define  DEF_VOLUME_SAMPLER_H
+
+#include  <bicpl.h>
+
+/*--- world positions to be sampled, and the voxel positions and
+      evaluation order for the grid of the last volume sampled, which are
+      reused for subsequent volumes on the same grid */
+
+typedef struct
+{
+    int       n_points;
+    Real      *world[N_DIMENSIONS];
+
+    BOOLEAN   grid_valid;
+    int       sizes[N_DIMENSIONS];
+    Real      origin[N_DIMENSIONS];
+    Real      axes[N_DIMENSIONS][N_DIMENSIONS];
+    Real      *voxels[N_DIMENSIONS];
+    int       *order;
+} volume_sampler_struct;
+
+#ifndef  public
+#define       public   extern
+#define       public_was_defined_here
+#endif
+
+#include  <volume_sampler_prototypes.h>
+
+#ifdef  public_was_defined_here
+#undef       public
+#undef       public_was_defined_here
+#endif
+
+#endif
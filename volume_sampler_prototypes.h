@@ -0,0 +1,26 @@
+#ifndef  DEF_VOLUME_SAMPLER_PROTOTYPES
+#define  DEF_VOLUME_SAMPLER_PROTOTYPES
+
+public  void  initialize_volume_sampler(
+    volume_sampler_struct  *sampler,
+    int                    n_points );
+
+public  void  set_volume_sampler_point(
+    volume_sampler_struct  *sampler,
+    int                    point,
+    Real                   x,
+    Real                   y,
+    Real                   z );
+
+public  void  delete_volume_sampler(
+    volume_sampler_struct  *sampler );
+
+public  void  sample_volumes_at_points(
+    volume_sampler_struct  *sampler,
+    int                    n_volumes,
+    Volume                 volumes[],
+    int                    degrees_continuity,
+    Real                   outside_value,
+    Real                   *values[],
+    BOOLEAN                *inside[] );
+#endif
@@ -0,0 +1,535 @@
+#include  <volume_io/internal_volume_io.h>
+#include  <voxel_histogram.h>
+
+/* ----------------------------- MNI Header -----------------------------------
+@NAME       : initialize_bin_range
+@INPUT      : min_value
+              max_value
+              n_bins
+@OUTPUT     : range
+@RETURNS    :
+@DESCRIPTION: Initializes n_bins equal bins spanning min_value to max_value.
+@METHOD     :
+@GLOBALS    :
+@CALLS      :
+@CREATED    :
+@MODIFIED   :
+---------------------------------------------------------------------------- */
+
+public  void  initialize_bin_range(
+    bin_range_struct  *range,
+    Real              min_value,
+    Real              max_value,
+    int               n_bins )
+{
+    if( n_bins < 1 )
+        n_bins = 1;
+
+    if( max_value <= min_value )
+        max_value = min_value + 1.0;
+
+    range->n_bins = n_bins;
+    range->min_value = min_value;
+    range->max_value = max_value;
+    range->bin_width = (max_value - min_value) / (Real) n_bins;
+    initialize_voxel_table( &range->table );
+}
+
+public  void  delete_bin_range(
+    bin_range_struct  *range )
+{
+    delete_voxel_table( &range->table );
+}
+
+/*--- returns the bin containing the value, or -1 if it is out of range */
+
+public  int  get_value_bin(
+    bin_range_struct  *range,
+    Real              value )
+{
+    int   bin;
+
+    if( value < range->min_value || value > range->max_value )
+        return( -1 );
+
+    bin = (int) ((value - range->min_value) / range->bin_width);
+
+    if( bin >= range->n_bins )
+        bin = range->n_bins - 1;
+
+    return( bin );
+}
+
+/*--- get_value_bin() in the form used to tabulate voxel values */
+
+private  int  get_value_bin_entry(
+    Real   value,
+    void   *range )
+{
+    return( get_value_bin( (bin_range_struct *) range, value ) );
+}
+
+#define  CONVERT_BINS( type )                                               \
+    {                                                                       \
+        type  *ptr = (type *) span->voxels;                                 \
+                                                                            \
+        for_less( i, 0, span->n_voxels )                                    \
+        {                                                                   \
+            value = span->scale * (Real) ptr[i] + span->translation;        \
+            if( value < min_value || value > max_value )                    \
+                bins[i] = -1;                                               \
+            else                                                            \
+            {                                                               \
+                bins[i] = (int) ((value - min_value) / bin_width);          \
+                if( bins[i] >= n_bins )                                     \
+                    bins[i] = n_bins - 1;                                   \
+            }                                                               \
+        }                                                                   \
+    }
+
+/* ----------------------------- MNI Header -----------------------------------
+@NAME       : get_voxel_span_bins
+@INPUT      : range
+              span
+@OUTPUT     : bins
+@RETURNS    :
+@DESCRIPTION: Finds the bin of the real value of each voxel of the span, or
+              -1 where it is out of range.  Byte and short voxels are binned
+              by lookup in a table of all their possible values, without
+              converting them to real values.
+@METHOD     :
+@GLOBALS    :
+@CALLS      :
+@CREATED    :
+@MODIFIED   :
+---------------------------------------------------------------------------- */
+
+public  void  get_voxel_span_bins(
+    bin_range_struct   *range,
+    voxel_span_struct  *span,
+    int                bins[] )
+{
+    int    i, n_bins;
+    Real   value, min_value, max_value, bin_width;
+
+    n_bins = range->n_bins;
+    min_value = range->min_value;
+    max_value = range->max_value;
+    bin_width = range->bin_width;
+
+    if( get_voxel_span_table_entries( &range->table, span,
+                                      get_value_bin_entry, (void *) range,
+                                      bins ) )
+        return;
+
+    switch( span->data_type )
+    {
+    case UNSIGNED_INT:    CONVERT_BINS( unsigned int );     break;
+    case SIGNED_INT:      CONVERT_BINS( int );              break;
+    case FLOAT:           CONVERT_BINS( float );            break;
+    case DOUBLE:          CONVERT_BINS( double );           break;
+    default:
+        handle_internal_error( "get_voxel_span_bins" );
+        break;
+    }
+}
+
+/*--- clears the bin of each voxel of the span whose mask value is zero */
+
+private  void  mask_voxel_span_bins(
+    voxel_span_struct  *mask_span,
+    Real               mask_values[],
+    int                bins[] )
+{
+    int   i;
+
+    get_voxel_span_values( mask_span, TRUE, mask_values );
+
+    for_less( i, 0, mask_span->n_voxels )
+    {
+        if( mask_values[i] == 0.0 )
+            bins[i] = -1;
+    }
+}
+
+/*--- checks that a volume to be scanned alongside another has the same
+      sizes */
+
+private  BOOLEAN  volumes_match(
+    Volume   volume,
+    Volume   other )
+{
+    int   dim, sizes[MAX_DIMENSIONS], other_sizes[MAX_DIMENSIONS];
+
+    if( get_volume_n_dimensions( volume ) != get_volume_n_dimensions( other ) )
+        return( FALSE );
+
+    get_volume_sizes( volume, sizes );
+    get_volume_sizes( other, other_sizes );
+
+    for_less( dim, 0, get_volume_n_dimensions( volume ) )
+    {
+        if( sizes[dim] != other_sizes[dim] )
+            return( FALSE );
+    }
+
+    return( TRUE );
+}
+
+public  void  initialize_voxel_histogram(
+    voxel_histogram_struct  *histogram,
+    Real                    min_value,
+    Real                    max_value,
+    int                     n_bins )
+{
+    int   bin;
+
+    initialize_bin_range( &histogram->range, min_value, max_value, n_bins );
+
+    ALLOC( histogram->counts, histogram->range.n_bins );
+    for_less( bin, 0, histogram->range.n_bins )
+        histogram->counts[bin] = 0;
+
+    histogram->n_samples = 0;
+}
+
+public  void  delete_voxel_histogram(
+    voxel_histogram_struct  *histogram )
+{
+    delete_bin_range( &histogram->range );
+    FREE( histogram->counts );
+}
+
+public  void  add_values_to_voxel_histogram(
+    voxel_histogram_struct  *histogram,
+    int                     n_values,
+    Real                    values[] )
+{
+    int   i, bin;
+
+    for_less( i, 0, n_values )
+    {
+        bin = get_value_bin( &histogram->range, values[i] );
+        if( bin >= 0 )
+        {
+            ++histogram->counts[bin];
+            ++histogram->n_samples;
+        }
+    }
+}
+
+/* ----------------------------- MNI Header -----------------------------------
+@NAME       : add_volume_to_voxel_histogram
+@INPUT      : histogram
+              volume
+              mask_volume
+@OUTPUT     : histogram
+@RETURNS    : OK or ERROR
+@DESCRIPTION: Adds the real values of all the voxels of the volume to the
+              histogram, or if mask_volume is not NULL, of those voxels where
+              the mask volume, of the same sizes, is nonzero.
+@METHOD     :
+@GLOBALS    :
+@CALLS      :
+@CREATED    :
+@MODIFIED   :
+---------------------------------------------------------------------------- */
+
+public  Status  add_volume_to_voxel_histogram(
+    voxel_histogram_struct  *histogram,
+    Volume                  volume,
+    Volume                  mask_volume )
+{
+    int                i, *bins, *counts, n_samples;
+    Real               *mask_values;
+    voxel_scan_struct  scan, mask_scan;
+    voxel_span_struct  span, mask_span;
+
+    if( mask_volume != NULL && !volumes_match( volume, mask_volume ) )
+    {
+        print_error( "Mask volume does not match the volume sizes.\n" );
+        return( ERROR );
+    }
+
+    initialize_voxel_scan( &scan, volume, 0 );
+    ALLOC( bins, get_voxel_scan_max_span( &scan ) );
+
+    if( mask_volume != NULL )
+    {
+        initialize_voxel_scan( &mask_scan, mask_volume,
+                               get_voxel_scan_max_span( &scan ) );
+        ALLOC( mask_values, get_voxel_scan_max_span( &scan ) );
+    }
+
+    counts = histogram->counts;
+    n_samples = 0;
+
+    while( get_next_voxel_span( &scan, &span ) )
+    {
+        get_voxel_span_bins( &histogram->range, &span, bins );
+
+        if( mask_volume != NULL &&
+            get_next_voxel_span( &mask_scan, &mask_span ) )
+            mask_voxel_span_bins( &mask_span, mask_values, bins );
+
+        for_less( i, 0, span.n_voxels )
+        {
+            if( bins[i] >= 0 )
+            {
+                ++counts[bins[i]];
+                ++n_samples;
+            }
+        }
+    }
+
+    histogram->n_samples += n_samples;
+
+    if( mask_volume != NULL )
+    {
+        FREE( mask_values );
+        delete_voxel_scan( &mask_scan );
+    }
+
+    FREE( bins );
+    delete_voxel_scan( &scan );
+
+    return( OK );
+}
+
+/*--- adds the counts of another histogram with the same bins, such as one
+      accumulated over a different part of the data */
+
+public  void  merge_voxel_histograms(
+    voxel_histogram_struct  *histogram,
+    voxel_histogram_struct  *other )
+{
+    int   bin;
+
+    if( other->range.n_bins != histogram->range.n_bins ||
+        other->range.min_value != histogram->range.min_value ||
+        other->range.max_value != histogram->range.max_value )
+    {
+        handle_internal_error( "merge_voxel_histograms" );
+        return;
+    }
+
+    for_less( bin, 0, histogram->range.n_bins )
+        histogram->counts[bin] += other->counts[bin];
+
+    histogram->n_samples += other->n_samples;
+}
+
+/* ----------------------------- MNI Header -----------------------------------
+@NAME       : get_voxel_histogram_counts
+@INPUT      : histogram
+              filter_width
+@OUTPUT     : counts
+              scale
+              trans
+@RETURNS    : number of counts
+@DESCRIPTION: Returns the counts from the first to the last nonempty bin,
+              box filtered over filter_width if this spans more than one bin,
+              count i being centred on the value scale * i + trans, in the
+              same manner as get_histogram_counts().
+@METHOD     :
+@GLOBALS    :
+@CALLS      :
+@CREATED    :
+@MODIFIED   :
+---------------------------------------------------------------------------- */
+
+public  int  get_voxel_histogram_counts(
+    voxel_histogram_struct  *histogram,
+    Real                    filter_width,
+    Real                    *counts[],
+    Real                    *scale,
+    Real                    *trans )
+{
+    int    first, last, n, i, j, half_width;
+    Real   sum;
+
+    first = 0;
+    while( first < histogram->range.n_bins && histogram->counts[first] == 0 )
+        ++first;
+
+    last = histogram->range.n_bins - 1;
+    while( last > first && histogram->counts[last] == 0 )
+        --last;
+
+    *scale = histogram->range.bin_width;
+    *trans = histogram->range.min_value +
+             ((Real) first + 0.5) * histogram->range.bin_width;
+
+    if( first >= histogram->range.n_bins )
+    {
+        *counts = NULL;
+        return( 0 );
+    }
+
+    n = last - first + 1;
+    ALLOC( *counts, n );
+
+    half_width = ROUND( filter_width / histogram->range.bin_width ) / 2;
+
+    for_less( i, 0, n )
+    {
+        sum = 0.0;
+        for_inclusive( j, i - half_width, i + half_width )
+        {
+            if( j >= 0 && j < n )
+                sum += (Real) histogram->counts[first+j];
+        }
+
+        (*counts)[i] = sum / (Real) (2 * half_width + 1);
+    }
+
+    return( n );
+}
+
+public  void  initialize_joint_histogram(
+    joint_histogram_struct  *histogram,
+    Real                    min_value1,
+    Real                    max_value1,
+    int                     n_bins1,
+    Real                    min_value2,
+    Real                    max_value2,
+    int                     n_bins2 )
+{
+    int   i, n_counts;
+
+    initialize_bin_range( &histogram->ranges[0], min_value1, max_value1,
+                          n_bins1 );
+    initialize_bin_range( &histogram->ranges[1], min_value2, max_value2,
+                          n_bins2 );
+
+    n_counts = histogram->ranges[0].n_bins * histogram->ranges[1].n_bins;
+    ALLOC( histogram->counts, n_counts );
+    for_less( i, 0, n_counts )
+        histogram->counts[i] = 0;
+
+    histogram->n_samples = 0;
+}
+
+public  void  delete_joint_histogram(
+    joint_histogram_struct  *histogram )
+{
+    delete_bin_range( &histogram->ranges[0] );
+    delete_bin_range( &histogram->ranges[1] );
+    FREE( histogram->counts );
+}
+
+/*--- adds pairs of values held in float buffers, such as the intensities and
+      gradient magnitudes from compute_volume_derivatives() */
+
+public  void  add_float_values_to_joint_histogram(
+    joint_histogram_struct  *histogram,
+    int                     n_values,
+    float                   values1[],
+    float                   values2[] )
+{
+    int   i, bin1, bin2, n_bins2;
+
+    n_bins2 = histogram->ranges[1].n_bins;
+
+    for_less( i, 0, n_values )
+    {
+        bin1 = get_value_bin( &histogram->ranges[0], (Real) values1[i] );
+        bin2 = get_value_bin( &histogram->ranges[1], (Real) values2[i] );
+
+        if( bin1 >= 0 && bin2 >= 0 )
+        {
+            ++histogram->counts[bin1*n_bins2+bin2];
+            ++histogram->n_samples;
+        }
+    }
+}
+
+/* ----------------------------- MNI Header -----------------------------------
+@NAME       : add_volumes_to_joint_histogram
+@INPUT      : histogram
+              volume1
+              volume2
+              mask_volume
+@OUTPUT     : histogram
+@RETURNS    : OK or ERROR
+@DESCRIPTION: Adds the pairs of real values of corresponding voxels of two
+              volumes of the same sizes to the joint histogram, restricted
+              to the voxels where mask_volume is nonzero if it is not NULL.
+              With a label volume as volume1 and one bin per label, this
+              gives the histogram of volume2 within each label.
+@METHOD     :
+@GLOBALS    :
+@CALLS      :
+@CREATED    :
+@MODIFIED   :
+---------------------------------------------------------------------------- */
+
+public  Status  add_volumes_to_joint_histogram(
+    joint_histogram_struct  *histogram,
+    Volume                  volume1,
+    Volume                  volume2,
+    Volume                  mask_volume )
+{
+    int                i, *bins1, *bins2, n_bins2, n_samples, max_span;
+    Real               *mask_values;
+    voxel_scan_struct  scan1, scan2, mask_scan;
+    voxel_span_struct  span1, span2, mask_span;
+
+    if( !volumes_match( volume1, volume2 ) ||
+        (mask_volume != NULL && !volumes_match( volume1, mask_volume )) )
+    {
+        print_error( "Volumes for the joint histogram differ in size.\n" );
+        return( ERROR );
+    }
+
+    initialize_voxel_scan( &scan1, volume1, 0 );
+    max_span = get_voxel_scan_max_span( &scan1 );
+    initialize_voxel_scan( &scan2, volume2, max_span );
+
+    ALLOC( bins1, max_span );
+    ALLOC( bins2, max_span );
+
+    if( mask_volume != NULL )
+    {
+        initialize_voxel_scan( &mask_scan, mask_volume, max_span );
+        ALLOC( mask_values, max_span );
+    }
+
+    n_bins2 = histogram->ranges[1].n_bins;
+    n_samples = 0;
+
+    while( get_next_voxel_span( &scan1, &span1 ) &&
+           get_next_voxel_span( &scan2, &span2 ) )
+    {
+        get_voxel_span_bins( &histogram->ranges[0], &span1, bins1 );
+        get_voxel_span_bins( &histogram->ranges[1], &span2, bins2 );
+
+        if( mask_volume != NULL &&
+            get_next_voxel_span( &mask_scan, &mask_span ) )
+            mask_voxel_span_bins( &mask_span, mask_values, bins1 );
+
+        for_less( i, 0, span1.n_voxels )
+        {
+            if( bins1[i] >= 0 && bins2[i] >= 0 )
+            {
+                ++histogram->counts[bins1[i]*n_bins2+bins2[i]];
+                ++n_samples;
+            }
+        }
+    }
+
+    histogram->n_samples += n_samples;
+
+    if( mask_volume != NULL )
+    {
+        FREE( mask_values );
+        delete_voxel_scan( &mask_scan );
+    }
+
+    FREE( bins1 );
+    FREE( bins2 );
+    delete_voxel_scan( &scan1 );
+    delete_voxel_scan( &scan2 );
+
+    return( OK );
+}
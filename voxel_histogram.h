@@ -0,0 +1,50 @@
+#ifndef  DEF_VOXEL_HISTOGRAM_H
+#define  DEF_VOXEL_HISTOGRAM_H
+
+#include  <bicpl.h>
+#include  <voxel_scan.h>
+
+/*--- n_bins equal bins spanning [min_value,max_value], a value equal to
+      max_value falling in the last bin and values outside the range in
+      none.  For byte and short voxels the bin of every possible voxel value
+      is tabulated once, so that spans are binned by table lookup. */
+
+typedef  struct
+{
+    int                  n_bins;
+    Real                 min_value;
+    Real                 max_value;
+    Real                 bin_width;
+    voxel_table_struct   table;
+} bin_range_struct;
+
+typedef  struct
+{
+    bin_range_struct   range;
+    int                n_samples;
+    int                *counts;
+} voxel_histogram_struct;
+
+/*--- counts[i*ranges[1].n_bins+j] is the number of samples in bin i of the
+      first value and bin j of the second */
+
+typedef  struct
+{
+    bin_range_struct   ranges[2];
+    int                n_samples;
+    int                *counts;
+} joint_histogram_struct;
+
+#ifndef  public
+#define       public   extern
+#define       public_was_defined_here
+#endif
+
+#include  <voxel_histogram_prototypes.h>
+
+#ifdef  public_was_defined_here
+#undef       public
+#undef       public_was_defined_here
+#endif
+
+#endif
@@ -0,0 +1,75 @@
+#ifndef  DEF_VOXEL_HISTOGRAM_PROTOTYPES
+#define  DEF_VOXEL_HISTOGRAM_PROTOTYPES
+
+public  void  initialize_bin_range(
+    bin_range_struct  *range,
+    Real              min_value,
+    Real              max_value,
+    int               n_bins );
+
+public  void  delete_bin_range(
+    bin_range_struct  *range );
+
+public  int  get_value_bin(
+    bin_range_struct  *range,
+    Real              value );
+
+public  void  get_voxel_span_bins(
+    bin_range_struct   *range,
+    voxel_span_struct  *span,
+    int                bins[] );
+
+public  void  initialize_voxel_histogram(
+    voxel_histogram_struct  *histogram,
+    Real                    min_value,
+    Real                    max_value,
+    int                     n_bins );
+
+public  void  delete_voxel_histogram(
+    voxel_histogram_struct  *histogram );
+
+public  void  add_values_to_voxel_histogram(
+    voxel_histogram_struct  *histogram,
+    int                     n_values,
+    Real                    values[] );
+
+public  Status  add_volume_to_voxel_histogram(
+    voxel_histogram_struct  *histogram,
+    Volume                  volume,
+    Volume                  mask_volume );
+
+public  void  merge_voxel_histograms(
+    voxel_histogram_struct  *histogram,
+    voxel_histogram_struct  *other );
+
+public  int  get_voxel_histogram_counts(
+    voxel_histogram_struct  *histogram,
+    Real                    filter_width,
+    Real                    *counts[],
+    Real                    *scale,
+    Real                    *trans );
+
+public  void  initialize_joint_histogram(
+    joint_histogram_struct  *histogram,
+    Real                    min_value1,
+    Real                    max_value1,
+    int                     n_bins1,
+    Real                    min_value2,
+    Real                    max_value2,
+    int                     n_bins2 );
+
+public  void  delete_joint_histogram(
+    joint_histogram_struct  *histogram );
+
+public  void  add_float_values_to_joint_histogram(
+    joint_histogram_struct  *histogram,
+    int                     n_values,
+    float                   values1[],
+    float                   values2[] );
+
+public  Status  add_volumes_to_joint_histogram(
+    joint_histogram_struct  *histogram,
+    Volume                  volume1,
+    Volume                  volume2,
+    Volume                  mask_volume );
+#endif
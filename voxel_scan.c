@@ -0,0 +1,431 @@
+#include  <volume_io/internal_volume_io.h>
+#include  <voxel_scan.h>
+
+/*--- default number of voxels per span, rounded down to whole slices but
+      never less than one slice */
+
+#define  DEFAULT_VOXELS_PER_SPAN   262144
+
+/* ----------------------------- MNI Header -----------------------------------
+@NAME       : initialize_voxel_scan
+@INPUT      : volume
+              max_voxels_per_span
+@OUTPUT     : scan
+@RETURNS    :
+@DESCRIPTION: Starts a scan of all the voxels of the volume, in spans of at
+              most max_voxels_per_span voxels, or a default if this is not
+              positive.  Each span is a whole number of slices of the first
+              dimension.
+@METHOD     :
+@GLOBALS    :
+@CALLS      :
+@CREATED    :
+@MODIFIED   :
+---------------------------------------------------------------------------- */
+
+public  void  initialize_voxel_scan(
+    voxel_scan_struct  *scan,
+    Volume             volume,
+    int                max_voxels_per_span )
+{
+    int    dim;
+
+    scan->volume = volume;
+    scan->n_dimensions = get_volume_n_dimensions( volume );
+    get_volume_sizes( volume, scan->sizes );
+
+    for_less( dim, scan->n_dimensions, MAX_DIMENSIONS )
+        scan->sizes[dim] = 1;
+
+    scan->slice_size = 1;
+    for_less( dim, 1, scan->n_dimensions )
+        scan->slice_size *= scan->sizes[dim];
+
+    if( max_voxels_per_span <= 0 )
+        max_voxels_per_span = DEFAULT_VOXELS_PER_SPAN;
+
+    scan->slices_per_span = MAX( 1, max_voxels_per_span / scan->slice_size );
+    scan->slices_per_span = MIN( scan->slices_per_span, scan->sizes[0] );
+
+    scan->next_slice = 0;
+    scan->data_type = get_volume_data_type( volume );
+    scan->translation = convert_voxel_to_value( volume, 0.0 );
+    scan->scale = convert_voxel_to_value( volume, 1.0 ) - scan->translation;
+
+    /*--- volumes in memory are stored contiguously, as assumed by
+          set_all_volume_label_data() */
+
+    scan->in_memory = !volume->is_cached_volume;
+
+    if( scan->in_memory )
+    {
+        GET_VOXEL_PTR( scan->first_voxel, volume, 0, 0, 0, 0, 0 );
+        scan->buffer = NULL;
+    }
+    else
+    {
+        scan->first_voxel = NULL;
+        ALLOC( scan->buffer, scan->slices_per_span * scan->slice_size );
+    }
+
+    scan->values = NULL;
+}
+
+public  void  delete_voxel_scan(
+    voxel_scan_struct  *scan )
+{
+    if( scan->buffer != NULL )
+    {
+        FREE( scan->buffer );
+    }
+
+    if( scan->values != NULL )
+    {
+        FREE( scan->values );
+    }
+}
+
+public  int  get_voxel_scan_max_span(
+    voxel_scan_struct  *scan )
+{
+    return( scan->slices_per_span * scan->slice_size );
+}
+
+public  BOOLEAN  get_next_voxel_span(
+    voxel_scan_struct  *scan,
+    voxel_span_struct  *span )
+{
+    int    n_slices;
+
+    if( scan->next_slice >= scan->sizes[0] )
+        return( FALSE );
+
+    n_slices = MIN( scan->slices_per_span,
+                    scan->sizes[0] - scan->next_slice );
+
+    span->start = scan->next_slice * scan->slice_size;
+    span->n_voxels = n_slices * scan->slice_size;
+    span->scale = scan->scale;
+    span->translation = scan->translation;
+
+    if( scan->in_memory )
+    {
+        span->data_type = scan->data_type;
+        span->voxels = (void *) ((char *) scan->first_voxel +
+                                 (size_t) span->start *
+                                 (size_t) get_type_size( scan->data_type ));
+    }
+    else
+    {
+        get_volume_voxel_hyperslab( scan->volume, scan->next_slice, 0, 0, 0, 0,
+                                    n_slices, scan->sizes[1], scan->sizes[2],
+                                    scan->sizes[3], scan->sizes[4],
+                                    scan->buffer );
+        span->data_type = DOUBLE;
+        span->voxels = (void *) scan->buffer;
+    }
+
+    scan->next_slice += n_slices;
+
+    return( TRUE );
+}
+
+/*--- one loop per data type, so that each is a plain conversion the
+      compiler can unroll and vectorise */
+
+#define  CONVERT_SPAN( type )                                               \
+    {                                                                       \
+        type  *ptr = (type *) span->voxels;                                 \
+                                                                            \
+        if( real_flag )                                                     \
+        {                                                                   \
+            for_less( i, 0, n )                                             \
+                values[i] = scale * (Real) ptr[i] + translation;            \
+        }                                                                   \
+        else                                                                \
+        {                                                                   \
+            for_less( i, 0, n )                                             \
+                values[i] = (Real) ptr[i];                                  \
+        }                                                                   \
+    }
+
+/* ----------------------------- MNI Header -----------------------------------
+@NAME       : get_voxel_span_values
+@INPUT      : span
+              real_flag
+@OUTPUT     : values
+@RETURNS    :
+@DESCRIPTION: Converts the voxels of the span to Real, as real values if
+              real_flag is TRUE, otherwise as voxel values.
+@METHOD     :
+@GLOBALS    :
+@CALLS      :
+@CREATED    :
+@MODIFIED   :
+---------------------------------------------------------------------------- */
+
+public  void  get_voxel_span_values(
+    voxel_span_struct  *span,
+    BOOLEAN            real_flag,
+    Real               values[] )
+{
+    int    i, n;
+    Real   scale, translation;
+
+    n = span->n_voxels;
+    scale = span->scale;
+    translation = span->translation;
+
+    switch( span->data_type )
+    {
+    case UNSIGNED_BYTE:   CONVERT_SPAN( unsigned char );    break;
+    case SIGNED_BYTE:     CONVERT_SPAN( signed char );      break;
+    case UNSIGNED_SHORT:  CONVERT_SPAN( unsigned short );   break;
+    case SIGNED_SHORT:    CONVERT_SPAN( short );            break;
+    case UNSIGNED_INT:    CONVERT_SPAN( unsigned int );     break;
+    case SIGNED_INT:      CONVERT_SPAN( int );              break;
+    case FLOAT:           CONVERT_SPAN( float );            break;
+    case DOUBLE:          CONVERT_SPAN( double );           break;
+    default:
+        handle_internal_error( "get_voxel_span_values" );
+        break;
+    }
+}
+
+/*--- one loop per data type for storing real values back into the voxels,
+      rounding for integer types */
+
+#define  STORE_SPAN( type, rounding )                                       \
+    {                                                                       \
+        type  *ptr = (type *) span->voxels;                                 \
+                                                                            \
+        for_less( i, 0, n )                                                 \
+            ptr[i] = (type) rounding( (values[i] - translation) / scale );  \
+    }
+
+#define  NO_ROUNDING( x )   (x)
+
+/* ----------------------------- MNI Header -----------------------------------
+@NAME       : set_voxel_span_values
+@INPUT      : scan
+              span
+              values
+@OUTPUT     :
+@RETURNS    :
+@DESCRIPTION: Stores real values into the voxels of a span returned by
+              get_next_voxel_span(), directly for volumes in memory and as a
+              hyperslab for cached volumes.
+@METHOD     :
+@GLOBALS    :
+@CALLS      :
+@CREATED    :
+@MODIFIED   :
+---------------------------------------------------------------------------- */
+
+public  void  set_voxel_span_values(
+    voxel_scan_struct  *scan,
+    voxel_span_struct  *span,
+    Real               values[] )
+{
+    int    i, n, first_slice, n_slices;
+    Real   scale, translation;
+
+    if( !scan->in_memory )
+    {
+        first_slice = span->start / scan->slice_size;
+        n_slices = span->n_voxels / scan->slice_size;
+
+        set_volume_value_hyperslab( scan->volume, first_slice, 0, 0, 0, 0,
+                                    n_slices, scan->sizes[1], scan->sizes[2],
+                                    scan->sizes[3], scan->sizes[4], values );
+        return;
+    }
+
+    n = span->n_voxels;
+    scale = span->scale;
+    translation = span->translation;
+
+    if( scale == 0.0 )
+        scale = 1.0;
+
+    switch( span->data_type )
+    {
+    case UNSIGNED_BYTE:   STORE_SPAN( unsigned char, ROUND );    break;
+    case SIGNED_BYTE:     STORE_SPAN( signed char, ROUND );      break;
+    case UNSIGNED_SHORT:  STORE_SPAN( unsigned short, ROUND );   break;
+    case SIGNED_SHORT:    STORE_SPAN( short, ROUND );            break;
+    case UNSIGNED_INT:    STORE_SPAN( unsigned int, ROUND );     break;
+    case SIGNED_INT:      STORE_SPAN( int, ROUND );              break;
+    case FLOAT:           STORE_SPAN( float, NO_ROUNDING );      break;
+    case DOUBLE:          STORE_SPAN( double, NO_ROUNDING );     break;
+    default:
+        handle_internal_error( "set_voxel_span_values" );
+        break;
+    }
+}
+
+/*--- steps to the next span and converts it into the scan's own buffer */
+
+public  BOOLEAN  get_next_voxel_span_values(
+    voxel_scan_struct  *scan,
+    BOOLEAN            real_flag,
+    int                *start,
+    int                *n_voxels,
+    Real               **values )
+{
+    voxel_span_struct  span;
+
+    if( !get_next_voxel_span( scan, &span ) )
+        return( FALSE );
+
+    if( scan->values == NULL )
+    {
+        ALLOC( scan->values, get_voxel_scan_max_span( scan ) );
+    }
+
+    get_voxel_span_values( &span, real_flag, scan->values );
+
+    *start = span.start;
+    *n_voxels = span.n_voxels;
+    *values = scan->values;
+
+    return( TRUE );
+}
+
+/*--- converts the index of a voxel within the scan to its voxel indices */
+
+public  void  get_voxel_scan_position(
+    voxel_scan_struct  *scan,
+    int                index,
+    int                voxel[] )
+{
+    int    dim;
+
+    for( dim = MAX_DIMENSIONS-1;  dim >= 0;  --dim )
+    {
+        voxel[dim] = index % scan->sizes[dim];
+        index /= scan->sizes[dim];
+    }
+}
+
+public  void  initialize_voxel_table(
+    voxel_table_struct  *table )
+{
+    table->data_type = NO_DATA_TYPE;
+    table->entries = NULL;
+}
+
+/*--- frees the entries, leaving the table empty, as after the values of its
+      entries have changed */
+
+public  void  delete_voxel_table(
+    voxel_table_struct  *table )
+{
+    if( table->entries != NULL )
+    {
+        FREE( table->entries );
+    }
+
+    initialize_voxel_table( table );
+}
+
+/*--- tabulates the entry of every voxel value of the span's type, unless
+      the table already holds these for the same type and conversion */
+
+private  void  check_voxel_table(
+    voxel_table_struct  *table,
+    voxel_span_struct   *span,
+    int                 (*get_entry) ( Real, void * ),
+    void                *entry_data )
+{
+    int   min_voxel, max_voxel, v;
+
+    if( table->entries != NULL && table->data_type == span->data_type &&
+        table->scale == span->scale &&
+        table->translation == span->translation )
+        return;
+
+    switch( span->data_type )
+    {
+    case UNSIGNED_BYTE:   min_voxel = 0;       max_voxel = 255;     break;
+    case SIGNED_BYTE:     min_voxel = -128;    max_voxel = 127;     break;
+    case UNSIGNED_SHORT:  min_voxel = 0;       max_voxel = 65535;   break;
+    default:              min_voxel = -32768;  max_voxel = 32767;   break;
+    }
+
+    delete_voxel_table( table );
+
+    ALLOC( table->entries, max_voxel - min_voxel + 1 );
+
+    for_inclusive( v, min_voxel, max_voxel )
+    {
+        table->entries[v-min_voxel] = (*get_entry)( span->scale * (Real) v +
+                                                    span->translation,
+                                                    entry_data );
+    }
+
+    table->data_type = span->data_type;
+    table->scale = span->scale;
+    table->translation = span->translation;
+    table->offset = -min_voxel;
+}
+
+#define  TABLE_ENTRIES( type )                                              \
+    {                                                                       \
+        type  *ptr = (type *) span->voxels;                                 \
+        int   *table_entries = table->entries + table->offset;              \
+                                                                            \
+        for_less( i, 0, span->n_voxels )                                    \
+            entries[i] = table_entries[(int) ptr[i]];                       \
+    }
+
+/* ----------------------------- MNI Header -----------------------------------
+@NAME       : get_voxel_span_table_entries
+@INPUT      : table
+              span
+              get_entry   - function giving the entry of a real value
+              entry_data  - passed to get_entry
+@OUTPUT     : entries
+@RETURNS    : TRUE if the span was looked up
+@DESCRIPTION: Looks up the entry of each voxel of a byte or short span in a
+              table of all the possible voxel values, building the table
+              from get_entry first if needed.  Returns FALSE for spans of
+              other types, which the caller converts itself.
+@METHOD     :
+@GLOBALS    :
+@CALLS      :
+@CREATED    :
+@MODIFIED   :
+---------------------------------------------------------------------------- */
+
+public  BOOLEAN  get_voxel_span_table_entries(
+    voxel_table_struct  *table,
+    voxel_span_struct   *span,
+    int                 (*get_entry) ( Real, void * ),
+    void                *entry_data,
+    int                 entries[] )
+{
+    int   i;
+
+    switch( span->data_type )
+    {
+    case UNSIGNED_BYTE:
+    case SIGNED_BYTE:
+    case UNSIGNED_SHORT:
+    case SIGNED_SHORT:
+        check_voxel_table( table, span, get_entry, entry_data );
+        break;
+    default:
+        return( FALSE );
+    }
+
+    switch( span->data_type )
+    {
+    case UNSIGNED_BYTE:   TABLE_ENTRIES( unsigned char );      break;
+    case SIGNED_BYTE:     TABLE_ENTRIES( signed char );        break;
+    case UNSIGNED_SHORT:  TABLE_ENTRIES( unsigned short );     break;
+    default:              TABLE_ENTRIES( short );              break;
+    }
+
+    return( TRUE );
+}
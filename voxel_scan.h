@@ -0,0 +1,66 @@
+#ifndef  DEF_VOXEL_SCAN_H
+#define  DEF_VOXEL_SCAN_H
+
+#include  <bicpl.h>
+
+/*--- a scan over all the voxels of a volume, in storage order with the last
+      dimension varying fastest, as a sequence of spans of whole slices of
+      the first dimension.  For volumes held in memory a span points
+      directly at the stored voxels, of the volume's data type, and real
+      values are scale * voxel + translation.  Cached volumes are read a
+      span at a time into a buffer of Real voxel values. */
+
+typedef  struct
+{
+    Data_types   data_type;
+    void         *voxels;
+    int          start;
+    int          n_voxels;
+    Real         scale;
+    Real         translation;
+} voxel_span_struct;
+
+typedef  struct
+{
+    Volume              volume;
+    int                 n_dimensions;
+    int                 sizes[MAX_DIMENSIONS];
+    int                 slice_size;
+    int                 slices_per_span;
+    int                 next_slice;
+    BOOLEAN             in_memory;
+    Data_types          data_type;
+    void                *first_voxel;
+    Real                scale;
+    Real                translation;
+    Real                *buffer;
+    Real                *values;
+} voxel_scan_struct;
+
+/*--- an integer entry, such as a bin or a label, for every possible voxel
+      value of byte and short spans, so that their spans are looked up
+      rather than converted to real values.  The table is rebuilt when a
+      span has a different type or conversion. */
+
+typedef  struct
+{
+    Data_types   data_type;
+    Real         scale;
+    Real         translation;
+    int          offset;
+    int          *entries;
+} voxel_table_struct;
+
+#ifndef  public
+#define       public   extern
+#define       public_was_defined_here
+#endif
+
+#include  <voxel_scan_prototypes.h>
+
+#ifdef  public_was_defined_here
+#undef       public
+#undef       public_was_defined_here
+#endif
+
+#endif
@@ -0,0 +1,53 @@
+#ifndef  DEF_VOXEL_SCAN_PROTOTYPES
+#define  DEF_VOXEL_SCAN_PROTOTYPES
+
+public  void  initialize_voxel_scan(
+    voxel_scan_struct  *scan,
+    Volume             volume,
+    int                max_voxels_per_span );
+
+public  void  delete_voxel_scan(
+    voxel_scan_struct  *scan );
+
+public  int  get_voxel_scan_max_span(
+    voxel_scan_struct  *scan );
+
+public  BOOLEAN  get_next_voxel_span(
+    voxel_scan_struct  *scan,
+    voxel_span_struct  *span );
+
+public  void  get_voxel_span_values(
+    voxel_span_struct  *span,
+    BOOLEAN            real_flag,
+    Real               values[] );
+
+public  void  set_voxel_span_values(
+    voxel_scan_struct  *scan,
+    voxel_span_struct  *span,
+    Real               values[] );
+
+public  BOOLEAN  get_next_voxel_span_values(
+    voxel_scan_struct  *scan,
+    BOOLEAN            real_flag,
+    int                *start,
+    int                *n_voxels,
+    Real               **values );
+
+public  void  get_voxel_scan_position(
+    voxel_scan_struct  *scan,
+    int                index,
+    int                voxel[] );
+
+public  void  initialize_voxel_table(
+    voxel_table_struct  *table );
+
+public  void  delete_voxel_table(
+    voxel_table_struct  *table );
+
+public  BOOLEAN  get_voxel_span_table_entries(
+    voxel_table_struct  *table,
+    voxel_span_struct   *span,
+    int                 (*get_entry) ( Real, void * ),
+    void                *entry_data,
+    int                 entries[] );
+#endif
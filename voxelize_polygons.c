@@ -0,0 +1,435 @@
+#include  <volume_io/internal_volume_io.h>
+#include  <voxelize_polygons.h>
+
+/*--- triangles are binned into slabs of this many x slices, and each slab
+      is rasterized and filled on its own */
+
+#define  SLAB_SIZE   8
+
+typedef  struct
+{
+    int    row;
+    Real   z;
+} crossing_struct;
+
+private  int  compare_crossings(
+    const void  *p1,
+    const void  *p2 )
+{
+    const crossing_struct  *c1 = (const crossing_struct *) p1;
+    const crossing_struct  *c2 = (const crossing_struct *) p2;
+
+    if( c1->row != c2->row )
+        return( c1->row - c2->row );
+    else if( c1->z < c2->z )
+        return( -1 );
+    else if( c1->z > c2->z )
+        return( 1 );
+    else
+        return( 0 );
+}
+
+/*--- separating axis test of a triangle against the voxel cube centred at
+      the origin, the triangle vertices being relative to the voxel centre */
+
+private  BOOLEAN  triangle_overlaps_voxel(
+    Real   v[3][N_DIMENSIONS] )
+{
+    int    i, k, axis, dim;
+    Real   edge[3][N_DIMENSIONS], a[N_DIMENSIONS], normal[N_DIMENSIONS];
+    Real   p, p_min, p_max, r;
+
+    for_less( dim, 0, N_DIMENSIONS )
+    {
+        p_min = MIN3( v[0][dim], v[1][dim], v[2][dim] );
+        p_max = MAX3( v[0][dim], v[1][dim], v[2][dim] );
+        if( p_min > 0.5 || p_max < -0.5 )
+            return( FALSE );
+    }
+
+    for_less( k, 0, 3 )
+    {
+        for_less( dim, 0, N_DIMENSIONS )
+            edge[k][dim] = v[(k+1)%3][dim] - v[k][dim];
+    }
+
+    /*--- plane of the triangle */
+
+    normal[X] = edge[0][Y] * edge[1][Z] - edge[0][Z] * edge[1][Y];
+    normal[Y] = edge[0][Z] * edge[1][X] - edge[0][X] * edge[1][Z];
+    normal[Z] = edge[0][X] * edge[1][Y] - edge[0][Y] * edge[1][X];
+
+    p = normal[X] * v[0][X] + normal[Y] * v[0][Y] + normal[Z] * v[0][Z];
+    r = 0.5 * (FABS(normal[X]) + FABS(normal[Y]) + FABS(normal[Z]));
+    if( p > r || p < -r )
+        return( FALSE );
+
+    /*--- cross products of the cube axes with the triangle edges */
+
+    for_less( k, 0, 3 )
+    {
+        for_less( axis, 0, N_DIMENSIONS )
+        {
+            a[axis] = 0.0;
+            a[(axis+1)%N_DIMENSIONS] = -edge[k][(axis+2)%N_DIMENSIONS];
+            a[(axis+2)%N_DIMENSIONS] = edge[k][(axis+1)%N_DIMENSIONS];
+
+            p_min = 0.0;
+            p_max = 0.0;
+            for_less( i, 0, 3 )
+            {
+                p = a[X] * v[i][X] + a[Y] * v[i][Y] + a[Z] * v[i][Z];
+                if( i == 0 || p < p_min )
+                    p_min = p;
+                if( i == 0 || p > p_max )
+                    p_max = p;
+            }
+
+            r = 0.5 * (FABS(a[X]) + FABS(a[Y]) + FABS(a[Z]));
+            if( p_min > r || p_max < -r )
+                return( FALSE );
+        }
+    }
+
+    return( TRUE );
+}
+
+/*--- tests whether the line through (x,y) parallel to the z axis crosses
+      the triangle, and where.  Each edge function is evaluated from its
+      lower numbered vertex, so triangles sharing an edge get exactly
+      opposite values, and points on an edge are assigned to one side as
+      if moved by an infinitesimal (e, e^2).  Each crossing of a closed
+      surface is then counted exactly once. */
+
+private  BOOLEAN  ray_crosses_triangle(
+    Real   **voxels,
+    int    tri[],
+    Real   px,
+    Real   py,
+    Real   *z )
+{
+    int    k, a, b, lo, hi;
+    Real   area, e, e_own[3], dx, dy;
+
+    area = (voxels[tri[1]][X] - voxels[tri[0]][X]) *
+           (voxels[tri[2]][Y] - voxels[tri[0]][Y]) -
+           (voxels[tri[1]][Y] - voxels[tri[0]][Y]) *
+           (voxels[tri[2]][X] - voxels[tri[0]][X]);
+
+    if( area == 0.0 )
+        return( FALSE );
+
+    for_less( k, 0, 3 )
+    {
+        a = tri[k];
+        b = tri[(k+1)%3];
+        lo = MIN( a, b );
+        hi = MAX( a, b );
+
+        dx = voxels[hi][X] - voxels[lo][X];
+        dy = voxels[hi][Y] - voxels[lo][Y];
+        e = dx * (py - voxels[lo][Y]) - dy * (px - voxels[lo][X]);
+
+        if( a != lo )
+            e = -e;
+
+        e_own[k] = e;
+
+        if( e == 0.0 )
+        {
+            e = (dy != 0.0) ? -dy : dx;
+            if( a != lo )
+                e = -e;
+        }
+
+        if( (area > 0.0 && e <= 0.0) || (area < 0.0 && e >= 0.0) )
+            return( FALSE );
+    }
+
+    /*--- e_own[k] is the barycentric weight of the vertex opposite edge k */
+
+    *z = (e_own[1] * voxels[tri[0]][Z] + e_own[2] * voxels[tri[1]][Z] +
+          e_own[0] * voxels[tri[2]][Z]) / area;
+
+    return( TRUE );
+}
+
+private  void  add_crossing(
+    int               *n_crossings,
+    int               *n_alloced,
+    crossing_struct   **crossings,
+    int               row,
+    Real              z )
+{
+    if( *n_crossings >= *n_alloced )
+    {
+        SET_ARRAY_SIZE( *crossings, *n_alloced, 2 * *n_alloced + 1,
+                        DEFAULT_CHUNK_SIZE );
+        *n_alloced = 2 * *n_alloced + 1;
+    }
+
+    (*crossings)[*n_crossings].row = row;
+    (*crossings)[*n_crossings].z = z;
+    ++(*n_crossings);
+}
+
+/* ----------------------------- MNI Header -----------------------------------
+@NAME       : voxelize_polygons
+@INPUT      : polygons
+              volume
+              surface_label   - label for voxels the surface passes through,
+                                or 0 for none
+              inside_label    - label for voxels inside the closed surface,
+                                or 0 for none
+              labels          - voxel labels of the volume, see
+                                VOXEL_LABEL_INDEX()
+@OUTPUT     : labels
+@RETURNS    :
+@DESCRIPTION: Labels the voxels touched by the polygons, and those inside
+              them, without a flood fill.  A voxel is touched if the cube
+              of the voxel intersects one of the triangles the polygons are
+              split into.  A voxel is inside if the line through it along z
+              crosses the surface an odd number of times before reaching it.
+              Voxels already labelled are left alone by the inside fill.
+@METHOD     : The triangles are binned into slabs of x slices.  For each
+              slab, each triangle is tested against the voxels in its
+              bounding box, and its crossings with the z lines of the slab
+              are collected, sorted, and filled between in pairs.
+@GLOBALS    :
+@CALLS      :
+@CREATED    :
+@MODIFIED   :
+---------------------------------------------------------------------------- */
+
+public  void  voxelize_polygons(
+    polygons_struct  *polygons,
+    Volume           volume,
+    int              surface_label,
+    int              inside_label,
+    unsigned char    labels[] )
+{
+    int              sizes[MAX_DIMENSIONS], point, poly, size, k, dim;
+    int              n_triangles, *triangles, *tri, t, slab, n_slabs;
+    int              *slab_starts, *slab_triangles, *slab_counts;
+    int              lo[N_DIMENSIONS], hi[N_DIMENSIONS], x, y, z;
+    int              x_start, x_end, n_crossings, n_alloced, i, row;
+    int              z_start, z_end, index;
+    Real             **voxels, v[3][N_DIMENSIONS], t_min, t_max, cross_z;
+    crossing_struct  *crossings;
+
+    get_volume_sizes( volume, sizes );
+
+    if( polygons->n_points == 0 || sizes[X] <= 0 )
+        return;
+
+    /*--- all positions are converted to voxel coordinates once */
+
+    ALLOC2D( voxels, polygons->n_points, N_DIMENSIONS );
+
+    for_less( point, 0, polygons->n_points )
+    {
+        Real   voxel[MAX_DIMENSIONS];
+
+        convert_world_to_voxel( volume, RPoint_x(polygons->points[point]),
+                                RPoint_y(polygons->points[point]),
+                                RPoint_z(polygons->points[point]), voxel );
+        for_less( dim, 0, N_DIMENSIONS )
+            voxels[point][dim] = voxel[dim];
+    }
+
+    /*--- split the polygons into triangles around their first vertex */
+
+    n_triangles = 0;
+    for_less( poly, 0, polygons->n_items )
+    {
+        size = GET_OBJECT_SIZE( *polygons, poly );
+        if( size >= 3 )
+            n_triangles += size - 2;
+    }
+
+    if( n_triangles == 0 )
+    {
+        FREE2D( voxels );
+        return;
+    }
+
+    ALLOC( triangles, 3 * n_triangles );
+
+    t = 0;
+    for_less( poly, 0, polygons->n_items )
+    {
+        size = GET_OBJECT_SIZE( *polygons, poly );
+        for_less( k, 1, size - 1 )
+        {
+            triangles[3*t] = polygons->indices[
+                      POINT_INDEX( polygons->end_indices, poly, 0 )];
+            triangles[3*t+1] = polygons->indices[
+                      POINT_INDEX( polygons->end_indices, poly, k )];
+            triangles[3*t+2] = polygons->indices[
+                      POINT_INDEX( polygons->end_indices, poly, k+1 )];
+            ++t;
+        }
+    }
+
+    /*--- bin the triangles by the slabs their voxel range overlaps */
+
+    n_slabs = (sizes[X] + SLAB_SIZE - 1) / SLAB_SIZE;
+
+    ALLOC( slab_counts, n_slabs );
+    ALLOC( slab_starts, n_slabs + 1 );
+
+    for_less( slab, 0, n_slabs )
+        slab_counts[slab] = 0;
+
+    for( i = 0;  i < 2;  ++i )
+    {
+        for_less( t, 0, n_triangles )
+        {
+            tri = &triangles[3*t];
+            t_min = MIN3( voxels[tri[0]][X], voxels[tri[1]][X],
+                          voxels[tri[2]][X] );
+            t_max = MAX3( voxels[tri[0]][X], voxels[tri[1]][X],
+                          voxels[tri[2]][X] );
+            lo[X] = MAX( 0, CEILING( t_min - 0.5 ) );
+            hi[X] = MIN( sizes[X] - 1, FLOOR( t_max + 0.5 ) );
+
+            if( lo[X] > hi[X] )
+                continue;
+
+            for_inclusive( slab, lo[X] / SLAB_SIZE, hi[X] / SLAB_SIZE )
+            {
+                if( i == 0 )
+                    ++slab_counts[slab];
+                else
+                    slab_triangles[slab_starts[slab] + slab_counts[slab]++] = t;
+            }
+        }
+
+        if( i == 0 )
+        {
+            slab_starts[0] = 0;
+            for_less( slab, 0, n_slabs )
+            {
+                slab_starts[slab+1] = slab_starts[slab] + slab_counts[slab];
+                slab_counts[slab] = 0;
+            }
+
+            ALLOC( slab_triangles, MAX( 1, slab_starts[n_slabs] ) );
+        }
+    }
+
+    n_alloced = 0;
+    crossings = NULL;
+
+    for_less( slab, 0, n_slabs )
+    {
+        x_start = slab * SLAB_SIZE;
+        x_end = MIN( sizes[X], x_start + SLAB_SIZE );
+        n_crossings = 0;
+
+        for_less( i, slab_starts[slab], slab_starts[slab+1] )
+        {
+            tri = &triangles[3*slab_triangles[i]];
+
+            for_less( dim, 0, N_DIMENSIONS )
+            {
+                t_min = MIN3( voxels[tri[0]][dim], voxels[tri[1]][dim],
+                              voxels[tri[2]][dim] );
+                t_max = MAX3( voxels[tri[0]][dim], voxels[tri[1]][dim],
+                              voxels[tri[2]][dim] );
+                lo[dim] = MAX( 0, CEILING( t_min - 0.5 ) );
+                hi[dim] = MIN( sizes[dim] - 1, FLOOR( t_max + 0.5 ) );
+            }
+
+            lo[X] = MAX( lo[X], x_start );
+            hi[X] = MIN( hi[X], x_end - 1 );
+
+            /*--- conservative rasterization of the surface */
+
+            if( surface_label > 0 )
+            {
+                for_inclusive( x, lo[X], hi[X] )
+                for_inclusive( y, lo[Y], hi[Y] )
+                for_inclusive( z, lo[Z], hi[Z] )
+                {
+                    index = VOXEL_LABEL_INDEX( sizes, x, y, z );
+                    if( labels[index] == (unsigned char) surface_label )
+                        continue;
+
+                    for_less( k, 0, 3 )
+                    {
+                        v[k][X] = voxels[tri[k]][X] - (Real) x;
+                        v[k][Y] = voxels[tri[k]][Y] - (Real) y;
+                        v[k][Z] = voxels[tri[k]][Z] - (Real) z;
+                    }
+
+                    if( triangle_overlaps_voxel( v ) )
+                        labels[index] = (unsigned char) surface_label;
+                }
+            }
+
+            /*--- crossings with the z lines through the voxel centres; the
+                  triangle range is within half a voxel of the centres */
+
+            if( inside_label > 0 )
+            {
+                for_inclusive( x, lo[X], hi[X] )
+                for_inclusive( y, lo[Y], hi[Y] )
+                {
+                    if( ray_crosses_triangle( voxels, tri, (Real) x, (Real) y,
+                                              &cross_z ) )
+                    {
+                        add_crossing( &n_crossings, &n_alloced, &crossings,
+                                      (x - x_start) * sizes[Y] + y, cross_z );
+                    }
+                }
+            }
+        }
+
+        if( n_crossings == 0 )
+            continue;
+
+        qsort( (void *) crossings, (size_t) n_crossings, sizeof(crossings[0]),
+               compare_crossings );
+
+        /*--- fill between successive pairs of crossings on each line */
+
+        i = 0;
+        while( i < n_crossings )
+        {
+            row = crossings[i].row;
+
+            while( i + 1 < n_crossings && crossings[i].row == row &&
+                   crossings[i+1].row == row )
+            {
+                x = x_start + row / sizes[Y];
+                y = row % sizes[Y];
+                z_start = MAX( 0, CEILING( crossings[i].z ) );
+                z_end = MIN( sizes[Z] - 1, FLOOR( crossings[i+1].z ) );
+
+                for_inclusive( z, z_start, z_end )
+                {
+                    index = VOXEL_LABEL_INDEX( sizes, x, y, z );
+                    if( labels[index] == 0 )
+                        labels[index] = (unsigned char) inside_label;
+                }
+
+                i += 2;
+            }
+
+            /*--- skip an unpaired crossing of an open surface */
+
+            while( i < n_crossings && crossings[i].row == row )
+                ++i;
+        }
+    }
+
+    if( n_alloced > 0 )
+        FREE( crossings );
+
+    FREE( slab_triangles );
+    FREE( slab_starts );
+    FREE( slab_counts );
+    FREE( triangles );
+    FREE2D( voxels );
+}
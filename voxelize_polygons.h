@@ -0,0 +1,24 @@
+#ifndef  DEF_VOXELIZE_POLYGONS_H
+#define  DEF_VOXELIZE_POLYGONS_H
+
+#include  <bicpl.h>
+
+/*--- labels[] arrays are indexed as IJK(x,y,z,sizes[Y],sizes[Z]) with the
+      voxel sizes of the volume, in the order it was read */
+
+#define  VOXEL_LABEL_INDEX( sizes, x, y, z ) \
+             IJK( x, y, z, (sizes)[Y], (sizes)[Z] )
+
+#ifndef  public
+#define       public   extern
+#define       public_was_defined_here
+#endif
+
+#include  <voxelize_polygons_prototypes.h>
+
+#ifdef  public_was_defined_here
+#undef       public
+#undef       public_was_defined_here
+#endif
+
+#endif
@@ -0,0 +1,10 @@
+#ifndef  DEF_VOXELIZE_POLYGONS_PROTOTYPES
+#define  DEF_VOXELIZE_POLYGONS_PROTOTYPES
+
+public  void  voxelize_polygons(
+    polygons_struct  *polygons,
+    Volume           volume,
+    int              surface_label,
+    int              inside_label,
+    unsigned char    labels[] );
+#endif
@@ -0,0 +1,332 @@
+#include  <volume_io/internal_volume_io.h>
+#include  <winding_number.h>
+#include  <triangle_tree.h>
+
+/*--- generalized winding numbers of a triangulated surface, evaluated with
+      a bounding volume hierarchy: triangles of a node far enough from the
+      query points are replaced by the dipole at the node centre, closer
+      ones are summed exactly from their solid angles */
+
+#define  MAX_TRIANGLES_IN_LEAF   8
+#define  MIN_POINTS_TO_SPLIT     8
+
+/*--- the far field of each node of the triangle tree */
+
+typedef  struct
+{
+    Real    centre[N_DIMENSIONS];
+    Real    radius;
+    Real    dipole[N_DIMENSIONS];
+} winding_node_struct;
+
+struct  winding_tree_struct
+{
+    triangle_tree_struct  triangles;
+    Real                  accuracy;
+    winding_node_struct   *nodes;
+};
+
+/*--- corners of triangle t in tree order */
+
+#define  CORNER( tree, t, k, dim )  \
+             (TRIANGLE_CORNER( &(tree)->triangles, t, k )[dim])
+
+/*--- the dipole of a node is the sum of the area vectors of its triangles,
+      placed at their area weighted centroid, and its radius bounds the
+      distance from there to their corners */
+
+private  void  compute_node_dipole(
+    winding_tree   tree,
+    int            node_index )
+{
+    int                    t, k, dim;
+    Real                   total_area, area, dist_sq, max_dist_sq, d;
+    Real                   e1[N_DIMENSIONS], e2[N_DIMENSIONS];
+    Real                   normal[N_DIMENSIONS], centroid;
+    triangle_node_struct   *node;
+    winding_node_struct    *moments;
+
+    node = &tree->triangles.nodes[node_index];
+    moments = &tree->nodes[node_index];
+
+    total_area = 0.0;
+    for_less( dim, 0, N_DIMENSIONS )
+    {
+        moments->centre[dim] = 0.0;
+        moments->dipole[dim] = 0.0;
+    }
+
+    for_less( t, node->start, node->end )
+    {
+        for_less( dim, 0, N_DIMENSIONS )
+        {
+            e1[dim] = CORNER( tree, t, 1, dim ) - CORNER( tree, t, 0, dim );
+            e2[dim] = CORNER( tree, t, 2, dim ) - CORNER( tree, t, 0, dim );
+        }
+
+        normal[X] = 0.5 * (e1[Y] * e2[Z] - e1[Z] * e2[Y]);
+        normal[Y] = 0.5 * (e1[Z] * e2[X] - e1[X] * e2[Z]);
+        normal[Z] = 0.5 * (e1[X] * e2[Y] - e1[Y] * e2[X]);
+
+        area = sqrt( normal[X] * normal[X] + normal[Y] * normal[Y] +
+                     normal[Z] * normal[Z] );
+        total_area += area;
+
+        for_less( dim, 0, N_DIMENSIONS )
+        {
+            centroid = (CORNER( tree, t, 0, dim ) + CORNER( tree, t, 1, dim ) +
+                        CORNER( tree, t, 2, dim )) / 3.0;
+            moments->centre[dim] += area * centroid;
+            moments->dipole[dim] += normal[dim];
+        }
+    }
+
+    for_less( dim, 0, N_DIMENSIONS )
+    {
+        if( total_area > 0.0 )
+            moments->centre[dim] /= total_area;
+        else
+            moments->centre[dim] = (node->limits[0][dim] +
+                                    node->limits[1][dim]) / 2.0;
+    }
+
+    max_dist_sq = 0.0;
+    for_less( t, node->start, node->end )
+    {
+        for_less( k, 0, 3 )
+        {
+            dist_sq = 0.0;
+            for_less( dim, 0, N_DIMENSIONS )
+            {
+                d = CORNER( tree, t, k, dim ) - moments->centre[dim];
+                dist_sq += d * d;
+            }
+            max_dist_sq = MAX( max_dist_sq, dist_sq );
+        }
+    }
+
+    moments->radius = sqrt( max_dist_sq );
+}
+
+/* ----------------------------- MNI Header -----------------------------------
+@NAME       : create_winding_tree
+@INPUT      : polygons
+              accuracy  - a node is approximated for points further than
+                          accuracy times its radius, 2 is typical
+@OUTPUT     :
+@RETURNS    : tree
+@DESCRIPTION: Builds the hierarchy used to evaluate winding numbers of the
+              polygons, which are split into triangles around their first
+              vertex.  The surface need not be closed or free of self
+              intersections.
+@METHOD     :
+@GLOBALS    :
+@CALLS      :
+@CREATED    :
+@MODIFIED   :
+---------------------------------------------------------------------------- */
+
+public  winding_tree  create_winding_tree(
+    polygons_struct  *polygons,
+    Real             accuracy )
+{
+    winding_tree   tree;
+    int            node_index;
+
+    ALLOC( tree, 1 );
+
+    tree->accuracy = accuracy;
+
+    create_triangle_tree( polygons, MAX_TRIANGLES_IN_LEAF,
+                          &tree->triangles );
+
+    if( tree->triangles.n_nodes > 0 )
+    {
+        ALLOC( tree->nodes, tree->triangles.n_nodes );
+    }
+
+    for_less( node_index, 0, tree->triangles.n_nodes )
+        compute_node_dipole( tree, node_index );
+
+    return( tree );
+}
+
+public  void  delete_winding_tree(
+    winding_tree   tree )
+{
+    if( tree->triangles.n_nodes > 0 )
+        FREE( tree->nodes );
+
+    delete_triangle_tree( &tree->triangles );
+
+    FREE( tree );
+}
+
+/*--- solid angle of a triangle seen from the origin, over 4 pi, by the
+      formula of van Oosterom and Strackee */
+
+private  Real  triangle_winding(
+    Real   a[],
+    Real   b[],
+    Real   c[] )
+{
+    Real   la, lb, lc, det, denom;
+
+    la = sqrt( a[X] * a[X] + a[Y] * a[Y] + a[Z] * a[Z] );
+    lb = sqrt( b[X] * b[X] + b[Y] * b[Y] + b[Z] * b[Z] );
+    lc = sqrt( c[X] * c[X] + c[Y] * c[Y] + c[Z] * c[Z] );
+
+    det = a[X] * (b[Y] * c[Z] - b[Z] * c[Y]) +
+          a[Y] * (b[Z] * c[X] - b[X] * c[Z]) +
+          a[Z] * (b[X] * c[Y] - b[Y] * c[X]);
+
+    denom = la * lb * lc +
+            (a[X] * b[X] + a[Y] * b[Y] + a[Z] * b[Z]) * lc +
+            (b[X] * c[X] + b[Y] * c[Y] + b[Z] * c[Z]) * la +
+            (c[X] * a[X] + c[Y] * a[Y] + c[Z] * a[Z]) * lb;
+
+    return( 2.0 * atan2( det, denom ) / (4.0 * PI) );
+}
+
+/*--- adds the winding numbers of the triangles of a node to a batch of
+      points.  If the node is not far from the bounding box of the batch,
+      a large batch is split in two and a small one is passed on to the
+      children, so neighbouring points share the upper levels. */
+
+private  void  add_node_winding(
+    winding_tree   tree,
+    int            node_index,
+    int            n_points,
+    Real           points[][N_DIMENSIONS],
+    Real           winding[] )
+{
+    int                    p, t, k, dim, half;
+    Real                   box_dist_sq, d, dist_sq, r[N_DIMENSIONS];
+    Real                   corner[3][N_DIMENSIONS], low, high;
+    Real                   accuracy_dist;
+    triangle_node_struct   *node;
+    winding_node_struct    *moments;
+
+    node = &tree->triangles.nodes[node_index];
+    moments = &tree->nodes[node_index];
+
+    box_dist_sq = 0.0;
+    for_less( dim, 0, N_DIMENSIONS )
+    {
+        low = points[0][dim];
+        high = points[0][dim];
+        for_less( p, 1, n_points )
+        {
+            low = MIN( low, points[p][dim] );
+            high = MAX( high, points[p][dim] );
+        }
+
+        if( moments->centre[dim] < low )
+            d = low - moments->centre[dim];
+        else if( moments->centre[dim] > high )
+            d = moments->centre[dim] - high;
+        else
+            d = 0.0;
+        box_dist_sq += d * d;
+    }
+
+    accuracy_dist = tree->accuracy * moments->radius;
+
+    if( box_dist_sq > accuracy_dist * accuracy_dist )
+    {
+        for_less( p, 0, n_points )
+        {
+            dist_sq = 0.0;
+            for_less( dim, 0, N_DIMENSIONS )
+            {
+                r[dim] = moments->centre[dim] - points[p][dim];
+                dist_sq += r[dim] * r[dim];
+            }
+
+            winding[p] += (r[X] * moments->dipole[X] +
+                           r[Y] * moments->dipole[Y] +
+                           r[Z] * moments->dipole[Z]) /
+                          (4.0 * PI * dist_sq * sqrt( dist_sq ));
+        }
+    }
+    else if( node->children[0] < 0 )
+    {
+        for_less( t, node->start, node->end )
+        {
+            for_less( p, 0, n_points )
+            {
+                for_less( k, 0, 3 )
+                {
+                    for_less( dim, 0, N_DIMENSIONS )
+                        corner[k][dim] = CORNER( tree, t, k, dim ) -
+                                         points[p][dim];
+                }
+
+                winding[p] += triangle_winding( corner[0], corner[1],
+                                                corner[2] );
+            }
+        }
+    }
+    else if( n_points > MIN_POINTS_TO_SPLIT )
+    {
+        half = n_points / 2;
+        add_node_winding( tree, node_index, half, points, winding );
+        add_node_winding( tree, node_index, n_points - half,
+                          &points[half], &winding[half] );
+    }
+    else
+    {
+        add_node_winding( tree, node->children[0], n_points, points,
+                          winding );
+        add_node_winding( tree, node->children[1], n_points, points,
+                          winding );
+    }
+}
+
+/* ----------------------------- MNI Header -----------------------------------
+@NAME       : evaluate_winding_numbers
+@INPUT      : tree
+              n_points
+              points
+@OUTPUT     : winding
+@RETURNS    :
+@DESCRIPTION: Computes the winding number of the surface about each point,
+              near 1 (or -1, depending on the orientation) inside a closed
+              surface and 0 outside.  Points given in order along a line,
+              such as a row of voxels, share most of the tree traversal.
+@METHOD     :
+@GLOBALS    :
+@CALLS      :
+@CREATED    :
+@MODIFIED   :
+---------------------------------------------------------------------------- */
+
+public  void  evaluate_winding_numbers(
+    winding_tree   tree,
+    int            n_points,
+    Real           points[][N_DIMENSIONS],
+    Real           winding[] )
+{
+    int   p;
+
+    for_less( p, 0, n_points )
+        winding[p] = 0.0;
+
+    if( n_points > 0 && tree->triangles.n_nodes > 0 )
+        add_node_winding( tree, 0, n_points, points, winding );
+}
+
+public  Real  evaluate_winding_number(
+    winding_tree   tree,
+    Real           point[] )
+{
+    Real   points[1][N_DIMENSIONS], winding;
+    int    dim;
+
+    for_less( dim, 0, N_DIMENSIONS )
+        points[0][dim] = point[dim];
+
+    evaluate_winding_numbers( tree, 1, points, &winding );
+
+    return( winding );
+}
@@ -0,0 +1,24 @@
+#ifndef  DEF_WINDING_NUMBER_H
+#define  DEF_WINDING_NUMBER_H
+
+#include  <bicpl.h>
+
+struct  winding_tree_struct;
+
+typedef  struct  winding_tree_struct  *winding_tree;
+
+
+#ifndef  public
+#define       public   extern
+#define       public_was_defined_here
+#endif
+
+#include  <winding_number_prototypes.h>
+
+#ifdef  public_was_defined_here
+#undef       public
+#undef       public_was_defined_here
+#endif
+
+
+#endif
@@ -0,0 +1,20 @@
+#ifndef  DEF_WINDING_NUMBER_PROTOTYPES
+#define  DEF_WINDING_NUMBER_PROTOTYPES
+
+public  winding_tree  create_winding_tree(
+    polygons_struct  *polygons,
+    Real             accuracy );
+
+public  void  delete_winding_tree(
+    winding_tree   tree );
+
+public  void  evaluate_winding_numbers(
+    winding_tree   tree,
+    int            n_points,
+    Real           points[][N_DIMENSIONS],
+    Real           winding[] );
+
+public  Real  evaluate_winding_number(
+    winding_tree   tree,
+    Real           point[] );
+#endif